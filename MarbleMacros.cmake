@@ -152,6 +152,16 @@ macro( marble_add_test TEST_NAME )
             qt4_generate_moc( ${TEST_NAME}.cpp ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.moc )
             include_directories( ${CMAKE_CURRENT_BINARY_DIR} )
             set( ${TEST_NAME}_SRCS ${CMAKE_CURRENT_BINARY_DIR}/${TEST_NAME}.moc ${${TEST_NAME}_SRCS} )
+            # library sources compiled into the test may include their moc files as well,
+            # which are generated once for all tests
+            foreach( _test_src ${ARGN} )
+                get_filename_component( _test_src_path ${_test_src} ABSOLUTE )
+                list( FIND MARBLE_TEST_MOC_SOURCES ${_test_src_path} _test_src_index )
+                if( _test_src_index EQUAL -1 )
+                    list( APPEND MARBLE_TEST_MOC_SOURCES ${_test_src_path} )
+                    marble_qt4_automoc( ${_test_src} )
+                endif()
+            endforeach( _test_src )
           
             add_executable( ${TEST_NAME} ${${TEST_NAME}_SRCS} )
         else( QTONLY )
@@ -0,0 +1,866 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "DocumentCache.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QVariant>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+#include "GeoDataData.h"
+#include "GeoDataExtendedData.h"
+#include "GeoDataFolder.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataLineString.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataStyle.h"
+#include "GeoDataStyleMap.h"
+#include "GeoDataTimeSpan.h"
+#include "GeoDataTimeStamp.h"
+#include "GeoDataTypes.h"
+#include "MarbleDebug.h"
+
+namespace Marble
+{
+
+static const quint32 cacheMagic = 0x4d444f43; // "MDOC"
+static const quint32 formatVersion = 2;
+
+// magic, version, string count, node count and the offsets of the three sections
+static const qint64 headerSize = 4 * sizeof( quint32 ) + 3 * sizeof( qint64 );
+
+// longitude and latitude in radian and altitude, as little endian doubles
+static const qint64 nodeSize = 3 * sizeof( double );
+
+enum FeatureType {
+    DocumentFeature = 1,
+    FolderFeature = 2,
+    PlacemarkFeature = 3
+};
+
+enum GeometryType {
+    NoGeometry = 0,
+    PointGeometry = 1,
+    LineStringGeometry = 2,
+    LinearRingGeometry = 3,
+    PolygonGeometry = 4,
+    MultiGeometryGeometry = 5
+};
+
+enum ValueType {
+    StringValue = 0,
+    IntegerValue = 1,
+    RealValue = 2
+};
+
+enum FeatureFlag {
+    VisibleFlag = 0x1,
+    DescriptionCDATAFlag = 0x2,
+    InlineStyleFlag = 0x4,
+    TimeSpanFlag = 0x8,
+    TimeStampFlag = 0x10
+};
+
+static void setupStream( QDataStream &stream )
+{
+    // the layout of the packed styles depends on the stream version
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream.setByteOrder( QDataStream::LittleEndian );
+    stream.setFloatingPointPrecision( QDataStream::DoublePrecision );
+}
+
+// the default styles of the visual categories have no parent, while
+// setStyle() makes the feature the parent of its own style
+static bool hasInlineStyle( const GeoDataFeature *feature )
+{
+    const GeoDataStyle *style = feature->style();
+    return style && style->parent() != 0;
+}
+
+static bool isCached( const GeoDataFeature *feature )
+{
+    return feature->nodeType() == GeoDataTypes::GeoDataDocumentType
+        || feature->nodeType() == GeoDataTypes::GeoDataFolderType
+        || feature->nodeType() == GeoDataTypes::GeoDataPlacemarkType;
+}
+
+static bool isCachedGeometry( const GeoDataGeometry *geometry )
+{
+    if ( geometry->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+        const GeoDataMultiGeometry *multiGeometry = static_cast<const GeoDataMultiGeometry *>( geometry );
+        for ( int i = 0; i < multiGeometry->size(); ++i ) {
+            if ( !isCachedGeometry( multiGeometry->child( i ) ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return geometry->nodeType() == GeoDataTypes::GeoDataPointType
+        || geometry->nodeType() == GeoDataTypes::GeoDataLineStringType
+        || geometry->nodeType() == GeoDataTypes::GeoDataLinearRingType
+        || geometry->nodeType() == GeoDataTypes::GeoDataPolygonType;
+}
+
+static bool isCompletelyCached( const GeoDataContainer *container )
+{
+    foreach ( const GeoDataFeature *feature, container->featureList() ) {
+        if ( !isCached( feature ) ) {
+            return false;
+        }
+
+        if ( feature->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+            const GeoDataGeometry *geometry = static_cast<const GeoDataPlacemark *>( feature )->geometry();
+            if ( geometry && !isCachedGeometry( geometry ) ) {
+                return false;
+            }
+        } else if ( !isCompletelyCached( static_cast<const GeoDataContainer *>( feature ) ) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+class DocumentCacheWriter
+{
+ public:
+    DocumentCacheWriter();
+
+    bool write( QIODevice *device, const GeoDataDocument *document );
+
+ private:
+    quint32 stringId( const QString &string );
+
+    void writeFeature( const GeoDataFeature *feature );
+    void writeContainer( const GeoDataContainer *container );
+    void writeGeometry( const GeoDataGeometry *geometry );
+    void writePoint( const GeoDataCoordinates &coordinates );
+    void writeNodes( const GeoDataLineString &lineString );
+
+    QHash<QString, quint32> m_stringIds;
+    QList<QByteArray> m_strings;
+
+    QByteArray m_nodeData;
+    QDataStream m_nodes;
+    quint32 m_nodeCount;
+
+    QByteArray m_featureData;
+    QDataStream m_features;
+};
+
+DocumentCacheWriter::DocumentCacheWriter()
+    : m_nodes( &m_nodeData, QIODevice::WriteOnly ),
+      m_nodeCount( 0 ),
+      m_features( &m_featureData, QIODevice::WriteOnly )
+{
+    setupStream( m_nodes );
+    setupStream( m_features );
+}
+
+quint32 DocumentCacheWriter::stringId( const QString &string )
+{
+    QHash<QString, quint32>::const_iterator it = m_stringIds.constFind( string );
+    if ( it != m_stringIds.constEnd() ) {
+        return it.value();
+    }
+
+    const quint32 id = m_strings.size();
+    m_stringIds.insert( string, id );
+    m_strings.append( string.toUtf8() );
+    return id;
+}
+
+bool DocumentCacheWriter::write( QIODevice *device, const GeoDataDocument *document )
+{
+    writeFeature( document );
+
+    QDataStream stream( device );
+    setupStream( stream );
+
+    const qint64 stringsOffset = headerSize;
+    qint64 stringsSize = ( m_strings.size() + 1 ) * sizeof( quint32 );
+    foreach ( const QByteArray &string, m_strings ) {
+        stringsSize += string.size();
+    }
+    // the nodes are aligned to their size in memory
+    const qint64 padding = ( sizeof( double ) - ( stringsOffset + stringsSize ) % sizeof( double ) ) % sizeof( double );
+    const qint64 nodesOffset = stringsOffset + stringsSize + padding;
+    const qint64 featuresOffset = nodesOffset + m_nodeCount * nodeSize;
+
+    stream << cacheMagic << formatVersion << quint32( m_strings.size() ) << m_nodeCount;
+    stream << stringsOffset << nodesOffset << featuresOffset;
+
+    quint32 offset = 0;
+    stream << offset;
+    foreach ( const QByteArray &string, m_strings ) {
+        offset += string.size();
+        stream << offset;
+    }
+    foreach ( const QByteArray &string, m_strings ) {
+        stream.writeRawData( string.constData(), string.size() );
+    }
+    for ( int i = 0; i < padding; ++i ) {
+        stream << quint8( 0 );
+    }
+
+    stream.writeRawData( m_nodeData.constData(), m_nodeData.size() );
+    stream.writeRawData( m_featureData.constData(), m_featureData.size() );
+
+    return stream.status() == QDataStream::Ok;
+}
+
+void DocumentCacheWriter::writeFeature( const GeoDataFeature *feature )
+{
+    if ( feature->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        m_features << quint8( DocumentFeature );
+    } else if ( feature->nodeType() == GeoDataTypes::GeoDataFolderType ) {
+        m_features << quint8( FolderFeature );
+    } else {
+        Q_ASSERT( feature->nodeType() == GeoDataTypes::GeoDataPlacemarkType );
+        m_features << quint8( PlacemarkFeature );
+    }
+
+    m_features << stringId( feature->name() )
+               << stringId( feature->description() )
+               << stringId( feature->styleUrl() )
+               << stringId( feature->role() )
+               << stringId( feature->address() )
+               << stringId( feature->phoneNumber() );
+
+    quint8 flags = 0;
+    if ( feature->isVisible() ) {
+        flags |= VisibleFlag;
+    }
+    if ( feature->descriptionIsCDATA() ) {
+        flags |= DescriptionCDATAFlag;
+    }
+    if ( hasInlineStyle( feature ) ) {
+        flags |= InlineStyleFlag;
+    }
+    const GeoDataTimeSpan &timeSpan = feature->timeSpan();
+    if ( timeSpan.begin().isValid() || timeSpan.end().isValid() ) {
+        flags |= TimeSpanFlag;
+    }
+    const GeoDataTimeStamp &timeStamp = feature->timeStamp();
+    if ( timeStamp.when().isValid() ) {
+        flags |= TimeStampFlag;
+    }
+    m_features << flags;
+    m_features << qint64( feature->popularity() ) << qint32( feature->zoomLevel() ) << qint32( feature->visualCategory() );
+
+    if ( flags & InlineStyleFlag ) {
+        feature->style()->pack( m_features );
+    }
+    if ( flags & TimeSpanFlag ) {
+        timeSpan.pack( m_features );
+    }
+    if ( flags & TimeStampFlag ) {
+        // pack() leaves out the resolution
+        timeStamp.pack( m_features );
+        m_features << qint32( timeStamp.resolution() );
+    }
+
+    const GeoDataExtendedData &extendedData = feature->extendedData();
+    m_features << quint32( extendedData.size() );
+    QHash<QString, GeoDataData>::const_iterator it = extendedData.constBegin();
+    QHash<QString, GeoDataData>::const_iterator const end = extendedData.constEnd();
+    for (; it != end; ++it ) {
+        const GeoDataData &data = it.value();
+        m_features << stringId( it.key() ) << stringId( data.name() ) << stringId( data.displayName() );
+
+        const QVariant value = data.value();
+        switch ( value.type() ) {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            m_features << quint8( IntegerValue ) << qint64( value.toLongLong() );
+            break;
+        case QVariant::Double:
+            m_features << quint8( RealValue ) << value.toDouble();
+            break;
+        default:
+            m_features << quint8( StringValue ) << stringId( value.toString() );
+            break;
+        }
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataDocumentType ) {
+        const GeoDataDocument *document = static_cast<const GeoDataDocument *>( feature );
+
+        const QList<GeoDataStyle> styles = document->styles();
+        m_features << quint32( styles.size() );
+        foreach ( const GeoDataStyle &style, styles ) {
+            style.pack( m_features );
+        }
+
+        const QList<GeoDataStyleMap> styleMaps = document->styleMaps();
+        m_features << quint32( styleMaps.size() );
+        foreach ( const GeoDataStyleMap &styleMap, styleMaps ) {
+            styleMap.pack( m_features );
+        }
+    }
+
+    if ( feature->nodeType() == GeoDataTypes::GeoDataPlacemarkType ) {
+        const GeoDataPlacemark *placemark = static_cast<const GeoDataPlacemark *>( feature );
+        m_features << stringId( placemark->countryCode() ) << stringId( placemark->state() );
+        m_features << double( placemark->area() ) << qint64( placemark->population() );
+
+        const GeoDataGeometry *geometry = placemark->geometry();
+        const char *type = geometry ? geometry->nodeType() : 0;
+        if ( type == GeoDataTypes::GeoDataPointType
+             || type == GeoDataTypes::GeoDataLineStringType
+             || type == GeoDataTypes::GeoDataLinearRingType
+             || type == GeoDataTypes::GeoDataPolygonType
+             || type == GeoDataTypes::GeoDataMultiGeometryType ) {
+            writeGeometry( geometry );
+        } else {
+            writePoint( placemark->coordinate() );
+        }
+    } else {
+        writeContainer( static_cast<const GeoDataContainer *>( feature ) );
+    }
+}
+
+void DocumentCacheWriter::writeContainer( const GeoDataContainer *container )
+{
+    const QVector<GeoDataFeature *> features = container->featureList();
+
+    quint32 count = 0;
+    foreach ( const GeoDataFeature *feature, features ) {
+        if ( isCached( feature ) ) {
+            ++count;
+        }
+    }
+
+    m_features << count;
+    foreach ( const GeoDataFeature *feature, features ) {
+        if ( isCached( feature ) ) {
+            writeFeature( feature );
+        }
+    }
+}
+
+void DocumentCacheWriter::writeGeometry( const GeoDataGeometry *geometry )
+{
+    if ( geometry->nodeType() == GeoDataTypes::GeoDataPointType ) {
+        writePoint( static_cast<const GeoDataPoint *>( geometry )->coordinates() );
+    }
+    else if ( geometry->nodeType() == GeoDataTypes::GeoDataLineStringType
+              || geometry->nodeType() == GeoDataTypes::GeoDataLinearRingType ) {
+        const GeoDataLineString *lineString = static_cast<const GeoDataLineString *>( geometry );
+        const bool isRing = geometry->nodeType() == GeoDataTypes::GeoDataLinearRingType;
+        m_features << quint8( isRing ? LinearRingGeometry : LineStringGeometry );
+        m_features << qint32( lineString->tessellationFlags() );
+        writeNodes( *lineString );
+    }
+    else if ( geometry->nodeType() == GeoDataTypes::GeoDataPolygonType ) {
+        const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon *>( geometry );
+        m_features << quint8( PolygonGeometry );
+        m_features << qint32( polygon->tessellationFlags() );
+        writeNodes( polygon->outerBoundary() );
+        m_features << quint32( polygon->innerBoundaries().size() );
+        foreach ( const GeoDataLinearRing &innerBoundary, polygon->innerBoundaries() ) {
+            writeNodes( innerBoundary );
+        }
+    }
+    else if ( geometry->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+        const GeoDataMultiGeometry *multiGeometry = static_cast<const GeoDataMultiGeometry *>( geometry );
+        m_features << quint8( MultiGeometryGeometry );
+        m_features << quint32( multiGeometry->size() );
+        for ( int i = 0; i < multiGeometry->size(); ++i ) {
+            writeGeometry( multiGeometry->child( i ) );
+        }
+    }
+    else {
+        m_features << quint8( NoGeometry );
+    }
+}
+
+void DocumentCacheWriter::writePoint( const GeoDataCoordinates &coordinates )
+{
+    m_features << quint8( PointGeometry );
+    m_features << double( coordinates.longitude() ) << double( coordinates.latitude() ) << double( coordinates.altitude() );
+}
+
+void DocumentCacheWriter::writeNodes( const GeoDataLineString &lineString )
+{
+    const int size = lineString.size();
+    m_features << m_nodeCount << quint32( size );
+
+    for ( int i = 0; i < size; ++i ) {
+        m_nodes << double( lineString.longitude( i ) ) << double( lineString.latitude( i ) ) << double( lineString.altitude( i ) );
+    }
+    m_nodeCount += size;
+}
+
+class DocumentCacheReader
+{
+ public:
+    DocumentCacheReader( const uchar *data, qint64 size );
+
+    GeoDataDocument *read( QString *error );
+
+ private:
+    bool readHeader();
+
+    QString string( quint32 id );
+    QString readString( QDataStream &stream );
+
+    GeoDataFeature *readFeature( QDataStream &stream, int depth );
+    GeoDataGeometry *readGeometry( QDataStream &stream, int depth );
+    void readNodes( QDataStream &stream, GeoDataLineString &lineString );
+
+    static double readDouble( const uchar *data );
+
+    const uchar *const m_data;
+    const qint64 m_size;
+    bool m_ok;
+
+    quint32 m_stringCount;
+    quint32 m_nodeCount;
+    qint64 m_stringsOffset;
+    qint64 m_nodesOffset;
+    qint64 m_featuresOffset;
+
+    // decoded strings, m_decoded tells which ones are
+    QVector<QString> m_strings;
+    QVector<bool> m_decoded;
+};
+
+DocumentCacheReader::DocumentCacheReader( const uchar *data, qint64 size )
+    : m_data( data ),
+      m_size( size ),
+      m_ok( true ),
+      m_stringCount( 0 ),
+      m_nodeCount( 0 ),
+      m_stringsOffset( 0 ),
+      m_nodesOffset( 0 ),
+      m_featuresOffset( 0 )
+{
+}
+
+bool DocumentCacheReader::readHeader()
+{
+    if ( m_size < headerSize ) {
+        return false;
+    }
+
+    const QByteArray header = QByteArray::fromRawData( reinterpret_cast<const char *>( m_data ), headerSize );
+    QDataStream stream( header );
+    setupStream( stream );
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version >> m_stringCount >> m_nodeCount;
+    stream >> m_stringsOffset >> m_nodesOffset >> m_featuresOffset;
+
+    if ( stream.status() != QDataStream::Ok || magic != cacheMagic || version != formatVersion ) {
+        return false;
+    }
+
+    // the sections must be in order and fit into the file
+    const qint64 stringDataOffset = m_stringsOffset + ( qint64( m_stringCount ) + 1 ) * sizeof( quint32 );
+    if ( m_stringsOffset != headerSize || stringDataOffset > m_nodesOffset
+         || m_nodesOffset + m_nodeCount * nodeSize != m_featuresOffset
+         || m_featuresOffset > m_size ) {
+        return false;
+    }
+
+    const quint32 stringDataSize = qFromLittleEndian<quint32>( m_data + stringDataOffset - sizeof( quint32 ) );
+    if ( stringDataOffset + stringDataSize > m_nodesOffset ) {
+        return false;
+    }
+
+    m_strings.resize( m_stringCount );
+    m_decoded.fill( false, m_stringCount );
+    return true;
+}
+
+GeoDataDocument *DocumentCacheReader::read( QString *error )
+{
+    if ( !readHeader() ) {
+        if ( error ) {
+            *error = QString( "The file is not a document cache of this version of Marble" );
+        }
+        return 0;
+    }
+
+    const QByteArray features = QByteArray::fromRawData( reinterpret_cast<const char *>( m_data + m_featuresOffset ),
+                                                         m_size - m_featuresOffset );
+    QDataStream stream( features );
+    setupStream( stream );
+
+    GeoDataFeature *feature = readFeature( stream, 0 );
+    if ( !m_ok || stream.status() != QDataStream::Ok
+         || !feature || feature->nodeType() != GeoDataTypes::GeoDataDocumentType ) {
+        delete feature;
+        if ( error ) {
+            *error = QString( "The document cache is damaged" );
+        }
+        return 0;
+    }
+
+    return static_cast<GeoDataDocument *>( feature );
+}
+
+QString DocumentCacheReader::string( quint32 id )
+{
+    if ( id >= m_stringCount ) {
+        m_ok = false;
+        return QString();
+    }
+
+    if ( !m_decoded[id] ) {
+        const uchar *offsets = m_data + m_stringsOffset;
+        const quint32 begin = qFromLittleEndian<quint32>( offsets + id * sizeof( quint32 ) );
+        const quint32 end = qFromLittleEndian<quint32>( offsets + ( id + 1 ) * sizeof( quint32 ) );
+        const quint32 last = qFromLittleEndian<quint32>( offsets + m_stringCount * sizeof( quint32 ) );
+        if ( begin > end || end > last ) {
+            m_ok = false;
+            return QString();
+        }
+
+        const uchar *data = offsets + ( m_stringCount + 1 ) * sizeof( quint32 );
+        m_strings[id] = QString::fromUtf8( reinterpret_cast<const char *>( data + begin ), end - begin );
+        m_decoded[id] = true;
+    }
+
+    return m_strings[id];
+}
+
+QString DocumentCacheReader::readString( QDataStream &stream )
+{
+    quint32 id = 0;
+    stream >> id;
+    return string( id );
+}
+
+GeoDataFeature *DocumentCacheReader::readFeature( QDataStream &stream, int depth )
+{
+    // damaged files must not nest features without end
+    if ( depth > 1000 ) {
+        m_ok = false;
+        return 0;
+    }
+
+    quint8 type = 0;
+    stream >> type;
+
+    GeoDataFeature *feature = 0;
+    if ( type == DocumentFeature ) {
+        feature = new GeoDataDocument;
+    } else if ( type == FolderFeature ) {
+        feature = new GeoDataFolder;
+    } else if ( type == PlacemarkFeature ) {
+        feature = new GeoDataPlacemark;
+    } else {
+        m_ok = false;
+        return 0;
+    }
+
+    feature->setName( readString( stream ) );
+    feature->setDescription( readString( stream ) );
+    feature->setStyleUrl( readString( stream ) );
+    feature->setRole( readString( stream ) );
+    feature->setAddress( readString( stream ) );
+    feature->setPhoneNumber( readString( stream ) );
+
+    quint8 flags = 0;
+    qint64 popularity = 0;
+    qint32 zoomLevel = 0;
+    qint32 visualCategory = 0;
+    stream >> flags >> popularity >> zoomLevel >> visualCategory;
+    feature->setVisible( flags & VisibleFlag );
+    feature->setDescriptionCDATA( flags & DescriptionCDATAFlag );
+    feature->setPopularity( popularity );
+    feature->setZoomLevel( zoomLevel );
+    feature->setVisualCategory( GeoDataFeature::GeoDataVisualCategory( visualCategory ) );
+
+    if ( flags & InlineStyleFlag ) {
+        GeoDataStyle *style = new GeoDataStyle;
+        style->unpack( stream );
+        feature->setStyle( style );
+    }
+    if ( flags & TimeSpanFlag ) {
+        GeoDataTimeSpan timeSpan;
+        timeSpan.unpack( stream );
+        feature->setTimeSpan( timeSpan );
+    }
+    if ( flags & TimeStampFlag ) {
+        GeoDataTimeStamp timeStamp;
+        timeStamp.unpack( stream );
+        qint32 resolution = 0;
+        stream >> resolution;
+        timeStamp.setResolution( GeoDataTimeStamp::TimeResolution( resolution ) );
+        feature->setTimeStamp( timeStamp );
+    }
+
+    quint32 dataCount = 0;
+    stream >> dataCount;
+    for ( quint32 i = 0; i < dataCount && m_ok && stream.status() == QDataStream::Ok; ++i ) {
+        const QString key = readString( stream );
+        GeoDataData data;
+        data.setName( readString( stream ) );
+        data.setDisplayName( readString( stream ) );
+
+        quint8 valueType = 0;
+        stream >> valueType;
+        if ( valueType == IntegerValue ) {
+            qint64 value = 0;
+            stream >> value;
+            // integers which fit are kept as int, like the parsers do
+            if ( value == qint64( int( value ) ) ) {
+                data.setValue( int( value ) );
+            } else {
+                data.setValue( value );
+            }
+        } else if ( valueType == RealValue ) {
+            double value = 0.0;
+            stream >> value;
+            data.setValue( value );
+        } else {
+            data.setValue( readString( stream ) );
+        }
+
+        if ( data.name().isEmpty() ) {
+            data.setName( key );
+        }
+        feature->extendedData().addValue( data );
+    }
+
+    if ( type == DocumentFeature ) {
+        GeoDataDocument *document = static_cast<GeoDataDocument *>( feature );
+
+        quint32 styleCount = 0;
+        stream >> styleCount;
+        for ( quint32 i = 0; i < styleCount && stream.status() == QDataStream::Ok; ++i ) {
+            GeoDataStyle style;
+            style.unpack( stream );
+            document->addStyle( style );
+        }
+
+        quint32 styleMapCount = 0;
+        stream >> styleMapCount;
+        for ( quint32 i = 0; i < styleMapCount && stream.status() == QDataStream::Ok; ++i ) {
+            GeoDataStyleMap styleMap;
+            styleMap.unpack( stream );
+            document->addStyleMap( styleMap );
+        }
+    }
+
+    if ( type == PlacemarkFeature ) {
+        GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark *>( feature );
+        placemark->setCountryCode( readString( stream ) );
+        placemark->setState( readString( stream ) );
+
+        double area = 0.0;
+        qint64 population = 0;
+        stream >> area >> population;
+        placemark->setArea( area );
+        placemark->setPopulation( population );
+
+        GeoDataGeometry *geometry = readGeometry( stream, depth + 1 );
+        if ( geometry ) {
+            placemark->setGeometry( geometry );
+        }
+    } else {
+        GeoDataContainer *container = static_cast<GeoDataContainer *>( feature );
+
+        quint32 count = 0;
+        stream >> count;
+        for ( quint32 i = 0; i < count && m_ok && stream.status() == QDataStream::Ok; ++i ) {
+            GeoDataFeature *child = readFeature( stream, depth + 1 );
+            if ( child ) {
+                container->append( child );
+            }
+        }
+    }
+
+    return feature;
+}
+
+GeoDataGeometry *DocumentCacheReader::readGeometry( QDataStream &stream, int depth )
+{
+    if ( depth > 1000 ) {
+        m_ok = false;
+        return 0;
+    }
+
+    quint8 type = NoGeometry;
+    stream >> type;
+
+    if ( type == PointGeometry ) {
+        double lon = 0.0;
+        double lat = 0.0;
+        double alt = 0.0;
+        stream >> lon >> lat >> alt;
+        return new GeoDataPoint( GeoDataCoordinates( lon, lat, alt ) );
+    }
+
+    if ( type == LineStringGeometry || type == LinearRingGeometry ) {
+        qint32 flags = 0;
+        stream >> flags;
+        GeoDataLineString *lineString = type == LinearRingGeometry ? new GeoDataLinearRing : new GeoDataLineString;
+        lineString->setTessellationFlags( TessellationFlags( flags ) );
+        readNodes( stream, *lineString );
+        return lineString;
+    }
+
+    if ( type == PolygonGeometry ) {
+        qint32 flags = 0;
+        stream >> flags;
+        GeoDataPolygon *polygon = new GeoDataPolygon;
+        polygon->setTessellationFlags( TessellationFlags( flags ) );
+
+        GeoDataLinearRing outerBoundary;
+        readNodes( stream, outerBoundary );
+        polygon->setOuterBoundary( outerBoundary );
+
+        quint32 innerCount = 0;
+        stream >> innerCount;
+        for ( quint32 i = 0; i < innerCount && m_ok && stream.status() == QDataStream::Ok; ++i ) {
+            GeoDataLinearRing innerBoundary;
+            readNodes( stream, innerBoundary );
+            polygon->appendInnerBoundary( innerBoundary );
+        }
+        return polygon;
+    }
+
+    if ( type == MultiGeometryGeometry ) {
+        GeoDataMultiGeometry *multiGeometry = new GeoDataMultiGeometry;
+
+        quint32 count = 0;
+        stream >> count;
+        for ( quint32 i = 0; i < count && m_ok && stream.status() == QDataStream::Ok; ++i ) {
+            GeoDataGeometry *child = readGeometry( stream, depth + 1 );
+            if ( child ) {
+                multiGeometry->append( child );
+            }
+        }
+        return multiGeometry;
+    }
+
+    if ( type != NoGeometry ) {
+        m_ok = false;
+    }
+    return 0;
+}
+
+void DocumentCacheReader::readNodes( QDataStream &stream, GeoDataLineString &lineString )
+{
+    quint32 first = 0;
+    quint32 count = 0;
+    stream >> first >> count;
+    if ( first > m_nodeCount || count > m_nodeCount - first ) {
+        m_ok = false;
+        return;
+    }
+
+    lineString.reserve( count );
+    const uchar *node = m_data + m_nodesOffset + first * nodeSize;
+    for ( quint32 i = 0; i < count; ++i, node += nodeSize ) {
+        lineString.appendNode( readDouble( node ),
+                               readDouble( node + sizeof( double ) ),
+                               readDouble( node + 2 * sizeof( double ) ) );
+    }
+}
+
+double DocumentCacheReader::readDouble( const uchar *data )
+{
+    const quint64 bits = qFromLittleEndian<quint64>( data );
+    double value;
+    std::memcpy( &value, &bits, sizeof( value ) );
+    return value;
+}
+
+bool DocumentCache::write( const QString &fileName, const GeoDataDocument *document )
+{
+    // written to a temporary file first, so a partially written cache is never read
+    const QString temporaryFileName = fileName + ".tmp";
+
+    QFile file( temporaryFileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        mDebug() << "Unable to write the document cache" << temporaryFileName;
+        return false;
+    }
+
+    DocumentCacheWriter writer;
+    const bool written = writer.write( &file, document );
+    file.close();
+
+    if ( !written ) {
+        QFile::remove( temporaryFileName );
+        return false;
+    }
+
+    QFile::remove( fileName );
+    return QFile::rename( temporaryFileName, fileName );
+}
+
+bool DocumentCache::isCacheable( const GeoDataDocument *document )
+{
+    return isCompletelyCached( document );
+}
+
+bool DocumentCache::isDocumentCache( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return false;
+    }
+
+    QDataStream stream( &file );
+    setupStream( stream );
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    return stream.status() == QDataStream::Ok && magic == cacheMagic && version == formatVersion;
+}
+
+GeoDataDocument *DocumentCache::read( const QString &fileName, DocumentRole role, QString *error )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        if ( error ) {
+            *error = file.errorString();
+        }
+        return 0;
+    }
+
+    qint64 size = file.size();
+    const uchar *data = file.map( 0, size );
+    QByteArray contents;
+    if ( !data ) {
+        // not every file system supports mappings
+        contents = file.readAll();
+        data = reinterpret_cast<const uchar *>( contents.constData() );
+        size = contents.size();
+    }
+
+    DocumentCacheReader reader( data, size );
+    GeoDataDocument *document = reader.read( error );
+    if ( document ) {
+        document->setDocumentRole( role );
+        document->setFileName( fileName );
+    }
+
+    return document;
+}
+
+}
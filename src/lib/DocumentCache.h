@@ -0,0 +1,67 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_DOCUMENTCACHE_H
+#define MARBLE_DOCUMENTCACHE_H
+
+#include <QString>
+
+#include "GeoDataDocument.h"
+#include "marble_export.h"
+
+namespace Marble
+{
+
+/**
+ * @short Binary cache files of whole documents.
+ *
+ * A cache file keeps the folders, placemarks, geometries, styles, time
+ * primitives and extended data of a document, so opening a large file
+ * again doesn't need to parse it.
+ *
+ * The file starts with a versioned header, followed by a table of all
+ * distinct strings, a block with the nodes of all line strings as packed
+ * doubles and finally the features, which refer to strings and nodes by
+ * their index. Files are read through a memory mapping: each string is
+ * decoded when it is referred to for the first time, and the nodes of a
+ * line string are copied in one go without GeoDataCoordinates objects.
+ *
+ * Ground, screen and photo overlays are not cached. Geometries other than
+ * points, line strings, linear rings, polygons and multi geometries are
+ * cached as the point of their placemark.
+ */
+class MARBLE_EXPORT DocumentCache
+{
+ public:
+    /**
+     * Writes @p document to @p fileName. The file is replaced only once
+     * it has been written completely.
+     */
+    static bool write( const QString &fileName, const GeoDataDocument *document );
+
+    /**
+     * Returns whether @p document is cached without loss, i.e. it has no
+     * overlays and no geometries which are cached as a point.
+     */
+    static bool isCacheable( const GeoDataDocument *document );
+
+    /**
+     * Returns whether @p fileName is a document cache file of the current version.
+     */
+    static bool isDocumentCache( const QString &fileName );
+
+    /**
+     * Reads the document cached in @p fileName. Returns 0 and sets @p error
+     * if the file can't be read.
+     */
+    static GeoDataDocument *read( const QString &fileName, DocumentRole role, QString *error = 0 );
+};
+
+}
+
+#endif
@@ -66,13 +66,15 @@ bool DownloadPolicyKey::matches( QString const & hostName, const DownloadUsage u
 
 DownloadPolicy::DownloadPolicy()
     : m_key(),
-      m_maximumConnections( 1 )
+      m_maximumConnections( 1 ),
+      m_maximumConnectionsPerHost( 6 )
 {
 }
 
 DownloadPolicy::DownloadPolicy( const DownloadPolicyKey & key )
     : m_key( key ),
-      m_maximumConnections( 1 )
+      m_maximumConnections( 1 ),
+      m_maximumConnectionsPerHost( 6 )
 {
 }
 
@@ -86,6 +88,16 @@ void DownloadPolicy::setMaximumConnections( const int n )
     m_maximumConnections = n;
 }
 
+int DownloadPolicy::maximumConnectionsPerHost() const
+{
+    return m_maximumConnectionsPerHost;
+}
+
+void DownloadPolicy::setMaximumConnectionsPerHost( const int n )
+{
+    m_maximumConnectionsPerHost = n;
+}
+
 DownloadPolicyKey DownloadPolicy::key() const
 {
     return m_key;
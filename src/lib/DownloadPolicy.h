@@ -63,16 +63,27 @@ class DownloadPolicy
     int maximumConnections() const;
     void setMaximumConnections( const int );
 
+    /**
+     * The maximum number of simultaneous downloads from a single host.
+     * Defaults to the number of connections QNetworkAccessManager opens per
+     * host, so that no download waits inside the network layer where it
+     * cannot be prioritized anymore.
+     */
+    int maximumConnectionsPerHost() const;
+    void setMaximumConnectionsPerHost( const int );
+
     DownloadPolicyKey key() const;
 
  private:
     DownloadPolicyKey m_key;
     int m_maximumConnections;
+    int m_maximumConnectionsPerHost;
 };
 
 inline bool operator==( const DownloadPolicy & lhs, const DownloadPolicy & rhs )
 {
-    return lhs.m_key == rhs.m_key && lhs.m_maximumConnections == rhs.m_maximumConnections;
+    return lhs.m_key == rhs.m_key && lhs.m_maximumConnections == rhs.m_maximumConnections
+        && lhs.m_maximumConnectionsPerHost == rhs.m_maximumConnectionsPerHost;
 }
 
 }
@@ -17,8 +17,11 @@
 
 #include "MarbleDebug.h"
 
+#include "HttpDownloadManager.h"
 #include "HttpJob.h"
 
+#include <QtAlgorithms>
+
 namespace Marble
 {
 
@@ -84,10 +87,24 @@ void DownloadQueueSet::addJob( HttpJob * const job )
 
 void DownloadQueueSet::activateJobs()
 {
-    while ( !m_jobs.isEmpty()
-            && m_activeJobs.count() < m_downloadPolicy.maximumConnections() )
+    if ( m_jobs.isEmpty() || m_activeJobs.count() >= m_downloadPolicy.maximumConnections() )
+        return;
+
+    QHash<QString, int> activeJobsPerHost;
+    QList<HttpJob*>::const_iterator pos = m_activeJobs.constBegin();
+    QList<HttpJob*>::const_iterator const end = m_activeJobs.constEnd();
+    for (; pos != end; ++pos ) {
+        ++activeJobsPerHost[ (*pos)->sourceUrl().host() ];
+    }
+
+    while ( m_activeJobs.count() < m_downloadPolicy.maximumConnections() )
     {
-        HttpJob * const job = m_jobs.pop();
+        HttpJob * const job = m_jobs.takeNext( activeJobsPerHost,
+                                               m_downloadPolicy.maximumConnectionsPerHost() );
+        if ( !job )
+            break;
+
+        ++activeJobsPerHost[ job->sourceUrl().host() ];
         activateJob( job );
     }
 }
@@ -122,6 +139,20 @@ void DownloadQueueSet::purgeJobs()
     emit progressChanged( m_activeJobs.size(), m_jobs.count() );
 }
 
+void DownloadQueueSet::updatePriorities( const DownloadPrioritizer &prioritizer )
+{
+    const QList<HttpJob*> cancelledJobs = m_jobs.updatePriorities( prioritizer );
+    if ( cancelledJobs.isEmpty() )
+        return;
+
+    foreach ( HttpJob *job, cancelledJobs ) {
+        emit jobRemoved();
+        job->deleteLater();
+    }
+
+    emit progressChanged( m_activeJobs.size(), m_jobs.count() );
+}
+
 void DownloadQueueSet::finishJob( HttpJob * job, const QByteArray& data )
 {
     mDebug() << "finishJob: " << job->sourceUrl() << job->destinationFileName();
@@ -243,36 +274,87 @@ bool DownloadQueueSet::jobIsBlackListed( const QUrl& sourceUrl ) const
 }
 
 
-inline bool DownloadQueueSet::JobStack::contains( const QString& destinationFileName ) const
+static bool lessThanByPriority( const HttpJob *lhs, const HttpJob *rhs )
+{
+    return lhs->priority() < rhs->priority();
+}
+
+inline bool DownloadQueueSet::JobQueue::contains( const QString& destinationFileName ) const
 {
     return m_jobsContent.contains( destinationFileName );
 }
 
-inline int DownloadQueueSet::JobStack::count() const
+inline int DownloadQueueSet::JobQueue::count() const
 {
     return m_jobs.count();
 }
 
-inline bool DownloadQueueSet::JobStack::isEmpty() const
+inline bool DownloadQueueSet::JobQueue::isEmpty() const
 {
     return m_jobs.isEmpty();
 }
 
-inline HttpJob * DownloadQueueSet::JobStack::pop()
+inline HttpJob * DownloadQueueSet::JobQueue::pop()
 {
-    HttpJob * const job = m_jobs.pop();
+    HttpJob * const job = m_jobs.takeFirst();
     bool const removed = m_jobsContent.remove( job->destinationFileName() );
     Q_UNUSED( removed ); // for Q_ASSERT in release mode
     Q_ASSERT( removed );
     return job;
 }
 
-inline void DownloadQueueSet::JobStack::push( HttpJob * const job )
+inline void DownloadQueueSet::JobQueue::push( HttpJob * const job )
 {
-    m_jobs.push( job );
+    // in front of the jobs of equal priority
+    QList<HttpJob*>::iterator const pos = qLowerBound( m_jobs.begin(), m_jobs.end(), job, lessThanByPriority );
+    m_jobs.insert( pos, job );
     m_jobsContent.insert( job->destinationFileName() );
 }
 
+HttpJob * DownloadQueueSet::JobQueue::takeNext( const QHash<QString, int> &activeJobsPerHost, int maximumPerHost )
+{
+    for ( int i = 0; i < m_jobs.count(); ++i ) {
+        HttpJob * const job = m_jobs.at( i );
+        if ( activeJobsPerHost.value( job->sourceUrl().host() ) >= maximumPerHost )
+            continue;
+
+        m_jobs.removeAt( i );
+        bool const removed = m_jobsContent.remove( job->destinationFileName() );
+        Q_UNUSED( removed ); // for Q_ASSERT in release mode
+        Q_ASSERT( removed );
+        return job;
+    }
+
+    return 0;
+}
+
+QList<HttpJob*> DownloadQueueSet::JobQueue::updatePriorities( const DownloadPrioritizer &prioritizer )
+{
+    QList<HttpJob*> cancelledJobs;
+    QList<HttpJob*> jobs;
+
+    QList<HttpJob*>::const_iterator pos = m_jobs.constBegin();
+    QList<HttpJob*>::const_iterator const end = m_jobs.constEnd();
+    for (; pos != end; ++pos ) {
+        HttpJob * const job = *pos;
+        int priority = job->priority();
+        if ( prioritizer.priority( job->initiatorId(), priority ) ) {
+            job->setPriority( priority );
+            jobs.append( job );
+        }
+        else {
+            m_jobsContent.remove( job->destinationFileName() );
+            cancelledJobs.append( job );
+        }
+    }
+
+    // keeps the most recently added jobs first among jobs of equal priority
+    qStableSort( jobs.begin(), jobs.end(), lessThanByPriority );
+    m_jobs = jobs;
+
+    return cancelledJobs;
+}
+
 
 }
 
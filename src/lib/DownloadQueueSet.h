@@ -16,11 +16,11 @@
 #ifndef MARBLE_DOWNLOADQUEUESET_H
 #define MARBLE_DOWNLOADQUEUESET_H
 
+#include <QHash>
 #include <QList>
 #include <QQueue>
 #include <QObject>
 #include <QSet>
-#include <QStack>
 #include <QUrl>
 
 #include "DownloadPolicy.h"
@@ -28,6 +28,7 @@
 namespace Marble
 {
 
+class DownloadPrioritizer;
 class HttpJob;
 
 /**
@@ -37,9 +38,13 @@ class HttpJob;
      the HttpJob is put into the m_jobQueue where it waits for "activation"
      signal jobAdded is emitted
    - Job is activated
-     Job is moved from m_jobQueue to m_activeJobs and signals of the job
+     The queued job with the lowest priority value whose host has a free
+     connection is moved from m_jobQueue to m_activeJobs and signals of the job
      are connected to slots (local or HttpDownloadManager)
      Job is executed by calling the jobs execute() method
+   - or Job is cancelled while queued (see updatePriorities())
+     Job is removed from m_jobQueue and destroyed
+     signal jobRemoved is emitted
 
    now there are different possibilities:
    1) Job emits jobDone (some error occurred, or canceled (kio))
@@ -89,6 +94,12 @@ class DownloadQueueSet: public QObject
     void retryJobs();
     void purgeJobs();
 
+    /**
+     * Asks @p prioritizer for the priorities of all queued jobs and cancels
+     * the jobs it doesn't want anymore.
+     */
+    void updatePriorities( const DownloadPrioritizer &prioritizer );
+
  Q_SIGNALS:
     void jobAdded();
     void jobRemoved();
@@ -115,9 +126,10 @@ class DownloadQueueSet: public QObject
     DownloadPolicy m_downloadPolicy;
 
     /** This is the first stage a job enters, from this queue it will get
-     *  into the activatedJobs container.
+     *  into the activatedJobs container. Jobs are ordered by priority and
+     *  among jobs of equal priority the most recently added one comes first.
      */
-    class JobStack
+    class JobQueue
     {
     public:
         bool contains( const QString& destinationFileName ) const;
@@ -125,11 +137,21 @@ class DownloadQueueSet: public QObject
         bool isEmpty() const;
         HttpJob * pop();
         void push( HttpJob * const );
+
+        /** Removes and returns the first job whose host has less than
+         *  @p maximumPerHost active jobs, or 0 if there is none.
+         */
+        HttpJob * takeNext( const QHash<QString, int> &activeJobsPerHost, int maximumPerHost );
+
+        /** Updates the priorities and returns the removed jobs which
+         *  @p prioritizer cancelled.
+         */
+        QList<HttpJob*> updatePriorities( const DownloadPrioritizer &prioritizer );
     private:
-        QStack<HttpJob*> m_jobs;
+        QList<HttpJob*> m_jobs;
         QSet<QString> m_jobsContent;
     };
-    JobStack m_jobs;
+    JobQueue m_jobs;
 
     /// Contains the jobs which are currently being downloaded.
     QList<HttpJob*> m_activeJobs;
@@ -9,6 +9,7 @@
 //
 
 #include "ElevationModel.h"
+#include "GeoDataLineString.h"
 #include "GeoSceneHead.h"
 #include "GeoSceneLayer.h"
 #include "GeoSceneMap.h"
@@ -22,21 +23,73 @@
 #include "MapThemeManager.h"
 #include "TileId.h"
 
-#include <QLabel>
+#include <QCache>
+#include <QMetaType>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 #include <qmath.h>
 
 namespace Marble
 {
 
+namespace {
+    // marks samples without data in the rasters, as in SRTM files
+    qint16 const noHeight = -32768;
+}
+
+/**
+ * The heights of an elevation tile, decoded once from the tile image.
+ * Copies share the heights, so tiles are cheap to take out of the cache.
+ */
+class ElevationTile
+{
+public:
+    ElevationTile() : m_width( 0 ) {}
+    explicit ElevationTile( const QImage &image );
+
+    bool isNull() const { return m_heights.isEmpty(); }
+
+    qint16 height( int x, int y ) const { return m_heights.at( y * m_width + x ); }
+
+private:
+    int m_width;
+    QVector<qint16> m_heights;
+};
+
+ElevationTile::ElevationTile( const QImage &image )
+    : m_width( image.width() ),
+      m_heights( image.width() * image.height() )
+{
+    const QImage rgbImage = ( image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32 )
+                            ? image : image.convertToFormat( QImage::Format_ARGB32 );
+
+    qint16 *height = m_heights.data();
+    for ( int y = 0; y < rgbImage.height(); ++y ) {
+        const QRgb *pixel = reinterpret_cast<const QRgb *>( rgbImage.scanLine( y ) );
+        for ( int x = 0; x < m_width; ++x, ++height ) {
+            // the height is stored in the color channels of the fully opaque pixels
+            const uint value = pixel[x] & 0x00ffffff;
+            *height = value == invalidElevationData ? noHeight : qint16( qMin<uint>( value, 32767 ) );
+        }
+    }
+}
+
 class ElevationModelPrivate
 {
 public:
     ElevationModelPrivate( ElevationModel *_q, MarbleModel *const model )
         : q( _q ),
           m_tileLoader( model->downloadManager(), model->pluginManager() ),
-          m_textureLayer( 0 )
+          m_textureLayer( 0 ),
+          m_lastRequestId( 0 )
     {
-        m_cache.setMaxCost( 10 ); //keep 10 tiles in memory (~17MB)
+        m_cache.setMaxCost( 20 ); //keep 20 tiles in memory (~17MB)
+
+        // the tile loader is not used by several threads at once
+        m_threadPool.setMaxThreadCount( 1 );
 
         const GeoSceneDocument *srtmTheme = MapThemeManager::loadMapTheme( "earth/srtm2/srtm2.dgml" );
         if ( !srtmTheme ) {
@@ -59,104 +112,251 @@ public:
 
     void tileCompleted( const TileId & tileId, const QImage &image )
     {
-        m_cache.insert( tileId, new QImage( image ) );
-        emit q->updateAvailable();
+        // downloaded tiles are identified by the source dir of the texture layer
+        const TileId id( 0, tileId.zoomLevel(), tileId.x(), tileId.y() );
+        insertTile( id, new ElevationTile( image ) );
     }
 
+    void loadTile( const TileId &id );
+    void insertTile( const TileId &id, const ElevationTile *tile );
+    bool tile( const TileId &id, bool load, ElevationTile *result );
+    void heights( const qreal *lon, const qreal *lat, qreal *heights, int count, bool load );
+    void computeHeights( int id, const GeoDataLineString &path );
+
 public:
     ElevationModel *q;
 
     TileLoader m_tileLoader;
     const GeoSceneTextureTile *m_textureLayer;
-    QCache<TileId, const QImage> m_cache;
+    int m_lastRequestId;
+
+    // the cache and the pending tiles are shared with the thread pool,
+    // m_mutex is only locked while looking them up
+    QMutex m_mutex;
+    QCache<TileId, const ElevationTile> m_cache;
+    QSet<TileId> m_pendingTiles;
+
+    QThreadPool m_threadPool;
 };
 
-ElevationModel::ElevationModel( MarbleModel *const model )
-    : QObject( 0 ),
-      d( new ElevationModelPrivate( this, model ) )
+/**
+ * Loads an elevation tile in the background.
+ */
+class ElevationTileLoader : public QRunnable
 {
-    connect( &d->m_tileLoader, SIGNAL(tileCompleted(TileId,QImage)),
-             this, SLOT(tileCompleted(TileId,QImage)) );
-}
+public:
+    ElevationTileLoader( ElevationModelPrivate *model, const TileId &id )
+        : m_model( model ),
+          m_id( id )
+    {
+    }
 
+    virtual void run()
+    {
+        m_model->loadTile( m_id );
+    }
 
-qreal ElevationModel::height( qreal lon, qreal lat ) const
+private:
+    ElevationModelPrivate *const m_model;
+    const TileId m_id;
+};
+
+/**
+ * Computes the heights of the nodes of a path in the background.
+ */
+class ElevationProfileJob : public QRunnable
 {
-    if ( !d->m_textureLayer ) {
-        return invalidElevationData;
+public:
+    ElevationProfileJob( ElevationModelPrivate *model, int id, const GeoDataLineString &path )
+        : m_model( model ),
+          m_id( id ),
+          m_path( path )
+    {
     }
 
-    const int tileZoomLevel = d->m_tileLoader.maximumTileLevel( *( d->m_textureLayer ) );
-    Q_ASSERT( tileZoomLevel == 9 );
+    virtual void run()
+    {
+        m_model->computeHeights( m_id, m_path );
+    }
 
-    const int width = d->m_textureLayer->tileSize().width();
-    const int height = d->m_textureLayer->tileSize().height();
+private:
+    ElevationModelPrivate *const m_model;
+    const int m_id;
+    const GeoDataLineString m_path;
+};
 
-    const int numTilesX = TileLoaderHelper::levelToColumn( d->m_textureLayer->levelZeroColumns(), tileZoomLevel );
-    const int numTilesY = TileLoaderHelper::levelToRow( d->m_textureLayer->levelZeroRows(), tileZoomLevel );
-    Q_ASSERT( numTilesX > 0 );
-    Q_ASSERT( numTilesY > 0 );
+void ElevationModelPrivate::loadTile( const TileId &id )
+{
+    // a route profile may have loaded the tile meanwhile
+    ElevationTile result;
+    tile( id, true, &result );
 
-    qreal textureX = 180 + lon;
-    textureX *= numTilesX * width / 360;
+    {
+        QMutexLocker locker( &m_mutex );
+        m_pendingTiles.remove( id );
+    }
 
-    qreal textureY = 90 - lat;
-    textureY *= numTilesY * height / 180;
+    emit q->updateAvailable();
+}
 
-    qreal ret = 0;
-    bool hasHeight = false;
-    qreal noData = 0;
+void ElevationModelPrivate::insertTile( const TileId &id, const ElevationTile *tile )
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        m_cache.insert( id, tile );
+        m_pendingTiles.remove( id );
+    }
 
-    for ( int i = 0; i < 4; ++i ) {
-        const int x = static_cast<int>( textureX + ( i % 2 ) );
-        const int y = static_cast<int>( textureY + ( i / 2 ) );
+    emit q->updateAvailable();
+}
 
-        //mDebug() << "x" << x << ( x / width );
-        //mDebug() << "y" << y << ( y / height );
+bool ElevationModelPrivate::tile( const TileId &id, bool load, ElevationTile *result )
+{
+    {
+        QMutexLocker locker( &m_mutex );
 
-        const TileId id( 0, tileZoomLevel, ( x % ( numTilesX * width ) ) / width, ( y % ( numTilesY * height ) ) / height );
-        //mDebug() << "LAT" << lat << "LON" << lon << "tile" << ( x % ( numTilesX * width ) ) / width << ( y % ( numTilesY * height ) ) / height;
+        const ElevationTile *tile = m_cache.object( id );
+        if ( tile ) {
+            *result = *tile;
+            return true;
+        }
 
-        const QImage *image = d->m_cache[id];
-        if ( image == 0 ) {
-            image = new QImage( d->m_tileLoader.loadTileImage( d->m_textureLayer, id, DownloadBrowse ) );
-            d->m_cache.insert( id, image );
+        if ( !load ) {
+            if ( !m_pendingTiles.contains( id ) ) {
+                m_pendingTiles.insert( id );
+                m_threadPool.start( new ElevationTileLoader( this, id ) );
+            }
+            return false;
         }
-        Q_ASSERT( image );
-        Q_ASSERT( !image->isNull() );
-        Q_ASSERT( width == image->width() );
-        Q_ASSERT( height == image->height() );
-
-        const qreal dx = ( textureX > ( qreal )x ) ? textureX - ( qreal )x : ( qreal )x - textureX;
-        const qreal dy = ( textureY > ( qreal )y ) ? textureY - ( qreal )y : ( qreal )y - textureY;
-
-        Q_ASSERT( 0 <= dx && dx <= 1 );
-        Q_ASSERT( 0 <= dy && dy <= 1 );
-        unsigned int pixel;
-        pixel = image->pixel( x % width, y % height );
-        pixel -= 0xFF000000; //fully opaque
-        //mDebug() << "(1-dx)" << (1-dx) << "(1-dy)" << (1-dy);
-        if ( pixel != invalidElevationData ) { //no data?
-            //mDebug() << "got at x" << x % width << "y" << y % height << "a height of" << pixel << "** RGB" << qRed(pixel) << qGreen(pixel) << qBlue(pixel);
-            ret += ( qreal )pixel * ( 1 - dx ) * ( 1 - dy );
-            hasHeight = true;
-        } else {
-            //mDebug() << "no data at" <<  x % width << "y" << y % height;
-            noData += ( 1 - dx ) * ( 1 - dy );
+    }
+
+    // only done in the thread pool, so no other thread loads tiles meanwhile
+    *result = ElevationTile( m_tileLoader.loadTileImage( m_textureLayer, id, DownloadBrowse ) );
+
+    QMutexLocker locker( &m_mutex );
+    m_cache.insert( id, new ElevationTile( *result ) );
+    return true;
+}
+
+void ElevationModelPrivate::heights( const qreal *lon, const qreal *lat, qreal *heights, int count, bool load )
+{
+    if ( !m_textureLayer ) {
+        for ( int i = 0; i < count; ++i ) {
+            heights[i] = invalidElevationData;
         }
+        return;
     }
 
-    if ( !hasHeight ) {
-        ret = invalidElevationData; //no data
-    } else {
-        if ( noData ) {
-            //mDebug() << "NO DATA" << noData;
+    const int tileZoomLevel = TileLoader::maximumTileLevel( *m_textureLayer );
+    Q_ASSERT( tileZoomLevel == 9 );
+
+    const int width = m_textureLayer->tileSize().width();
+    const int height = m_textureLayer->tileSize().height();
+
+    const int numTilesX = TileLoaderHelper::levelToColumn( m_textureLayer->levelZeroColumns(), tileZoomLevel );
+    const int numTilesY = TileLoaderHelper::levelToRow( m_textureLayer->levelZeroRows(), tileZoomLevel );
+    Q_ASSERT( numTilesX > 0 );
+    Q_ASSERT( numTilesY > 0 );
+
+    const qreal pixelsPerDegreeX = numTilesX * width / 360;
+    const qreal pixelsPerDegreeY = numTilesY * height / 180;
+
+    // consecutive samples are mostly in the same tile, which is looked up once
+    // for them, so the cache is not locked while the heights are interpolated
+    TileId lastId;
+    ElevationTile lastTile;
+
+    for ( int i = 0; i < count; ++i ) {
+        const qreal textureX = ( 180 + lon[i] ) * pixelsPerDegreeX;
+        const qreal textureY = ( 90 - lat[i] ) * pixelsPerDegreeY;
+
+        qreal ret = 0;
+        bool hasHeight = false;
+        bool hasTiles = true;
+        qreal noData = 0;
+
+        for ( int j = 0; j < 4; ++j ) {
+            const int x = static_cast<int>( textureX + ( j % 2 ) );
+            const int y = static_cast<int>( textureY + ( j / 2 ) );
+
+            const TileId id( 0, tileZoomLevel, ( x % ( numTilesX * width ) ) / width, ( y % ( numTilesY * height ) ) / height );
+            if ( lastTile.isNull() || !( id == lastId ) ) {
+                if ( !tile( id, load, &lastTile ) ) {
+                    lastTile = ElevationTile();
+                }
+                lastId = id;
+            }
+
+            if ( lastTile.isNull() ) {
+                hasTiles = false;
+                break;
+            }
+
+            const qreal dx = ( textureX > ( qreal )x ) ? textureX - ( qreal )x : ( qreal )x - textureX;
+            const qreal dy = ( textureY > ( qreal )y ) ? textureY - ( qreal )y : ( qreal )y - textureY;
+
+            Q_ASSERT( 0 <= dx && dx <= 1 );
+            Q_ASSERT( 0 <= dy && dy <= 1 );
+            const qint16 sample = lastTile.height( x % width, y % height );
+            if ( sample != noHeight ) {
+                ret += ( qreal )sample * ( 1 - dx ) * ( 1 - dy );
+                hasHeight = true;
+            } else {
+                noData += ( 1 - dx ) * ( 1 - dy );
+            }
+        }
+
+        if ( !hasTiles || !hasHeight ) {
+            ret = invalidElevationData; //no data
+        } else if ( noData ) {
             ret += ( ret / ( 1 - noData ) ) * noData;
         }
+
+        heights[i] = ret;
     }
+}
 
-    //mDebug() << ">>>" << lat << lon << "returning an elevation of" << ret;
-    return ret;
+void ElevationModelPrivate::computeHeights( int id, const GeoDataLineString &path )
+{
+    const int size = path.size();
+    QVector<qreal> lon( size );
+    QVector<qreal> lat( size );
+    for ( int i = 0; i < size; ++i ) {
+        lon[i] = path.longitude( i ) * RAD2DEG;
+        lat[i] = path.latitude( i ) * RAD2DEG;
+    }
+
+    QVector<qreal> result( size );
+    heights( lon.constData(), lat.constData(), result.data(), size, true );
+    emit q->heightsAvailable( id, result );
+}
+
+ElevationModel::ElevationModel( MarbleModel *const model )
+    : QObject( 0 ),
+      d( new ElevationModelPrivate( this, model ) )
+{
+    qRegisterMetaType<QVector<qreal> >( "QVector<qreal>" );
+
+    connect( &d->m_tileLoader, SIGNAL(tileCompleted(TileId,QImage)),
+             this, SLOT(tileCompleted(TileId,QImage)) );
+}
+
+ElevationModel::~ElevationModel()
+{
+    d->m_threadPool.waitForDone();
+    delete d;
+}
+
+qreal ElevationModel::height( qreal lon, qreal lat ) const
+{
+    qreal result;
+    d->heights( &lon, &lat, &result, 1, false );
+    return result;
+}
+
+void ElevationModel::heights( const qreal *lon, const qreal *lat, qreal *heights, int count ) const
+{
+    d->heights( lon, lat, heights, count, false );
 }
 
 QList<GeoDataCoordinates> ElevationModel::heightProfile( qreal fromLon, qreal fromLat, qreal toLon, qreal toLat ) const
@@ -165,7 +365,7 @@ QList<GeoDataCoordinates> ElevationModel::heightProfile( qreal fromLon, qreal fr
         return QList<GeoDataCoordinates>();
     }
 
-    const int tileZoomLevel = d->m_tileLoader.maximumTileLevel( *( d->m_textureLayer ) );
+    const int tileZoomLevel = TileLoader::maximumTileLevel( *( d->m_textureLayer ) );
     const int width = d->m_textureLayer->tileSize().width();
     const int numTilesX = TileLoaderHelper::levelToColumn( d->m_textureLayer->levelZeroColumns(), tileZoomLevel );
 
@@ -180,13 +380,12 @@ QList<GeoDataCoordinates> ElevationModel::heightProfile( qreal fromLon, qreal fr
     //mDebug() << "fromLon" << fromLon << "fromLat" << fromLat;
     //mDebug() << "diff lon" << ( fromLon - toLon ) << "diff lat" << ( fromLat - toLat );
     //mDebug() << "dirLon" << QString::number(dirLon) << "dirLat" << QString::number(dirLat) << "k" << k;
-    QList<GeoDataCoordinates> ret;
+    QVector<qreal> lons;
+    QVector<qreal> lats;
     while ( lat*dirLat <= toLat*dirLat && lon*dirLon <= toLon * dirLon ) {
         //mDebug() << lat << lon;
-        qreal h = height( lon, lat );
-        if ( h < 32000 ) {
-            ret << GeoDataCoordinates( lon, lat, h, GeoDataCoordinates::Degree );
-        }
+        lons << lon;
+        lats << lat;
         if ( k < 0.5 ) {
             //mDebug() << "lon(x) += distPerPixel";
             lat += distPerPixel * k * dirLat;
@@ -197,10 +396,27 @@ QList<GeoDataCoordinates> ElevationModel::heightProfile( qreal fromLon, qreal fr
             lon += distPerPixel / k * dirLon;
         }
     }
+
+    QVector<qreal> heights( lons.size() );
+    d->heights( lons.constData(), lats.constData(), heights.data(), lons.size(), false );
+
+    QList<GeoDataCoordinates> ret;
+    for ( int i = 0; i < heights.size(); ++i ) {
+        if ( heights[i] < 32000 ) {
+            ret << GeoDataCoordinates( lons[i], lats[i], heights[i], GeoDataCoordinates::Degree );
+        }
+    }
     //mDebug() << ret;
     return ret;
 }
 
+int ElevationModel::requestHeights( const GeoDataLineString &path ) const
+{
+    const int id = ++d->m_lastRequestId;
+    d->m_threadPool.start( new ElevationProfileJob( d, id, path ) );
+    return id;
+}
+
 }
 
 
@@ -16,8 +16,8 @@
 #include "marble_export.h"
 
 #include <QObject>
-#include <QCache>
 #include <QImage>
+#include <QVector>
 
 namespace Marble
 {
@@ -26,19 +26,43 @@ namespace {
     unsigned int const invalidElevationData = 32768;
 }
 
+class GeoDataLineString;
 class TileId;
 class MarbleModel;
 class ElevationModelPrivate;
 
+/**
+ * @short Heights of the SRTM2 elevation tiles.
+ *
+ * Tiles are decoded into 16 bit rasters and loaded in the background. Queries
+ * never wait for a tile: heights in tiles which are not loaded yet are returned
+ * as invalidElevationData, and updateAvailable() is emitted once they are.
+ */
 class MARBLE_EXPORT ElevationModel : public QObject
 {
     Q_OBJECT
 public:
     explicit ElevationModel( MarbleModel * const model );
+    ~ElevationModel();
 
     qreal height( qreal lon, qreal lat ) const;
+
+    /**
+     * Writes the heights at @p count positions given in degree by @p lon and @p lat
+     * to @p heights. Consecutive positions in the same tile are looked up cheaply,
+     * so paths should be queried in order.
+     */
+    void heights( const qreal *lon, const qreal *lat, qreal *heights, int count ) const;
+
     QList<GeoDataCoordinates> heightProfile( qreal fromLon, qreal fromLat, qreal toLon, qreal toLat ) const;
 
+    /**
+     * Computes the heights of all nodes of @p path in the background, loading the
+     * tiles it crosses. The result is passed to heightsAvailable() along with the
+     * returned request id.
+     */
+    int requestHeights( const GeoDataLineString &path ) const;
+
 Q_SIGNALS:
     /**
      * Elevation tiles loaded. You will get more accurate results when querying height
@@ -46,6 +70,12 @@ Q_SIGNALS:
      **/
     void updateAvailable();
 
+    /**
+     * The heights of the nodes of the path of the request @p id. Heights
+     * without data are invalidElevationData.
+     */
+    void heightsAvailable( int id, const QVector<qreal> &heights );
+
 private:
     Q_PRIVATE_SLOT( d, void tileCompleted( TileId, QImage ) )
 
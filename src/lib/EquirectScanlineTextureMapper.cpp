@@ -15,6 +15,7 @@
 
 // posix
 #include <cmath>
+#include <cstring>
 
 // Qt
 #include <QRunnable>
@@ -32,7 +33,7 @@ using namespace Marble;
 class EquirectScanlineTextureMapper::RenderJob : public QRunnable
 {
 public:
-    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewportParams, MapQuality mapQuality, int yTop, int yBottom );
+    RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewportParams, MapQuality mapQuality, int yTop, int yBottom, int xLeft, int xRight );
 
     virtual void run();
 
@@ -44,25 +45,46 @@ private:
     const MapQuality m_mapQuality;
     const int m_yPaintedTop;
     const int m_yPaintedBottom;
+    const int m_xLeft;
+    const int m_xRight;
 };
 
-EquirectScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom )
+EquirectScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoader, int tileLevel, QImage *canvasImage, const ViewportParams *viewport, MapQuality mapQuality, int yTop, int yBottom, int xLeft, int xRight )
     : m_tileLoader( tileLoader ),
       m_tileLevel( tileLevel ),
       m_canvasImage( canvasImage ),
       m_viewport( viewport ),
       m_mapQuality( mapQuality ),
       m_yPaintedTop( yTop ),
-      m_yPaintedBottom( yBottom )
+      m_yPaintedBottom( yBottom ),
+      m_xLeft( xLeft ),
+      m_xRight( xRight )
 {
 }
 
+// A pan is treated as a translation by whole pixels if it is off by at most this fraction of a pixel.
+static const qreal maxScrollError = 0.05;
+
+// The vertical offset of the map as used by RenderJob::run().
+static int mappedYCenterOffset( const ViewportParams *viewport )
+{
+    const qreal rad2Pixel = (qreal)( 2 * (qint64)viewport->radius() ) / M_PI;
+    return (int)( viewport->centerLatitude() * rad2Pixel );
+}
+
 
 EquirectScanlineTextureMapper::EquirectScanlineTextureMapper( StackedTileLoader *tileLoader )
     : TextureMapperInterface(),
       m_tileLoader( tileLoader ),
       m_radius( 0 ),
-      m_oldYPaintedTop( 0 )
+      m_oldYPaintedTop( 0 ),
+      m_oldYPaintedBottom( 0 ),
+      m_centerLon( 0.0 ),
+      m_viewportCenterLon( 0.0 ),
+      m_yCenterOffset( 0 ),
+      m_tileZoomLevel( -1 ),
+      m_mapQuality( NormalQuality ),
+      m_colorizedImageValid( false )
 {
 }
 
@@ -87,17 +109,46 @@ void EquirectScanlineTextureMapper::mapTexture( GeoPainter *painter,
         m_repaintNeeded = true;
     }
 
+    bool mapped = false;
+
+    if ( !m_repaintNeeded && ( m_viewportCenterLon != viewport->centerLongitude()
+                               || m_yCenterOffset != mappedYCenterOffset( viewport ) ) ) {
+        m_repaintNeeded = tileZoomLevel != m_tileZoomLevel
+                          || painter->mapQuality() != m_mapQuality
+                          || !scrollTexture( viewport, tileZoomLevel, painter->mapQuality() );
+        mapped = !m_repaintNeeded;
+    }
+
     if ( m_repaintNeeded ) {
         mapTexture( viewport, tileZoomLevel, painter->mapQuality() );
+        m_repaintNeeded = false;
+        mapped = true;
+    }
+
+    if ( !texColorizer ) {
+        m_colorizedImageValid = false;
+        painter->drawImage( dirtyRect, m_canvasImage, dirtyRect );
+        return;
+    }
 
-        if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+    // The colorizer replaces the grey values of the canvas, so it works on a
+    // copy and the canvas can still be scrolled.
+    if ( mapped || !m_colorizedImageValid ) {
+        if ( m_colorizedImage.size() != m_canvasImage.size() || m_colorizedImage.format() != m_canvasImage.format() ) {
+            m_colorizedImage = QImage( m_canvasImage.size(), m_canvasImage.format() );
         }
+        memcpy( m_colorizedImage.bits(), m_canvasImage.constBits(), m_canvasImage.byteCount() );
 
-        m_repaintNeeded = false;
+        texColorizer->colorize( &m_colorizedImage, viewport, painter->mapQuality(), &m_threadPool );
+        m_colorizedImageValid = true;
     }
 
-    painter->drawImage( dirtyRect, m_canvasImage, dirtyRect );
+    painter->drawImage( dirtyRect, m_colorizedImage, dirtyRect );
+}
+
+void EquirectScanlineTextureMapper::setViewportChanged()
+{
+    // mapTexture() compares the viewport with the one of the last frame
 }
 
 void EquirectScanlineTextureMapper::mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
@@ -128,14 +179,7 @@ void EquirectScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
     if (yPaintedBottom < 0)             yPaintedBottom = 0;
     if (yPaintedBottom > imageHeight) yPaintedBottom = imageHeight;
 
-    const int numThreads = m_threadPool.maxThreadCount();
-    const int yStep = ( yPaintedBottom - yPaintedTop ) / numThreads;
-    for ( int i = 0; i < numThreads; ++i ) {
-        const int yStart = yPaintedTop +  i      * yStep;
-        const int yEnd   = yPaintedTop + (i + 1) * yStep;
-        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd );
-        m_threadPool.start( job );
-    }
+    renderRows( viewport, tileZoomLevel, mapQuality, yPaintedTop, yPaintedBottom, 0, m_canvasImage.width() );
 
     // Remove unused lines
     const int clearStart = ( yPaintedTop - m_oldYPaintedTop <= 0 ) ? yPaintedBottom : 0;
@@ -151,10 +195,113 @@ void EquirectScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
     m_threadPool.waitForDone();
 
     m_oldYPaintedTop = yPaintedTop;
+    m_oldYPaintedBottom = yPaintedBottom;
+    m_centerLon = viewport->centerLongitude();
+    m_viewportCenterLon = m_centerLon;
+    m_yCenterOffset = mappedYCenterOffset( viewport );
+    m_tileZoomLevel = tileZoomLevel;
+    m_mapQuality = mapQuality;
 
     m_tileLoader->cleanupTilehash();
 }
 
+bool EquirectScanlineTextureMapper::scrollTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
+{
+    const int imageHeight = m_canvasImage.height();
+    const int imageWidth  = m_canvasImage.width();
+    const qint64  radius  = viewport->radius();
+    // the same conversions as in RenderJob::run()
+    const qreal rad2Pixel = (qreal)( 2 * radius ) / M_PI;
+    const float pixel2Rad = 1.0/rad2Pixel;
+
+    qreal deltaLon = viewport->centerLongitude() - m_centerLon;
+    while ( deltaLon < -M_PI ) deltaLon += 2 * M_PI;
+    while ( deltaLon >  M_PI ) deltaLon -= 2 * M_PI;
+
+    const qreal exactDx = deltaLon / pixel2Rad;
+    const int dx = qRound( exactDx );
+    const int yCenterOffset = mappedYCenterOffset( viewport );
+    const int dy = yCenterOffset - m_yCenterOffset;
+
+    if ( qAbs( exactDx - dx ) > maxScrollError || qAbs( dx ) >= imageWidth || qAbs( dy ) >= imageHeight )
+        return false;
+
+    m_viewportCenterLon = viewport->centerLongitude();
+
+    // panned by less than a pixel, the canvas stays as it is
+    if ( dx == 0 && dy == 0 )
+        return true;
+
+    ScanlineTextureMapperContext::scrollImage( &m_canvasImage, -dx, dy );
+
+    // Calculate the y-range which can be painted, as in mapTexture()
+    const float paintedRad2Pixel = (float)( 2 * radius ) / M_PI;
+    const int yPaintedCenterOffset = (int)( viewport->centerLatitude() * paintedRad2Pixel );
+    const int yPaintedTop    = qBound( 0, (int)( imageHeight / 2 - radius + yPaintedCenterOffset ), imageHeight );
+    const int yPaintedBottom = qBound( 0, (int)( imageHeight / 2 + radius + yPaintedCenterOffset ), imageHeight );
+
+    // the columns which got exposed by the horizontal part of the pan
+    const int xExposedLeft  = ( dx > 0 ) ? imageWidth - dx : 0;
+    const int xExposedRight = ( dx > 0 ) ? imageWidth : -dx;
+
+    m_tileLoader->resetTilehash();
+
+    // Rows which were painted before get their exposed columns mapped,
+    // all other rows are mapped completely.
+    int row = yPaintedTop;
+    while ( row < yPaintedBottom ) {
+        const bool scrolled = row - dy >= m_oldYPaintedTop && row - dy < m_oldYPaintedBottom;
+        int yEnd = row + 1;
+        while ( yEnd < yPaintedBottom
+                && scrolled == ( yEnd - dy >= m_oldYPaintedTop && yEnd - dy < m_oldYPaintedBottom ) ) {
+            ++yEnd;
+        }
+
+        if ( !scrolled ) {
+            renderRows( viewport, tileZoomLevel, mapQuality, row, yEnd, 0, imageWidth );
+        }
+        else if ( dx != 0 ) {
+            renderRows( viewport, tileZoomLevel, mapQuality, row, yEnd, xExposedLeft, xExposedRight );
+        }
+
+        row = yEnd;
+    }
+
+    // Remove unused lines
+    const int bytesPerLine = m_canvasImage.bytesPerLine();
+    for ( int y = 0; y < yPaintedTop; ++y ) {
+        memset( m_canvasImage.scanLine( y ), 0, bytesPerLine );
+    }
+    for ( int y = yPaintedBottom; y < imageHeight; ++y ) {
+        memset( m_canvasImage.scanLine( y ), 0, bytesPerLine );
+    }
+
+    m_threadPool.waitForDone();
+
+    m_oldYPaintedTop = yPaintedTop;
+    m_oldYPaintedBottom = yPaintedBottom;
+    // Keep the longitude the scrolled canvas actually shows, so that
+    // the errors of subsequent pans don't add up.
+    m_centerLon += dx * pixel2Rad;
+    m_yCenterOffset = yCenterOffset;
+
+    m_tileLoader->cleanupTilehash();
+
+    return true;
+}
+
+void EquirectScanlineTextureMapper::renderRows( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality,
+                                                int yTop, int yBottom, int xLeft, int xRight )
+{
+    const int numThreads = qMax( 1, qMin( m_threadPool.maxThreadCount(), yBottom - yTop ) );
+    for ( int i = 0; i < numThreads; ++i ) {
+        const int yStart = yTop +  i      * ( yBottom - yTop ) / numThreads;
+        const int yEnd   = yTop + (i + 1) * ( yBottom - yTop ) / numThreads;
+        QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd, xLeft, xRight );
+        m_threadPool.start( job );
+    }
+}
+
 void EquirectScanlineTextureMapper::RenderJob::run()
 {
     // Scanline based algorithm to do texture mapping
@@ -182,11 +329,14 @@ void EquirectScanlineTextureMapper::RenderJob::run()
 
     const int yTop = imageHeight / 2 - radius + yCenterOffset;
 
-    qreal leftLon = + centerLon - ( imageWidth / 2 * pixel2Rad );
+    qreal leftLon = + centerLon - ( imageWidth / 2 * pixel2Rad ) + m_xLeft * pixel2Rad;
     while ( leftLon < -M_PI ) leftLon += 2 * M_PI;
     while ( leftLon >  M_PI ) leftLon -= 2 * M_PI;
 
-    const int maxInterpolationPointX = n * (int)( imageWidth / n - 1 ) + 1;
+    // Narrow columns, as exposed by a pan, are mapped without interpolation.
+    const int rangeWidth = m_xRight - m_xLeft;
+    const int maxInterpolationPointX = ( rangeWidth >= 2 * n ) ? m_xLeft + n * (int)( rangeWidth / n - 1 ) + 1
+                                                               : m_xLeft;
 
 
     // initialize needed variables that are modified during texture mapping:
@@ -198,16 +348,16 @@ void EquirectScanlineTextureMapper::RenderJob::run()
 
     for ( int y = m_yPaintedTop; y < m_yPaintedBottom; ++y ) {
 
-        QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) );
+        QRgb * scanLine = (QRgb*)( m_canvasImage->scanLine( y ) ) + m_xLeft;
 
         qreal lon = leftLon;
         const qreal lat = M_PI/2 - (y - yTop )* pixel2Rad;
 
-        for ( int x = 0; x < imageWidth; ++x ) {
+        for ( int x = m_xLeft; x < m_xRight; ++x ) {
 
             // Prepare for interpolation
             bool interpolate = false;
-            if ( x > 0 && x <= maxInterpolationPointX ) {
+            if ( x > m_xLeft && x <= maxInterpolationPointX ) {
                 x += n - 1;
                 lon += (n - 1) * pixel2Rad;
                 interpolate = !printQuality;
@@ -228,7 +378,7 @@ void EquirectScanlineTextureMapper::RenderJob::run()
                 scanLine += ( n - 1 );
             }
 
-            if ( x < imageWidth ) {
+            if ( x < m_xRight ) {
                 if ( highQuality )
                     context.pixelValueF( lon, lat, scanLine );
                 else
@@ -244,9 +394,9 @@ void EquirectScanlineTextureMapper::RenderJob::run()
 
             const int pixelByteSize = m_canvasImage->bytesPerLine() / imageWidth;
 
-            memcpy( m_canvasImage->scanLine( y + 1 ),
-                    m_canvasImage->scanLine( y     ),
-                    imageWidth * pixelByteSize );
+            memcpy( m_canvasImage->scanLine( y + 1 ) + m_xLeft * pixelByteSize,
+                    m_canvasImage->scanLine( y     ) + m_xLeft * pixelByteSize,
+                    ( m_xRight - m_xLeft ) * pixelByteSize );
             ++y;
         }
     }
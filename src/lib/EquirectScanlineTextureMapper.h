@@ -36,9 +36,21 @@ class EquirectScanlineTextureMapper : public TextureMapperInterface
                              const QRect &dirtyRect,
                              TextureColorizer *texColorizer );
 
+    virtual void setViewportChanged();
+
  private:
     void mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
 
+    /**
+     * Scrolls the canvas image by the pan since the last frame and maps the
+     * newly exposed areas only. Returns false if the pan isn't a translation
+     * by whole pixels within the canvas, so the canvas has to be mapped anew.
+     */
+    bool scrollTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
+
+    void renderRows( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality,
+                     int yTop, int yBottom, int xLeft, int xRight );
+
  private:
     class RenderJob;
 
@@ -46,6 +58,18 @@ class EquirectScanlineTextureMapper : public TextureMapperInterface
     int m_radius;
     QImage m_canvasImage;
     int    m_oldYPaintedTop;
+    int    m_oldYPaintedBottom;
+    // the viewport the canvas image was mapped for
+    qreal  m_centerLon;
+    // the center of the viewport of the last frame, which the canvas is off by
+    // less than a pixel if it was scrolled
+    qreal  m_viewportCenterLon;
+    int    m_yCenterOffset;
+    int    m_tileZoomLevel;
+    MapQuality m_mapQuality;
+    // the canvas image as passed through the TextureColorizer
+    QImage m_colorizedImage;
+    bool   m_colorizedImageValid;
     QThreadPool m_threadPool;
 };
 
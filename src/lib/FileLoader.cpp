@@ -11,20 +11,25 @@
 #include "FileLoader.h"
 
 #include <QBuffer>
-#include <QDataStream>
+#include <QCryptographicHash>
 #include <QDateTime>
+#include <QDir>
+#include <QEventLoop>
 #include <QFile>
-#include <QThread>
 
+#include "DocumentCache.h"
 #include "GeoDataParser.h"
 #include "GeoDataDocument.h"
 #include "GeoDataFolder.h"
+#include "GeoDataLatLonAltBox.h"
 #include "GeoDataPlacemark.h"
 #include "GeoDataData.h"
 #include "GeoDataExtendedData.h"
 #include "GeoDataStyleMap.h"
 #include "GeoDataPolyStyle.h"
 #include "GeoDataLineStyle.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPolygon.h"
 #include "GeoDataStyle.h"
 #include "GeoDataTypes.h"
 #include "MarbleClock.h"
@@ -42,9 +47,10 @@ public:
     FileLoaderPrivate( FileLoader* parent, MarbleModel *model, bool recenter,
                        const QString& file, const QString& property, GeoDataStyle* style, DocumentRole role )
         : q( parent),
-          m_runner( model->pluginManager() ),
+          m_pluginManager( model->pluginManager() ),
           m_recenter( recenter ),
           m_filepath ( file ),
+          m_cacheCompleteDocumentsOnly( false ),
           m_property( property ),
           m_style( style ),
           m_documentRole ( role ),
@@ -61,11 +67,14 @@ public:
     FileLoaderPrivate( FileLoader* parent, MarbleModel *model,
                        const QString& contents, const QString& file, DocumentRole role )
         : q( parent ),
-          m_runner( model->pluginManager() ),
+          m_pluginManager( model->pluginManager() ),
           m_recenter( false ),
           m_filepath ( file ),
           m_contents ( contents ),
+          m_cacheCompleteDocumentsOnly( false ),
+          m_style( 0 ),
           m_documentRole ( role ),
+          m_styleMap( new GeoDataStyleMap ),
           m_document( 0 ),
           m_clock( model->clock() )
     {
@@ -73,12 +82,15 @@ public:
 
     ~FileLoaderPrivate()
     {
+        delete m_styleMap;
     }
 
     void saveFile(const QString& filename );
-    void savePlacemarks(QDataStream &out, const GeoDataContainer *container);
+    static QString documentCacheFile( const QString &sourceFile );
 
+    void prepareDocument();
     void createFilterProperties( GeoDataContainer *container );
+    static void cacheLatLonAltBoxes( const GeoDataGeometry *geometry );
     int cityPopIdx( qint64 population ) const;
     int spacePopIdx( qint64 population ) const;
     int areaPopIdx( qreal area ) const;
@@ -86,16 +98,18 @@ public:
     void documentParsed( GeoDataDocument *doc, const QString& error);
 
     FileLoader *q;
-    ParsingRunnerManager m_runner;
+    const PluginManager *const m_pluginManager;
     bool m_recenter;
     QString m_filepath;
     QString m_contents;
-    QString m_nonExistentLocalCacheFile;
+    QString m_cacheFileToWrite;
+    bool m_cacheCompleteDocumentsOnly;
     QString m_property;
     GeoDataStyle* m_style;
     DocumentRole m_documentRole;
     GeoDataStyleMap* m_styleMap;
     GeoDataDocument *m_document;
+    GeoDataLatLonAltBox m_latLonAltBox;
     QString m_error;
 
     const MarbleClock *m_clock;
@@ -103,14 +117,14 @@ public:
 
 FileLoader::FileLoader( QObject* parent, MarbleModel *model, bool recenter,
                        const QString& file, const QString& property, GeoDataStyle* style = new GeoDataStyle(), DocumentRole role = UnknownDocument )
-    : QThread( parent ),
+    : QObject( parent ),
       d( new FileLoaderPrivate( this, model, recenter, file, property, style, role ) )
 {
 }
 
 FileLoader::FileLoader( QObject* parent, MarbleModel *model,
                         const QString& contents, const QString& file, DocumentRole role = UnknownDocument)
-    : QThread( parent ),
+    : QObject( parent ),
       d( new FileLoaderPrivate( this, model, contents, file, role ) )
 {
 }
@@ -135,6 +149,11 @@ QString FileLoader::error() const
     return d->m_error;
 }
 
+GeoDataLatLonAltBox FileLoader::latLonAltBox() const
+{
+    return d->m_latLonAltBox;
+}
+
 void FileLoader::run()
 {
     if ( d->m_contents.isEmpty() ) {
@@ -148,6 +167,7 @@ void FileLoader::run()
         QString name = fileinfo.completeBaseName();
         QString suffix = fileinfo.suffix();
         QString cacheFile;
+        QString localCacheFile;
 
         // determine source, cache names
         if ( fileinfo.isAbsolute() ) {
@@ -163,44 +183,73 @@ void FileLoader::run()
             defaultSourceName   = MarbleDirs::path( "placemarks/" + path + name + '.' + suffix );
 
             cacheFile = MarbleDirs::path( "placemarks/" + path + name + ".cache" );
+            localCacheFile = MarbleDirs::localPath() + "/placemarks/" + path + name + ".cache";
             if ( cacheFile.isEmpty()) {
-                cacheFile = MarbleDirs::localPath() + "/placemarks/" + path + name + ".cache";
-                if ( !QFileInfo( cacheFile ).exists() ) {
-                    d->m_nonExistentLocalCacheFile = cacheFile;
-                }
+                cacheFile = localCacheFile;
             }
         }
 
+        const bool sourceExists = QFile::exists( defaultSourceName );
+
+        if ( cacheFile.isEmpty() && sourceExists && suffix != "cache" ) {
+            // other files are cached in the local cache directory, as long
+            // as nothing of them gets lost in the cache
+            cacheFile = FileLoaderPrivate::documentCacheFile( defaultSourceName );
+            localCacheFile = cacheFile;
+            d->m_cacheCompleteDocumentsOnly = true;
+        }
+
+        QString sourceFile;
+
         // if cache file more recent that source file, load cache file
         if ( QFile::exists( cacheFile ) ) {
-            mDebug() << "Loading Cache File:" + cacheFile;
-
             QDateTime sourceLastModified;
 
-            if ( QFile::exists( defaultSourceName ) ) {
+            if ( sourceExists ) {
                 sourceLastModified = QFileInfo( defaultSourceName ).lastModified();
             }
 
             const QDateTime cacheLastModified  = QFileInfo( cacheFile ).lastModified();
 
-            if ( sourceLastModified < cacheLastModified ) {
-                connect( &d->m_runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
-                         this, SLOT(documentParsed(GeoDataDocument*,QString)) );
-                d->m_runner.parseFile( cacheFile, d->m_documentRole );
+            // a cache of the old point only format is regenerated from its source
+            if ( sourceLastModified < cacheLastModified
+                 && ( !sourceExists || DocumentCache::isDocumentCache( cacheFile ) ) ) {
+                mDebug() << "Loading Cache File:" + cacheFile;
+                sourceFile = cacheFile;
             }
         }
+
         // we load source file, multiple cases
-        else if ( QFile::exists( defaultSourceName ) ) {
-            mDebug() << "No recent Default Placemark Cache File available!";
+        if ( sourceFile.isEmpty() && sourceExists ) {
+            mDebug() << "No recent Cache File available for" << defaultSourceName;
 
             // use runners: pnt, gpx, osm
-            connect( &d->m_runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
-                    this, SLOT(documentParsed(GeoDataDocument*,QString)) );
-            d->m_runner.parseFile( defaultSourceName, d->m_documentRole );
+            sourceFile = defaultSourceName;
+            d->m_cacheFileToWrite = localCacheFile;
         }
-        else {
+        else if ( sourceFile.isEmpty() ) {
             mDebug() << "No Default Placemark Source File for " << name;
         }
+
+        if ( !sourceFile.isEmpty() ) {
+            // The runners parse in the global thread pool, this thread only
+            // waits for them. The runner manager lives in this thread, so the
+            // result is delivered here as well. Unlike openFile() this waits
+            // without a watchdog: large files may take long to parse, and the
+            // runner manager must outlive its parsing tasks.
+            ParsingRunnerManager runner( d->m_pluginManager );
+            connect( &runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
+                     this, SLOT(documentParsed(GeoDataDocument*,QString)), Qt::DirectConnection );
+            QEventLoop localEventLoop;
+            connect( &runner, SIGNAL(parsingFinished()),
+                     &localEventLoop, SLOT(quit()), Qt::QueuedConnection );
+            runner.parseFile( sourceFile, d->m_documentRole );
+            localEventLoop.exec();
+            if ( d->m_document && sourceFile == cacheFile && sourceExists ) {
+                d->m_document->setFileName( defaultSourceName );
+            }
+            d->prepareDocument();
+        }
     // content is not empty, we load from data
     } else {
         // Read the KML Data
@@ -210,27 +259,20 @@ void FileLoader::run()
         QBuffer buffer( &ba );
         buffer.open( QIODevice::ReadOnly );
 
-        if ( !parser.read( &buffer ) ) {
+        if ( parser.read( &buffer ) ) {
+            GeoDocument* document = parser.releaseDocument();
+            Q_ASSERT( document );
+
+            d->m_document = static_cast<GeoDataDocument*>( document );
+            d->m_document->setDocumentRole( d->m_documentRole );
+            d->prepareDocument();
+        } else {
             qWarning( "Could not import kml buffer!" );
-            emit loaderFinished( this );
-            return;
         }
-
-        GeoDocument* document = parser.releaseDocument();
-        Q_ASSERT( document );
-
-        d->m_document = static_cast<GeoDataDocument*>( document );
-        d->m_document->setProperty( d->m_property );
-        d->m_document->setDocumentRole( d->m_documentRole );
-        d->createFilterProperties( d->m_document );
         buffer.close();
-
-        mDebug() << "newGeoDataDocumentAdded" << d->m_filepath;
-
-        emit newGeoDataDocumentAdded( d->m_document );
-        emit loaderFinished( this );
     }
 
+    emit loaderFinished( this );
 }
 
 bool FileLoader::recenter() const
@@ -238,64 +280,42 @@ bool FileLoader::recenter() const
     return d->m_recenter;
 }
 
-const quint32 MarbleMagicNumber = 0x31415926;
+QString FileLoaderPrivate::documentCacheFile( const QString &sourceFile )
+{
+    // keyed by path and modification time, so an older file copied over
+    // the source doesn't get the cache of the newer one
+    const QString canonicalPath = QFileInfo( sourceFile ).canonicalFilePath();
+    const QByteArray hash = QCryptographicHash::hash( canonicalPath.toUtf8(), QCryptographicHash::Md5 ).toHex();
+    const uint lastModified = QFileInfo( sourceFile ).lastModified().toTime_t();
+
+    return QString( "%1/cache/documents/%2-%3.cache" ).arg( MarbleDirs::localPath() )
+                                                     .arg( QString::fromLatin1( hash ) )
+                                                     .arg( lastModified );
+}
 
 void FileLoaderPrivate::saveFile( const QString& filename )
 {
+    const QFileInfo fileInfo( filename );
+    if ( !fileInfo.dir().exists() )
+        ( QDir::root() ).mkpath( fileInfo.path() );
 
-    if ( !QDir( MarbleDirs::localPath() + "/placemarks/" ).exists() )
-        ( QDir::root() ).mkpath( MarbleDirs::localPath() + "/placemarks/" );
-   
-    mDebug() << "Creating cache at " << filename ;
+    if ( m_cacheCompleteDocumentsOnly ) {
+        if ( !DocumentCache::isCacheable( m_document ) ) {
+            mDebug() << "Not caching" << m_filepath << "as the cache would lose some of it";
+            return;
+        }
 
-    QFile file( filename );
-    if ( !file.open( QIODevice::WriteOnly ) ) {
-        mDebug() << Q_FUNC_INFO << "Can't open" << filename << "for writing";
-        return;
+        // drop the caches of earlier versions of the file
+        const QString stale = fileInfo.completeBaseName().section( '-', 0, 0 ) + "-*.cache";
+        foreach ( const QString &fileName, fileInfo.dir().entryList( QStringList() << stale, QDir::Files ) ) {
+            fileInfo.dir().remove( fileName );
+        }
     }
-    QDataStream out( &file );
 
-    // Write a header with a "magic number" and a version
-    // out << (quint32)0xA0B0C0D0;
-    out << (quint32)MarbleMagicNumber;
-    out << (qint32)015;
-
-    out.setVersion( QDataStream::Qt_4_2 );
-
-    savePlacemarks(out, m_document);
-}
-
-void FileLoaderPrivate::savePlacemarks(QDataStream &out, const GeoDataContainer *container)
-{
-
-    qreal lon;
-    qreal lat;
-    qreal alt;
-
-    const QVector<GeoDataPlacemark*> placemarks = container->placemarkList();
-    QVector<GeoDataPlacemark*>::const_iterator it = placemarks.constBegin();
-    QVector<GeoDataPlacemark*>::const_iterator const end = placemarks.constEnd();
-    for (; it != end; ++it ) {
-        out << (*it)->name();
-        (*it)->coordinate( m_clock->dateTime() ).geoCoordinates( lon, lat, alt );
-
-        // Use double to provide a single cache file format across architectures
-        out << (double)(lon) << (double)(lat) << (double)(alt);
-        out << QString( (*it)->role() );
-        out << QString( (*it)->description() );
-        out << QString( (*it)->countryCode() );
-        out << QString( (*it)->state() );
-        out << (double) (*it)->area();
-        out << (qint64) (*it)->population();
-        out << ( qint16 ) ( (*it)->extendedData().value("gmt").value().toInt() );
-        out << ( qint8 ) ( (*it)->extendedData().value("dst").value().toInt() );
-    }
+    mDebug() << "Creating cache at " << filename ;
 
-    const QVector<GeoDataFolder*> folders = container->folderList();
-    QVector<GeoDataFolder*>::const_iterator cont = folders.constBegin();
-    QVector<GeoDataFolder*>::const_iterator endcont = folders.constEnd();
-    for (; cont != endcont; ++cont ) {
-            savePlacemarks(out, *cont);
+    if ( !DocumentCache::write( filename, m_document ) ) {
+        mDebug() << Q_FUNC_INFO << "Can't write" << filename;
     }
 }
 
@@ -303,20 +323,41 @@ void FileLoaderPrivate::documentParsed( GeoDataDocument* doc, const QString& err
 {
     m_error = error;
     if ( doc ) {
-        m_document = doc;
-        doc->setProperty( m_property );
-        if( m_style ) {
-            doc->addStyleMap( *m_styleMap );
-            doc->addStyle( *m_style );
+        if ( m_document ) {
+            // another runner parsed the file as well
+            delete doc;
+        } else {
+            m_document = doc;
         }
+    }
+}
 
-        createFilterProperties( doc );
-        emit q->newGeoDataDocumentAdded( m_document );
-        if ( !m_nonExistentLocalCacheFile.isEmpty() ) {
-            saveFile( m_nonExistentLocalCacheFile );
-        }
+void FileLoaderPrivate::prepareDocument()
+{
+    if ( !m_document ) {
+        return;
+    }
+
+    m_document->setProperty( m_property );
+    if ( m_document->name().isEmpty() && !m_document->fileName().isEmpty() ) {
+        QFileInfo file( m_document->fileName() );
+        m_document->setName( file.baseName() );
+    }
+    if( m_style ) {
+        m_document->addStyleMap( *m_styleMap );
+        m_document->addStyle( *m_style );
+    }
+
+    createFilterProperties( m_document );
+    if ( m_recenter ) {
+        m_latLonAltBox = m_document->latLonAltBox();
+    }
+
+    mDebug() << "newGeoDataDocumentAdded" << m_filepath;
+    emit q->newGeoDataDocumentAdded( m_document );
+    if ( !m_cacheFileToWrite.isEmpty() ) {
+        saveFile( m_cacheFileToWrite );
     }
-    emit q->loaderFinished( q );
 }
 
 void FileLoaderPrivate::createFilterProperties( GeoDataContainer *container )
@@ -337,6 +378,7 @@ void FileLoaderPrivate::createFilterProperties( GeoDataContainer *container )
 
             GeoDataPlacemark* placemark = static_cast<GeoDataPlacemark*>( *i );
             Q_ASSERT( placemark->geometry() );
+            cacheLatLonAltBoxes( placemark->geometry() );
 
             bool hasPopularity = false;
 
@@ -511,6 +553,28 @@ void FileLoaderPrivate::createFilterProperties( GeoDataContainer *container )
     }
 }
 
+void FileLoaderPrivate::cacheLatLonAltBoxes( const GeoDataGeometry *geometry )
+{
+    // Line strings compute their bounding boxes once and keep them. Doing
+    // it here spares the GUI thread when the geometries are put into the
+    // spatial index of the geometry layer.
+    if ( geometry->nodeType() == GeoDataTypes::GeoDataLineStringType
+         || geometry->nodeType() == GeoDataTypes::GeoDataLinearRingType ) {
+        static_cast<const GeoDataLineString*>( geometry )->latLonAltBox();
+    } else if ( geometry->nodeType() == GeoDataTypes::GeoDataPolygonType ) {
+        const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon*>( geometry );
+        polygon->outerBoundary().latLonAltBox();
+        foreach ( const GeoDataLinearRing &innerBoundary, polygon->innerBoundaries() ) {
+            innerBoundary.latLonAltBox();
+        }
+    } else if ( geometry->nodeType() == GeoDataTypes::GeoDataMultiGeometryType ) {
+        const GeoDataMultiGeometry *multiGeometry = static_cast<const GeoDataMultiGeometry*>( geometry );
+        for ( int i = 0; i < multiGeometry->size(); ++i ) {
+            cacheLatLonAltBoxes( multiGeometry->child( i ) );
+        }
+    }
+}
+
 int FileLoaderPrivate::cityPopIdx( qint64 population ) const
 {
     int popidx = 3;
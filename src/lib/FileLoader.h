@@ -13,16 +13,26 @@
 #include "GeoDataDocument.h"
 #include "GeoDataStyle.h"
 
-#include <QThread>
+#include <QObject>
+#include <QRunnable>
 #include <QString>
 
 namespace Marble
 {
 class GeoDataContainer;
+class GeoDataLatLonAltBox;
 class FileLoaderPrivate;
 class MarbleModel;
 
-class FileLoader : public QThread
+/**
+ * Loads a file, or KML data given as a string, into a document.
+ *
+ * Everything which only concerns the document is done when the loader
+ * runs, i.e. in a thread of the pool of the FileManager: parsing, assigning
+ * styles and popularities to the placemarks and computing the bounding boxes
+ * of their geometries. The document is not added to any model.
+ */
+class FileLoader : public QObject, public QRunnable
 {
     Q_OBJECT
     public:
@@ -32,12 +42,22 @@ class FileLoader : public QThread
                     const QString& contents, const QString& name, DocumentRole role );
         virtual ~FileLoader();
 
+        /**
+         * @reimp
+         */
         void run();
+
         bool recenter() const;
         QString path() const;
         GeoDataDocument *document();
         QString error() const;
 
+        /**
+         * Returns the bounding box of the visible placemarks of the document,
+         * which is only computed if the loader should recenter.
+         */
+        GeoDataLatLonAltBox latLonAltBox() const;
+
     Q_SIGNALS:
         void loaderFinished( FileLoader* );
         void newGeoDataDocumentAdded( GeoDataDocument* );
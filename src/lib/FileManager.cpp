@@ -13,7 +13,10 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
 #include <QTime>
+#include <QTimer>
 #include <QMessageBox>
 
 #include "FileLoader.h"
@@ -38,25 +41,40 @@ public:
         : m_model( model ),
           q( parent )
     {
+        // A pool of its own: loaders wait for the parse runners, which run
+        // in the global thread pool.
+        m_loaderPool.setMaxThreadCount( QThread::idealThreadCount() );
+
+        // documents finishing shortly after each other are added at once,
+        // without waiting for files which take longer to load
+        m_batchTimer.setSingleShot( true );
+        m_batchTimer.setInterval( 200 );
+        QObject::connect( &m_batchTimer, SIGNAL(timeout()), q, SLOT(addFinishedDocuments()) );
     }
 
     ~FileManagerPrivate()
     {
-        foreach ( FileLoader *loader, m_loaderList ) {
-            if ( loader ) {
-                loader->wait();
-            }
+        m_loaderPool.waitForDone();
+        foreach ( FileLoader *loader, m_loaderList + m_discardedLoaders + m_finishedLoaders ) {
+            delete loader->document();
         }
     }
 
     void appendLoader( FileLoader *loader );
     void closeFile( const QString &key );
     void cleanupLoader( FileLoader *loader );
+    void addFinishedDocuments();
 
     MarbleModel* const m_model;
 
     FileManager * const q;
+    QThreadPool m_loaderPool;
     QList<FileLoader*> m_loaderList;
+    // loaders whose file was removed while loading
+    QList<FileLoader*> m_discardedLoaders;
+    // loaders whose documents are added to the tree model with the next batch
+    QList<FileLoader*> m_finishedLoaders;
+    QTimer m_batchTimer;
     QHash < QString, GeoDataDocument* > m_fileItemHash;
     GeoDataLatLonBox m_latLonBox;
     QTime m_timer;
@@ -81,7 +99,7 @@ void FileManager::addFile( const QString& filepath, const QString& property, Geo
             return;  // already loaded
     }
 
-    foreach ( const FileLoader *loader, d->m_loaderList ) {
+    foreach ( const FileLoader *loader, d->m_loaderList + d->m_finishedLoaders ) {
         if ( loader->path() == filepath )
             return;  // currently loading
     }
@@ -108,21 +126,31 @@ void FileManager::addData( const QString &name, const QString &data, DocumentRol
 
 void FileManagerPrivate::appendLoader( FileLoader *loader )
 {
+    // emitted in a thread of the pool
     QObject::connect( loader, SIGNAL(loaderFinished(FileLoader*)),
-             q, SLOT(cleanupLoader(FileLoader*)) );
+             q, SLOT(cleanupLoader(FileLoader*)), Qt::QueuedConnection );
 
     m_loaderList.append( loader );
-    loader->start();
+    loader->setAutoDelete( false );
+    m_loaderPool.start( loader );
 }
 
 void FileManager::removeFile( const QString& key )
 {
     foreach ( FileLoader *loader, d->m_loaderList ) {
         if ( loader->path() == key ) {
-            disconnect( loader, 0, this, 0 );
-            loader->wait();
+            // the document is deleted once the loader is finished
             d->m_loaderList.removeAll( loader );
+            d->m_discardedLoaders.append( loader );
+            return;
+        }
+    }
+
+    foreach ( FileLoader *loader, d->m_finishedLoaders ) {
+        if ( loader->path() == key ) {
+            d->m_finishedLoaders.removeAll( loader );
             delete loader->document();
+            delete loader;
             return;
         }
     }
@@ -188,34 +216,61 @@ GeoDataDocument * FileManager::at( const QString &key )
 
 void FileManagerPrivate::cleanupLoader( FileLoader* loader )
 {
-    GeoDataDocument *doc = loader->document();
     m_loaderList.removeAll( loader );
-    if ( loader->isFinished() ) {
-        if ( doc ) {
-            if ( doc->name().isEmpty() && !doc->fileName().isEmpty() )
-            {
-                QFileInfo file( doc->fileName() );
-                doc->setName( file.baseName() );
-            }
-            m_model->treeModel()->addDocument( doc );
-            m_fileItemHash.insert( loader->path(), doc );
-            emit q->fileAdded( loader->path() );
-            if( loader->recenter() ) {
-                m_latLonBox |= doc->latLonAltBox();
-            }
+    if ( m_discardedLoaders.removeAll( loader ) ) {
+        delete loader->document();
+        delete loader;
+    }
+    else {
+        // the message box runs an event loop, other loaders may finish meanwhile
+        const QString error = loader->error();
+        if ( loader->document() ) {
+            m_finishedLoaders.append( loader );
+        }
+        else {
+            delete loader;
         }
-        if ( !loader->error().isEmpty() ) {
+        if ( !error.isEmpty() ) {
             QMessageBox errorBox;
             errorBox.setWindowTitle( QObject::tr("File Parsing Error"));
-            errorBox.setText( loader->error() );
+            errorBox.setText( error );
             errorBox.setIcon( QMessageBox::Warning );
             errorBox.exec();
-            qWarning() << "File Parsing error " << loader->error();
+            qWarning() << "File Parsing error " << error;
+        }
+    }
+    if ( m_loaderList.isEmpty() ) {
+        // nothing left to wait for
+        m_batchTimer.stop();
+        addFinishedDocuments();
+    }
+    else if ( !m_finishedLoaders.isEmpty() && !m_batchTimer.isActive() ) {
+        m_batchTimer.start();
+    }
+}
+
+void FileManagerPrivate::addFinishedDocuments()
+{
+    const QList<FileLoader*> loaders = m_finishedLoaders;
+    m_finishedLoaders.clear();
+
+    QVector<GeoDataDocument*> documents;
+    documents.reserve( loaders.size() );
+    foreach ( FileLoader *loader, loaders ) {
+        documents.append( loader->document() );
+    }
+    m_model->treeModel()->addDocuments( documents );
+
+    foreach ( FileLoader *loader, loaders ) {
+        m_fileItemHash.insert( loader->path(), loader->document() );
+        emit q->fileAdded( loader->path() );
+        if( loader->recenter() ) {
+            m_latLonBox |= loader->latLonAltBox();
         }
         delete loader;
     }
-    if ( m_loaderList.isEmpty()  )
-    {
+
+    if ( m_loaderList.isEmpty() ) {
         mDebug() << "Finished loading all placemarks " << m_timer.elapsed();
 
         if ( !m_latLonBox.isEmpty() ) {
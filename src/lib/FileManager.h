@@ -32,6 +32,9 @@ class GeoDataLatLonBox;
  *
  * The loaded data are accessible via
  * various models in MarbleModel.
+ *
+ * Files are loaded by a pool of threads. The documents loaded meanwhile
+ * are added to the tree model together in batches, at most every 200 ms.
  */
 class FileManager : public QObject
 {
@@ -87,6 +90,7 @@ class FileManager : public QObject
  private:
 
     Q_PRIVATE_SLOT( d, void cleanupLoader( FileLoader *loader ) )
+    Q_PRIVATE_SLOT( d, void addFinishedDocuments() )
 
     Q_DISABLE_COPY( FileManager )
 
@@ -597,6 +597,27 @@ int GeoDataTreeModel::addDocument( GeoDataDocument *document )
     return addFeature( d->m_rootDocument, document );
 }
 
+int GeoDataTreeModel::addDocuments( const QVector<GeoDataDocument*> &documents )
+{
+    const int first = d->m_rootDocument->size();
+    if ( documents.isEmpty() ) {
+        return first;
+    }
+
+    beginInsertRows( QModelIndex(), first, first + documents.size() - 1 );
+    foreach ( GeoDataDocument *document, documents ) {
+        d->m_rootDocument->append( document );
+    }
+    d->checkParenting( d->m_rootDocument );
+    endInsertRows();
+
+    foreach ( GeoDataDocument *document, documents ) {
+        emit added( document );
+    }
+
+    return first;
+}
+
 bool GeoDataTreeModel::removeFeature( GeoDataContainer *parent, int row )
 {
     if ( row<parent->size() ) {
@@ -14,6 +14,7 @@
 #include "marble_export.h"
 
 #include <QAbstractItemModel>
+#include <QVector>
 
 class QItemSelectionModel;
 
@@ -96,6 +97,13 @@ public Q_SLOTS:
 
     int addDocument( GeoDataDocument *document );
 
+    /**
+     * Adds the @p documents at the end of the root document with a single
+     * insertion of rows, which is cheaper for the views and layers than
+     * adding them one by one. Returns the row of the first document.
+     */
+    int addDocuments( const QVector<GeoDataDocument*> &documents );
+
     void removeDocument( int index );
 
     void removeDocument( GeoDataDocument* document );
@@ -11,35 +11,113 @@
 #include "GeoGraphicsScene.h"
 
 #include "GeoDataFeature.h"
-#include "GeoDataGroundOverlay.h"
-#include "GeoDataLatLonBox.h"
-#include "GeoDataPhotoOverlay.h"
-#include "GeoDataPlacemark.h"
-#include "GeoDataTypes.h"
+#include "GeoDataLatLonAltBox.h"
 #include "GeoGraphicsItem.h"
-#include "TileId.h"
-#include "TileCoordsPyramid.h"
-#include "MarbleDebug.h"
-#include <QMap>
+#include "RTree.h"
+
+#include <QHash>
+#include <QMultiHash>
+#include <QVector>
 
 namespace Marble
 {
 
-bool zValueLessThan( GeoGraphicsItem* i1, GeoGraphicsItem* i2 )
-{
-    return i1->zValue() < i2->zValue();
-}
+// pending items are loaded in bulk if they outnumber the indexed ones
+static const int minimumBulkLoad = 64;
 
 class GeoGraphicsScenePrivate
 {
 public:
+    /**
+     * Identifies an item in the index. The serial keeps the order of items
+     * with the same z value stable.
+     */
+    struct IndexEntry
+    {
+        GeoGraphicsItem *item;
+        int serial;
+
+        bool operator==( const IndexEntry &other ) const { return item == other.item; }
+    };
+
+    typedef RTree<IndexEntry> Index;
+
+    /**
+     * The boxes an item has been indexed with. Boxes crossing the date line
+     * are indexed as their eastern and western parts.
+     */
+    struct ItemBoxes
+    {
+        Index::Box boxes[2];
+        int count;
+        int serial;
+    };
 
-    void addItems(const TileId &tileId, QList<GeoGraphicsItem*> &result, int maxZoomLevel ) const;
+    GeoGraphicsScenePrivate();
 
-    QMap<TileId, QList<GeoGraphicsItem*> > m_items;
-    QMultiHash<const GeoDataFeature*, TileId> m_features;
+    static int boxes( const GeoDataLatLonBox &box, Index::Box *result );
+
+    static bool lessThanByZValue( const IndexEntry &a, const IndexEntry &b );
+
+    /**
+     * Moves the pending items into the index.
+     */
+    void indexPendingItems();
+
+    Index m_index;
+    QVector<Index::Entry> m_pending;
+    QHash<GeoGraphicsItem*, ItemBoxes> m_items;
+    QMultiHash<const GeoDataFeature*, GeoGraphicsItem*> m_features;
+    int m_nextSerial;
 };
 
+GeoGraphicsScenePrivate::GeoGraphicsScenePrivate()
+    : m_nextSerial( 0 )
+{
+}
+
+int GeoGraphicsScenePrivate::boxes( const GeoDataLatLonBox &box, Index::Box *result )
+{
+    qreal north, south, east, west;
+    box.boundaries( north, south, east, west );
+
+    if ( west > east ) {
+        result[0] = Index::Box::fromCoordinates( west, south, M_PI, north );
+        result[1] = Index::Box::fromCoordinates( -M_PI, south, east, north );
+        return 2;
+    }
+
+    result[0] = Index::Box::fromCoordinates( west, south, east, north );
+    return 1;
+}
+
+bool GeoGraphicsScenePrivate::lessThanByZValue( const IndexEntry &a, const IndexEntry &b )
+{
+    const qreal zA = a.item->zValue();
+    const qreal zB = b.item->zValue();
+    return zA < zB || ( zA == zB && a.serial < b.serial );
+}
+
+void GeoGraphicsScenePrivate::indexPendingItems()
+{
+    if ( m_pending.isEmpty() ) {
+        return;
+    }
+
+    if ( m_pending.size() >= minimumBulkLoad && m_pending.size() > m_index.size() ) {
+        QVector<Index::Entry> entries = m_pending;
+        m_index.entries( &entries );
+        m_index.load( entries );
+    }
+    else {
+        foreach ( const Index::Entry &entry, m_pending ) {
+            m_index.insert( entry.box, entry.value );
+        }
+    }
+
+    m_pending.clear();
+}
+
 GeoGraphicsScene::GeoGraphicsScene( QObject* parent ): QObject( parent ), d( new GeoGraphicsScenePrivate() )
 {
 
@@ -52,128 +130,77 @@ GeoGraphicsScene::~GeoGraphicsScene()
 
 void GeoGraphicsScene::eraseAll()
 {
-    for( QMap< TileId, QList< GeoGraphicsItem* > >::const_iterator i = d->m_items.constBegin();
-         i != d->m_items.constEnd(); ++i )
-    {
-        qDeleteAll(*i);
-    }
-    d->m_items.clear();
-    d->m_features.clear();
+    qDeleteAll( d->m_items.keys() );
+    clear();
 }
 
 QList< GeoGraphicsItem* > GeoGraphicsScene::items( const GeoDataLatLonBox &box, int zoomLevel ) const
 {
-    if ( box.west() > box.east() ) {
-        // Handle boxes crossing the IDL by splitting it into two separate boxes
-        GeoDataLatLonBox left;
-        left.setWest( -M_PI );
-        left.setEast( box.east() );
-        left.setNorth( box.north() );
-        left.setSouth( box.south() );
-
-        GeoDataLatLonBox right;
-        right.setWest( box.west() );
-        right.setEast( M_PI );
-        right.setNorth( box.north() );
-        right.setSouth( box.south() );
-
-        QList< GeoGraphicsItem* > allItems = items( left, zoomLevel );
-        foreach( GeoGraphicsItem* item, items( right, zoomLevel ) ) {
-            if ( !allItems.contains( item ) ) {
-                allItems << item;
-            }
-        }
-        return allItems;
+    d->indexPendingItems();
+
+    GeoGraphicsScenePrivate::Index::Box boxes[2];
+    const int count = GeoGraphicsScenePrivate::boxes( box, boxes );
+
+    QVector<GeoGraphicsScenePrivate::IndexEntry> entries;
+    for ( int i = 0; i < count; ++i ) {
+        d->m_index.query( boxes[i], &entries );
     }
 
+    // items crossing the date line may have been found twice
+    qSort( entries.begin(), entries.end(), GeoGraphicsScenePrivate::lessThanByZValue );
+
     QList< GeoGraphicsItem* > result;
-    QRect rect;
-    qreal north, south, east, west;
-    box.boundaries( north, south, east, west );
-    TileId key;
-
-    key = TileId::fromCoordinates( GeoDataCoordinates(west, north, 0), zoomLevel );
-    rect.setLeft( key.x() );
-    rect.setTop( key.y() );
-
-    key = TileId::fromCoordinates( GeoDataCoordinates(east, south, 0), zoomLevel );
-    rect.setRight( key.x() );
-    rect.setBottom( key.y() );
-    
-    TileCoordsPyramid pyramid( 0, zoomLevel );
-    pyramid.setBottomLevelCoords( rect );
-
-    for ( int level = pyramid.topLevel(); level <= pyramid.bottomLevel(); ++level ) {
-        QRect const coords = pyramid.coords( level );
-        int x1, y1, x2, y2;
-        coords.getCoords( &x1, &y1, &x2, &y2 );
-        for ( int x = x1; x <= x2; ++x ) {
-            for ( int y = y1; y <= y2; ++y ) {
-                d->addItems( TileId ( 0, level, x, y ), result, zoomLevel );
-            }
+    result.reserve( entries.size() );
+    GeoGraphicsItem *previous = 0;
+    foreach ( const GeoGraphicsScenePrivate::IndexEntry &entry, entries ) {
+        if ( entry.item != previous
+             && entry.item->minZoomLevel() <= zoomLevel && entry.item->visible() ) {
+            result.append( entry.item );
         }
+        previous = entry.item;
     }
+
     return result;
 }
 
 void GeoGraphicsScene::removeItem( const GeoDataFeature* feature )
 {
-    QList<TileId> keys = d->m_features.values( feature );
-    foreach( TileId key, keys ) {
-        QList< GeoGraphicsItem* >& tileList = d->m_items[key];
-        foreach( GeoGraphicsItem* item, tileList ) {
-            if( item->feature() == feature ) {
-                d->m_features.remove( feature );
-                tileList.removeAll( item );
-                break;
-            }
+    d->indexPendingItems();
+
+    foreach ( GeoGraphicsItem *item, d->m_features.values( feature ) ) {
+        const GeoGraphicsScenePrivate::ItemBoxes itemBoxes = d->m_items.take( item );
+        const GeoGraphicsScenePrivate::IndexEntry entry = { item, itemBoxes.serial };
+        for ( int i = 0; i < itemBoxes.count; ++i ) {
+            d->m_index.remove( itemBoxes.boxes[i], entry );
         }
     }
+
+    d->m_features.remove( feature );
 }
 
 void GeoGraphicsScene::clear()
 {
+    d->m_index.clear();
+    d->m_pending.clear();
     d->m_items.clear();
+    d->m_features.clear();
 }
 
 void GeoGraphicsScene::addItem( GeoGraphicsItem* item )
 {
-    // Select zoom level so that the object fit in single tile
-    int zoomLevel;
-    qreal north, south, east, west;
-    item->latLonAltBox().boundaries( north, south, east, west );
-    for(zoomLevel = item->minZoomLevel(); zoomLevel >= 0; zoomLevel--)
-    {
-        if( TileId::fromCoordinates( GeoDataCoordinates(west, north, 0), zoomLevel ) ==
-            TileId::fromCoordinates( GeoDataCoordinates(east, south, 0), zoomLevel ) )
-            break;
+    GeoGraphicsScenePrivate::ItemBoxes itemBoxes;
+    itemBoxes.count = GeoGraphicsScenePrivate::boxes( item->latLonAltBox(), itemBoxes.boxes );
+    itemBoxes.serial = d->m_nextSerial++;
+
+    // indexed on the next query, possibly together with many others
+    const GeoGraphicsScenePrivate::IndexEntry entry = { item, itemBoxes.serial };
+    for ( int i = 0; i < itemBoxes.count; ++i ) {
+        const GeoGraphicsScenePrivate::Index::Entry pending = { itemBoxes.boxes[i], entry };
+        d->m_pending.append( pending );
     }
 
-    const TileId key = TileId::fromCoordinates( GeoDataCoordinates(west, north, 0), zoomLevel ); // same as GeoDataCoordinates(east, south, 0), see above
-
-    QList< GeoGraphicsItem* >& tileList = d->m_items[key];
-    QList< GeoGraphicsItem* >::iterator position = qLowerBound( tileList.begin(), tileList.end(), item, zValueLessThan );
-    tileList.insert( position, item );
-    d->m_features.insert( item->feature(), key );
-}
-
-void GeoGraphicsScenePrivate::addItems( const TileId &tileId, QList<GeoGraphicsItem *> &result, int maxZoomLevel ) const
-{
-    const QList< GeoGraphicsItem* > &objects = m_items.value(tileId);
-    QList< GeoGraphicsItem* >::iterator before = result.begin();
-    QList< GeoGraphicsItem* >::const_iterator currentItem = objects.constBegin();
-    while( currentItem != objects.end() ) {
-        while( ( currentItem != objects.end() )
-          && ( ( before == result.end() ) || ( (*currentItem)->zValue() < (*before)->zValue() ) ) ) {
-            if( (*currentItem)->minZoomLevel() <= maxZoomLevel && (*currentItem)->visible() ) {
-                before = result.insert( before, *currentItem );
-            }
-            ++currentItem;
-        }
-        if ( before != result.end() ) {
-            ++before;
-        }
-    }
+    d->m_items.insert( item, itemBoxes );
+    d->m_features.insert( item->feature(), item );
 }
 
 }
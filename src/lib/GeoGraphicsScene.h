@@ -49,7 +49,8 @@ public:
 
     /**
      * @brief Remove all concerned items from the GeoGraphicsScene
-     * Removes all items which are associated with @p object from the GeoGraphicsScene
+     * Removes all items which are associated with @p object from the GeoGraphicsScene.
+     * The items are not deleted.
      */
     void removeItem( const GeoDataFeature *feature );
 
@@ -73,7 +74,9 @@ public:
      *
      * @param box The box around the items.
      * @param maxZoomLevel The max zoom level of tiling
-     * @return The list of items in the specified box in no specific order.
+     * @return The list of visible items in the specified box whose minimum
+     * zoom level doesn't exceed @p maxZoomLevel, in ascending order of their
+     * z values. Items of the same z value are in the order they were added.
      */
     QList<GeoGraphicsItem *> items( const GeoDataLatLonBox &box, int maxZoomLevel ) const;
 
@@ -471,24 +471,42 @@ void GeoPainter::drawPixmap ( const GeoDataCoordinates & centerPosition,
 }
 
 
-void GeoPainter::drawPolyline ( const GeoDataLineString & lineString,
-                                const QString& labelText,
-                                LabelPositionFlags labelPositionFlags )
+bool GeoPainter::screenPolygons ( const ViewportParams *viewport,
+                                  const GeoDataLineString & lineString,
+                                  QVector<QPolygonF*> & polygons )
 {
     // Immediately leave this method now if:
     // - the object is not visible in the viewport or if
     // - the size of the object is below the resolution of the viewport
-    if ( ! d->m_viewport->viewLatLonAltBox().intersects( lineString.latLonAltBox() ) ||
-         ! d->m_viewport->resolves( lineString.latLonAltBox() )
+    if ( ! viewport->viewLatLonAltBox().intersects( lineString.latLonAltBox() ) ||
+         ! viewport->resolves( lineString.latLonAltBox() )
         )
     {
         // mDebug() << "LineString doesn't get displayed on the viewport";
-        return;
+        return false;
     }
 
+    viewport->screenCoordinates( lineString, polygons );
+    return true;
+}
+
+
+void GeoPainter::drawPolyline ( const GeoDataLineString & lineString,
+                                const QString& labelText,
+                                LabelPositionFlags labelPositionFlags )
+{
     QVector<QPolygonF*> polygons;
-    d->m_viewport->screenCoordinates( lineString, polygons );
+    if ( screenPolygons( d->m_viewport, lineString, polygons ) ) {
+        drawPolyline( polygons, labelText, labelPositionFlags );
+        qDeleteAll( polygons );
+    }
+}
+
 
+void GeoPainter::drawPolyline ( const QVector<QPolygonF*> & polygons,
+                                const QString& labelText,
+                                LabelPositionFlags labelPositionFlags )
+{
     if ( labelText.isEmpty() || labelPositionFlags.testFlag( NoLabel ) ) {
         foreach( QPolygonF* itPolygon, polygons ) {
             ClipPainter::drawPolyline( *itPolygon );
@@ -519,7 +537,6 @@ void GeoPainter::drawPolyline ( const GeoDataLineString & lineString,
             }
         }
     }
-    qDeleteAll( polygons );
 }
 
 
@@ -560,25 +577,20 @@ QRegion GeoPainter::regionFromPolyline ( const GeoDataLineString & lineString,
 void GeoPainter::drawPolygon ( const GeoDataLinearRing & linearRing,
                                Qt::FillRule fillRule )
 {
-    // Immediately leave this method now if:
-    // - the object is not visible in the viewport or if
-    // - the size of the object is below the resolution of the viewport
-    if ( ! d->m_viewport->viewLatLonAltBox().intersects( linearRing.latLonAltBox() ) ||
-         ! d->m_viewport->resolves( linearRing.latLonAltBox() )
-        )
-    {
-        // mDebug() << "Polygon doesn't get displayed on the viewport";
-        return;
+    QVector<QPolygonF*> polygons;
+    if ( screenPolygons( d->m_viewport, linearRing, polygons ) ) {
+        drawPolygon( polygons, fillRule );
+        qDeleteAll( polygons );
     }
+}
 
-    QVector<QPolygonF*> polygons;
-    d->m_viewport->screenCoordinates( linearRing, polygons );
 
+void GeoPainter::drawPolygon ( const QVector<QPolygonF*> & polygons,
+                               Qt::FillRule fillRule )
+{
     foreach( QPolygonF* itPolygon, polygons ) {
         ClipPainter::drawPolygon( *itPolygon, fillRule );
     }
-
-    qDeleteAll( polygons );
 }
 
 
@@ -625,56 +637,51 @@ QRegion GeoPainter::regionFromPolygon ( const GeoDataLinearRing & linearRing,
 }
 
 
-void GeoPainter::drawPolygon ( const GeoDataPolygon & polygon,
-                               Qt::FillRule fillRule )
+bool GeoPainter::screenPolygons ( const ViewportParams *viewport,
+                                  const GeoDataPolygon & polygon,
+                                  QVector<QPolygonF*> & polygons,
+                                  QVector<QPolygonF> & outline )
 {
     // If the object is not visible in the viewport return 
-    if ( ! d->m_viewport->viewLatLonAltBox().intersects( polygon.outerBoundary().latLonAltBox() ) ||
+    if ( ! viewport->viewLatLonAltBox().intersects( polygon.outerBoundary().latLonAltBox() ) ||
     // If the size of the object is below the resolution of the viewport then return
-         ! d->m_viewport->resolves( polygon.outerBoundary().latLonAltBox() )
+         ! viewport->resolves( polygon.outerBoundary().latLonAltBox() )
         )
     {
         // mDebug() << "Polygon doesn't get displayed on the viewport";
-        return;
+        return false;
     }
-    // mDebug() << "Drawing Polygon";
 
     // Creating the outer screen polygons first
-    QVector<QPolygonF*> outerPolygons;
-    d->m_viewport->screenCoordinates( polygon.outerBoundary(), outerPolygons );
+    viewport->screenCoordinates( polygon.outerBoundary(), polygons );
 
     // Now creating the "holes" by cutting away the inner boundaries:
 
     // In QPathClipper We Trust ...
     // ... and in the speed of a threesome of nested foreachs!
 
-    QVector<QPolygonF> outline;
-    QPen const oldPen = pen();
     // When inner boundaries exist, the outline of the polygon must be painted
     // separately to avoid connections between the outer and inner boundaries
     // To avoid performance penalties the separate painting is only done when
     // it's really needed. See review 105019 for details.
     bool const needOutlineWorkaround = !polygon.innerBoundaries().isEmpty();
     if ( needOutlineWorkaround ) {
-        foreach( QPolygonF* polygon, outerPolygons ) {
-            outline << *polygon;
+        foreach( QPolygonF* outerPolygon, polygons ) {
+            outline << *outerPolygon;
         }
-        setPen( QPen( Qt::NoPen ) );
     }
 
-
-    QVector<GeoDataLinearRing> innerBoundaries = polygon.innerBoundaries(); 
-    foreach( const GeoDataLinearRing& itInnerBoundary, innerBoundaries ) {
+    foreach( const GeoDataLinearRing& itInnerBoundary, polygon.innerBoundaries() ) {
         QVector<QPolygonF*> innerPolygons;
-        d->m_viewport->screenCoordinates( itInnerBoundary, innerPolygons );
+        viewport->screenCoordinates( itInnerBoundary, innerPolygons );
 
         if ( needOutlineWorkaround ) {
-            foreach( QPolygonF* polygon, innerPolygons ) {
-                outline << *polygon;
+            foreach( QPolygonF* innerPolygon, innerPolygons ) {
+                outline << *innerPolygon;
             }
         }
 
-        foreach( QPolygonF* itOuterPolygon, outerPolygons ) {
+        foreach( QPolygonF* itOuterPolygon, polygons ) {
             foreach( QPolygonF* itInnerPolygon, innerPolygons ) {
                 *itOuterPolygon = itOuterPolygon->subtracted( *itInnerPolygon );
             }
@@ -682,18 +689,42 @@ void GeoPainter::drawPolygon ( const GeoDataPolygon & polygon,
         qDeleteAll( innerPolygons );    
     }
 
-    foreach( QPolygonF* itOuterPolygon, outerPolygons ) {
-        ClipPainter::drawPolygon( *itOuterPolygon, fillRule );
+    return true;
+}
+
+
+void GeoPainter::drawPolygon ( const GeoDataPolygon & polygon,
+                               Qt::FillRule fillRule )
+{
+    QVector<QPolygonF*> polygons;
+    QVector<QPolygonF> outline;
+    if ( screenPolygons( d->m_viewport, polygon, polygons, outline ) ) {
+        drawPolygon( polygons, outline, fillRule );
+        qDeleteAll( polygons );
     }
+}
 
-    if ( needOutlineWorkaround ) {
-        setPen( oldPen );
-        foreach( const QPolygonF &polygon, outline ) {
-            ClipPainter::drawPolyline( polygon );
-        }
+
+void GeoPainter::drawPolygon ( const QVector<QPolygonF*> & polygons,
+                               const QVector<QPolygonF> & outline,
+                               Qt::FillRule fillRule )
+{
+    if ( outline.isEmpty() ) {
+        drawPolygon( polygons, fillRule );
+        return;
+    }
+
+    QPen const oldPen = pen();
+    setPen( QPen( Qt::NoPen ) );
+
+    foreach( QPolygonF* itOuterPolygon, polygons ) {
+        ClipPainter::drawPolygon( *itOuterPolygon, fillRule );
     }
 
-    qDeleteAll( outerPolygons );    
+    setPen( oldPen );
+    foreach( const QPolygonF &polygon, outline ) {
+        ClipPainter::drawPolyline( polygon );
+    }
 }
 
 
@@ -16,6 +16,7 @@
 
 #include <QSize>
 #include <QRegion>
+#include <QVector>
 
 // Marble
 #include "MarbleGlobal.h"
@@ -304,6 +305,20 @@ class MARBLE_EXPORT GeoPainter : public ClipPainter
                         LabelPositionFlags labelPositionFlags = LineCenter );
 
 
+/*!
+    \brief Draws the screen polygons of a line string.
+
+    Like drawPolyline( GeoDataLineString ), but for a line string which has
+    been projected by screenPolygons() before. This allows to project line
+    strings ahead of painting, e.g. on other threads.
+
+    \see screenPolygons()
+*/
+    void drawPolyline ( const QVector<QPolygonF*> & polygons,
+                        const QString& labelText = QString(),
+                        LabelPositionFlags labelPositionFlags = LineCenter );
+
+
 /*!
     \brief Creates a region for a given line string (a "polyline").
 
@@ -336,6 +351,18 @@ class MARBLE_EXPORT GeoPainter : public ClipPainter
                        Qt::FillRule fillRule = Qt::OddEvenFill );
 
 
+/*!
+    \brief Draws the screen polygons of a linear ring.
+
+    Like drawPolygon( GeoDataLinearRing ), but for a linear ring which has
+    been projected by screenPolygons() before.
+
+    \see screenPolygons()
+*/
+    void drawPolygon ( const QVector<QPolygonF*> & polygons,
+                       Qt::FillRule fillRule = Qt::OddEvenFill );
+
+
 /*!
     \brief Creates a region for a given linear ring (a "polygon without holes").
 
@@ -373,6 +400,51 @@ class MARBLE_EXPORT GeoPainter : public ClipPainter
     void drawPolygon ( const GeoDataPolygon & polygon,
                        Qt::FillRule fillRule = Qt::OddEvenFill );
 
+
+/*!
+    \brief Draws the screen polygons of a polygon.
+
+    Like drawPolygon( GeoDataPolygon ), but for a polygon which has been
+    projected by screenPolygons() before. The \a outline is painted with
+    the current pen instead of the outline of the \a polygons, unless it is
+    empty.
+
+    \see screenPolygons()
+*/
+    void drawPolygon ( const QVector<QPolygonF*> & polygons,
+                       const QVector<QPolygonF> & outline,
+                       Qt::FillRule fillRule = Qt::OddEvenFill );
+
+
+/*!
+    \brief Projects a line string or linear ring into screen polygons.
+
+    The screen polygons of the \a lineString in the \a viewport are
+    appended to \a polygons, which the caller has to delete. Returns false
+    if the \a lineString is outside the \a viewport or too small to be
+    resolved.
+
+    Projecting doesn't need a painter, so different geometries can be
+    projected concurrently.
+*/
+    static bool screenPolygons ( const ViewportParams *viewport,
+                                 const GeoDataLineString & lineString,
+                                 QVector<QPolygonF*> & polygons );
+
+
+/*!
+    \brief Projects a polygon into screen polygons.
+
+    Like screenPolygons( GeoDataLineString ), with the inner boundaries of
+    the \a polygon cut out of the \a polygons. If there are inner
+    boundaries, the screen polygons of all boundaries are appended to
+    \a outline.
+*/
+    static bool screenPolygons ( const ViewportParams *viewport,
+                                 const GeoDataPolygon & polygon,
+                                 QVector<QPolygonF*> & polygons,
+                                 QVector<QPolygonF> & outline );
+
     
 /*!
     \brief Draws a rectangle at the given position.
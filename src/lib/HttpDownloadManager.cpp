@@ -129,6 +129,27 @@ void HttpDownloadManager::addDownloadPolicy( const DownloadPolicy& policy )
                            ( queueSet->downloadPolicy().key(), queueSet ));
 }
 
+StoragePolicy *HttpDownloadManager::storagePolicy() const
+{
+    return d->m_storagePolicy;
+}
+
+void HttpDownloadManager::updateJobPriorities( const DownloadPrioritizer &prioritizer,
+                                               const DownloadUsage usage )
+{
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator pos = d->m_queueSets.begin();
+    QList<QPair<DownloadPolicyKey, DownloadQueueSet *> >::iterator const end = d->m_queueSets.end();
+    for (; pos != end; ++pos ) {
+        if ( (*pos).first.usage() == usage ) {
+            (*pos).second->updatePriorities( prioritizer );
+        }
+    }
+
+    if ( d->m_defaultQueueSets.contains( usage ) ) {
+        d->m_defaultQueueSets[ usage ]->updatePriorities( prioritizer );
+    }
+}
+
 void HttpDownloadManager::addJob( const QUrl& sourceUrl, const QString& destFileName,
                                   const QString &id, const DownloadUsage usage )
 {
@@ -31,6 +31,25 @@ class DownloadPolicy;
 class DownloadQueueSet;
 class StoragePolicy;
 
+/**
+ * @short Decides in which order queued downloads are started.
+ *
+ * @see HttpDownloadManager::updateJobPriorities()
+ */
+class MARBLE_EXPORT DownloadPrioritizer
+{
+ public:
+    virtual ~DownloadPrioritizer() {}
+
+    /**
+     * Updates @p priority of the queued download with @p initiatorId.
+     * Downloads with lower values are started first.
+     *
+     * @return false if the download is not needed anymore and shall be cancelled
+     */
+    virtual bool priority( const QString &initiatorId, int &priority ) const = 0;
+};
+
 /**
  * @Short This class manages scheduled downloads. 
 
@@ -66,6 +85,17 @@ class MARBLE_EXPORT HttpDownloadManager : public QObject
     void setDownloadEnabled( const bool enable );
     void addDownloadPolicy( const DownloadPolicy& );
 
+    /**
+     * Returns the storage policy downloaded files are written to.
+     */
+    StoragePolicy *storagePolicy() const;
+
+    /**
+     * Reorders the queued jobs of @p usage according to @p prioritizer and
+     * cancels those it rejects. Jobs which are running already are kept.
+     */
+    void updateJobPriorities( const DownloadPrioritizer &prioritizer, const DownloadUsage usage );
+
  public Q_SLOTS:
 
     /**
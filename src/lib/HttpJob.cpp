@@ -32,6 +32,7 @@ class Marble::HttpJobPrivate
     QString        m_initiatorId;
     int            m_trialsLeft;
     DownloadUsage  m_downloadUsage;
+    int            m_priority;
     QString m_pluginId;
     QNetworkAccessManager *const m_networkAccessManager;
     QNetworkReply *m_networkReply;
@@ -44,6 +45,7 @@ HttpJobPrivate::HttpJobPrivate( const QUrl & sourceUrl, const QString & destFile
       m_initiatorId( id ),
       m_trialsLeft( 3 ),
       m_downloadUsage( DownloadBrowse ),
+      m_priority( 0 ),
       // FIXME: remove initialization depending on if empty pluginId
       // results in valid user agent string
       m_pluginId( "unknown" ),
@@ -114,6 +116,16 @@ void HttpJob::setDownloadUsage( const DownloadUsage usage )
     d->m_downloadUsage = usage;
 }
 
+int HttpJob::priority() const
+{
+    return d->m_priority;
+}
+
+void HttpJob::setPriority( int priority )
+{
+    d->m_priority = priority;
+}
+
 void HttpJob::setUserAgentPluginId( const QString & pluginId ) const
 {
     d->m_pluginId = pluginId;
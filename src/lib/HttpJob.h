@@ -52,6 +52,12 @@ class MARBLE_EXPORT HttpJob: public QObject
     DownloadUsage downloadUsage() const;
     void setDownloadUsage( const DownloadUsage );
 
+    /**
+     * Queued jobs with lower values are started first. Defaults to 0.
+     */
+    int priority() const;
+    void setPriority( int priority );
+
     void setUserAgentPluginId( const QString & pluginId ) const;
 
     QByteArray userAgent() const;
@@ -0,0 +1,77 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "LabelGrid.h"
+
+#include <qmath.h>
+
+namespace Marble
+{
+
+LabelGrid::LabelGrid()
+    : m_cellSize( 1 ),
+      m_columns( 1 ),
+      m_rows( 1 ),
+      m_cells( 1 )
+{
+}
+
+void LabelGrid::reset( const QSize &size, int cellSize )
+{
+    m_cellSize = qMax( 1, cellSize );
+    m_columns = qMax( 1, ( size.width() + m_cellSize - 1 ) / m_cellSize );
+    m_rows = qMax( 1, ( size.height() + m_cellSize - 1 ) / m_cellSize );
+
+    // the cells keep their memory from one layout to the next
+    m_cells.resize( m_columns * m_rows );
+    for ( int i = 0; i < m_cells.size(); ++i ) {
+        m_cells[i].reserve( m_cells[i].capacity() );
+        m_cells[i].resize( 0 );
+    }
+}
+
+bool LabelGrid::intersects( const QRectF &rect ) const
+{
+    int left, top, right, bottom;
+    cells( rect, left, top, right, bottom );
+
+    for ( int row = top; row <= bottom; ++row ) {
+        for ( int column = left; column <= right; ++column ) {
+            const QVector<QRectF> &cell = m_cells[row * m_columns + column];
+            for ( int i = 0; i < cell.size(); ++i ) {
+                if ( rect.intersects( cell[i] ) ) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void LabelGrid::insert( const QRectF &rect )
+{
+    int left, top, right, bottom;
+    cells( rect, left, top, right, bottom );
+
+    for ( int row = top; row <= bottom; ++row ) {
+        for ( int column = left; column <= right; ++column ) {
+            m_cells[row * m_columns + column].append( rect );
+        }
+    }
+}
+
+void LabelGrid::cells( const QRectF &rect, int &left, int &top, int &right, int &bottom ) const
+{
+    left = qBound( 0, qFloor( rect.left() / m_cellSize ), m_columns - 1 );
+    right = qBound( 0, qFloor( rect.right() / m_cellSize ), m_columns - 1 );
+    top = qBound( 0, qFloor( rect.top() / m_cellSize ), m_rows - 1 );
+    bottom = qBound( 0, qFloor( rect.bottom() / m_cellSize ), m_rows - 1 );
+}
+
+}
@@ -0,0 +1,55 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_LABELGRID_H
+#define MARBLE_LABELGRID_H
+
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+
+namespace Marble
+{
+
+/**
+ * @short A uniform grid of the rectangles claimed by labels on the screen.
+ *
+ * Each rectangle is kept in all cells it overlaps, so a collision test only
+ * compares against the rectangles in the few cells covered by the new one.
+ * Rectangles reaching beyond the screen are kept in the cells at its edges.
+ */
+class LabelGrid
+{
+ public:
+    LabelGrid();
+
+    /**
+     * Removes all rectangles and covers a screen of @p size by square cells
+     * of @p cellSize pixels.
+     */
+    void reset( const QSize &size, int cellSize );
+
+    /**
+     * Returns whether @p rect intersects any of the rectangles inserted.
+     */
+    bool intersects( const QRectF &rect ) const;
+
+    void insert( const QRectF &rect );
+
+ private:
+    void cells( const QRectF &rect, int &left, int &top, int &right, int &bottom ) const;
+
+    int m_cellSize;
+    int m_columns;
+    int m_rows;
+    QVector< QVector<QRectF> > m_cells;
+};
+
+}
+
+#endif
@@ -646,6 +646,11 @@ quint64 MarbleMap::volatileTileCacheLimit() const
     return d->m_textureLayer.volatileCacheLimit();
 }
 
+bool MarbleMap::asynchronousTileLoading() const
+{
+    return d->m_textureLayer.asynchronousTileLoading();
+}
+
 
 void MarbleMap::rotateBy( const qreal& deltaLon, const qreal& deltaLat )
 {
@@ -1223,6 +1228,11 @@ void MarbleMap::setVolatileTileCacheLimit( quint64 kilobytes )
     d->m_textureLayer.setVolatileCacheLimit( kilobytes );
 }
 
+void MarbleMap::setAsynchronousTileLoading( bool asynchronous )
+{
+    d->m_textureLayer.setAsynchronousTileLoading( asynchronous );
+}
+
 AngleUnit MarbleMap::defaultAngleUnit() const
 {
     if ( GeoDataCoordinates::defaultNotation() == GeoDataCoordinates::Decimal ) {
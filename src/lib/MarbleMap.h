@@ -361,6 +361,11 @@ class MARBLE_EXPORT MarbleMap : public QObject
      */
     quint64 volatileTileCacheLimit() const;
 
+    /**
+     * @brief  Returns whether texture tiles are loaded in the background.
+     */
+    bool asynchronousTileLoading() const;
+
     /**
      * @brief Returns a list of all RenderPlugins in the model, this includes float items
      * @return the list of RenderPlugins
@@ -626,6 +631,12 @@ class MARBLE_EXPORT MarbleMap : public QObject
      */
     void setVolatileTileCacheLimit( quint64 kiloBytes );
 
+    /**
+     * @brief  Set whether texture tiles missing in memory are loaded in the background.
+     * @param  asynchronous if true, rendering doesn't wait for tiles to be loaded
+     */
+    void setAsynchronousTileLoading( bool asynchronous );
+
     void setDefaultAngleUnit( AngleUnit angleUnit );
 
     void setDefaultFont( const QFont& font );
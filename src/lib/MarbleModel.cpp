@@ -51,7 +51,6 @@
 
 #include "DgmlAuxillaryDictionary.h"
 #include "MarbleClock.h"
-#include "FileStoragePolicy.h"
 #include "FileStorageWatcher.h"
 #include "PositionTracking.h"
 #include "HttpDownloadManager.h"
@@ -59,8 +58,10 @@
 #include "FileManager.h"
 #include "GeoDataTreeModel.h"
 #include "Planet.h"
+#include "PlacemarkSearchIndex.h"
 #include "PluginManager.h"
 #include "StoragePolicy.h"
+#include "TilePackStoragePolicy.h"
 #include "SunLocator.h"
 #include "TileCreator.h"
 #include "TileCreatorDialog.h"
@@ -105,6 +106,7 @@ class MarbleModelPrivate
         m_placemarkProxyModel.setFilterFixedString( GeoDataTypes::GeoDataPlacemarkType );
         m_placemarkProxyModel.setFilterKeyColumn( 1 );
         m_placemarkProxyModel.setSourceModel( &m_descendantProxy );
+        m_placemarkSearchIndex.setModel( &m_placemarkProxyModel );
 
         m_groundOverlayProxyModel.setFilterFixedString( GeoDataTypes::GeoDataGroundOverlayType );
         m_groundOverlayProxyModel.setFilterKeyColumn( 1 );
@@ -129,7 +131,7 @@ class MarbleModelPrivate
     // View and paint stuff
     GeoSceneDocument        *m_mapTheme;
 
-    FileStoragePolicy        m_storagePolicy;
+    TilePackStoragePolicy    m_storagePolicy;
     HttpDownloadManager      m_downloadManager;
 
     // Cache related
@@ -142,6 +144,7 @@ class MarbleModelPrivate
     KDescendantsProxyModel   m_descendantProxy;
     QSortFilterProxyModel    m_placemarkProxyModel;
     QSortFilterProxyModel    m_groundOverlayProxyModel;
+    PlacemarkSearchIndex     m_placemarkSearchIndex;
 
     // Selection handling
     QItemSelectionModel      m_placemarkSelectionModel;
@@ -444,6 +447,11 @@ QItemSelectionModel *MarbleModel::placemarkSelectionModel()
     return &d->m_placemarkSelectionModel;
 }
 
+const PlacemarkSearchIndex *MarbleModel::placemarkSearchIndex() const
+{
+    return &d->m_placemarkSearchIndex;
+}
+
 PositionTracking *MarbleModel::positionTracking() const
 {
     return &d->m_positionTracking;
@@ -494,6 +502,11 @@ quint64 MarbleModel::persistentTileCacheLimit() const
     return d->m_storageWatcher.cacheLimit() / 1024;
 }
 
+bool MarbleModel::packedTileCacheEnabled() const
+{
+    return d->m_storagePolicy.isPackingEnabled();
+}
+
 void MarbleModel::clearPersistentTileCache()
 {
     d->m_storagePolicy.clearCache();
@@ -542,6 +555,7 @@ void MarbleModel::clearPersistentTileCache()
 void MarbleModel::setPersistentTileCacheLimit(quint64 kiloBytes)
 {
     d->m_storageWatcher.setCacheLimit( kiloBytes * 1024 );
+    d->m_storagePolicy.setCacheLimit( kiloBytes * 1024 );
 
     if( kiloBytes != 0 )
     {
@@ -555,6 +569,11 @@ void MarbleModel::setPersistentTileCacheLimit(quint64 kiloBytes)
     // TODO: trigger update
 }
 
+void MarbleModel::setPackedTileCacheEnabled( bool enabled )
+{
+    d->m_storagePolicy.setPackingEnabled( enabled );
+}
+
 void MarbleModel::setTrackedPlacemark( const GeoDataPlacemark *placemark )
 {
     d->m_trackedPlacemark = placemark;
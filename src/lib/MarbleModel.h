@@ -65,6 +65,7 @@ class RoutingManager;
 class BookmarkManager;
 class FileManager;
 class ElevationModel;
+class PlacemarkSearchIndex;
 class CloudSyncManager;
 
 /**
@@ -126,6 +127,12 @@ class MARBLE_EXPORT MarbleModel : public QObject
 
     QItemSelectionModel *placemarkSelectionModel();
 
+    /**
+     * Returns the index of the names of the placemarks in placemarkModel(),
+     * which is shared by the local search runners.
+     */
+    const PlacemarkSearchIndex *placemarkSearchIndex() const;
+
     /**
      * @brief Return the name of the current map theme.
      * @return the identifier of the current MapTheme.
@@ -227,6 +234,12 @@ class MARBLE_EXPORT MarbleModel : public QObject
      */
     quint64 persistentTileCacheLimit() const;
 
+    /**
+     * @brief  Returns whether downloaded tiles are stored in a single pack file
+     *         instead of one file per tile.
+     */
+    bool packedTileCacheEnabled() const;
+
     /**
      * @brief  Returns the limit of the volatile (in RAM) tile cache.
      * @return the cache limit in kilobytes
@@ -293,6 +306,12 @@ class MARBLE_EXPORT MarbleModel : public QObject
      */
     void setPersistentTileCacheLimit( quint64 kiloBytes );
 
+    /**
+     * @brief  Set whether downloaded tiles are stored in a single pack file
+     *         instead of one file per tile. Disabled by default.
+     */
+    void setPackedTileCacheEnabled( bool enabled );
+
     /**
      * @brief Change the placemark tracked by this model
      * @see trackedPlacemark(), trackedPlacemarkChanged()
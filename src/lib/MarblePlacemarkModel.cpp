@@ -145,7 +145,6 @@ QModelIndexList MarblePlacemarkModel::approxMatch( const QModelIndex & start, in
     QModelIndex entryIndex;
     QString     listName;
     QString     queryString = value.toString().toLower();
-    QString     simplifiedListName;
 
     int         row = start.row();
     const int   rowNum = rowCount();
@@ -154,10 +153,10 @@ QModelIndexList MarblePlacemarkModel::approxMatch( const QModelIndex & start, in
         if ( flags & Qt::MatchStartsWith ) {
             entryIndex = index( row, 0 );
             listName    = data( entryIndex, role ).toString().toLower();
-            simplifiedListName = GeoString::deaccent( listName );
 
+            // deaccenting is expensive, only do it if needed
             if ( listName.startsWith( queryString ) 
-                 || simplifiedListName.startsWith( queryString )
+                 || GeoString::deaccent( listName ).startsWith( queryString )
                  )
             {
                 results << entryIndex;
@@ -22,7 +22,7 @@ namespace GeoString
 {
     static const QRegExp combiningDiacriticalMarks("[\\x0300-\\x036F]+");
 
-    QString deaccent( const QString& accentString )
+    inline QString deaccent( const QString& accentString )
     {
         QString    result;
 
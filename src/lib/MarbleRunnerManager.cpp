@@ -385,19 +385,13 @@ QVector<GeoDataDocument*> MarbleRunnerManager::searchRoute( const RouteRequest *
 
 void MarbleRunnerManager::parseFile( const QString &fileName, DocumentRole role )
 {
-    QList<const ParseRunnerPlugin*> plugins = d->m_pluginManager->parsingRunnerPlugins();
-    QFileInfo const fileInfo( fileName );
-    const QString suffix = fileInfo.suffix().toLower();
-    const QString completeSuffix = fileInfo.completeSuffix().toLower();
+    QList<const ParseRunnerPlugin*> plugins = d->m_pluginManager->parsingRunnerPlugins( fileName );
 
     foreach( const ParseRunnerPlugin *plugin, plugins ) {
-        QStringList const extensions = plugin->fileExtensions();
-        if ( extensions.isEmpty() || extensions.contains( suffix ) || extensions.contains( completeSuffix ) ) {
-            ParsingTask *task = new ParsingTask( plugin->newRunner(), this, fileName, role );
-            connect( task, SIGNAL(finished(ParsingTask*)), this, SLOT(cleanupParsingTask(ParsingTask*)) );
-            mDebug() << "parse task " << plugin->nameId() << " " << (long)task;
-            d->m_parsingTasks << task;
-        }
+        ParsingTask *task = new ParsingTask( plugin->newRunner(), this, fileName, role );
+        connect( task, SIGNAL(finished(ParsingTask*)), this, SLOT(cleanupParsingTask(ParsingTask*)) );
+        mDebug() << "parse task " << plugin->nameId() << " " << (long)task;
+        d->m_parsingTasks << task;
     }
 
     foreach ( ParsingTask *task, d->m_parsingTasks ) {
@@ -49,6 +49,7 @@
 #include "SunLocator.h"
 #include "TileCreatorDialog.h"
 #include "ViewportParams.h"
+#include "layers/TextureLayer.h"
 #include "routing/RoutingLayer.h"
 
 namespace Marble
@@ -1323,6 +1324,10 @@ void MarbleWidget::flyTo( const GeoDataLookAt &newLookAt, FlyToMode mode )
         }
     }
     else {
+        // the tiles at the destination can be loaded while the animation is running
+        const int radius = qRound( radiusFromDistance( newLookAt.range() * METER2KM ) );
+        textureLayer()->prefetchDestination( newLookAt.longitude(), newLookAt.latitude(), radius );
+
         d->m_physics.flyTo( newLookAt, mode );
     }
 }
@@ -21,6 +21,7 @@
 #include "blendings/Blending.h"
 #include "blendings/BlendingFactory.h"
 #include "SunLocator.h"
+#include "SunShading.h"
 #include "MarbleGlobal.h"
 #include "MarbleMath.h"
 #include "MarbleDebug.h"
@@ -45,6 +46,9 @@
 #include <QMutexLocker>
 #include <QPointer>
 #include <QPainter>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QWriteLocker>
 
 using namespace Marble;
 
@@ -53,12 +57,9 @@ class MergedLayerDecorator::Private
 public:
     Private( TileLoader *tileLoader, const SunLocator *sunLocator );
 
-    static int maxDivisor( int maximum, int fullLength );
-
     StackedTile *createTile( const QVector<QSharedPointer<TextureTile> > &tiles ) const;
 
     void renderGroundOverlays( QImage *tileImage, const QVector<QSharedPointer<TextureTile> > &tiles ) const;
-    void paintSunShading( QImage *tileImage, const TileId &id ) const;
     void paintTileId( QImage *tileImage, const TileId &id ) const;
 
     void detectMaxTileLevel();
@@ -66,6 +67,7 @@ public:
 
     TileLoader *const m_tileLoader;
     const SunLocator *const m_sunLocator;
+    const SunShading m_sunShading;
     BlendingFactory m_blendingFactory;
     QVector<const GeoSceneTextureTile *> m_textureLayers;
     QList<const GeoDataGroundOverlay *> m_groundOverlays;
@@ -76,11 +78,14 @@ public:
     bool m_showSunShading;
     bool m_showCityLights;
     bool m_showTileId;
+    // tiles may be loaded on worker threads while the settings above change
+    mutable QReadWriteLock m_lock;
 };
 
 MergedLayerDecorator::Private::Private( TileLoader *tileLoader, const SunLocator *sunLocator ) :
     m_tileLoader( tileLoader ),
     m_sunLocator( sunLocator ),
+    m_sunShading( sunLocator ),
     m_blendingFactory( sunLocator ),
     m_textureLayers(),
     m_maxTileLevel( 0 ),
@@ -106,6 +111,8 @@ MergedLayerDecorator::~MergedLayerDecorator()
 
 void MergedLayerDecorator::setTextureLayers( const QVector<const GeoSceneTextureTile *> &textureLayers )
 {
+    QWriteLocker locker( &d->m_lock );
+
     mDebug() << Q_FUNC_INFO;
 
     if ( textureLayers.count() > 0 ) {
@@ -123,6 +130,8 @@ void MergedLayerDecorator::setTextureLayers( const QVector<const GeoSceneTexture
 
 void MergedLayerDecorator::updateGroundOverlays(const QList<const GeoDataGroundOverlay *> &groundOverlays )
 {
+    QWriteLocker locker( &d->m_lock );
+
     d->m_groundOverlays = groundOverlays;
 }
 
@@ -211,7 +220,7 @@ StackedTile *MergedLayerDecorator::Private::createTile( const QVector<QSharedPoi
     renderGroundOverlays( &resultImage, tiles );
 
     if ( m_showSunShading && !m_showCityLights ) {
-        paintSunShading( &resultImage, id );
+        m_sunShading.shade( &resultImage, id, m_levelZeroColumns, m_levelZeroRows );
     }
 
     if ( m_showTileId ) {
@@ -294,8 +303,10 @@ void MergedLayerDecorator::Private::renderGroundOverlays( QImage *tileImage, con
     }
 }
 
-StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId )
+StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId, DownloadUsage usage )
 {
+    QReadLocker locker( &d->m_lock );
+
     const QVector<const GeoSceneTextureTile *> textureLayers = d->findRelevantTextureLayers( stackedTileId );
     QVector<QSharedPointer<TextureTile> > tiles;
 
@@ -312,7 +323,7 @@ StackedTile *MergedLayerDecorator::loadTile( const TileId &stackedTileId )
         }
 
         const GeoSceneTextureTile *const textureLayer = static_cast<const GeoSceneTextureTile *>( layer );
-        const QImage tileImage = d->m_tileLoader->loadTileImage( textureLayer, tileId, DownloadBrowse );
+        const QImage tileImage = d->m_tileLoader->loadTileImage( textureLayer, tileId, usage );
 
         QSharedPointer<TextureTile> tile( new TextureTile( tileId, tileImage, blending ) );
         tiles.append( tile );
@@ -329,6 +340,8 @@ StackedTile *MergedLayerDecorator::updateTile( const StackedTile &stackedTile, c
 
     d->detectMaxTileLevel();
 
+    QReadLocker locker( &d->m_lock );
+
     QVector<QSharedPointer<TextureTile> > tiles = stackedTile.tiles();
 
     for ( int i = 0; i < tiles.count(); ++ i) {
@@ -347,7 +360,7 @@ void MergedLayerDecorator::downloadStackedTile( const TileId &id, DownloadUsage
     const QVector<const GeoSceneTextureTile *> textureLayers = d->findRelevantTextureLayers( id );
 
     foreach ( const GeoSceneTextureTile *textureLayer, textureLayers ) {
-        if ( TileLoader::tileStatus( textureLayer, id ) != TileLoader::Available || usage == DownloadBrowse ) {
+        if ( d->m_tileLoader->tileStatus( textureLayer, id ) != TileLoader::Available || usage == DownloadBrowse ) {
             d->m_tileLoader->downloadTile( textureLayer, id, usage );
         }
     }
@@ -355,6 +368,8 @@ void MergedLayerDecorator::downloadStackedTile( const TileId &id, DownloadUsage
 
 void MergedLayerDecorator::setShowSunShading( bool show )
 {
+    QWriteLocker locker( &d->m_lock );
+
     d->m_showSunShading = show;
 }
 
@@ -365,6 +380,8 @@ bool MergedLayerDecorator::showSunShading() const
 
 void MergedLayerDecorator::setShowCityLights( bool show )
 {
+    QWriteLocker locker( &d->m_lock );
+
     d->m_showCityLights = show;
 }
 
@@ -375,88 +392,9 @@ bool MergedLayerDecorator::showCityLights() const
 
 void MergedLayerDecorator::setShowTileId( bool visible )
 {
-    d->m_showTileId = visible;
-}
-
-void MergedLayerDecorator::Private::paintSunShading( QImage *tileImage, const TileId &id ) const
-{
-    if ( tileImage->depth() != 32 )
-        return;
+    QWriteLocker locker( &d->m_lock );
 
-    // TODO add support for 8-bit maps?
-    // add sun shading
-    const qreal  global_width  = tileImage->width()
-            * TileLoaderHelper::levelToColumn( m_levelZeroColumns, id.zoomLevel() );
-    const qreal  global_height = tileImage->height()
-            * TileLoaderHelper::levelToRow( m_levelZeroRows, id.zoomLevel() );
-    const qreal lon_scale = 2*M_PI / global_width;
-    const qreal lat_scale = -M_PI / global_height;
-    const int tileHeight = tileImage->height();
-    const int tileWidth = tileImage->width();
-
-    // First we determine the supporting point interval for the interpolation.
-    const int n = maxDivisor( 30, tileWidth );
-    const int ipRight = n * (int)( tileWidth / n );
-
-    for ( int cur_y = 0; cur_y < tileHeight; ++cur_y ) {
-        const qreal lat = lat_scale * ( id.y() * tileHeight + cur_y ) - 0.5*M_PI;
-        const qreal a = sin( (lat+DEG2RAD * m_sunLocator->getLat() )/2.0 );
-        const qreal c = cos(lat)*cos( -DEG2RAD * m_sunLocator->getLat() );
-
-        QRgb* scanline = (QRgb*)tileImage->scanLine( cur_y );
-
-        qreal lastShade = -10.0;
-
-        int cur_x = 0;
-
-        while ( cur_x < tileWidth ) {
-
-            const bool interpolate = ( cur_x != 0 && cur_x < ipRight && cur_x + n < tileWidth );
-
-            qreal shade = 0;
-
-            if ( interpolate ) {
-                const int check = cur_x + n;
-                const qreal checklon   = lon_scale * ( id.x() * tileWidth + check );
-                shade = m_sunLocator->shading( checklon, a, c );
-
-                // if the shading didn't change across the interpolation
-                // interval move on and don't change anything.
-                if ( shade == lastShade && shade == 1.0 ) {
-                    scanline += n;
-                    cur_x += n;
-                    continue;
-                }
-                if ( shade == lastShade && shade == 0.0 ) {
-                    for ( int t = 0; t < n; ++t ) {
-                        m_sunLocator->shadePixel( *scanline, shade );
-                        ++scanline;
-                    }
-                    cur_x += n;
-                    continue;
-                }
-                for ( int t = 0; t < n ; ++t ) {
-                    const qreal lon   = lon_scale * ( id.x() * tileWidth + cur_x );
-                    shade = m_sunLocator->shading( lon, a, c );
-                    m_sunLocator->shadePixel( *scanline, shade );
-                    ++scanline;
-                    ++cur_x;
-                }
-            }
-
-            else {
-                // Make sure we don't exceed the image memory
-                if ( cur_x < tileWidth ) {
-                    const qreal lon   = lon_scale * ( id.x() * tileWidth + cur_x );
-                    shade = m_sunLocator->shading( lon, a, c );
-                    m_sunLocator->shadePixel( *scanline, shade );
-                    ++scanline;
-                    ++cur_x;
-                }
-            }
-            lastShade = shade;
-        }
-    }
+    d->m_showTileId = visible;
 }
 
 void MergedLayerDecorator::Private::paintTileId( QImage *tileImage, const TileId &id ) const
@@ -546,25 +484,3 @@ QVector<const GeoSceneTextureTile *> MergedLayerDecorator::Private::findRelevant
 
     return result;
 }
-
-// TODO: This should likely go into a math class in the future ...
-
-int MergedLayerDecorator::Private::maxDivisor( int maximum, int fullLength )
-{
-    // Find the optimal interpolation interval n for the
-    // current image canvas width
-    int best = 2;
-
-    int  nEvalMin = fullLength;
-    for ( int it = 1; it <= maximum; ++it ) {
-        // The optimum is the interval which results in the least amount
-        // supporting points taking into account the rest which can't
-        // get used for interpolation.
-        int nEval = fullLength / it + fullLength % it;
-        if ( nEval < nEvalMin ) {
-            nEvalMin = nEval;
-            best = it;
-        }
-    }
-    return best;
-}
@@ -62,7 +62,7 @@ class MergedLayerDecorator
 
     QSize tileSize() const;
 
-    StackedTile *loadTile( const TileId &id );
+    StackedTile *loadTile( const TileId &id, DownloadUsage usage = DownloadBrowse );
 
     StackedTile *updateTile( const StackedTile &stackedTile, const TileId &tileId, const QImage &tileImage );
 
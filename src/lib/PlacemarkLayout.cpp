@@ -41,6 +41,46 @@
 namespace Marble
 {
 
+// labels collide with the labels in the same cells of about two lines of text
+static const int labelGridCellSize = 32;
+
+class PlacemarkLayout::LabelMetrics
+{
+ public:
+    explicit LabelMetrics( const GeoDataStyle *style );
+
+    int width( const QString &labelText ) const
+    {
+        return m_fontMetrics.width( labelText ) + m_outlineWidth;
+    }
+
+    int height() const { return m_height; }
+
+ private:
+    static QFont paintedFont( const GeoDataStyle *style );
+
+    const QFontMetrics m_fontMetrics;
+    const int m_height;
+    const int m_outlineWidth;
+};
+
+PlacemarkLayout::LabelMetrics::LabelMetrics( const GeoDataStyle *style )
+    : m_fontMetrics( paintedFont( style ) ),
+      m_height( QFontMetrics( style->labelStyle().font() ).height() ),
+      m_outlineWidth( style->labelStyle().glow() ? qRound( 2 * s_labelOutlineWidth ) : 0 )
+{
+}
+
+QFont PlacemarkLayout::LabelMetrics::paintedFont( const GeoDataStyle *style )
+{
+    QFont labelFont = style->labelStyle().font();
+    if ( style->labelStyle().glow() ) {
+        labelFont.setWeight( 75 ); // Needed to calculate the correct pixmap size;
+    }
+
+    return labelFont;
+}
+
 QVector<GeoDataFeature::GeoDataVisualCategory> sortedVisualCategories()
 {
     QVector<GeoDataFeature::GeoDataVisualCategory> visualCategories;
@@ -148,8 +188,12 @@ PlacemarkLayout::PlacemarkLayout( QAbstractItemModel  *placemarkModel,
       m_showLandingSites( false ),
       m_showCraters( false ),
       m_showMaria( false ),
-      m_maxLabelHeight( 0 ),
-      m_styleResetRequested( true )
+      m_styleResetRequested( true ),
+      m_layoutValid( false ),
+      m_layoutProjection( Spherical ),
+      m_layoutRadius( 0 ),
+      m_layoutCenterLongitude( 0.0 ),
+      m_layoutCenterLatitude( 0.0 )
 {
     m_placemarkModel.setSourceModel( placemarkModel );
     m_placemarkModel.setDynamicSortFilter( true );
@@ -172,48 +216,57 @@ PlacemarkLayout::PlacemarkLayout( QAbstractItemModel  *placemarkModel,
 
 PlacemarkLayout::~PlacemarkLayout()
 {
-    styleReset();
+    qDeleteAll( m_visiblePlacemarks );
+    qDeleteAll( m_labelMetrics );
 }
 
 void PlacemarkLayout::setShowPlaces( bool show )
 {
     m_showPlaces = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowCities( bool show )
 {
     m_showCities = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowTerrain( bool show )
 {
     m_showTerrain = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowOtherPlaces( bool show )
 {
     m_showOtherPlaces = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowLandingSites( bool show )
 {
     m_showLandingSites = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowCraters( bool show )
 {
     m_showCraters = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::setShowMaria( bool show )
 {
     m_showMaria = show;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::requestStyleReset()
 {
     mDebug() << "Style reset requested.";
     m_styleResetRequested = true;
+    m_layoutValid = false;
 }
 
 void PlacemarkLayout::styleReset()
@@ -222,8 +275,34 @@ void PlacemarkLayout::styleReset()
     m_labelArea = 0;
     qDeleteAll( m_visiblePlacemarks );
     m_visiblePlacemarks.clear();
-    m_maxLabelHeight = maxLabelHeight();
+    qDeleteAll( m_labelMetrics );
+    m_labelMetrics.clear();
+
+    m_selectedPlacemarks.clear();
+    m_selectedPlacemarkSet.clear();
+    const QModelIndexList selectedIndexes = m_selectionModel->selection().indexes();
+    foreach ( const QModelIndex &index, selectedIndexes ) {
+        const GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
+        Q_ASSERT( placemark );
+        if ( !m_selectedPlacemarkSet.contains( placemark ) ) {
+            m_selectedPlacemarks.append( placemark );
+            m_selectedPlacemarkSet.insert( placemark );
+        }
+    }
+
     m_styleResetRequested = false;
+    m_layoutValid = false;
+}
+
+bool PlacemarkLayout::isLayoutValid( const ViewportParams *viewport ) const
+{
+    return m_layoutValid
+        && m_layoutProjection == viewport->projection()
+        && m_layoutRadius == viewport->radius()
+        && m_layoutCenterLongitude == viewport->centerLongitude()
+        && m_layoutCenterLatitude == viewport->centerLatitude()
+        && m_layoutSize == viewport->size()
+        && m_layoutDateTime == m_clock->dateTime();
 }
 
 QVector<const GeoDataPlacemark*> PlacemarkLayout::whichPlacemarkAt( const QPoint& curpos )
@@ -244,26 +323,6 @@ QVector<const GeoDataPlacemark*> PlacemarkLayout::whichPlacemarkAt( const QPoint
     return ret;
 }
 
-int PlacemarkLayout::maxLabelHeight() const
-{
-    int maxLabelHeight = 0;
-
-    for ( int i = 0; i < m_placemarkModel.rowCount(); ++i ) {
-        QModelIndex index = m_placemarkModel.index( i, 0 );
-        const GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
-        if ( placemark ) {
-            const GeoDataStyle* style = placemark->style();
-            QFont labelFont = style->labelStyle().font();
-            int textHeight = QFontMetrics( labelFont ).height();
-            if ( textHeight > maxLabelHeight )
-                maxLabelHeight = textHeight;
-        }
-    }
-
-    //mDebug() <<"Detected maxLabelHeight: " << maxLabelHeight;
-    return maxLabelHeight;
-}
-
 /// feed an internal QMap of placemarks with TileId as key when model changes
 void PlacemarkLayout::addPlacemarks( QModelIndex parent, int first, int last )
 {
@@ -303,6 +362,7 @@ void PlacemarkLayout::removePlacemarks( QModelIndex parent, int first, int last
         TileId key = TileId::fromCoordinates( coordinates, zoomLevel );
         m_placemarkCache[key].removeAll( placemark );
     }
+    m_layoutValid = false;
     emit repaintNeeded();
 }
 
@@ -378,13 +438,15 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
         styleReset();
     }
 
-    if ( m_maxLabelHeight == 0 ) {
-        return QVector<VisiblePlacemark *>();
+    /**
+     * Nothing changed since the last layout, e.g. when a tile finished loading.
+     */
+    if ( isLayoutValid( viewport ) ) {
+        m_runtimeTrace = QString("Placemarks: reused Drawn: %1").arg( m_paintOrder.size() );
+        return m_paintOrder;
     }
 
-    const int secnumber = viewport->height() / m_maxLabelHeight + 1;
-    m_rowsection.clear();
-    m_rowsection.resize(secnumber);
+    m_labelGrid.reset( viewport->size(), labelGridCellSize );
 
     m_paintOrder.clear();
     m_labelArea = 0;
@@ -393,12 +455,7 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
      * First handle the selected placemarks, as they have the highest priority.
      */
 
-    const QModelIndexList selectedIndexes = m_selectionModel->selection().indexes();
-
-    for ( int i = 0; i < selectedIndexes.count(); ++i ) {
-        const QModelIndex index = selectedIndexes.at( i );
-        const GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
-        Q_ASSERT(placemark);
+    foreach ( const GeoDataPlacemark *placemark, m_selectedPlacemarks ) {
         const GeoDataCoordinates coordinates = placemarkIconCoordinates( placemark );
 
         if ( !coordinates.isValid() ) {
@@ -427,8 +484,6 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
     /**
      * Now handle all other placemarks...
      */
-    const QItemSelection selection = m_selectionModel->selection();
-
     QList<TileId> tileIdList = visibleTiles( viewport ).toList();
     qSort( tileIdList );
     QList<const GeoDataPlacemark*> placemarkList;
@@ -506,18 +561,10 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
          * Assuming that only a small amount of places is selected
          * we check for the selected state after all other filters
          */
-        bool isSelected = false;
-        foreach ( const QModelIndex &index, selection.indexes() ) {
-            const GeoDataPlacemark *mark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
-            if (mark == placemark ) {
-                isSelected = true;
-                break;
-            }
-        }
-        if ( isSelected )
+        if ( m_selectedPlacemarkSet.contains( placemark ) )
             continue;
 
-        if( layoutPlacemark( placemark, x, y, isSelected ) ) {
+        if( layoutPlacemark( placemark, x, y, false ) ) {
             // Make sure not to draw more placemarks on the screen than
             // specified by placemarksOnScreenLimit().
             if ( placemarksOnScreenLimit( viewport->size() ) )
@@ -525,6 +572,14 @@ QVector<VisiblePlacemark *> PlacemarkLayout::generateLayout( const ViewportParam
         }
     }
 
+    m_layoutValid = true;
+    m_layoutProjection = viewport->projection();
+    m_layoutRadius = viewport->radius();
+    m_layoutCenterLongitude = viewport->centerLongitude();
+    m_layoutCenterLatitude = viewport->centerLatitude();
+    m_layoutSize = viewport->size();
+    m_layoutDateTime = m_clock->dateTime();
+
     m_runtimeTrace = QString("Placemarks: %1 Drawn: %2").arg( placemarkList.count() ).arg( m_paintOrder.size() );
     return m_paintOrder;
 }
@@ -542,16 +597,16 @@ bool PlacemarkLayout::layoutPlacemark( const GeoDataPlacemark *placemark, qreal
     // If there's not enough space free don't add a VisiblePlacemark here.
     const GeoDataStyle* style = placemark->style();
 
+    // Find the corresponding visible placemark
+    VisiblePlacemark *mark = m_visiblePlacemarks.value( placemark );
+
     QRectF labelRect;
     if( !placemark->name().isEmpty() ) {
-        labelRect = roomForLabel( style, x, y, placemark->name() );
+        labelRect = roomForLabel( style, mark, x, y, placemark->name() );
         if ( labelRect.isNull() ) {
             return false;
         }
     }
-
-    // Find the corresponding visible placemark
-    VisiblePlacemark *mark = m_visiblePlacemarks.value( placemark );
     if ( !mark ) {
         // If there is no visible placemark yet for this index,
         // create a new one...
@@ -570,14 +625,7 @@ bool PlacemarkLayout::layoutPlacemark( const GeoDataPlacemark *placemark, qreal
     mark->setLabelRect( labelRect );
 
     if ( !labelRect.isEmpty() ) {
-        // Add the current placemark to the matching row and its
-        // direct neighbors.
-        int idx = y / m_maxLabelHeight;
-        if ( idx - 1 >= 0 )
-            m_rowsection[ idx - 1 ].append( mark );
-        m_rowsection[ idx ].append( mark );
-        if ( idx + 1 < m_rowsection.size() )
-            m_rowsection[ idx + 1 ].append( mark );
+        m_labelGrid.insert( labelRect );
     }
 
     m_paintOrder.append( mark );
@@ -601,29 +649,40 @@ GeoDataCoordinates PlacemarkLayout::placemarkIconCoordinates( const GeoDataPlace
     return GeoDataCoordinates();
 }
 
-QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle * style,
-                                      const qreal x, const qreal y,
-                                      const QString &labelText ) const
+const PlacemarkLayout::LabelMetrics *PlacemarkLayout::labelMetrics( const GeoDataStyle *style )
 {
-    QFont labelFont = style->labelStyle().font();
-    int textHeight = QFontMetrics( labelFont ).height();
-
-    int textWidth;
-    if ( style->labelStyle().glow() ) {
-        labelFont.setWeight( 75 ); // Needed to calculate the correct pixmap size;
-        textWidth = ( QFontMetrics( labelFont ).width( labelText )
-            + qRound( 2 * s_labelOutlineWidth ) );
-    } else {
-        textWidth = ( QFontMetrics( labelFont ).width( labelText ) );
+    QHash<const GeoDataStyle*, LabelMetrics*>::const_iterator it = m_labelMetrics.constFind( style );
+    if ( it == m_labelMetrics.constEnd() ) {
+        it = m_labelMetrics.insert( style, new LabelMetrics( style ) );
     }
 
-    const QVector<VisiblePlacemark*> currentsec = m_rowsection.at( y / m_maxLabelHeight );
+    return it.value();
+}
+
+QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle * style,
+                                      const VisiblePlacemark *previous,
+                                      const qreal x, const qreal y,
+                                      const QString &labelText )
+{
+    const LabelMetrics *metrics = labelMetrics( style );
+    const int textHeight = metrics->height();
+    const int textWidth = metrics->width( labelText );
 
     if ( style->labelStyle().alignment() == GeoDataLabelStyle::Corner ) {
         const int symbolWidth = style->iconStyle().icon().width();
 
+        // Start with the corner the label had in the previous layout
+        int first = 0;
+        if ( previous && !previous->labelRect().isEmpty() ) {
+            const QPointF previousPosition = previous->symbolPosition() + previous->hotSpot();
+            const bool left = previous->labelRect().left() < previousPosition.x();
+            const bool above = previous->labelRect().top() < previousPosition.y() - 0.5;
+            first = ( left ? 2 : 0 ) + ( above ? 1 : 0 );
+        }
+
         // Check the four possible positions by going through all of them
-        for( int i=0; i<4; ++i ) {
+        for( int j=0; j<4; ++j ) {
+            const int i = ( first + j ) % 4;
             const qreal xPos = ( i/2 == 0 ) ? x + symbolWidth / 2 + 1 :
                                               x - symbolWidth / 2 - 1 - textWidth;
             const qreal yPos = ( i%2 == 0 ) ? y :
@@ -631,40 +690,18 @@ QRectF PlacemarkLayout::roomForLabel( const GeoDataStyle * style,
             const QRectF labelRect = QRectF( xPos, yPos, textWidth, textHeight );
 
             // Check if there is another label or symbol that overlaps.
-            bool isRoom = true;
-            QVector<VisiblePlacemark*>::const_iterator beforeItEnd = currentsec.constEnd();
-            for ( QVector<VisiblePlacemark*>::ConstIterator beforeIt = currentsec.constBegin();
-                  beforeIt != beforeItEnd;
-                  ++beforeIt ) {
-                if ( labelRect.intersects( (*beforeIt)->labelRect()) ) {
-                    isRoom = false;
-                    break;
-                }
-            }
-
-            if ( isRoom ) {
+            if ( !m_labelGrid.intersects( labelRect ) ) {
                 // claim the place immediately if it hasn't been used yet
                 return labelRect;
             }
         }
     }
     else if ( style->labelStyle().alignment() == GeoDataLabelStyle::Center ) {
-        bool isRoom = true;
         QRectF  labelRect( x - textWidth / 2, y - textHeight / 2,
                           textWidth, textHeight );
 
         // Check if there is another label or symbol that overlaps.
-        QVector<VisiblePlacemark*>::const_iterator beforeItEnd = currentsec.constEnd();
-        for ( QVector<VisiblePlacemark*>::ConstIterator beforeIt = currentsec.constBegin();
-              beforeIt != beforeItEnd; ++beforeIt )
-        {
-            if ( labelRect.intersects( (*beforeIt)->labelRect() ) ) {
-                isRoom = false;
-                break;
-            }
-        }
-
-        if ( isRoom ) {
+        if ( !m_labelGrid.intersects( labelRect ) ) {
             // claim the place immediately if it hasn't been used yet 
             return labelRect;
         }
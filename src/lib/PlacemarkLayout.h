@@ -18,6 +18,7 @@
 #define MARBLE_PLACEMARKLAYOUT_H
 
 
+#include <QDateTime>
 #include <QHash>
 #include <QModelIndex>
 #include <QRect>
@@ -26,6 +27,8 @@
 #include <QSortFilterProxyModel>
 
 #include "GeoDataFeature.h"
+#include "LabelGrid.h"
+#include "MarbleGlobal.h"
 
 class QAbstractItemModel;
 class QItemSelectionModel;
@@ -102,17 +105,16 @@ class PlacemarkLayout : public QObject
     void repaintNeeded();
 
  private:
-    /**
-     * Returns a the maximum height of all possible labels.
-     * WARNING: This is a really slow method as it traverses all placemarks
-     * to check the labelheight.
-     * FIXME: Once a StyleManager that manages all styles has been implemented
-     * just traverse all existing styles.
-     */
-    int maxLabelHeight() const;
+    class LabelMetrics;
 
     void styleReset();
 
+    /**
+     * Returns whether the layout of the last call of generateLayout() is
+     * still valid for @p viewport.
+     */
+    bool isLayoutValid( const ViewportParams *viewport ) const;
+
     QSet<TileId> visibleTiles( const ViewportParams *viewport ) const;
     bool layoutPlacemark( const GeoDataPlacemark *placemark, qreal x, qreal y, bool selected );
 
@@ -123,9 +125,21 @@ class PlacemarkLayout : public QObject
      */
     GeoDataCoordinates placemarkIconCoordinates( const GeoDataPlacemark *placemark ) const;
 
+    /**
+     * Returns the font metrics of the labels of @p style, which are
+     * created once for each style.
+     */
+    const LabelMetrics *labelMetrics( const GeoDataStyle *style );
+
+    /**
+     * Returns a free rectangle for the label of a placemark at @p x, @p y.
+     * The corner of the symbol used by @p previous is tried first, so labels
+     * don't jump around while the map is moved.
+     */
     QRectF  roomForLabel( const GeoDataStyle * style,
+                         const VisiblePlacemark *previous,
                          const qreal x, const qreal y,
-                         const QString &labelText ) const;
+                         const QString &labelText );
 
     bool    placemarksOnScreenLimit( const QSize &screenSize ) const;
 
@@ -139,10 +153,15 @@ class PlacemarkLayout : public QObject
     QString m_runtimeTrace;
     int m_labelArea;
     QHash<const GeoDataPlacemark*, VisiblePlacemark*> m_visiblePlacemarks;
-    QVector< QVector< VisiblePlacemark* > >  m_rowsection;
+    LabelGrid m_labelGrid;
+    QHash<const GeoDataStyle*, LabelMetrics*> m_labelMetrics;
+
+    /// the selected placemarks in the order of the selection, and for lookups
+    QVector<const GeoDataPlacemark*> m_selectedPlacemarks;
+    QSet<const GeoDataPlacemark*> m_selectedPlacemarkSet;
 
     /// map providing the list of placemark belonging in TileId as key
-    QMap<TileId, QList<const GeoDataPlacemark*> > m_placemarkCache;
+    QHash<TileId, QList<const GeoDataPlacemark*> > m_placemarkCache;
 
     const QVector< GeoDataFeature::GeoDataVisualCategory > m_acceptedVisualCategories;
 
@@ -157,8 +176,16 @@ class PlacemarkLayout : public QObject
     bool m_showCraters;
     bool m_showMaria;
 
-    int     m_maxLabelHeight;
     bool    m_styleResetRequested;
+
+    // the view the current layout was generated for
+    bool       m_layoutValid;
+    Projection m_layoutProjection;
+    int        m_layoutRadius;
+    qreal      m_layoutCenterLongitude;
+    qreal      m_layoutCenterLatitude;
+    QSize      m_layoutSize;
+    QDateTime  m_layoutDateTime;
 };
 
 }
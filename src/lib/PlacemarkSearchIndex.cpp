@@ -0,0 +1,444 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PlacemarkSearchIndex.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+
+#include "GeoDataPlacemark.h"
+#include "MarbleMath.h"
+#include "MarblePlacemarkModel.h"
+#include "MarblePlacemarkModel_P.h"
+
+namespace Marble
+{
+
+// the share of trigrams similar names have in common at least
+static const qreal minimumSimilarity = 0.5;
+
+class PlacemarkSearchIndex::Private
+{
+ public:
+    struct Entry
+    {
+        const GeoDataPlacemark *placemark; // 0 once removed
+        QString key;
+        int trigramCount;
+        qint64 popularity;
+        qreal longitude;
+        qreal latitude;
+    };
+
+    struct Match
+    {
+        int id;
+        qreal similarity;
+        qreal distance;
+    };
+
+    class KeyLessThan
+    {
+     public:
+        explicit KeyLessThan( const QVector<Entry> &entries ) : m_entries( entries ) {}
+
+        bool operator()( int a, int b ) const
+        {
+            return m_entries[a].key < m_entries[b].key;
+        }
+
+     private:
+        const QVector<Entry> &m_entries;
+    };
+
+    class MatchLessThan
+    {
+     public:
+        explicit MatchLessThan( const QVector<Entry> &entries ) : m_entries( entries ) {}
+
+        bool operator()( const Match &a, const Match &b ) const
+        {
+            if ( a.similarity != b.similarity ) {
+                return a.similarity > b.similarity;
+            }
+            if ( m_entries[a.id].popularity != m_entries[b.id].popularity ) {
+                return m_entries[a.id].popularity > m_entries[b.id].popularity;
+            }
+            if ( a.distance != b.distance ) {
+                return a.distance < b.distance;
+            }
+            return m_entries[a.id].key < m_entries[b.id].key;
+        }
+
+     private:
+        const QVector<Entry> &m_entries;
+    };
+
+    Private()
+        : m_model( 0 ),
+          m_removed( 0 ),
+          m_sortedDirty( false )
+    {
+    }
+
+    void add( const GeoDataPlacemark *placemark );
+    void insert( const Entry &entry );
+    void remove( const GeoDataPlacemark *placemark );
+    void clear();
+
+    /**
+     * Drops the removed entries once they make up most of the index.
+     */
+    void compact();
+
+    void addPrefixMatches( const QString &key, const GeoDataLatLonAltBox &preferred,
+                           QVector<Match> &matches ) const;
+    void addSimilarMatches( const QString &key, const GeoDataLatLonAltBox &preferred,
+                            QVector<Match> &matches ) const;
+
+    bool isPreferred( const Entry &entry, const GeoDataLatLonAltBox &preferred ) const;
+    qreal distance( const Entry &entry, const GeoDataLatLonAltBox &preferred ) const;
+
+    static void trigrams( const QString &key, QVector<quint64> &result );
+
+    const QAbstractItemModel *m_model;
+
+    QVector<Entry> m_entries;
+    QHash<const GeoDataPlacemark *, int> m_ids;
+    QHash<quint64, QVector<int> > m_trigrams;
+    int m_removed;
+
+    // the ids of the entries sorted by their keys, sorted again before searching after additions
+    mutable QVector<int> m_sorted;
+    mutable bool m_sortedDirty;
+
+    mutable QMutex m_mutex;
+};
+
+void PlacemarkSearchIndex::Private::add( const GeoDataPlacemark *placemark )
+{
+    if ( !placemark ) {
+        return;
+    }
+
+    remove( placemark );
+
+    const QString key = PlacemarkSearchIndex::normalized( placemark->name() );
+    if ( key.isEmpty() ) {
+        return;
+    }
+
+    const GeoDataCoordinates coordinates = placemark->coordinate();
+
+    Entry entry;
+    entry.placemark = placemark;
+    entry.key = key;
+    entry.trigramCount = 0;
+    entry.popularity = placemark->popularity();
+    entry.longitude = coordinates.longitude();
+    entry.latitude = coordinates.latitude();
+    insert( entry );
+}
+
+void PlacemarkSearchIndex::Private::insert( const Entry &entry )
+{
+    const int id = m_entries.size();
+    m_entries.append( entry );
+    m_ids.insert( entry.placemark, id );
+
+    QVector<quint64> keyTrigrams;
+    trigrams( entry.key, keyTrigrams );
+    m_entries.last().trigramCount = keyTrigrams.size();
+    foreach ( quint64 trigram, keyTrigrams ) {
+        m_trigrams[trigram].append( id );
+    }
+
+    m_sorted.append( id );
+    m_sortedDirty = true;
+}
+
+void PlacemarkSearchIndex::Private::remove( const GeoDataPlacemark *placemark )
+{
+    const QHash<const GeoDataPlacemark *, int>::iterator it = m_ids.find( placemark );
+    if ( it == m_ids.end() ) {
+        return;
+    }
+
+    // the key stays for the order of m_sorted
+    m_entries[it.value()].placemark = 0;
+    m_ids.erase( it );
+    ++m_removed;
+}
+
+void PlacemarkSearchIndex::Private::clear()
+{
+    m_entries.clear();
+    m_ids.clear();
+    m_trigrams.clear();
+    m_removed = 0;
+    m_sorted.clear();
+    m_sortedDirty = false;
+}
+
+void PlacemarkSearchIndex::Private::compact()
+{
+    if ( m_removed < 64 || 2 * m_removed < m_entries.size() ) {
+        return;
+    }
+
+    const QVector<Entry> entries = m_entries;
+    clear();
+    foreach ( const Entry &entry, entries ) {
+        if ( entry.placemark ) {
+            insert( entry );
+        }
+    }
+}
+
+void PlacemarkSearchIndex::Private::addPrefixMatches( const QString &key, const GeoDataLatLonAltBox &preferred,
+                                                      QVector<Match> &matches ) const
+{
+    if ( m_sortedDirty ) {
+        qSort( m_sorted.begin(), m_sorted.end(), KeyLessThan( m_entries ) );
+        m_sortedDirty = false;
+    }
+
+    // the first key not less than the search term
+    int first = 0;
+    int last = m_sorted.size();
+    while ( first < last ) {
+        const int middle = ( first + last ) / 2;
+        if ( m_entries[m_sorted[middle]].key < key ) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+
+    for ( int i = first; i < m_sorted.size(); ++i ) {
+        const int id = m_sorted[i];
+        const Entry &entry = m_entries[id];
+        if ( !entry.key.startsWith( key ) ) {
+            break;
+        }
+
+        if ( entry.placemark && isPreferred( entry, preferred ) ) {
+            const Match match = { id, 1.0, distance( entry, preferred ) };
+            matches.append( match );
+        }
+    }
+}
+
+void PlacemarkSearchIndex::Private::addSimilarMatches( const QString &key, const GeoDataLatLonAltBox &preferred,
+                                                       QVector<Match> &matches ) const
+{
+    // too short to share trigrams other than its prefix
+    if ( key.size() < 3 ) {
+        return;
+    }
+
+    QVector<quint64> keyTrigrams;
+    trigrams( key, keyTrigrams );
+
+    QHash<int, int> common;
+    foreach ( quint64 trigram, keyTrigrams ) {
+        const QHash<quint64, QVector<int> >::const_iterator it = m_trigrams.constFind( trigram );
+        if ( it == m_trigrams.constEnd() ) {
+            continue;
+        }
+
+        foreach ( int id, it.value() ) {
+            ++common[id];
+        }
+    }
+
+    QHash<int, int>::const_iterator it = common.constBegin();
+    for ( ; it != common.constEnd(); ++it ) {
+        const Entry &entry = m_entries[it.key()];
+        if ( !entry.placemark ) {
+            continue;
+        }
+
+        // Dice's coefficient of the trigrams
+        const qreal similarity = 2.0 * it.value() / ( keyTrigrams.size() + entry.trigramCount );
+        if ( similarity >= minimumSimilarity && isPreferred( entry, preferred ) ) {
+            const Match match = { it.key(), similarity, distance( entry, preferred ) };
+            matches.append( match );
+        }
+    }
+}
+
+bool PlacemarkSearchIndex::Private::isPreferred( const Entry &entry, const GeoDataLatLonAltBox &preferred ) const
+{
+    return preferred.isEmpty() || preferred.contains( GeoDataCoordinates( entry.longitude, entry.latitude ) );
+}
+
+qreal PlacemarkSearchIndex::Private::distance( const Entry &entry, const GeoDataLatLonAltBox &preferred ) const
+{
+    if ( preferred.isEmpty() ) {
+        return 0.0;
+    }
+
+    const GeoDataCoordinates center = preferred.center();
+    return distanceSphere( entry.longitude, entry.latitude, center.longitude(), center.latitude() );
+}
+
+void PlacemarkSearchIndex::Private::trigrams( const QString &key, QVector<quint64> &result )
+{
+    // padded to give the beginning of names more weight
+    const QString padded = QLatin1String( "  " ) + key + QLatin1Char( ' ' );
+
+    for ( int i = 0; i + 2 < padded.size(); ++i ) {
+        const quint64 trigram = ( quint64( padded[i].unicode() ) << 32 )
+                              | ( quint64( padded[i + 1].unicode() ) << 16 )
+                              | quint64( padded[i + 2].unicode() );
+        if ( !result.contains( trigram ) ) {
+            result.append( trigram );
+        }
+    }
+}
+
+PlacemarkSearchIndex::PlacemarkSearchIndex( QObject *parent )
+    : QObject( parent ),
+      d( new Private )
+{
+}
+
+PlacemarkSearchIndex::~PlacemarkSearchIndex()
+{
+    delete d;
+}
+
+void PlacemarkSearchIndex::setModel( const QAbstractItemModel *model )
+{
+    if ( d->m_model ) {
+        disconnect( d->m_model, 0, this, 0 );
+    }
+
+    d->m_model = model;
+
+    if ( model ) {
+        connect( model, SIGNAL(rowsInserted(QModelIndex,int,int)),
+                 this, SLOT(addRows(QModelIndex,int,int)) );
+        connect( model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+                 this, SLOT(removeRows(QModelIndex,int,int)) );
+        connect( model, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+                 this, SLOT(updateRows(QModelIndex,QModelIndex)) );
+        connect( model, SIGNAL(modelReset()),
+                 this, SLOT(resetRows()) );
+    }
+
+    resetRows();
+}
+
+void PlacemarkSearchIndex::addPlacemark( const GeoDataPlacemark *placemark )
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->add( placemark );
+}
+
+void PlacemarkSearchIndex::removePlacemark( const GeoDataPlacemark *placemark )
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->remove( placemark );
+    d->compact();
+}
+
+void PlacemarkSearchIndex::clear()
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->clear();
+}
+
+int PlacemarkSearchIndex::size() const
+{
+    QMutexLocker locker( &d->m_mutex );
+    return d->m_ids.size();
+}
+
+QVector<const GeoDataPlacemark *> PlacemarkSearchIndex::search( const QString &searchTerm,
+                                                                const GeoDataLatLonAltBox &preferred,
+                                                                int limit ) const
+{
+    QVector<const GeoDataPlacemark *> result;
+
+    const QString key = normalized( searchTerm );
+    if ( key.isEmpty() ) {
+        return result;
+    }
+
+    QMutexLocker locker( &d->m_mutex );
+
+    QVector<Private::Match> matches;
+    d->addPrefixMatches( key, preferred, matches );
+    if ( matches.isEmpty() ) {
+        d->addSimilarMatches( key, preferred, matches );
+    }
+
+    qSort( matches.begin(), matches.end(), Private::MatchLessThan( d->m_entries ) );
+
+    const int count = limit < 0 ? matches.size() : qMin( limit, matches.size() );
+    result.reserve( count );
+    for ( int i = 0; i < count; ++i ) {
+        result.append( d->m_entries[matches[i].id].placemark );
+    }
+
+    return result;
+}
+
+QString PlacemarkSearchIndex::normalized( const QString &name )
+{
+    return GeoString::deaccent( name.toLower() );
+}
+
+void PlacemarkSearchIndex::addRows( const QModelIndex &parent, int first, int last )
+{
+    QMutexLocker locker( &d->m_mutex );
+
+    for ( int i = first; i <= last; ++i ) {
+        const QModelIndex index = d->m_model->index( i, 0, parent );
+        const GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
+        d->add( placemark );
+    }
+}
+
+void PlacemarkSearchIndex::removeRows( const QModelIndex &parent, int first, int last )
+{
+    QMutexLocker locker( &d->m_mutex );
+
+    for ( int i = first; i <= last; ++i ) {
+        const QModelIndex index = d->m_model->index( i, 0, parent );
+        const GeoDataPlacemark *placemark = static_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>(index.data( MarblePlacemarkModel::ObjectPointerRole ) ));
+        d->remove( placemark );
+    }
+
+    d->compact();
+}
+
+void PlacemarkSearchIndex::updateRows( const QModelIndex &topLeft, const QModelIndex &bottomRight )
+{
+    // names may have changed, which add() handles by indexing the placemarks again
+    addRows( topLeft.parent(), topLeft.row(), bottomRight.row() );
+}
+
+void PlacemarkSearchIndex::resetRows()
+{
+    clear();
+
+    if ( d->m_model ) {
+        addRows( QModelIndex(), 0, d->m_model->rowCount() - 1 );
+    }
+}
+
+}
+
+#include "PlacemarkSearchIndex.moc"
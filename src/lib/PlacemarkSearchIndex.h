@@ -0,0 +1,98 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PLACEMARKSEARCHINDEX_H
+#define MARBLE_PLACEMARKSEARCHINDEX_H
+
+#include <QObject>
+#include <QVector>
+
+#include "GeoDataLatLonAltBox.h"
+#include "marble_export.h"
+
+class QAbstractItemModel;
+class QModelIndex;
+
+namespace Marble
+{
+
+class GeoDataPlacemark;
+
+/**
+ * @short An index of the names of placemarks for searching them as you type.
+ *
+ * Names are indexed without case and accents. Placemarks whose names start
+ * with the search term are found by a binary search in the sorted names.
+ * If there are none, placemarks with similar names are found by the
+ * trigrams (the sequences of three characters) their names share with
+ * the search term, which tolerates typos.
+ *
+ * The index follows the rows of a model like MarbleModel::placemarkModel(),
+ * or placemarks are added and removed explicitly. Searching is thread-safe,
+ * changing the index must happen in the thread of the index.
+ */
+class MARBLE_EXPORT PlacemarkSearchIndex : public QObject
+{
+    Q_OBJECT
+
+ public:
+    explicit PlacemarkSearchIndex( QObject *parent = 0 );
+    ~PlacemarkSearchIndex();
+
+    /**
+     * Indexes the placemarks in the rows of the flat @p model and keeps
+     * following its changes. The placemarks are taken from
+     * MarblePlacemarkModel::ObjectPointerRole.
+     */
+    void setModel( const QAbstractItemModel *model );
+
+    void addPlacemark( const GeoDataPlacemark *placemark );
+
+    void removePlacemark( const GeoDataPlacemark *placemark );
+
+    void clear();
+
+    /**
+     * Returns the number of placemarks indexed.
+     */
+    int size() const;
+
+    /**
+     * Returns the placemarks whose names start with @p searchTerm, or those
+     * with similar names if there are none. Only placemarks inside
+     * @p preferred are returned unless it is empty.
+     *
+     * Similar names come first, then popular placemarks, then those closest
+     * to the center of @p preferred. At most @p limit placemarks are
+     * returned unless it is negative.
+     */
+    QVector<const GeoDataPlacemark *> search( const QString &searchTerm,
+                                              const GeoDataLatLonAltBox &preferred = GeoDataLatLonAltBox(),
+                                              int limit = -1 ) const;
+
+    /**
+     * Returns @p name the way it is indexed, in lower case without accents.
+     */
+    static QString normalized( const QString &name );
+
+ private Q_SLOTS:
+    void addRows( const QModelIndex &parent, int first, int last );
+    void removeRows( const QModelIndex &parent, int first, int last );
+    void updateRows( const QModelIndex &topLeft, const QModelIndex &bottomRight );
+    void resetRows();
+
+ private:
+    Q_DISABLE_COPY( PlacemarkSearchIndex )
+
+    class Private;
+    Private *const d;
+};
+
+}
+
+#endif
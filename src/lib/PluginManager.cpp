@@ -13,14 +13,33 @@
 // Own
 #include "PluginManager.h"
 
+// posix
+#include <cstdio>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
 // Qt
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QList>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QPluginLoader>
+#include <QTemporaryFile>
+#include <QThread>
 #include <QTime>
+#include <QVector>
 
 // Local dir
 #include "MarbleDirs.h"
 #include "MarbleDebug.h"
+#include "MarbleGlobal.h"
 #include "RenderPlugin.h"
 #include "PositionProviderPlugin.h"
 #include "AbstractFloatItem.h"
@@ -32,19 +51,81 @@
 namespace Marble
 {
 
+static const quint32 cacheMagic = 0x4d504c43; // "MPLC"
+static const quint32 cacheVersion = 1;
+
 class PluginManagerPrivate
 {
  public:
-    PluginManagerPrivate()
-            : m_pluginsLoaded(false)
+    enum PluginType {
+        NoPluginType,
+        RenderPluginType,
+        PositionProviderPluginType,
+        SearchRunnerPluginType,
+        ReverseGeocodingRunnerPluginType,
+        RoutingRunnerPluginType,
+        ParseRunnerPluginType
+    };
+
+    /**
+     * What is known about a plugin file without loading it. This is
+     * kept in a cache between runs of Marble, and the plugins are only
+     * loaded when plugins of their type are asked for.
+     */
+    struct PluginInfo
+    {
+        PluginInfo() : size( 0 ), type( NoPluginType ), loaded( false ) {}
+
+        QString path;
+        QDateTime lastModified;
+        qint64 size;
+        PluginType type;
+        QString nameId;
+        QStringList fileExtensions;
+        bool loaded;
+    };
+
+    explicit PluginManagerPrivate( PluginManager *parent )
+            : q( parent ),
+              m_pluginsScanned(false)
     {
     }
 
     ~PluginManagerPrivate();
 
-    void loadPlugins();
+    /**
+     * Finds the plugin files and their types, from the cache if possible.
+     */
+    void scanPlugins();
+
+    void loadPlugins( PluginType type );
+
+    /**
+     * Loads the plugin of @p info and adds it to the list of its type.
+     */
+    void loadPlugin( PluginInfo &info );
+
+    void readCache( QHash<QString, PluginInfo> &cache ) const;
+
+    void writeCache() const;
+
+    static QString cachePath();
+
+    /**
+     * Atomically replaces @p target with @p source.
+     */
+    static bool replaceFile( const QString &source, const QString &target );
+
+    static bool canParse( const QStringList &fileExtensions, const QString &fileName );
+
+    PluginManager *const q;
+
+    // plugins may be asked for by the threads loading files
+    QMutex m_mutex;
+
+    bool m_pluginsScanned;
+    QVector<PluginInfo> m_plugins;
 
-    bool m_pluginsLoaded;
     QList<const RenderPlugin *> m_renderPluginTemplates;
     QList<const PositionProviderPlugin *> m_positionProviderPluginTemplates;
     QList<const SearchRunnerPlugin *> m_searchRunnerPlugins;
@@ -59,7 +140,7 @@ PluginManagerPrivate::~PluginManagerPrivate()
 }
 
 PluginManager::PluginManager( QObject *parent ) : QObject( parent ),
-    d( new PluginManagerPrivate() )
+    d( new PluginManagerPrivate( this ) )
 {
 }
 
@@ -70,85 +151,133 @@ PluginManager::~PluginManager()
 
 QList<const RenderPlugin *> PluginManager::renderPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::RenderPluginType );
     return d->m_renderPluginTemplates;
 }
 
 void PluginManager::addRenderPlugin( const RenderPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_renderPluginTemplates << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::RenderPluginType );
+        d->m_renderPluginTemplates << plugin;
+    }
     emit renderPluginsChanged();
 }
 
 QList<const PositionProviderPlugin *> PluginManager::positionProviderPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::PositionProviderPluginType );
     return d->m_positionProviderPluginTemplates;
 }
 
 void PluginManager::addPositionProviderPlugin( const PositionProviderPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_positionProviderPluginTemplates << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::PositionProviderPluginType );
+        d->m_positionProviderPluginTemplates << plugin;
+    }
     emit positionProviderPluginsChanged();
 }
 
 QList<const SearchRunnerPlugin *> PluginManager::searchRunnerPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::SearchRunnerPluginType );
     return d->m_searchRunnerPlugins;
 }
 
 void PluginManager::addSearchRunnerPlugin( const SearchRunnerPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_searchRunnerPlugins << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::SearchRunnerPluginType );
+        d->m_searchRunnerPlugins << plugin;
+    }
     emit searchRunnerPluginsChanged();
 }
 
 QList<const ReverseGeocodingRunnerPlugin *> PluginManager::reverseGeocodingRunnerPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::ReverseGeocodingRunnerPluginType );
     return d->m_reverseGeocodingRunnerPlugins;
 }
 
 void PluginManager::addReverseGeocodingRunnerPlugin( const ReverseGeocodingRunnerPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_reverseGeocodingRunnerPlugins << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::ReverseGeocodingRunnerPluginType );
+        d->m_reverseGeocodingRunnerPlugins << plugin;
+    }
     emit reverseGeocodingRunnerPluginsChanged();
 }
 
 QList<RoutingRunnerPlugin *> PluginManager::routingRunnerPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::RoutingRunnerPluginType );
     return d->m_routingRunnerPlugins;
 }
 
 void PluginManager::addRoutingRunnerPlugin( RoutingRunnerPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_routingRunnerPlugins << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::RoutingRunnerPluginType );
+        d->m_routingRunnerPlugins << plugin;
+    }
     emit routingRunnerPluginsChanged();
 }
 
 QList<const ParseRunnerPlugin *> PluginManager::parsingRunnerPlugins() const
 {
-    d->loadPlugins();
+    QMutexLocker locker( &d->m_mutex );
+    d->loadPlugins( PluginManagerPrivate::ParseRunnerPluginType );
     return d->m_parsingRunnerPlugins;
 }
 
+QList<const ParseRunnerPlugin *> PluginManager::parsingRunnerPlugins( const QString &fileName ) const
+{
+    QMutexLocker locker( &d->m_mutex );
+    d->scanPlugins();
+
+    // only the plugins which can parse the file are loaded
+    for ( int i = 0; i < d->m_plugins.size(); ++i ) {
+        PluginManagerPrivate::PluginInfo &info = d->m_plugins[i];
+        if ( !info.loaded && info.type == PluginManagerPrivate::ParseRunnerPluginType
+             && PluginManagerPrivate::canParse( info.fileExtensions, fileName ) ) {
+            d->loadPlugin( info );
+        }
+    }
+
+    QList<const ParseRunnerPlugin *> plugins;
+    foreach ( const ParseRunnerPlugin *plugin, d->m_parsingRunnerPlugins ) {
+        if ( PluginManagerPrivate::canParse( plugin->fileExtensions(), fileName ) ) {
+            plugins << plugin;
+        }
+    }
+
+    return plugins;
+}
+
 void PluginManager::addParseRunnerPlugin( const ParseRunnerPlugin *plugin )
 {
-    d->loadPlugins();
-    d->m_parsingRunnerPlugins << plugin;
+    {
+        QMutexLocker locker( &d->m_mutex );
+        d->loadPlugins( PluginManagerPrivate::ParseRunnerPluginType );
+        d->m_parsingRunnerPlugins << plugin;
+    }
     emit parseRunnerPluginsChanged();
 }
 
-/** Append obj to the given plugins list if it inherits both T and U */
+/** Append obj to the given plugins list if it inherits both T and U, return the appended plugin */
 template<class T, class U>
-bool appendPlugin( QObject * obj, QPluginLoader* &loader, QList<T*> &plugins )
+T* appendPlugin( QObject * obj, QPluginLoader* &loader, QList<T*> &plugins )
 {
     if ( qobject_cast<T*>( obj ) && qobject_cast<U*>( obj ) ) {
         Q_ASSERT( obj->metaObject()->superClass() ); // all our plugins have a super class
@@ -157,15 +286,15 @@ bool appendPlugin( QObject * obj, QPluginLoader* &loader, QList<T*> &plugins )
         T* plugin = qobject_cast<T*>( obj );
         Q_ASSERT( plugin ); // checked above
         plugins << plugin;
-        return true;
+        return plugin;
     }
 
-    return false;
+    return 0;
 }
 
-/** Append obj to the given plugins list if it inherits both T and U */
+/** Append obj to the given plugins list if it inherits both T and U, return the appended plugin */
 template<class T, class U>
-bool appendPlugin( QObject * obj, QPluginLoader* &loader, QList<const T*> &plugins )
+T* appendPlugin( QObject * obj, QPluginLoader* &loader, QList<const T*> &plugins )
 {
     if ( qobject_cast<T*>( obj ) && qobject_cast<U*>( obj ) ) {
         Q_ASSERT( obj->metaObject()->superClass() ); // all our plugins have a super class
@@ -174,70 +303,208 @@ bool appendPlugin( QObject * obj, QPluginLoader* &loader, QList<const T*> &plugi
         T* plugin = qobject_cast<T*>( obj );
         Q_ASSERT( plugin ); // checked above
         plugins << plugin;
-        return true;
+        return plugin;
     }
 
-    return false;
+    return 0;
 }
 
-void PluginManagerPrivate::loadPlugins()
+void PluginManagerPrivate::scanPlugins()
 {
-    if (m_pluginsLoaded)
-    {
+    if ( m_pluginsScanned ) {
         return;
     }
 
     QTime t;
     t.start();
-    mDebug() << "Starting to load Plugins.";
+    mDebug() << "Starting to scan Plugins.";
 
     QStringList pluginFileNameList = MarbleDirs::pluginEntryList( "", QDir::Files );
 
     MarbleDirs::debug();
 
-    Q_ASSERT( m_renderPluginTemplates.isEmpty() );
-    Q_ASSERT( m_positionProviderPluginTemplates.isEmpty() );
-    Q_ASSERT( m_searchRunnerPlugins.isEmpty() );
-    Q_ASSERT( m_reverseGeocodingRunnerPlugins.isEmpty() );
-    Q_ASSERT( m_routingRunnerPlugins.isEmpty() );
-    Q_ASSERT( m_parsingRunnerPlugins.isEmpty() );
+    Q_ASSERT( m_plugins.isEmpty() );
+
+    QHash<QString, PluginInfo> cache;
+    readCache( cache );
 
+    bool cacheChanged = false;
     foreach( const QString &fileName, pluginFileNameList ) {
-        // mDebug() << fileName << " - " << MarbleDirs::pluginPath( fileName );
         QString const path = MarbleDirs::pluginPath( fileName );
-        QPluginLoader* loader = new QPluginLoader( path );
-
-        QObject * obj = loader->instance();
-
-        if ( obj ) {
-            bool isPlugin = appendPlugin<RenderPlugin, RenderPluginInterface>
-                       ( obj, loader, m_renderPluginTemplates );
-            isPlugin = isPlugin || appendPlugin<PositionProviderPlugin, PositionProviderPluginInterface>
-                       ( obj, loader, m_positionProviderPluginTemplates );
-            isPlugin = isPlugin || appendPlugin<SearchRunnerPlugin, SearchRunnerPlugin>
-                       ( obj, loader, m_searchRunnerPlugins ); // intentionally T==U
-            isPlugin = isPlugin || appendPlugin<ReverseGeocodingRunnerPlugin, ReverseGeocodingRunnerPlugin>
-                       ( obj, loader, m_reverseGeocodingRunnerPlugins ); // intentionally T==U
-            isPlugin = isPlugin || appendPlugin<RoutingRunnerPlugin, RoutingRunnerPlugin>
-                       ( obj, loader, m_routingRunnerPlugins ); // intentionally T==U
-            isPlugin = isPlugin || appendPlugin<ParseRunnerPlugin, ParseRunnerPlugin>
-                       ( obj, loader, m_parsingRunnerPlugins ); // intentionally T==U
-            if ( !isPlugin ) {
-                qWarning() << "Ignoring the following plugin since it couldn't be loaded:" << path;
-                mDebug() << "Plugin failure:" << path << "is a plugin, but it does not implement the "
-                        << "right interfaces or it was compiled against an old version of Marble. Ignoring it.";
-                delete loader;
-            }
+        QFileInfo const fileInfo( path );
+
+        const QHash<QString, PluginInfo>::const_iterator cached = cache.constFind( path );
+        if ( cached != cache.constEnd()
+             && cached->lastModified == fileInfo.lastModified()
+             && cached->size == fileInfo.size() ) {
+            m_plugins << cached.value();
+            continue;
+        }
+
+        // new or changed plugins are loaded to find out what they are
+        PluginInfo info;
+        info.path = path;
+        info.lastModified = fileInfo.lastModified();
+        info.size = fileInfo.size();
+        loadPlugin( info );
+        m_plugins << info;
+        cacheChanged = true;
+    }
+
+    if ( cacheChanged || cache.size() != m_plugins.size() ) {
+        writeCache();
+    }
+
+    m_pluginsScanned = true;
+
+    mDebug() << Q_FUNC_INFO << "Time elapsed:" << t.elapsed() << "ms";
+}
+
+void PluginManagerPrivate::loadPlugins( PluginType type )
+{
+    scanPlugins();
+
+    for ( int i = 0; i < m_plugins.size(); ++i ) {
+        if ( !m_plugins[i].loaded && m_plugins[i].type == type ) {
+            loadPlugin( m_plugins[i] );
+        }
+    }
+}
+
+void PluginManagerPrivate::loadPlugin( PluginInfo &info )
+{
+    QString const path = info.path;
+    QPluginLoader* loader = new QPluginLoader( path );
+
+    QObject * obj = loader->instance();
+
+    info.loaded = true;
+    info.type = NoPluginType;
+
+    if ( obj ) {
+        // the plugin belongs to the thread of the manager, not to the thread which asked for it
+        if ( obj->thread() == QThread::currentThread() ) {
+            obj->moveToThread( q->thread() );
+        }
+
+        if ( RenderPlugin *plugin = appendPlugin<RenderPlugin, RenderPluginInterface>( obj, loader, m_renderPluginTemplates ) ) {
+            info.type = RenderPluginType;
+            info.nameId = plugin->nameId();
+        } else if ( PositionProviderPlugin *plugin = appendPlugin<PositionProviderPlugin, PositionProviderPluginInterface>( obj, loader, m_positionProviderPluginTemplates ) ) {
+            info.type = PositionProviderPluginType;
+            info.nameId = plugin->nameId();
+        } else if ( SearchRunnerPlugin *plugin = appendPlugin<SearchRunnerPlugin, SearchRunnerPlugin>( obj, loader, m_searchRunnerPlugins ) ) { // intentionally T==U
+            info.type = SearchRunnerPluginType;
+            info.nameId = plugin->nameId();
+        } else if ( ReverseGeocodingRunnerPlugin *plugin = appendPlugin<ReverseGeocodingRunnerPlugin, ReverseGeocodingRunnerPlugin>( obj, loader, m_reverseGeocodingRunnerPlugins ) ) { // intentionally T==U
+            info.type = ReverseGeocodingRunnerPluginType;
+            info.nameId = plugin->nameId();
+        } else if ( RoutingRunnerPlugin *plugin = appendPlugin<RoutingRunnerPlugin, RoutingRunnerPlugin>( obj, loader, m_routingRunnerPlugins ) ) { // intentionally T==U
+            info.type = RoutingRunnerPluginType;
+            info.nameId = plugin->nameId();
+        } else if ( ParseRunnerPlugin *plugin = appendPlugin<ParseRunnerPlugin, ParseRunnerPlugin>( obj, loader, m_parsingRunnerPlugins ) ) { // intentionally T==U
+            info.type = ParseRunnerPluginType;
+            info.nameId = plugin->nameId();
+            info.fileExtensions = plugin->fileExtensions();
         } else {
-            qWarning() << "Ignoring to load the following file since it doesn't look like a valid Marble plugin:" << path << endl
-                       << "Reason:" << loader->errorString();
+            qWarning() << "Ignoring the following plugin since it couldn't be loaded:" << path;
+            mDebug() << "Plugin failure:" << path << "is a plugin, but it does not implement the "
+                    << "right interfaces or it was compiled against an old version of Marble. Ignoring it.";
             delete loader;
         }
+    } else {
+        qWarning() << "Ignoring to load the following file since it doesn't look like a valid Marble plugin:" << path << endl
+                   << "Reason:" << loader->errorString();
+        delete loader;
     }
+}
 
-    m_pluginsLoaded = true;
+QString PluginManagerPrivate::cachePath()
+{
+    return MarbleDirs::localPath() + "/plugins.cache";
+}
 
-    mDebug() << Q_FUNC_INFO << "Time elapsed:" << t.elapsed() << "ms";
+void PluginManagerPrivate::readCache( QHash<QString, PluginInfo> &cache ) const
+{
+    QFile file( cachePath() );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return;
+    }
+
+    // plugins have to be checked again when Marble changed
+    QDataStream stream( &file );
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString marbleVersion;
+    stream >> magic >> version >> marbleVersion;
+    if ( stream.status() != QDataStream::Ok || magic != cacheMagic || version != cacheVersion
+         || marbleVersion != MARBLE_VERSION_STRING ) {
+        return;
+    }
+
+    qint32 count = 0;
+    stream >> count;
+    for ( qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i ) {
+        PluginInfo info;
+        qint32 type = 0;
+        stream >> info.path >> info.lastModified >> info.size >> type >> info.nameId >> info.fileExtensions;
+        info.type = PluginType( type );
+        cache.insert( info.path, info );
+    }
+
+    if ( stream.status() != QDataStream::Ok ) {
+        cache.clear();
+    }
+}
+
+void PluginManagerPrivate::writeCache() const
+{
+    // written to a temporary file first, which then replaces the cache in
+    // one step, so other instances of Marble never read a partial cache
+    const QString path = cachePath();
+
+    QTemporaryFile file( path + ".XXXXXX" );
+    if ( !file.open() ) {
+        mDebug() << "Unable to write the plugin cache" << file.fileTemplate();
+        return;
+    }
+
+    QDataStream stream( &file );
+    stream << cacheMagic << cacheVersion << MARBLE_VERSION_STRING;
+    stream << qint32( m_plugins.size() );
+    foreach ( const PluginInfo &info, m_plugins ) {
+        stream << info.path << info.lastModified << info.size << qint32( info.type ) << info.nameId << info.fileExtensions;
+    }
+    file.close();
+
+    // the temporary file is removed if it didn't replace the cache
+    if ( stream.status() != QDataStream::Ok || !replaceFile( file.fileName(), path ) ) {
+        mDebug() << "Unable to write the plugin cache" << path;
+    }
+}
+
+bool PluginManagerPrivate::replaceFile( const QString &source, const QString &target )
+{
+    // QFile::rename() doesn't replace existing files
+#ifdef Q_OS_WIN
+    return MoveFileExW( reinterpret_cast<const wchar_t *>( QDir::toNativeSeparators( source ).utf16() ),
+                        reinterpret_cast<const wchar_t *>( QDir::toNativeSeparators( target ).utf16() ),
+                        MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return ::rename( QFile::encodeName( source ).constData(), QFile::encodeName( target ).constData() ) == 0;
+#endif
+}
+
+bool PluginManagerPrivate::canParse( const QStringList &fileExtensions, const QString &fileName )
+{
+    // plugins without extensions may parse any file
+    if ( fileExtensions.isEmpty() ) {
+        return true;
+    }
+
+    QFileInfo const fileInfo( fileName );
+    return fileExtensions.contains( fileInfo.suffix().toLower() )
+        || fileExtensions.contains( fileInfo.completeSuffix().toLower() );
 }
 
 }
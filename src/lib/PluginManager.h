@@ -32,6 +32,10 @@ class ParseRunnerPlugin;
 /**
  * @short The class that handles Marble's plugins.
  *
+ * Plugins are only loaded when plugins of their kind are asked for. What
+ * kind of plugin a file contains is kept in a cache between sessions, so
+ * the plugin files don't need to be loaded to find out.
+ *
  * Ownership policy for plugins:
  *
  * On every invocation of createNetworkPlugins and
@@ -128,6 +132,13 @@ class MARBLE_EXPORT PluginManager : public QObject
      */
     QList<const ParseRunnerPlugin *> parsingRunnerPlugins() const;
 
+    /**
+     * Returns the parse runner plugins which can open the file @p fileName
+     * according to its extension. Other parse runner plugins are not loaded.
+     * @note: The runner plugins are owned by the PluginManager, do not delete them.
+     */
+    QList<const ParseRunnerPlugin *> parsingRunnerPlugins( const QString &fileName ) const;
+
     /**
      * @brief Add a ParseRunnerPlugin manually to the list of known plugins. Normally you
      * don't need to call this method since all plugins are loaded automatically.
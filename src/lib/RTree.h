@@ -0,0 +1,465 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_RTREE_H
+#define MARBLE_RTREE_H
+
+#include <QtAlgorithms>
+#include <QVector>
+
+#include <cmath>
+
+namespace Marble
+{
+
+/**
+ * @short An R-tree of values with rectangular bounds.
+ *
+ * Values are inserted one at a time or loaded in bulk. Bulk loading packs
+ * the nodes by Sort-Tile-Recursive, which gives much tighter nodes than
+ * a sequence of insertions. Insertions choose the node needing the least
+ * enlargement and split overflowing nodes in halves along their longer
+ * axis. Removals don't rebalance the tree.
+ *
+ * Values are compared with operator==, which is needed for removal only.
+ */
+template <typename T>
+class RTree
+{
+ public:
+    struct Box
+    {
+        qreal minX;
+        qreal minY;
+        qreal maxX;
+        qreal maxY;
+
+        static Box fromCoordinates( qreal minX, qreal minY, qreal maxX, qreal maxY )
+        {
+            const Box box = { minX, minY, maxX, maxY };
+            return box;
+        }
+
+        bool intersects( const Box &other ) const
+        {
+            return minX <= other.maxX && other.minX <= maxX
+                && minY <= other.maxY && other.minY <= maxY;
+        }
+
+        bool contains( const Box &other ) const
+        {
+            return minX <= other.minX && other.maxX <= maxX
+                && minY <= other.minY && other.maxY <= maxY;
+        }
+
+        Box united( const Box &other ) const
+        {
+            return fromCoordinates( qMin( minX, other.minX ), qMin( minY, other.minY ),
+                                    qMax( maxX, other.maxX ), qMax( maxY, other.maxY ) );
+        }
+
+        qreal area() const { return ( maxX - minX ) * ( maxY - minY ); }
+
+        qreal centerX() const { return minX + maxX; }
+        qreal centerY() const { return minY + maxY; }
+
+        bool operator==( const Box &other ) const
+        {
+            return minX == other.minX && minY == other.minY
+                && maxX == other.maxX && maxY == other.maxY;
+        }
+    };
+
+    struct Entry
+    {
+        Box box;
+        T value;
+    };
+
+    RTree();
+    ~RTree();
+
+    int size() const { return m_size; }
+
+    bool isEmpty() const { return m_size == 0; }
+
+    void clear();
+
+    /**
+     * Replaces the contents of the tree by @p entries.
+     */
+    void load( const QVector<Entry> &entries );
+
+    void insert( const Box &box, const T &value );
+
+    /**
+     * Removes @p value which has been inserted with @p box. Returns false if
+     * there is no such entry.
+     */
+    bool remove( const Box &box, const T &value );
+
+    /**
+     * Appends the values of all entries intersecting @p box to @p result,
+     * in no specific order.
+     */
+    void query( const Box &box, QVector<T> *result ) const;
+
+    /**
+     * Appends all entries to @p result.
+     */
+    void entries( QVector<Entry> *result ) const;
+
+ private:
+    Q_DISABLE_COPY( RTree )
+
+    enum { MaximumEntries = 16 };
+
+    struct Node;
+
+    struct NodeEntry
+    {
+        Box box;
+        Node *child;
+        T value;
+    };
+
+    struct Node
+    {
+        explicit Node( bool isLeaf ) : leaf( isLeaf ) {}
+
+        Box boundingBox() const
+        {
+            Box box = entries.first().box;
+            for ( int i = 1; i < entries.size(); ++i ) {
+                box = box.united( entries[i].box );
+            }
+            return box;
+        }
+
+        bool leaf;
+        QVector<NodeEntry> entries;
+    };
+
+    static bool lessThanByX( const NodeEntry &a, const NodeEntry &b ) { return a.box.centerX() < b.box.centerX(); }
+    static bool lessThanByY( const NodeEntry &a, const NodeEntry &b ) { return a.box.centerY() < b.box.centerY(); }
+
+    static void deleteNode( Node *node );
+
+    /**
+     * Packs @p entries into nodes of one level and returns their entries.
+     */
+    static QVector<NodeEntry> pack( QVector<NodeEntry> entries, bool leaves );
+
+    /**
+     * Inserts @p entry below @p node and returns the new sibling of @p node
+     * if it had to be split.
+     */
+    static Node *insert( Node *node, const NodeEntry &entry );
+
+    static Node *split( Node *node );
+
+    static bool remove( Node *node, const Box &box, const T &value );
+
+    static NodeEntry nodeEntry( Node *node )
+    {
+        NodeEntry entry;
+        entry.box = node->boundingBox();
+        entry.child = node;
+        entry.value = T();
+        return entry;
+    }
+
+    Node *m_root;
+    int m_size;
+};
+
+template <typename T>
+RTree<T>::RTree()
+    : m_root( 0 ),
+      m_size( 0 )
+{
+}
+
+template <typename T>
+RTree<T>::~RTree()
+{
+    deleteNode( m_root );
+}
+
+template <typename T>
+void RTree<T>::clear()
+{
+    deleteNode( m_root );
+    m_root = 0;
+    m_size = 0;
+}
+
+template <typename T>
+void RTree<T>::deleteNode( Node *node )
+{
+    if ( !node ) {
+        return;
+    }
+
+    if ( !node->leaf ) {
+        for ( int i = 0; i < node->entries.size(); ++i ) {
+            deleteNode( node->entries[i].child );
+        }
+    }
+
+    delete node;
+}
+
+template <typename T>
+void RTree<T>::load( const QVector<Entry> &entries )
+{
+    clear();
+
+    if ( entries.isEmpty() ) {
+        return;
+    }
+
+    QVector<NodeEntry> level;
+    level.reserve( entries.size() );
+    for ( int i = 0; i < entries.size(); ++i ) {
+        NodeEntry entry;
+        entry.box = entries[i].box;
+        entry.child = 0;
+        entry.value = entries[i].value;
+        level.append( entry );
+    }
+
+    bool leaves = true;
+    while ( level.size() > MaximumEntries ) {
+        level = pack( level, leaves );
+        leaves = false;
+    }
+
+    m_root = new Node( leaves );
+    m_root->entries = level;
+    m_size = entries.size();
+}
+
+template <typename T>
+QVector<typename RTree<T>::NodeEntry> RTree<T>::pack( QVector<NodeEntry> entries, bool leaves )
+{
+    const int nodeCount = ( entries.size() + MaximumEntries - 1 ) / MaximumEntries;
+    const int sliceCount = qMax( 1, int( ceil( sqrt( qreal( nodeCount ) ) ) ) );
+    const int sliceSize = sliceCount * MaximumEntries;
+
+    // vertical slices of about the same number of nodes, each sorted from south to north
+    qSort( entries.begin(), entries.end(), lessThanByX );
+    for ( int first = 0; first < entries.size(); first += sliceSize ) {
+        const int last = qMin( first + sliceSize, entries.size() );
+        qSort( entries.begin() + first, entries.begin() + last, lessThanByY );
+    }
+
+    QVector<NodeEntry> result;
+    result.reserve( nodeCount );
+    for ( int first = 0; first < entries.size(); first += MaximumEntries ) {
+        Node *node = new Node( leaves );
+        node->entries = entries.mid( first, MaximumEntries );
+        result.append( nodeEntry( node ) );
+    }
+
+    return result;
+}
+
+template <typename T>
+void RTree<T>::insert( const Box &box, const T &value )
+{
+    if ( !m_root ) {
+        m_root = new Node( true );
+    }
+
+    NodeEntry entry;
+    entry.box = box;
+    entry.child = 0;
+    entry.value = value;
+
+    Node *sibling = insert( m_root, entry );
+    if ( sibling ) {
+        Node *root = new Node( false );
+        root->entries.append( nodeEntry( m_root ) );
+        root->entries.append( nodeEntry( sibling ) );
+        m_root = root;
+    }
+
+    ++m_size;
+}
+
+template <typename T>
+typename RTree<T>::Node *RTree<T>::insert( Node *node, const NodeEntry &entry )
+{
+    if ( node->leaf ) {
+        node->entries.append( entry );
+    }
+    else {
+        // the child needing the least enlargement, the smallest of those
+        int best = 0;
+        qreal bestEnlargement = 0.0;
+        qreal bestArea = 0.0;
+        for ( int i = 0; i < node->entries.size(); ++i ) {
+            const qreal area = node->entries[i].box.area();
+            const qreal enlargement = node->entries[i].box.united( entry.box ).area() - area;
+            if ( i == 0 || enlargement < bestEnlargement
+                 || ( enlargement == bestEnlargement && area < bestArea ) ) {
+                best = i;
+                bestEnlargement = enlargement;
+                bestArea = area;
+            }
+        }
+
+        NodeEntry &child = node->entries[best];
+        Node *sibling = insert( child.child, entry );
+        if ( sibling ) {
+            child.box = child.child->boundingBox();
+            node->entries.append( nodeEntry( sibling ) );
+        }
+        else {
+            child.box = child.box.united( entry.box );
+        }
+    }
+
+    if ( node->entries.size() > MaximumEntries ) {
+        return split( node );
+    }
+
+    return 0;
+}
+
+template <typename T>
+typename RTree<T>::Node *RTree<T>::split( Node *node )
+{
+    const Box box = node->boundingBox();
+    if ( box.maxX - box.minX > box.maxY - box.minY ) {
+        qSort( node->entries.begin(), node->entries.end(), lessThanByX );
+    }
+    else {
+        qSort( node->entries.begin(), node->entries.end(), lessThanByY );
+    }
+
+    const int half = node->entries.size() / 2;
+    Node *sibling = new Node( node->leaf );
+    sibling->entries = node->entries.mid( half );
+    node->entries.resize( half );
+
+    return sibling;
+}
+
+template <typename T>
+bool RTree<T>::remove( const Box &box, const T &value )
+{
+    if ( !m_root || !remove( m_root, box, value ) ) {
+        return false;
+    }
+
+    --m_size;
+
+    // drop roots with a single child
+    while ( !m_root->leaf && m_root->entries.size() == 1 ) {
+        Node *child = m_root->entries.first().child;
+        delete m_root;
+        m_root = child;
+    }
+
+    if ( m_root->entries.isEmpty() ) {
+        delete m_root;
+        m_root = 0;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool RTree<T>::remove( Node *node, const Box &box, const T &value )
+{
+    for ( int i = 0; i < node->entries.size(); ++i ) {
+        NodeEntry &entry = node->entries[i];
+
+        if ( node->leaf ) {
+            if ( entry.box == box && entry.value == value ) {
+                node->entries.remove( i );
+                return true;
+            }
+        }
+        else if ( entry.box.contains( box ) && remove( entry.child, box, value ) ) {
+            if ( entry.child->entries.isEmpty() ) {
+                delete entry.child;
+                node->entries.remove( i );
+            }
+            else {
+                entry.box = entry.child->boundingBox();
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename T>
+void RTree<T>::query( const Box &box, QVector<T> *result ) const
+{
+    if ( !m_root ) {
+        return;
+    }
+
+    QVector<const Node *> nodes;
+    nodes.append( m_root );
+
+    while ( !nodes.isEmpty() ) {
+        const Node *node = nodes.last();
+        nodes.pop_back();
+
+        for ( int i = 0; i < node->entries.size(); ++i ) {
+            const NodeEntry &entry = node->entries[i];
+            if ( !entry.box.intersects( box ) ) {
+                continue;
+            }
+
+            if ( node->leaf ) {
+                result->append( entry.value );
+            }
+            else {
+                nodes.append( entry.child );
+            }
+        }
+    }
+}
+
+template <typename T>
+void RTree<T>::entries( QVector<Entry> *result ) const
+{
+    if ( !m_root ) {
+        return;
+    }
+
+    QVector<const Node *> nodes;
+    nodes.append( m_root );
+
+    while ( !nodes.isEmpty() ) {
+        const Node *node = nodes.last();
+        nodes.pop_back();
+
+        for ( int i = 0; i < node->entries.size(); ++i ) {
+            const NodeEntry &entry = node->entries[i];
+            if ( node->leaf ) {
+                const Entry leafEntry = { entry.box, entry.value };
+                result->append( leafEntry );
+            }
+            else {
+                nodes.append( entry.child );
+            }
+        }
+    }
+}
+
+}
+
+#endif
@@ -437,6 +437,36 @@ QImage::Format ScanlineTextureMapperContext::optimalCanvasImageFormat( const Vie
     return imageFormat;
 }
 
+void ScanlineTextureMapperContext::scrollImage( QImage *image, int dx, int dy )
+{
+    const int width = image->width();
+    const int height = image->height();
+    const int pixelByteSize = image->depth() / 8;
+
+    const int columns = width - qAbs( dx );
+    if ( columns <= 0 || qAbs( dy ) >= height )
+        return;
+
+    const int sourceOffset = qMax( 0, -dx ) * pixelByteSize;
+    const int targetOffset = qMax( 0, dx ) * pixelByteSize;
+
+    // move the rows in an order which doesn't overwrite rows still to be moved
+    if ( dy > 0 ) {
+        for ( int y = height - 1; y >= dy; --y ) {
+            memmove( image->scanLine( y ) + targetOffset,
+                     image->scanLine( y - dy ) + sourceOffset,
+                     columns * pixelByteSize );
+        }
+    }
+    else {
+        for ( int y = 0; y < height + dy; ++y ) {
+            memmove( image->scanLine( y ) + targetOffset,
+                     image->scanLine( y - dy ) + sourceOffset,
+                     columns * pixelByteSize );
+        }
+    }
+}
+
 
 void ScanlineTextureMapperContext::nextTile( int &posX, int &posY )
 {
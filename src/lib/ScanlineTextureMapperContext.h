@@ -46,6 +46,12 @@ public:
 
     static QImage::Format optimalCanvasImageFormat( const ViewportParams *viewport );
 
+    /**
+     * Moves the content of @p image by @p dx pixels to the right and @p dy pixels
+     * down. The areas which get exposed keep their previous content.
+     */
+    static void scrollImage( QImage *image, int dx, int dy );
+
     int globalWidth() const;
     int globalHeight() const;
 
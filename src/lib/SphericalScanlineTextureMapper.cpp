@@ -60,10 +60,30 @@ SphericalScanlineTextureMapper::RenderJob::RenderJob( StackedTileLoader *tileLoa
 {
 }
 
+// The previous frame is kept for rotations which move no pixel by more than this fraction of a pixel.
+// ScanlineTextureMapperTest checks that such a frame differs less from a new one than the
+// NormalQuality mapping differs from the HighQuality one.
+static const qreal maxRotationError = 0.25;
+
+// Returns the angle of the rotation which turns the planet axis @p from into @p to.
+static qreal rotationAngle( const Quaternion &from, const Quaternion &to )
+{
+    const Quaternion delta = from.inverse() * to;
+    const qreal sinHalfAngle = sqrt( delta.v[Q_X] * delta.v[Q_X]
+                                     + delta.v[Q_Y] * delta.v[Q_Y]
+                                     + delta.v[Q_Z] * delta.v[Q_Z] );
+
+    // more precise than the acos of the real part for small angles
+    return 2.0 * asin( qMin<qreal>( 1.0, sinHalfAngle ) );
+}
+
 SphericalScanlineTextureMapper::SphericalScanlineTextureMapper( StackedTileLoader *tileLoader )
     : TextureMapperInterface()
     , m_tileLoader( tileLoader )
     , m_radius( 0 )
+    , m_planetAxis()
+    , m_tileZoomLevel( -1 )
+    , m_mapQuality( NormalQuality )
     , m_threadPool()
 {
 }
@@ -89,11 +109,18 @@ void SphericalScanlineTextureMapper::mapTexture( GeoPainter *painter,
         m_repaintNeeded = true;
     }
 
+    if ( !m_repaintNeeded && !( m_planetAxis == viewport->planetAxis() ) ) {
+        // The distance a point on the globe moves is at most the rotation angle times the radius.
+        m_repaintNeeded = tileZoomLevel != m_tileZoomLevel
+                          || painter->mapQuality() != m_mapQuality
+                          || rotationAngle( m_planetAxis, viewport->planetAxis() ) * viewport->radius() > maxRotationError;
+    }
+
     if ( m_repaintNeeded ) {
         mapTexture( viewport, tileZoomLevel, painter->mapQuality() );
 
         if ( texColorizer ) {
-            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality() );
+            texColorizer->colorize( &m_canvasImage, viewport, painter->mapQuality(), &m_threadPool );
         }
 
         m_repaintNeeded = false;
@@ -107,6 +134,11 @@ void SphericalScanlineTextureMapper::mapTexture( GeoPainter *painter,
     painter->drawImage( rect, m_canvasImage, rect );
 }
 
+void SphericalScanlineTextureMapper::setViewportChanged()
+{
+    // mapTexture() compares the viewport with the one of the last frame
+}
+
 void SphericalScanlineTextureMapper::mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality )
 {
     // Reset backend
@@ -126,16 +158,19 @@ void SphericalScanlineTextureMapper::mapTexture( const ViewportParams *viewport,
                                       : yTop + radius + radius - skip;
 
     const int numThreads = m_threadPool.maxThreadCount();
-    const int yStep = ( yBottom - yTop ) / numThreads;
     for ( int i = 0; i < numThreads; ++i ) {
-        const int yStart = yTop +  i      * yStep;
-        const int yEnd   = yTop + (i + 1) * yStep;
+        const int yStart = yTop +  i      * ( yBottom - yTop ) / numThreads;
+        const int yEnd   = yTop + (i + 1) * ( yBottom - yTop ) / numThreads;
         QRunnable *const job = new RenderJob( m_tileLoader, tileZoomLevel, &m_canvasImage, viewport, mapQuality, yStart, yEnd );
         m_threadPool.start( job );
     }
 
     m_threadPool.waitForDone();
 
+    m_planetAxis = viewport->planetAxis();
+    m_tileZoomLevel = tileZoomLevel;
+    m_mapQuality = mapQuality;
+
     m_tileLoader->cleanupTilehash();
 }
 
@@ -16,6 +16,7 @@
 #include "TextureMapperInterface.h"
 
 #include "MarbleGlobal.h"
+#include "Quaternion.h"
 
 #include <QThreadPool>
 #include <QImage>
@@ -47,6 +48,8 @@ class SphericalScanlineTextureMapper : public TextureMapperInterface
                              const QRect &dirtyRect,
                              TextureColorizer *texColorizer );
 
+    virtual void setViewportChanged();
+
  private:
     void mapTexture( const ViewportParams *viewport, int tileZoomLevel, MapQuality mapQuality );
 
@@ -55,6 +58,10 @@ class SphericalScanlineTextureMapper : public TextureMapperInterface
     StackedTileLoader *const m_tileLoader;
     int m_radius;
     QImage m_canvasImage;
+    // the viewport the canvas image was mapped for
+    Quaternion m_planetAxis;
+    int m_tileZoomLevel;
+    MapQuality m_mapQuality;
     QThreadPool m_threadPool;
 };
 
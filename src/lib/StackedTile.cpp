@@ -65,7 +65,8 @@ StackedTile::StackedTile( const TileId &id, const QImage &resultImage, QVector<Q
       jumpTable8( jumpTableFromQImage8( m_resultImage ) ),
       jumpTable32( jumpTableFromQImage32( m_resultImage ) ),
       m_byteCount( calcByteCount( resultImage, tiles ) ),
-      m_isUsed( false )
+      m_isUsed( false ),
+      m_isPlaceholder( false )
 {
     Q_ASSERT( !tiles.isEmpty() );
 
@@ -234,6 +235,16 @@ bool StackedTile::used() const
     return m_isUsed;
 }
 
+void StackedTile::setPlaceholder( bool placeholder )
+{
+    m_isPlaceholder = placeholder;
+}
+
+bool StackedTile::isPlaceholder() const
+{
+    return m_isPlaceholder;
+}
+
 uint StackedTile::pixelF( qreal x, qreal y ) const
 {
     int iX = (int)(x);
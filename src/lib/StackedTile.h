@@ -62,6 +62,13 @@ class StackedTile : public Tile
     void setUsed( bool used );
     bool used() const;
 
+/*!
+    \brief Marks the tile as a stand-in scaled from an ancestor tile
+    which is replaced once the tile itself has been loaded.
+*/
+    void setPlaceholder( bool placeholder );
+    bool isPlaceholder() const;
+
     int depth() const;
     int byteCount() const;
 
@@ -110,6 +117,7 @@ class StackedTile : public Tile
     const uint **const jumpTable32;
     const int m_byteCount;
     bool m_isUsed;
+    bool m_isPlaceholder;
 
     static int calcByteCount( const QImage &resultImage, const QVector<QSharedPointer<TextureTile> > &tiles );
 };
@@ -0,0 +1,301 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "StackedTileCache.h"
+
+#include "StackedTile.h"
+
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QSet>
+#include <QWriteLocker>
+
+namespace Marble
+{
+
+// number of least recently used tiles among which the one with the highest zoom level is evicted first
+static const int evictionWindow = 8;
+
+StackedTileCache::Shard::Shard()
+    : displayedBytes( 0 )
+{
+}
+
+StackedTileCache::StackedTileCache( int shardCount )
+    : m_shards( qMax( 1, shardCount ) ),
+      m_nextStamp( 0 ),
+      m_cachedBytes( 0 ),
+      m_capacity( 0 ),
+      m_hitCount( 0 ),
+      m_missCount( 0 ),
+      m_evictionCount( 0 )
+{
+    for ( int i = 0; i < m_shards.size(); ++i ) {
+        m_shards[i] = new Shard;
+    }
+
+    setCapacity( 20000 * 1024 );
+}
+
+StackedTileCache::~StackedTileCache()
+{
+    clear();
+    qDeleteAll( m_shards );
+}
+
+StackedTileCache::Shard *StackedTileCache::shard( const TileId &id ) const
+{
+    return m_shards[ qHash( id ) % m_shards.size() ];
+}
+
+QReadWriteLock *StackedTileCache::lock( const TileId &id ) const
+{
+    return &shard( id )->lock;
+}
+
+StackedTile *StackedTileCache::displayedTile( const TileId &id ) const
+{
+    return shard( id )->displayed.value( id, 0 );
+}
+
+void StackedTileCache::insertDisplayedTile( const TileId &id, StackedTile *tile )
+{
+    Shard *const s = shard( id );
+
+    StackedTile *const previous = s->displayed.value( id, 0 );
+    if ( previous ) {
+        s->displayedBytes -= previous->byteCount();
+    }
+
+    s->displayed.insert( id, tile );
+    s->displayedBytes += tile->byteCount();
+}
+
+StackedTile *StackedTileCache::takeDisplayedTile( const TileId &id )
+{
+    Shard *const s = shard( id );
+
+    StackedTile *const tile = s->displayed.take( id );
+    if ( tile ) {
+        s->displayedBytes -= tile->byteCount();
+    }
+
+    return tile;
+}
+
+const StackedTile *StackedTileCache::cachedTile( const TileId &id ) const
+{
+    Shard *const s = shard( id );
+
+    QHash<TileId, CacheEntry>::const_iterator const pos = s->cached.constFind( id );
+    if ( pos == s->cached.constEnd() ) {
+        return 0;
+    }
+
+    return pos->tile;
+}
+
+StackedTile *StackedTileCache::takeCachedTile( const TileId &id )
+{
+    Shard *const s = shard( id );
+
+    QHash<TileId, CacheEntry>::iterator const pos = s->cached.find( id );
+    if ( pos == s->cached.end() ) {
+        return 0;
+    }
+
+    StackedTile *const tile = pos->tile;
+    {
+        QMutexLocker locker( &m_usageMutex );
+        m_usage.remove( pos->stamp );
+        m_cachedBytes -= tile->byteCount();
+    }
+    s->cached.erase( pos );
+
+    return tile;
+}
+
+void StackedTileCache::insertCachedTile( const TileId &id, StackedTile *tile )
+{
+    Shard *const s = shard( id );
+
+    removeCachedTile( id );
+
+    CacheEntry entry;
+    entry.tile = tile;
+    {
+        QMutexLocker locker( &m_usageMutex );
+        entry.stamp = m_nextStamp++;
+        m_usage.insert( entry.stamp, id );
+        m_cachedBytes += tile->byteCount();
+    }
+    s->cached.insert( id, entry );
+
+    evict( s );
+}
+
+void StackedTileCache::removeCachedTile( const TileId &id )
+{
+    delete takeCachedTile( id );
+}
+
+void StackedTileCache::evict( Shard *lockedShard )
+{
+    QList<StackedTile *> evicted;
+
+    {
+        QMutexLocker locker( &m_usageMutex );
+
+        // tiles in shards locked by other threads, skipped in this run
+        QSet<quint64> skipped;
+
+        while ( m_cachedBytes > m_capacity ) {
+            QMap<quint64, TileId>::iterator victim = m_usage.end();
+
+            int window = 0;
+            QMap<quint64, TileId>::iterator candidate = m_usage.begin();
+            for (; window < evictionWindow && candidate != m_usage.end(); ++candidate ) {
+                if ( skipped.contains( candidate.key() ) ) {
+                    continue;
+                }
+
+                ++window;
+                if ( victim == m_usage.end() || candidate.value().zoomLevel() > victim.value().zoomLevel() ) {
+                    victim = candidate;
+                }
+            }
+
+            if ( victim == m_usage.end() ) {
+                break;
+            }
+
+            // the shards are locked before m_usageMutex, so waiting for one could deadlock
+            Shard *const s = shard( victim.value() );
+            if ( s != lockedShard && !s->lock.tryLockForWrite() ) {
+                skipped.insert( victim.key() );
+                continue;
+            }
+
+            StackedTile *const tile = s->cached.take( victim.value() ).tile;
+            m_usage.erase( victim );
+            m_cachedBytes -= tile->byteCount();
+
+            if ( s != lockedShard ) {
+                s->lock.unlock();
+            }
+
+            evicted << tile;
+            m_evictionCount.ref();
+        }
+    }
+
+    qDeleteAll( evicted );
+}
+
+void StackedTileCache::countHit()
+{
+    m_hitCount.ref();
+}
+
+void StackedTileCache::countMiss()
+{
+    m_missCount.ref();
+}
+
+QList<TileId> StackedTileCache::displayedTileIds() const
+{
+    QList<TileId> result;
+
+    foreach ( Shard *s, m_shards ) {
+        QReadLocker locker( &s->lock );
+        result << s->displayed.keys();
+    }
+
+    return result;
+}
+
+void StackedTileCache::clear()
+{
+    foreach ( Shard *s, m_shards ) {
+        QWriteLocker locker( &s->lock );
+
+        qDeleteAll( s->displayed );
+        s->displayed.clear();
+        s->displayedBytes = 0;
+
+        QMutexLocker usageLocker( &m_usageMutex );
+        QHash<TileId, CacheEntry>::const_iterator pos = s->cached.constBegin();
+        QHash<TileId, CacheEntry>::const_iterator const end = s->cached.constEnd();
+        for (; pos != end; ++pos ) {
+            m_usage.remove( pos->stamp );
+            m_cachedBytes -= pos->tile->byteCount();
+            delete pos->tile;
+        }
+        s->cached.clear();
+    }
+}
+
+void StackedTileCache::setCapacity( qint64 bytes )
+{
+    {
+        QMutexLocker locker( &m_usageMutex );
+        m_capacity = bytes;
+    }
+
+    evict( 0 );
+}
+
+qint64 StackedTileCache::capacity() const
+{
+    QMutexLocker locker( &m_usageMutex );
+    return m_capacity;
+}
+
+int StackedTileCache::count() const
+{
+    int result = 0;
+
+    foreach ( Shard *s, m_shards ) {
+        QReadLocker locker( &s->lock );
+        result += s->displayed.count() + s->cached.count();
+    }
+
+    return result;
+}
+
+qint64 StackedTileCache::byteCount() const
+{
+    qint64 result = 0;
+
+    foreach ( Shard *s, m_shards ) {
+        QReadLocker locker( &s->lock );
+        result += s->displayedBytes;
+    }
+
+    QMutexLocker locker( &m_usageMutex );
+    result += m_cachedBytes;
+
+    return result;
+}
+
+int StackedTileCache::hitCount() const
+{
+    return m_hitCount;
+}
+
+int StackedTileCache::missCount() const
+{
+    return m_missCount;
+}
+
+int StackedTileCache::evictionCount() const
+{
+    return m_evictionCount;
+}
+
+}
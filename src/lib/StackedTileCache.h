@@ -0,0 +1,146 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_STACKEDTILECACHE_H
+#define MARBLE_STACKEDTILECACHE_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QVector>
+
+#include "TileId.h"
+
+namespace Marble
+{
+
+class StackedTile;
+
+/**
+ * @short In-memory store for the stacked tiles of a StackedTileLoader.
+ *
+ * The cache keeps two sets of tiles: the tiles which are currently on display
+ * and the tiles which have been displayed before and are kept for later reuse.
+ * Both sets are split into shards by the hash of the TileId, each guarded by a
+ * lock of its own, so that render threads working on different tiles don't
+ * contend for a single lock.
+ *
+ * The tiles which are not on display are bounded by one budget in bytes for all
+ * shards, as given by StackedTile::byteCount(). When the budget is exceeded,
+ * tiles are evicted in least-recently-used order across all shards, but out of
+ * the oldest few tiles the one with the highest zoom level goes first. This keeps
+ * tiles of the lower levels around, which can serve as ancestors for scaled
+ * placeholders. Tiles in shards which are locked by other threads are left for
+ * later evictions.
+ *
+ * Except for the methods which operate on all shards, the caller has to hold the
+ * lock() of the given tile id: for reading when calling const methods and
+ * for writing when calling non-const methods.
+ */
+class StackedTileCache
+{
+ public:
+    explicit StackedTileCache( int shardCount = 16 );
+    ~StackedTileCache();
+
+    /**
+     * Returns the lock guarding the shard which contains the given tile.
+     */
+    QReadWriteLock *lock( const TileId &id ) const;
+
+    StackedTile *displayedTile( const TileId &id ) const;
+    void insertDisplayedTile( const TileId &id, StackedTile *tile );
+    StackedTile *takeDisplayedTile( const TileId &id );
+
+    /**
+     * Returns a tile which is not on display without removing it from the cache.
+     */
+    const StackedTile *cachedTile( const TileId &id ) const;
+
+    /**
+     * Removes a tile which is not on display from the cache and returns it,
+     * transferring ownership to the caller.
+     */
+    StackedTile *takeCachedTile( const TileId &id );
+
+    /**
+     * Inserts a tile which is no longer on display, taking ownership of it.
+     * The tile may be deleted right away if the budget is exceeded.
+     */
+    void insertCachedTile( const TileId &id, StackedTile *tile );
+
+    void removeCachedTile( const TileId &id );
+
+    void countHit();
+    void countMiss();
+
+    // The following methods lock each shard on their own.
+
+    QList<TileId> displayedTileIds() const;
+
+    /**
+     * Deletes all tiles, including those on display.
+     */
+    void clear();
+
+    /**
+     * Sets the budget for tiles which are not on display.
+     * @param bytes the budget in bytes
+     */
+    void setCapacity( qint64 bytes );
+    qint64 capacity() const;
+
+    int count() const;
+    qint64 byteCount() const;
+
+    int hitCount() const;
+    int missCount() const;
+    int evictionCount() const;
+
+ private:
+    Q_DISABLE_COPY( StackedTileCache )
+
+    struct CacheEntry
+    {
+        StackedTile *tile;
+        quint64 stamp;
+    };
+
+    struct Shard
+    {
+        Shard();
+
+        mutable QReadWriteLock lock;
+        QHash<TileId, StackedTile *> displayed;
+        QHash<TileId, CacheEntry> cached;
+        qint64 displayedBytes;
+    };
+
+    Shard *shard( const TileId &id ) const;
+    void evict( Shard *lockedShard );
+
+    QVector<Shard *> m_shards;
+
+    // guards the usage of the cached tiles of all shards, locked after the shards
+    mutable QMutex m_usageMutex;
+    QMap<quint64, TileId> m_usage; // oldest first
+    quint64 m_nextStamp;
+    qint64 m_cachedBytes;
+    qint64 m_capacity;
+
+    QAtomicInt m_hitCount;
+    QAtomicInt m_missCount;
+    QAtomicInt m_evictionCount;
+};
+
+}
+
+#endif
@@ -28,14 +28,21 @@
 #include "MarbleDebug.h"
 #include "MergedLayerDecorator.h"
 #include "StackedTile.h"
+#include "StackedTileCache.h"
+#include "TextureTile.h"
 #include "TileLoader.h"
 #include "TileLoaderHelper.h"
 #include "MarbleGlobal.h"
 
-#include <QCache>
-#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QReadLocker>
 #include <QReadWriteLock>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 #include <QImage>
+#include <QWriteLocker>
 
 
 namespace Marble
@@ -44,27 +51,262 @@ namespace Marble
 class StackedTileLoaderPrivate
 {
 public:
-    StackedTileLoaderPrivate( MergedLayerDecorator *mergedLayerDecorator )
-        : m_layerDecorator( mergedLayerDecorator )
+    StackedTileLoaderPrivate( MergedLayerDecorator *mergedLayerDecorator, StackedTileLoader *parent )
+        : q( parent ),
+          m_layerDecorator( mergedLayerDecorator ),
+          m_asynchronous( false ),
+          m_generation( 0 )
     {
-        m_tileCache.setMaxCost( 20000 * 1024 ); // Cache size measured in bytes
+        m_tileCache.setCapacity( 20000 * 1024 ); // Cache size measured in bytes
     }
 
+    /**
+     * Returns the tile from the hash or moves it there from the cache.
+     * Returns 0 if the tile is in neither of them. The caller has to hold
+     * the lock of the tile for writing.
+     */
+    StackedTile *takeTile( TileId const &stackedTileId );
+
+    /**
+     * Returns the matching part of the closest ancestor tile held in memory,
+     * scaled to the full tile size, or a null image if there is no ancestor.
+     */
+    QImage placeholderImage( TileId const &stackedTileId ) const;
+
+    /**
+     * Loads the tile synchronously and inserts it into the hash. The caller has
+     * to hold the lock of the tile for writing.
+     */
+    StackedTile *loadTile( TileId const &stackedTileId );
+
+    /**
+     * Starts loading the tile in the background. The caller has to hold the
+     * pending mutex and make sure the tile is not pending yet.
+     */
+    void startLoadJob( TileId const &stackedTileId, DownloadUsage usage, int priority );
+
+    void startLoadJob( TileId const &stackedTileId );
+
+    void finishLoadedTiles();
+
+    StackedTileLoader *const q;
     MergedLayerDecorator *const m_layerDecorator;
-    QHash <TileId, StackedTile*>  m_tilesOnDisplay;
-    QCache <TileId, StackedTile>  m_tileCache;
-    QReadWriteLock m_cacheLock;
+    StackedTileCache m_tileCache;
+
+    bool m_asynchronous;
+    QThreadPool m_threadPool;
+
+    // guards the pending tiles and the generation
+    QMutex m_pendingMutex;
+    // tiles currently being loaded in the background
+    QSet<TileId> m_pendingTiles;
+    // pending tiles for which an update arrived while their load job was running
+    QSet<TileId> m_outdatedPendingTiles;
+    // pending tiles which are loaded by a prefetch job
+    QSet<TileId> m_prefetchingTiles;
+    // incremented on clear() to discard results of load jobs started before
+    int m_generation;
+
+    QMutex m_loadedTilesMutex;
+    QList<QPair<int, StackedTile *> > m_loadedTiles;
+};
+
+class StackedTileLoadJob : public QRunnable
+{
+public:
+    StackedTileLoadJob( StackedTileLoaderPrivate *loader, TileId const &stackedTileId, DownloadUsage usage, int generation );
+
+    virtual void run();
+
+private:
+    StackedTileLoaderPrivate *const m_loader;
+    TileId const m_stackedTileId;
+    DownloadUsage const m_usage;
+    int const m_generation;
 };
 
+StackedTileLoadJob::StackedTileLoadJob( StackedTileLoaderPrivate *loader, TileId const &stackedTileId, DownloadUsage usage, int generation )
+    : m_loader( loader ),
+      m_stackedTileId( stackedTileId ),
+      m_usage( usage ),
+      m_generation( generation )
+{
+}
+
+void StackedTileLoadJob::run()
+{
+    StackedTile *const stackedTile = m_loader->m_layerDecorator->loadTile( m_stackedTileId, m_usage );
+    Q_ASSERT( stackedTile );
+
+    QMutexLocker locker( &m_loader->m_loadedTilesMutex );
+    m_loader->m_loadedTiles.append( qMakePair( m_generation, stackedTile ) );
+
+    // a single queued call collects all tiles which finished in the meantime
+    if ( m_loader->m_loadedTiles.count() == 1 ) {
+        QMetaObject::invokeMethod( m_loader->q, "finishLoadedTiles", Qt::QueuedConnection );
+    }
+}
+
+StackedTile *StackedTileLoaderPrivate::takeTile( TileId const &stackedTileId )
+{
+    // has another thread loaded our tile due to a race condition?
+    StackedTile *stackedTile = m_tileCache.displayedTile( stackedTileId );
+    if ( stackedTile ) {
+        Q_ASSERT( stackedTile->used() && "other thread should have marked tile as used" );
+        return stackedTile;
+    }
+
+    // the tile was not in the hash so check if it is in the cache
+    stackedTile = m_tileCache.takeCachedTile( stackedTileId );
+    if ( stackedTile ) {
+        Q_ASSERT( !stackedTile->used() && "cached tiles are invisible and should thus be marked as unused" );
+        stackedTile->setUsed( true );
+        m_tileCache.insertDisplayedTile( stackedTileId, stackedTile );
+        return stackedTile;
+    }
+
+    return 0;
+}
+
+QImage StackedTileLoaderPrivate::placeholderImage( TileId const &stackedTileId ) const
+{
+    for ( int level = stackedTileId.zoomLevel() - 1; level >= 0; --level ) {
+        int const deltaLevel = stackedTileId.zoomLevel() - level;
+        TileId const ancestorId( 0, level, stackedTileId.x() >> deltaLevel, stackedTileId.y() >> deltaLevel );
+
+        QImage ancestorImage;
+        {
+            QReadLocker locker( m_tileCache.lock( ancestorId ) );
+            const StackedTile *ancestor = m_tileCache.displayedTile( ancestorId );
+            if ( !ancestor ) {
+                ancestor = m_tileCache.cachedTile( ancestorId );
+            }
+            if ( !ancestor ) {
+                continue;
+            }
+            ancestorImage = *ancestor->resultImage();
+        }
+
+        int const restTileX = stackedTileId.x() % ( 1 << deltaLevel );
+        int const restTileY = stackedTileId.y() % ( 1 << deltaLevel );
+        int const partWidth = qMax( 1, ancestorImage.width() >> deltaLevel );
+        int const partHeight = qMax( 1, ancestorImage.height() >> deltaLevel );
+        QImage const part = ancestorImage.copy( restTileX * partWidth, restTileY * partHeight, partWidth, partHeight );
+
+        return part.scaled( ancestorImage.size() );
+    }
+
+    return QImage();
+}
+
+StackedTile *StackedTileLoaderPrivate::loadTile( TileId const &stackedTileId )
+{
+    mDebug() << "load tile from disk:" << stackedTileId;
+
+    StackedTile *const stackedTile = m_layerDecorator->loadTile( stackedTileId );
+    Q_ASSERT( stackedTile );
+    stackedTile->setUsed( true );
+
+    m_tileCache.insertDisplayedTile( stackedTileId, stackedTile );
+
+    return stackedTile;
+}
+
+void StackedTileLoaderPrivate::startLoadJob( TileId const &stackedTileId, DownloadUsage usage, int priority )
+{
+    m_pendingTiles.insert( stackedTileId );
+    m_threadPool.start( new StackedTileLoadJob( this, stackedTileId, usage, m_generation ), priority );
+}
+
+void StackedTileLoaderPrivate::startLoadJob( TileId const &stackedTileId )
+{
+    QMutexLocker locker( &m_pendingMutex );
+
+    if ( m_pendingTiles.contains( stackedTileId ) ) {
+        return;
+    }
+
+    mDebug() << "load tile in background:" << stackedTileId;
+
+    startLoadJob( stackedTileId, DownloadBrowse, 0 );
+}
+
+void StackedTileLoaderPrivate::finishLoadedTiles()
+{
+    m_loadedTilesMutex.lock();
+    QList<QPair<int, StackedTile *> > const loadedTiles = m_loadedTiles;
+    m_loadedTiles.clear();
+    m_loadedTilesMutex.unlock();
+
+    QList<QPair<int, StackedTile *> >::const_iterator pos = loadedTiles.constBegin();
+    QList<QPair<int, StackedTile *> >::const_iterator const end = loadedTiles.constEnd();
+    for (; pos != end; ++pos ) {
+        StackedTile *const stackedTile = pos->second;
+        TileId const stackedTileId = stackedTile->id();
+
+        bool outdated = false;
+        bool prefetched = false;
+        {
+            QMutexLocker locker( &m_pendingMutex );
+
+            if ( pos->first != m_generation ) {
+                // loaded before the last clear() => discard
+                delete stackedTile;
+                continue;
+            }
+
+            m_pendingTiles.remove( stackedTileId );
+            // an update arrived in the meantime, so the tile may have been loaded from outdated data
+            outdated = m_outdatedPendingTiles.remove( stackedTileId );
+            prefetched = m_prefetchingTiles.remove( stackedTileId );
+        }
+
+        QWriteLocker locker( m_tileCache.lock( stackedTileId ) );
+
+        StackedTile *const displayedTile = m_tileCache.displayedTile( stackedTileId );
+        const bool placeholder = displayedTile && displayedTile->isPlaceholder();
+        if ( placeholder ) {
+            m_tileCache.takeDisplayedTile( stackedTileId );
+            stackedTile->setUsed( true );
+            m_tileCache.insertDisplayedTile( stackedTileId, stackedTile );
+            delete displayedTile;
+
+            if ( outdated ) {
+                startLoadJob( stackedTileId );
+            }
+        } else if ( displayedTile || outdated ) {
+            // the tile has been loaded synchronously in the meantime, or updates arrived
+            delete stackedTile;
+        } else {
+            m_tileCache.insertCachedTile( stackedTileId, stackedTile );
+        }
+
+        locker.unlock();
+
+        if ( placeholder ) {
+            emit q->tileLoaded( stackedTileId );
+        }
+
+        if ( prefetched ) {
+            emit q->tilePrefetched( stackedTileId );
+        }
+    }
+}
+
 StackedTileLoader::StackedTileLoader( MergedLayerDecorator *mergedLayerDecorator, QObject *parent )
     : QObject( parent ),
-      d( new StackedTileLoaderPrivate( mergedLayerDecorator ) )
+      d( new StackedTileLoaderPrivate( mergedLayerDecorator, this ) )
 {
+    qRegisterMetaType<TileId>( "TileId" );
 }
 
 StackedTileLoader::~StackedTileLoader()
 {
-    qDeleteAll( d->m_tilesOnDisplay );
+    d->m_threadPool.waitForDone();
+
+    for ( int i = 0; i < d->m_loadedTiles.count(); ++i ) {
+        delete d->m_loadedTiles[i].second;
+    }
     delete d;
 }
 
@@ -90,11 +332,11 @@ QSize StackedTileLoader::tileSize() const
 
 void StackedTileLoader::resetTilehash()
 {
-    QHash<TileId, StackedTile*>::const_iterator it = d->m_tilesOnDisplay.constBegin();
-    QHash<TileId, StackedTile*>::const_iterator const end = d->m_tilesOnDisplay.constEnd();
-    for (; it != end; ++it ) {
-        Q_ASSERT( it.value()->used() && "contained in m_tilesOnDisplay should imply used()" );
-        it.value()->setUsed( false );
+    foreach ( const TileId &id, d->m_tileCache.displayedTileIds() ) {
+        QReadLocker locker( d->m_tileCache.lock( id ) );
+        StackedTile *const stackedTile = d->m_tileCache.displayedTile( id );
+        Q_ASSERT( stackedTile->used() && "displayed tiles should be marked as used" );
+        stackedTile->setUsed( false );
     }
 }
 
@@ -103,121 +345,247 @@ void StackedTileLoader::cleanupTilehash()
     // Make sure that tiles which haven't been used during the last
     // rendering of the map at all get removed from the tile hash.
 
-    QHashIterator<TileId, StackedTile*> it( d->m_tilesOnDisplay );
-    while ( it.hasNext() ) {
-        it.next();
-        if ( !it.value()->used() ) {
-            // If insert call result is false then the cache is too small to store the tile
-            // but the item will get deleted nevertheless and the pointer we have
-            // doesn't get set to zero (so don't delete it in this case or it will crash!)
-            d->m_tileCache.insert( it.key(), it.value(), it.value()->byteCount() );
-            d->m_tilesOnDisplay.remove( it.key() );
+    foreach ( const TileId &id, d->m_tileCache.displayedTileIds() ) {
+        QWriteLocker locker( d->m_tileCache.lock( id ) );
+
+        if ( d->m_tileCache.displayedTile( id )->used() ) {
+            continue;
+        }
+
+        StackedTile *const stackedTile = d->m_tileCache.takeDisplayedTile( id );
+
+        if ( stackedTile->isPlaceholder() ) {
+            // placeholders are cheap to recreate and must not end up in the cache
+            delete stackedTile;
+        } else {
+            d->m_tileCache.insertCachedTile( id, stackedTile );
         }
     }
 }
 
 const StackedTile* StackedTileLoader::loadTile( TileId const & stackedTileId )
 {
+    QReadWriteLock *const lock = d->m_tileCache.lock( stackedTileId );
+
     // check if the tile is in the hash
-    d->m_cacheLock.lockForRead();
-    StackedTile * stackedTile = d->m_tilesOnDisplay.value( stackedTileId, 0 );
-    d->m_cacheLock.unlock();
+    lock->lockForRead();
+    StackedTile * stackedTile = d->m_tileCache.displayedTile( stackedTileId );
+    lock->unlock();
     if ( stackedTile ) {
         stackedTile->setUsed( true );
+        d->m_tileCache.countHit();
         return stackedTile;
     }
     // here ends the performance critical section of this method
 
-    d->m_cacheLock.lockForWrite();
+    lock->lockForWrite();
 
-    // has another thread loaded our tile due to a race condition?
-    stackedTile = d->m_tilesOnDisplay.value( stackedTileId, 0 );
+    stackedTile = d->takeTile( stackedTileId );
     if ( stackedTile ) {
-        Q_ASSERT( stackedTile->used() && "other thread should have marked tile as used" );
-        d->m_cacheLock.unlock();
+        lock->unlock();
+        d->m_tileCache.countHit();
         return stackedTile;
     }
 
-    // the tile was not in the hash so check if it is in the cache
-    stackedTile = d->m_tileCache.take( stackedTileId );
-    if ( stackedTile ) {
-        Q_ASSERT( !stackedTile->used() && "tiles in m_tileCache are invisible and should thus be marked as unused" );
-        stackedTile->setUsed( true );
-        d->m_tilesOnDisplay[ stackedTileId ] = stackedTile;
-        d->m_cacheLock.unlock();
-        return stackedTile;
-    }
+    d->m_tileCache.countMiss();
 
     // tile (valid) has not been found in hash or cache, so load it from disk
     // and place it in the hash from where it will get transferred to the cache
 
-    mDebug() << "load tile from disk:" << stackedTileId;
+    if ( d->m_asynchronous ) {
+        // ancestors may live in other shards, so don't hold our lock while looking for them
+        lock->unlock();
+        const QImage placeholderImage = d->placeholderImage( stackedTileId );
+        lock->lockForWrite();
 
-    stackedTile = d->m_layerDecorator->loadTile( stackedTileId );
-    Q_ASSERT( stackedTile );
-    stackedTile->setUsed( true );
+        stackedTile = d->takeTile( stackedTileId );
+        if ( stackedTile ) {
+            lock->unlock();
+            return stackedTile;
+        }
 
-    d->m_tilesOnDisplay[ stackedTileId ] = stackedTile;
-    d->m_cacheLock.unlock();
+        if ( !placeholderImage.isNull() ) {
+            QVector<QSharedPointer<TextureTile> > tiles;
+            tiles << QSharedPointer<TextureTile>( new TextureTile( stackedTileId, placeholderImage, 0 ) );
 
-    emit tileLoaded( stackedTileId );
+            stackedTile = new StackedTile( stackedTileId, placeholderImage, tiles );
+            stackedTile->setUsed( true );
+            stackedTile->setPlaceholder( true );
+            d->m_tileCache.insertDisplayedTile( stackedTileId, stackedTile );
+
+            d->startLoadJob( stackedTileId );
+
+            lock->unlock();
+            return stackedTile;
+        }
+    }
+
+    // the caller gets the tile right away, so there is nothing to announce
+    stackedTile = d->loadTile( stackedTileId );
+    lock->unlock();
 
     return stackedTile;
 }
 
 quint64 StackedTileLoader::volatileCacheLimit() const
 {
-    return d->m_tileCache.maxCost() / 1024;
+    return d->m_tileCache.capacity() / 1024;
 }
 
 QList<TileId> StackedTileLoader::visibleTiles() const
 {
-    return d->m_tilesOnDisplay.keys();
+    return d->m_tileCache.displayedTileIds();
 }
 
 int StackedTileLoader::tileCount() const
 {
-    return d->m_tileCache.count() + d->m_tilesOnDisplay.count();
+    return d->m_tileCache.count();
+}
+
+qint64 StackedTileLoader::tileByteCount() const
+{
+    return d->m_tileCache.byteCount();
+}
+
+int StackedTileLoader::cacheHitCount() const
+{
+    return d->m_tileCache.hitCount();
+}
+
+int StackedTileLoader::cacheMissCount() const
+{
+    return d->m_tileCache.missCount();
+}
+
+int StackedTileLoader::cacheEvictionCount() const
+{
+    return d->m_tileCache.evictionCount();
 }
 
 void StackedTileLoader::setVolatileCacheLimit( quint64 kiloBytes )
 {
     mDebug() << QString("Setting tile cache to %1 kilobytes.").arg( kiloBytes );
-    d->m_tileCache.setMaxCost( kiloBytes * 1024 );
+    d->m_tileCache.setCapacity( kiloBytes * 1024 );
 }
 
 void StackedTileLoader::updateTile( TileId const &tileId, QImage const &tileImage )
 {
     const TileId stackedTileId( 0, tileId.zoomLevel(), tileId.x(), tileId.y() );
 
-    StackedTile * displayedTile = d->m_tilesOnDisplay.take( stackedTileId );
-    if ( displayedTile ) {
-        Q_ASSERT( !d->m_tileCache.contains( stackedTileId ) );
+    bool pending;
+    {
+        QMutexLocker locker( &d->m_pendingMutex );
+        pending = d->m_pendingTiles.contains( stackedTileId );
+        if ( pending ) {
+            // the tile is still being loaded in the background, reload once it is done
+            d->m_outdatedPendingTiles.insert( stackedTileId );
+        }
+    }
+
+    QWriteLocker locker( d->m_tileCache.lock( stackedTileId ) );
 
+    StackedTile * displayedTile = d->m_tileCache.displayedTile( stackedTileId );
+    if ( displayedTile && !displayedTile->isPlaceholder() ) {
+        Q_ASSERT( !d->m_tileCache.cachedTile( stackedTileId ) );
+
+        d->m_tileCache.takeDisplayedTile( stackedTileId );
         StackedTile *const stackedTile = d->m_layerDecorator->updateTile( *displayedTile, tileId, tileImage );
         stackedTile->setUsed( true );
-        d->m_tilesOnDisplay.insert( stackedTileId, stackedTile );
+        d->m_tileCache.insertDisplayedTile( stackedTileId, stackedTile );
 
         delete displayedTile;
         displayedTile = 0;
 
+        locker.unlock();
+
         emit tileLoaded( stackedTileId );
-    } else {
-        d->m_tileCache.remove( stackedTileId );
+    } else if ( !pending ) {
+        d->m_tileCache.removeCachedTile( stackedTileId );
     }
 }
 
+void StackedTileLoader::dropTile( TileId const &stackedTileId )
+{
+    {
+        QMutexLocker locker( &d->m_pendingMutex );
+        if ( d->m_pendingTiles.contains( stackedTileId ) ) {
+            d->m_outdatedPendingTiles.insert( stackedTileId );
+        }
+    }
+
+    QWriteLocker locker( d->m_tileCache.lock( stackedTileId ) );
+
+    // a placeholder is replaced by a reload once its load job is done
+    const StackedTile *const displayedTile = d->m_tileCache.displayedTile( stackedTileId );
+    if ( displayedTile && !displayedTile->isPlaceholder() ) {
+        delete d->m_tileCache.takeDisplayedTile( stackedTileId );
+    }
+    d->m_tileCache.removeCachedTile( stackedTileId );
+}
+
 void StackedTileLoader::clear()
 {
     mDebug() << Q_FUNC_INFO;
 
-    qDeleteAll( d->m_tilesOnDisplay );
-    d->m_tilesOnDisplay.clear();
     d->m_tileCache.clear(); // clear the tile cache in physical memory
 
+    {
+        // tiles which are still being loaded are discarded once they are ready
+        QMutexLocker locker( &d->m_pendingMutex );
+        ++d->m_generation;
+        d->m_pendingTiles.clear();
+        d->m_outdatedPendingTiles.clear();
+        d->m_prefetchingTiles.clear();
+    }
+
     emit cleared();
 }
 
+void StackedTileLoader::setAsynchronous( bool asynchronous )
+{
+    d->m_asynchronous = asynchronous;
+}
+
+bool StackedTileLoader::isAsynchronous() const
+{
+    return d->m_asynchronous;
+}
+
+bool StackedTileLoader::prefetchTile( TileId const &stackedTileId )
+{
+    // in synchronous mode, the prefetched tiles would only race with those loaded on display
+    if ( !d->m_asynchronous ) {
+        return false;
+    }
+
+    {
+        QReadLocker locker( d->m_tileCache.lock( stackedTileId ) );
+        if ( d->m_tileCache.displayedTile( stackedTileId ) || d->m_tileCache.cachedTile( stackedTileId ) ) {
+            return false;
+        }
+    }
+
+    QMutexLocker locker( &d->m_pendingMutex );
+
+    if ( d->m_pendingTiles.contains( stackedTileId ) ) {
+        return false;
+    }
+
+    mDebug() << "prefetch tile:" << stackedTileId;
+
+    d->m_prefetchingTiles.insert( stackedTileId );
+    d->startLoadJob( stackedTileId, DownloadBulk, -1 );
+
+    return true;
+}
+
+int StackedTileLoader::prefetchingTileCount() const
+{
+    QMutexLocker locker( &d->m_pendingMutex );
+
+    return d->m_prefetchingTiles.count();
+}
+
 }
 
 #include "StackedTileLoader.moc"
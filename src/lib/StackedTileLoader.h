@@ -115,6 +115,27 @@ class StackedTileLoader : public QObject
          */
         int tileCount() const;
 
+        /**
+         * @brief Return the memory used by the tiles in the cache.
+         * @return the memory used by tiles in bytes
+         */
+        qint64 tileByteCount() const;
+
+        /**
+         * @brief Return the number of loadTile() calls served from memory.
+         */
+        int cacheHitCount() const;
+
+        /**
+         * @brief Return the number of loadTile() calls which required loading a tile.
+         */
+        int cacheMissCount() const;
+
+        /**
+         * @brief Return the number of tiles evicted from the cache to stay within its limit.
+         */
+        int cacheEvictionCount() const;
+
         /**
          * @brief Set the limit of the volatile (in RAM) cache.
          * @param bytes The limit in kilobytes.
@@ -131,10 +152,64 @@ class StackedTileLoader : public QObject
          */
         void updateTile(TileId const & tileId, QImage const &tileImage );
 
+        /**
+         * @brief Removes a tile from memory because a download it waits for was cancelled.
+         *
+         * Without the download, the tile would keep its scaled image until it
+         * is evicted. Once dropped, the next loadTile() loads it again and
+         * thereby requests the download anew. A tile which is still being
+         * loaded in the background is discarded as soon as it is ready.
+         */
+        void dropTile( TileId const &stackedTileId );
+
+        /**
+         * @brief Sets whether tiles missing in memory are loaded in the background.
+         *
+         * In asynchronous mode loadTile() never decodes or blends tile images
+         * itself. A missing tile is replaced by a placeholder that is scaled
+         * from an ancestor tile already held in memory, while the real tile is
+         * loaded on a worker thread. tileLoaded() is emitted once it is ready.
+         *
+         * If no ancestor tile is available in memory, the tile is still loaded
+         * synchronously.
+         */
+        void setAsynchronous( bool asynchronous );
+        bool isAsynchronous() const;
+
+        /**
+         * @brief Loads a tile into the cache in the background ahead of its display.
+         *
+         * Prefetch jobs run after all queued loads of tiles on display, and
+         * missing tiles are downloaded with DownloadBulk. Nothing is done if
+         * the tile is in memory or being loaded already, or if tiles are not
+         * loaded asynchronously.
+         *
+         * @return whether a prefetch job was started for the tile
+         */
+        bool prefetchTile( TileId const &stackedTileId );
+
+        /**
+         * @brief Return the number of prefetch jobs which have not finished yet.
+         */
+        int prefetchingTileCount() const;
+
     Q_SIGNALS:
+        /**
+         * Emitted when a tile on display has been loaded in the background or
+         * updated. Tiles which loadTile() returns right away are not announced.
+         */
         void tileLoaded( TileId const &tileId );
+
+        /**
+         * Emitted when the prefetch job of a tile has finished.
+         */
+        void tilePrefetched( TileId const &tileId );
+
         void cleared();
 
+    private:
+        Q_PRIVATE_SLOT( d, void finishLoadedTiles() )
+
     private:
         Q_DISABLE_COPY( StackedTileLoader )
 
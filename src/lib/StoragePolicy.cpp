@@ -17,4 +17,19 @@ StoragePolicy::StoragePolicy( QObject *parent )
     : QObject( parent )
 {}
 
+bool StoragePolicy::readFile( const QString &fileName, QByteArray &data ) const
+{
+    Q_UNUSED( fileName );
+    Q_UNUSED( data );
+
+    return false;
+}
+
+QDateTime StoragePolicy::lastModified( const QString &fileName ) const
+{
+    Q_UNUSED( fileName );
+
+    return QDateTime();
+}
+
 #include "StoragePolicy.moc"
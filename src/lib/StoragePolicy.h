@@ -13,6 +13,7 @@
 #define MARBLE_STORAGEPOLICY_H
 
 
+#include <QDateTime>
 #include <QObject>
 #include <QString>
 
@@ -38,6 +39,19 @@ class StoragePolicy : public QObject
          */
         virtual bool updateFile( const QString &fileName, const QByteArray &data ) = 0;
 
+        /**
+         * Reads @p fileName into @p data if the policy keeps it somewhere else
+         * than in a file of its own. Returns false if the file has to be read
+         * from the file system.
+         */
+        virtual bool readFile( const QString &fileName, QByteArray &data ) const;
+
+        /**
+         * Returns when @p fileName was stored if the policy keeps it somewhere else
+         * than in a file of its own, an invalid QDateTime otherwise.
+         */
+        virtual QDateTime lastModified( const QString &fileName ) const;
+
 	virtual void clearCache() = 0;
 
         virtual QString lastErrorMessage() const = 0;
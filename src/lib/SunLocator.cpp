@@ -158,11 +158,7 @@ qreal SunLocator::shading(qreal lon, qreal a, qreal c) const
       theta = 2*asin(sqrt(h))
     */
 
-    qreal twilightZone = 0.0;
-
-    if ( d->m_planet->id() == "earth" || d->m_planet->id() == "venus" ) {
-        twilightZone = 0.1; // this equals 18 deg astronomical twilight.
-    }
+    const qreal twilightZone = this->twilightZone();
 
     qreal brightness;
     if ( h <= 0.5 - twilightZone / 2.0 )
@@ -175,6 +171,15 @@ qreal SunLocator::shading(qreal lon, qreal a, qreal c) const
     return brightness;
 }
 
+qreal SunLocator::twilightZone() const
+{
+    if ( d->m_planet->id() == "earth" || d->m_planet->id() == "venus" ) {
+        return 0.1; // this equals 18 deg astronomical twilight.
+    }
+
+    return 0.0;
+}
+
 void SunLocator::shadePixel(QRgb& pixcol, qreal brightness) const
 {
     // daylight - no change
@@ -39,6 +39,7 @@ class MARBLE_EXPORT SunLocator : public QObject
     virtual ~SunLocator();
 
     qreal shading(qreal lon, qreal a, qreal c) const;
+    qreal twilightZone() const;
     void  shadePixel(QRgb& pixcol, qreal shade) const;
     void  shadePixelComposite(QRgb& pixcol, const QRgb& dpixcol, qreal shade) const;
 
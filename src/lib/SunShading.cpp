@@ -0,0 +1,322 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "SunShading.h"
+
+#include "MarbleGlobal.h"
+#include "SunLocator.h"
+#include "TileId.h"
+#include "TileLoaderHelper.h"
+
+#include <QImage>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <cmath>
+
+namespace Marble
+{
+
+namespace
+{
+
+// a band painted by a worker thread has at least this many scanlines
+const int minimumBandHeight = 32;
+
+// shared by all instances, which are created for each blending of a map theme;
+// not the global pool, whose runner tasks would delay the bands
+Q_GLOBAL_STATIC( QThreadPool, bandThreadPool )
+
+enum Coverage
+{
+    Day,
+    Night,
+    Twilight
+};
+
+/**
+ * The shading parameters of a scanline. The brightness changes monotonously with
+ * the distance to the longitude of the sun, so the scanline is in daylight on one
+ * side of dayLimit and in the night on one side of nightLimit.
+ */
+struct Row
+{
+    bool isDay( qreal distance ) const
+    {
+        return dayIsNear ? distance <= dayLimit : distance >= dayLimit;
+    }
+
+    bool isNight( qreal distance ) const
+    {
+        return dayIsNear ? distance >= nightLimit : distance <= nightLimit;
+    }
+
+    qreal a;
+    qreal c;
+    qreal dayLimit;
+    qreal nightLimit;
+    bool dayIsNear;
+    Coverage coverage;
+};
+
+struct Context
+{
+    const SunLocator *sunLocator;
+    const uchar *nightChannel;
+    QImage *tileImage;
+    const QImage *nightImage;
+    QVector<Row> rows;
+    QVector<int> paintedRows;
+    int tileX;
+    qreal lonScale;
+    // the signed distance of the first column to the longitude of the sun
+    qreal startDistance;
+};
+
+/**
+ * Returns the distance to the longitude of the sun at which sin²(distance/2)
+ * equals @p s, or a value outside of [0, pi] if there is no such distance.
+ */
+qreal haversineDistance( qreal s )
+{
+    if ( s < 0.0 )
+        return -1.0;
+    if ( s > 1.0 )
+        return 4.0;
+
+    return 2.0 * asin( sqrt( s ) );
+}
+
+qreal wrappedDistance( qreal distance )
+{
+    distance = fmod( distance, 2 * M_PI );
+    if ( distance < -M_PI )
+        distance += 2 * M_PI;
+    else if ( distance >= M_PI )
+        distance -= 2 * M_PI;
+
+    return distance;
+}
+
+/**
+ * Determines the range of absolute distances to the longitude of the sun
+ * which is covered by the interval [start, start + width].
+ */
+void distanceRange( qreal start, qreal width, qreal &minimum, qreal &maximum )
+{
+    const qreal end = start + width;
+
+    if ( end > M_PI ) {
+        // the interval wraps around the antimeridian of the sun
+        maximum = M_PI;
+        minimum = ( start <= 0.0 || end - 2 * M_PI >= 0.0 ) ? 0.0 : qMin( start, 2 * M_PI - end );
+    }
+    else if ( start <= 0.0 && end >= 0.0 ) {
+        minimum = 0.0;
+        maximum = qMax( -start, end );
+    }
+    else {
+        minimum = qMin( qAbs( start ), qAbs( end ) );
+        maximum = qMax( qAbs( start ), qAbs( end ) );
+    }
+}
+
+inline void paintNightPixel( const Context &context, QRgb &pixel, const QRgb *nightPixel )
+{
+    if ( nightPixel ) {
+        pixel = *nightPixel;
+    }
+    else {
+        pixel = qRgb( context.nightChannel[qRed( pixel )],
+                      context.nightChannel[qGreen( pixel )],
+                      context.nightChannel[qBlue( pixel )] );
+    }
+}
+
+void paintRow( const Context &context, int y )
+{
+    const Row &row = context.rows[y];
+    const int tileWidth = context.tileImage->width();
+
+    QRgb *scanline = (QRgb *)context.tileImage->scanLine( y );
+    const QRgb *nightScanline = context.nightImage ? (const QRgb *)context.nightImage->scanLine( y ) : 0;
+
+    if ( row.coverage == Night ) {
+        for ( int x = 0; x < tileWidth; ++x ) {
+            paintNightPixel( context, scanline[x], nightScanline ? nightScanline + x : 0 );
+        }
+        return;
+    }
+
+    for ( int x = 0; x < tileWidth; ++x ) {
+        qreal distance = context.startDistance + x * context.lonScale;
+        if ( distance >= M_PI )
+            distance -= 2 * M_PI;
+        distance = qAbs( distance );
+
+        if ( row.isDay( distance ) )
+            continue;
+
+        if ( row.isNight( distance ) ) {
+            paintNightPixel( context, scanline[x], nightScanline ? nightScanline + x : 0 );
+            continue;
+        }
+
+        const qreal lon = context.lonScale * ( context.tileX * tileWidth + x );
+        const qreal shade = context.sunLocator->shading( lon, row.a, row.c );
+        if ( nightScanline ) {
+            context.sunLocator->shadePixelComposite( scanline[x], nightScanline[x], shade );
+        }
+        else {
+            context.sunLocator->shadePixel( scanline[x], shade );
+        }
+    }
+}
+
+void paintRows( const Context &context, int begin, int end )
+{
+    for ( int i = begin; i < end; ++i ) {
+        paintRow( context, context.paintedRows[i] );
+    }
+}
+
+class SunShadingJob : public QRunnable
+{
+ public:
+    SunShadingJob( const Context *context, int begin, int end, QSemaphore *finished )
+        : m_context( context ),
+          m_begin( begin ),
+          m_end( end ),
+          m_finished( finished )
+    {
+    }
+
+    virtual void run()
+    {
+        paintRows( *m_context, m_begin, m_end );
+        m_finished->release();
+    }
+
+ private:
+    const Context *const m_context;
+    const int m_begin;
+    const int m_end;
+    QSemaphore *const m_finished;
+};
+
+}
+
+SunShading::SunShading( const SunLocator *sunLocator )
+    : m_sunLocator( sunLocator ),
+      m_nightChannel( 256 )
+{
+    // the same truncation as in SunLocator::shadePixel()
+    for ( int i = 0; i < 256; ++i ) {
+        m_nightChannel[i] = uchar( int( i * 0.35 ) );
+    }
+}
+
+void SunShading::shade( QImage *tileImage, const TileId &id, int levelZeroColumns, int levelZeroRows ) const
+{
+    paint( tileImage, 0, id, levelZeroColumns, levelZeroRows );
+}
+
+void SunShading::composite( QImage *tileImage, const QImage &nightImage, const TileId &id,
+                            int levelZeroColumns, int levelZeroRows ) const
+{
+    paint( tileImage, &nightImage, id, levelZeroColumns, levelZeroRows );
+}
+
+void SunShading::paint( QImage *tileImage, const QImage *nightImage, const TileId &id,
+                        int levelZeroColumns, int levelZeroRows ) const
+{
+    if ( tileImage->depth() != 32 )
+        return;
+
+    // TODO add support for 8-bit maps?
+    const int tileHeight = tileImage->height();
+    const int tileWidth = tileImage->width();
+    const qreal global_width = tileWidth
+            * TileLoaderHelper::levelToColumn( levelZeroColumns, id.zoomLevel() );
+    const qreal global_height = tileHeight
+            * TileLoaderHelper::levelToRow( levelZeroRows, id.zoomLevel() );
+    const qreal lon_scale = 2*M_PI / global_width;
+    const qreal lat_scale = -M_PI / global_height;
+
+    const qreal sunLon = DEG2RAD * m_sunLocator->getLon();
+    const qreal sunLat = DEG2RAD * m_sunLocator->getLat();
+
+    // the values of the haversine at which the twilight zone begins and ends
+    const qreal twilightZone = m_sunLocator->twilightZone();
+    const qreal dayEnd = 0.5 - twilightZone / 2.0;
+    const qreal nightBegin = 0.5 + twilightZone / 2.0;
+
+    Context context;
+    context.sunLocator = m_sunLocator;
+    context.nightChannel = m_nightChannel.constData();
+    context.tileImage = tileImage;
+    context.nightImage = nightImage;
+    context.rows.resize( tileHeight );
+    context.tileX = id.x();
+    context.lonScale = lon_scale;
+    context.startDistance = wrappedDistance( lon_scale * ( id.x() * tileWidth ) - sunLon );
+
+    qreal minimumDistance;
+    qreal maximumDistance;
+    distanceRange( context.startDistance, ( tileWidth - 1 ) * lon_scale, minimumDistance, maximumDistance );
+
+    for ( int y = 0; y < tileHeight; ++y ) {
+        Row &row = context.rows[y];
+
+        const qreal lat = lat_scale * ( id.y() * tileHeight + y ) - 0.5*M_PI;
+        row.a = sin( ( lat + sunLat ) / 2.0 );
+        row.c = cos( lat ) * cos( -sunLat );
+
+        // solve h = a² + c * sin²(distance/2) for the distance
+        const qreal aa = row.a * row.a;
+        if ( row.c == 0.0 ) {
+            row.dayIsNear = true;
+            row.dayLimit = aa <= dayEnd ? 4.0 : -1.0;
+            row.nightLimit = aa >= nightBegin ? -1.0 : 4.0;
+        }
+        else {
+            row.dayIsNear = row.c > 0.0;
+            row.dayLimit = haversineDistance( ( dayEnd - aa ) / row.c );
+            row.nightLimit = haversineDistance( ( nightBegin - aa ) / row.c );
+        }
+
+        if ( row.isDay( minimumDistance ) && row.isDay( maximumDistance ) ) {
+            row.coverage = Day;
+            continue;
+        }
+
+        row.coverage = row.isNight( minimumDistance ) && row.isNight( maximumDistance ) ? Night : Twilight;
+        context.paintedRows.append( y );
+    }
+
+    // the tile is on the day side entirely
+    if ( context.paintedRows.isEmpty() )
+        return;
+
+    const int rowCount = context.paintedRows.size();
+    const int bandCount = qBound( 1, rowCount / minimumBandHeight, bandThreadPool()->maxThreadCount() + 1 );
+
+    // The calling thread paints the first band itself. Waiting for the other bands
+    // instead of the whole pool allows painting several tiles at the same time.
+    QSemaphore finished;
+    for ( int i = 1; i < bandCount; ++i ) {
+        bandThreadPool()->start( new SunShadingJob( &context, i * rowCount / bandCount,
+                                               ( i + 1 ) * rowCount / bandCount, &finished ) );
+    }
+
+    paintRows( context, 0, rowCount / bandCount );
+    finished.acquire( bandCount - 1 );
+}
+
+}
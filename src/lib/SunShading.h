@@ -0,0 +1,65 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SUNSHADING_H
+#define MARBLE_SUNSHADING_H
+
+#include <QVector>
+
+class QImage;
+
+namespace Marble
+{
+
+class SunLocator;
+class TileId;
+
+/**
+ * @short Paints the day and night sides of the planet onto texture tiles.
+ *
+ * Along a scanline the brightness only depends on the distance to the longitude
+ * of the sun. Instead of evaluating SunLocator::shading() for every pixel, the
+ * distances at which the twilight zone begins and ends are solved for once per
+ * scanline. Pixels on the day side are left alone, pixels on the night side are
+ * darkened through a lookup table, and only pixels inside the twilight zone need
+ * the shading to be evaluated. Tiles which are entirely on the day side are
+ * skipped.
+ *
+ * Tiles with enough scanlines to paint are split into bands which are painted
+ * in parallel, by a thread pool shared by all instances.
+ */
+class SunShading
+{
+ public:
+    explicit SunShading( const SunLocator *sunLocator );
+
+    /**
+     * Darkens the night side of @p tileImage, which is the tile @p id.
+     */
+    void shade( QImage *tileImage, const TileId &id, int levelZeroColumns, int levelZeroRows ) const;
+
+    /**
+     * Replaces the night side of @p tileImage by @p nightImage (e.g. city lights)
+     * and blends both images inside the twilight zone.
+     */
+    void composite( QImage *tileImage, const QImage &nightImage, const TileId &id,
+                    int levelZeroColumns, int levelZeroRows ) const;
+
+ private:
+    Q_DISABLE_COPY( SunShading )
+
+    void paint( QImage *tileImage, const QImage *nightImage, const TileId &id,
+                int levelZeroColumns, int levelZeroRows ) const;
+
+    const SunLocator *const m_sunLocator;
+    QVector<uchar> m_nightChannel;
+};
+
+}
+
+#endif
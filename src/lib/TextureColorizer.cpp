@@ -22,6 +22,9 @@
 #include <QColor>
 #include <QImage>
 #include <QPainter>
+#include <QRegion>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "MarbleGlobal.h"
 #include "GeoPainter.h"
@@ -30,10 +33,13 @@
 #include "ViewParams.h"
 #include "ViewportParams.h"
 #include "MathHelper.h"
+#include "MarbleMath.h"
 #include "GeoDataFeature.h"
 #include "GeoDataTypes.h"
 #include "GeoDataPlacemark.h"
 #include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPolygon.h"
 
 namespace Marble
 {
@@ -67,11 +73,71 @@ private:
     uchar  x4;
 };
 
+// Calculates the range of the row y which is covered by the globe.
+static void globeRowSpan( int y, int imgwidth, int imgheight, qint64 radius, int &xLeft, int &xRight )
+{
+    const int  imgrx = imgwidth / 2;
+    const int  dy = imgheight / 2 - y;
+    const int  rx = (int)sqrt( (qreal)( radius * radius - dy * dy ) );
+
+    xLeft  = 0;
+    xRight = imgwidth;
+
+    if ( imgrx-rx > 0 ) {
+        xLeft  = imgrx - rx;
+        xRight = imgrx + rx;
+    }
+}
+
+class TextureColorizer::ColorizeJob : public QRunnable
+{
+public:
+    ColorizeJob( const TextureColorizer *colorizer, QImage *origimg, int yTop, int yBottom,
+                 const EmbossFifo &emboss, qint64 radius, bool coversImage )
+        : m_colorizer( colorizer ),
+          m_origimg( origimg ),
+          m_yTop( yTop ),
+          m_yBottom( yBottom ),
+          m_emboss( emboss ),
+          m_radius( radius ),
+          m_coversImage( coversImage )
+    {}
+
+    virtual void run()
+    {
+        m_colorizer->colorizeRows( m_origimg, m_yTop, m_yBottom, m_emboss, m_radius, m_coversImage );
+    }
+
+private:
+    const TextureColorizer *const m_colorizer;
+    QImage *const m_origimg;
+    const int m_yTop;
+    const int m_yBottom;
+    const EmbossFifo m_emboss;
+    const qint64 m_radius;
+    const bool m_coversImage;
+};
+
+bool TextureColorizer::CoastImageState::operator==( const CoastImageState &other ) const
+{
+    return size == other.size
+        && projection == other.projection
+        && radius == other.radius
+        && mapQuality == other.mapQuality
+        && textureMapRevision == other.textureMapRevision
+        && visibleSeaDocuments == other.visibleSeaDocuments
+        && visibleLandDocuments == other.visibleLandDocuments
+        && documentRevisions == other.documentRevisions;
+}
+
 
 TextureColorizer::TextureColorizer( const QString &seafile,
                                     const QString &landfile,
                                     VectorComposer *veccomposer )
     : m_veccomposer( veccomposer ),
+      m_coastImageCenterLongitude( 0.0 ),
+      m_coastImageCenterLatitude( 0.0 ),
+      m_coastImageValid( false ),
       m_landColor(qRgb( 255, 0, 0 ) ),
       m_seaColor( qRgb( 0, 255, 0 ) )
 {
@@ -152,11 +218,13 @@ TextureColorizer::TextureColorizer( const QString &seafile,
 void TextureColorizer::addSeaDocument( const GeoDataDocument *seaDocument )
 {
     m_seaDocuments.append( seaDocument );
+    m_coastImageValid = false;
 }
 
 void TextureColorizer::addLandDocument( const GeoDataDocument *landDocument )
 {
     m_landDocuments.append( landDocument );
+    m_coastImageValid = false;
 }
 
 void TextureColorizer::setShowRelief( bool show )
@@ -210,6 +278,33 @@ void TextureColorizer::drawIndividualDocument( GeoPainter *painter, const GeoDat
     }
 }
 
+void TextureColorizer::appendRevisions( const GeoDataDocument *document, QVector<quint64> &revisions )
+{
+    QVector<GeoDataFeature*>::ConstIterator i = document->constBegin();
+    QVector<GeoDataFeature*>::ConstIterator end = document->constEnd();
+
+    for ( ; i != end; ++i ) {
+        if ( (*i)->nodeType() != GeoDataTypes::GeoDataPlacemarkType ) {
+            continue;
+        }
+
+        const GeoDataGeometry *geometry = static_cast<const GeoDataPlacemark*>( *i )->geometry();
+
+        if ( geometry->nodeType() == GeoDataTypes::GeoDataLineStringType
+             || geometry->nodeType() == GeoDataTypes::GeoDataLinearRingType ) {
+            revisions.append( static_cast<const GeoDataLineString*>( geometry )->revision() );
+        }
+
+        if ( geometry->nodeType() == GeoDataTypes::GeoDataPolygonType ) {
+            const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon*>( geometry );
+            revisions.append( polygon->outerBoundary().revision() );
+            foreach ( const GeoDataLinearRing &ring, polygon->innerBoundaries() ) {
+                revisions.append( ring.revision() );
+            }
+        }
+    }
+}
+
 void TextureColorizer::drawTextureMap( GeoPainter *painter )
 {
     foreach( const GeoDataDocument *doc, m_landDocuments ) {
@@ -227,25 +322,117 @@ void TextureColorizer::drawTextureMap( GeoPainter *painter )
     }
 }
 
-void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality )
+void TextureColorizer::updateCoastImage( const ViewportParams *viewport, MapQuality mapQuality )
+{
+    CoastImageState state;
+    state.size = viewport->size();
+    state.projection = viewport->projection();
+    state.radius = viewport->radius();
+    state.mapQuality = mapQuality;
+    state.textureMapRevision = m_veccomposer->textureMapRevision();
+    foreach ( const GeoDataDocument *doc, m_seaDocuments ) {
+        state.visibleSeaDocuments.append( doc->isVisible() );
+        appendRevisions( doc, state.documentRevisions );
+    }
+    foreach ( const GeoDataDocument *doc, m_landDocuments ) {
+        state.visibleLandDocuments.append( doc->isVisible() );
+        appendRevisions( doc, state.documentRevisions );
+    }
+
+    const QRect imageRect( QPoint( 0, 0 ), viewport->size() );
+    QPoint offset;
+
+    if ( m_coastImageValid && state == m_coastImageState
+         && coastImageOffset( viewport, offset ) )
+    {
+        // e.g. only the texture changed since the last frame
+        if ( offset.isNull() )
+            return;
+
+        // Move what is still visible and draw the strips that came into view.
+        QImage translated( m_coastImage.size(), QImage::Format_RGB32 );
+        translated.fill( QColor( 0, 0, 255, 0).rgb() );
+
+        QPainter painter( &translated );
+        painter.setCompositionMode( QPainter::CompositionMode_Source );
+        painter.drawImage( offset, m_coastImage );
+        painter.end();
+
+        m_coastImage = translated;
+        drawCoastImage( viewport, mapQuality,
+                        QRegion( imageRect ).subtracted( QRegion( imageRect.translated( offset ) ) ) );
+    }
+    else {
+        if ( m_coastImage.size() != viewport->size() )
+            m_coastImage = QImage( viewport->size(), QImage::Format_RGB32 );
+
+        m_coastImage.fill( QColor( 0, 0, 255, 0).rgb() );
+        drawCoastImage( viewport, mapQuality, QRegion( imageRect ) );
+    }
+
+    m_coastImageState = state;
+    m_coastImageCenterLongitude = viewport->centerLongitude();
+    m_coastImageCenterLatitude = viewport->centerLatitude();
+    m_coastImageValid = true;
+}
+
+bool TextureColorizer::coastImageOffset( const ViewportParams *viewport, QPoint &offset ) const
 {
-    if ( m_coastImage.size() != viewport->size() )
-        m_coastImage = QImage( viewport->size(), QImage::Format_RGB32 );
+    const qreal centerLon = viewport->centerLongitude();
+    const qreal centerLat = viewport->centerLatitude();
 
-    // update coast image
-    m_coastImage.fill( QColor( 0, 0, 255, 0).rgb() );
+    if ( centerLon == m_coastImageCenterLongitude && centerLat == m_coastImageCenterLatitude ) {
+        offset = QPoint( 0, 0 );
+        return true;
+    }
 
+    // On the globe a new center rotates the image.
+    if ( viewport->projection() != Equirectangular && viewport->projection() != Mercator )
+        return false;
+
+    const qreal rad2Pixel = 2.0 * viewport->radius() / M_PI;
+
+    // The map repeats horizontally, so take the shortest way around.
+    qreal lonDelta = m_coastImageCenterLongitude - centerLon;
+    if ( lonDelta > M_PI )
+        lonDelta -= 2 * M_PI;
+    else if ( lonDelta <= -M_PI )
+        lonDelta += 2 * M_PI;
+
+    const qreal dx = lonDelta * rad2Pixel;
+    const qreal dy = viewport->projection() == Equirectangular
+                   ? ( centerLat - m_coastImageCenterLatitude ) * rad2Pixel
+                   : ( gdInv( centerLat ) - gdInv( m_coastImageCenterLatitude ) ) * rad2Pixel;
+
+    // Anything else than whole pixels would move the edges of the coast lines.
+    if ( qAbs( dx - qRound( dx ) ) > 0.01 || qAbs( dy - qRound( dy ) ) > 0.01 )
+        return false;
+
+    offset = QPoint( qRound( dx ), qRound( dy ) );
+
+    return qAbs( offset.x() ) < viewport->width() && qAbs( offset.y() ) < viewport->height();
+}
+
+void TextureColorizer::drawCoastImage( const ViewportParams *viewport, MapQuality mapQuality,
+                                       const QRegion &region )
+{
     const bool antialiased =    mapQuality == HighQuality
                              || mapQuality == PrintQuality;
 
     GeoPainter painter( &m_coastImage, viewport, mapQuality );
     painter.setRenderHint( QPainter::Antialiasing, antialiased );
+    painter.setClipRegion( region );
 
     if ( m_landDocuments.isEmpty() ) {
         m_veccomposer->drawTextureMap( &painter, viewport );
     } else {
         drawTextureMap( &painter );
     }
+}
+
+void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality, QThreadPool *threadPool )
+{
+    updateCoastImage( viewport, mapQuality );
 
     const qint64   radius   = viewport->radius();
 
@@ -256,14 +443,15 @@ void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport
     // This variable is not used anywhere..
     const int  imgradius = imgrx * imgrx + imgry * imgry;
 
-    int     bump = 8;
+    int yTop = 0;
+    int yBottom = imgheight;
+    bool coversImage = false;
 
     if ( radius * radius > imgradius
          || viewport->projection() == Equirectangular
          || viewport->projection() == Mercator )
     {
-        int yTop = 0;
-        int yBottom = imgheight;
+        coversImage = true;
 
         if( viewport->projection() == Equirectangular
             || viewport->projection() == Mercator )
@@ -283,82 +471,108 @@ void TextureColorizer::colorize( QImage *origimg, const ViewportParams *viewport
                 yBottom = ( imgry + 2 * radius + yCenterOffset > imgheight )? imgheight : imgry + 2 * radius + yCenterOffset;
             }
         }
+    }
+    else {
+        yTop    = ( imgry-radius < 0 ) ? 0 : imgry-radius;
+        yBottom = ( yTop == 0 ) ? imgheight : imgry + radius;
+    }
 
-        const int itEnd = yBottom;
-
-        for (int y = yTop; y < itEnd; ++y) {
-
-            QRgb  *writeData         = (QRgb*)( origimg->scanLine( y ) );
-            const QRgb  *coastData   = (QRgb*)( m_coastImage.scanLine( y ) );
-
-            uchar *readDataStart     = origimg->scanLine( y );
-            const uchar *readDataEnd = readDataStart + imgwidth*4;
-
-            EmbossFifo  emboss;
+    if ( !threadPool || yBottom - yTop < 2 ) {
+        colorizeRows( origimg, yTop, yBottom, EmbossFifo(), radius, coversImage );
+        return;
+    }
 
-            for ( uchar* readData = readDataStart; 
-                  readData < readDataEnd;
-                  readData += 4, ++writeData, ++coastData )
-            {
+    const int numThreads = qMin( threadPool->maxThreadCount(), yBottom - yTop );
 
-                // Cheap Emboss / Bumpmapping
-                uchar&  grey = *readData; // qBlue(*data);
+    // On the globe the emboss filter runs across row boundaries. The state it
+    // starts each band with is taken before any band changes the image.
+    QList<ColorizeJob *> jobs;
+    for ( int i = 0; i < numThreads; ++i ) {
+        const int yStart = yTop + i * ( yBottom - yTop ) / numThreads;
+        const int yEnd   = yTop + ( i + 1 ) * ( yBottom - yTop ) / numThreads;
+        const EmbossFifo emboss = coversImage ? EmbossFifo() : embossFifo( origimg, yStart, yTop, radius );
+        jobs << new ColorizeJob( this, origimg, yStart, yEnd, emboss, radius, coversImage );
+    }
 
-                if ( m_showRelief ) {
-                    emboss << grey;
-                    bump = ( emboss.head() + 8 - grey );
-                    if ( bump  < 0 )  bump = 0;
-                    if ( bump  > 15 ) bump = 15;
-                }
-                setPixel( coastData, writeData, bump, grey );
-            }
-        }
+    foreach ( ColorizeJob *job, jobs ) {
+        threadPool->start( job );
     }
-    else {
-        int yTop    = ( imgry-radius < 0 ) ? 0 : imgry-radius;
-        const int yBottom = ( yTop == 0 ) ? imgheight : imgry + radius;
 
-        EmbossFifo  emboss;
+    threadPool->waitForDone();
+}
 
-        for ( int y = yTop; y < yBottom; ++y ) {
-            const int  dy = imgry - y;
-            int  rx = (int)sqrt( (qreal)( radius * radius - dy * dy ) );
-            int  xLeft  = 0; 
-            int  xRight = imgwidth;
+void TextureColorizer::colorizeRows( QImage *origimg, int yTop, int yBottom, const EmbossFifo &fifo,
+                                     qint64 radius, bool coversImage ) const
+{
+    const int  imgheight = origimg->height();
+    const int  imgwidth  = origimg->width();
 
-            if ( imgrx-rx > 0 ) {
-                xLeft  = imgrx - rx; 
-                xRight = imgrx + rx;
-            }
+    int     bump = 8;
 
-            QRgb  *writeData         = (QRgb*)( origimg->scanLine( y ) )  + xLeft;
-            const QRgb *coastData    = (QRgb*)( m_coastImage.scanLine( y ) ) + xLeft;
+    EmbossFifo  emboss = fifo;
 
-            uchar *readDataStart     = origimg->scanLine( y ) + xLeft * 4;
-            const uchar *readDataEnd = origimg->scanLine( y ) + xRight * 4;
+    for ( int y = yTop; y < yBottom; ++y ) {
+        int  xLeft  = 0;
+        int  xRight = imgwidth;
 
- 
-            for ( uchar* readData = readDataStart;
-                  readData < readDataEnd;
-                  readData += 4, ++writeData, ++coastData )
-            {
-                // Cheap Emboss / Bumpmapping
+        if ( coversImage ) {
+            emboss = EmbossFifo();
+        }
+        else {
+            globeRowSpan( y, imgwidth, imgheight, radius, xLeft, xRight );
+        }
 
-                uchar& grey = *readData; // qBlue(*data);
+        QRgb  *writeData         = (QRgb*)( origimg->scanLine( y ) ) + xLeft;
+        const QRgb *coastData    = (const QRgb*)( m_coastImage.scanLine( y ) ) + xLeft;
+        const QRgb *writeDataEnd = writeData + ( xRight - xLeft );
 
-                if ( m_showRelief ) {
-                    emboss << grey;
+        for ( ; writeData < writeDataEnd; ++writeData, ++coastData )
+        {
+            // Cheap Emboss / Bumpmapping
+            const uchar grey = *(const uchar*)writeData; // qBlue(*data);
+
+            if ( m_showRelief ) {
+                emboss << grey;
+                if ( coversImage ) {
+                    bump = ( emboss.head() + 8 - grey );
+                }
+                else {
                     bump = ( emboss.head() + 16 - grey ) >> 1;
-                    if ( bump > 15 ) bump = 15;
-                    if ( bump < 0 )  bump = 0;
                 }
-                setPixel( coastData, writeData, bump, grey );
+                if ( bump  < 0 )  bump = 0;
+                if ( bump  > 15 ) bump = 15;
             }
+            setPixel( coastData, writeData, bump, grey );
         }
     }
 }
 
-void TextureColorizer::setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey )
+EmbossFifo TextureColorizer::embossFifo( const QImage *origimg, int y, int yTop, qint64 radius ) const
+{
+    // the last four grey values the emboss filter has seen before row y, latest first
+    uchar greys[4];
+    int count = 0;
+
+    for ( int row = y - 1; row >= yTop && count < 4; --row ) {
+        int xLeft;
+        int xRight;
+        globeRowSpan( row, origimg->width(), origimg->height(), radius, xLeft, xRight );
+
+        const uchar *readData = origimg->scanLine( row );
+        for ( int x = xRight - 1; x >= xLeft && count < 4; --x ) {
+            greys[count++] = readData[4 * x];
+        }
+    }
+
+    EmbossFifo result;
+    while ( count > 0 ) {
+        result << greys[--count];
+    }
+
+    return result;
+}
+
+void TextureColorizer::setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey ) const
 {
     int alpha = qRed( *coastData );
     if ( alpha == 255 )
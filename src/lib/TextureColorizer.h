@@ -24,10 +24,15 @@
 #include <QImage>
 #include <QPen>
 #include <QBrush>
+#include <QVector>
+
+class QRegion;
+class QThreadPool;
 
 namespace Marble
 {
 
+class EmbossFifo;
 class VectorComposer;
 class ViewportParams;
 
@@ -50,15 +55,68 @@ class TextureColorizer
 
     void drawTextureMap( GeoPainter *painter );
 
-    void colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality );
+    /**
+     * Colorizes the gray scale image @p origimg. If @p threadPool is given, the
+     * image is split into bands of rows which are colorized on its threads.
+     */
+    void colorize( QImage *origimg, const ViewportParams *viewport, MapQuality mapQuality,
+                   QThreadPool *threadPool = 0 );
 
-    void setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey );
+    void setPixel( const QRgb *coastData, QRgb *writeData, int bump, uchar grey ) const;
 
  private:
+    class ColorizeJob;
+
+    /**
+     * The parameters the coast image was drawn with. The coast image is kept
+     * between frames as long as these don't change. If only the center moved,
+     * the flat projections translate the image instead of drawing it again.
+     */
+    struct CoastImageState
+    {
+        bool operator==( const CoastImageState &other ) const;
+
+        QSize size;
+        Projection projection;
+        int radius;
+        MapQuality mapQuality;
+        int textureMapRevision;
+        QVector<bool> visibleSeaDocuments;
+        QVector<bool> visibleLandDocuments;
+        QVector<quint64> documentRevisions;
+    };
+
+    /**
+     * Appends the revisions of the coast lines in @p document to @p revisions,
+     * which change whenever a coast line or the number of them changes.
+     */
+    static void appendRevisions( const GeoDataDocument *document, QVector<quint64> &revisions );
+
+    void updateCoastImage( const ViewportParams *viewport, MapQuality mapQuality );
+
+    /**
+     * Calculates by how many pixels the coast image moves if the map is
+     * centered on @p viewport instead of the center the image was drawn for.
+     * Returns false if the image can't be translated by whole pixels.
+     */
+    bool coastImageOffset( const ViewportParams *viewport, QPoint &offset ) const;
+
+    void drawCoastImage( const ViewportParams *viewport, MapQuality mapQuality,
+                         const QRegion &region );
+
+    void colorizeRows( QImage *origimg, int yTop, int yBottom, const EmbossFifo &emboss,
+                       qint64 radius, bool coversImage ) const;
+
+    EmbossFifo embossFifo( const QImage *origimg, int y, int yTop, qint64 radius ) const;
+
     VectorComposer *const m_veccomposer;
     QList<const GeoDataDocument*> m_seaDocuments;
     QList<const GeoDataDocument*> m_landDocuments;
     QImage m_coastImage;
+    CoastImageState m_coastImageState;
+    qreal m_coastImageCenterLongitude;
+    qreal m_coastImageCenterLatitude;
+    bool m_coastImageValid;
     uint texturepalette[16][512];
     bool m_showRelief;
     QRgb      m_landColor;
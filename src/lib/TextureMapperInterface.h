@@ -38,6 +38,13 @@ public:
 
     void setRepaintNeeded();
 
+    /**
+     * Notifies the mapper that the viewport changed while the textures stayed
+     * the same. By default this requests a full repaint, mappers which can
+     * update their previous frame incrementally check the viewport themselves.
+     */
+    virtual void setViewportChanged();
+
 protected:
     bool m_repaintNeeded;
 };
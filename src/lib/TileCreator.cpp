@@ -22,6 +22,9 @@
 #include <QImage>
 #include <QImageReader>
 #include <QPainter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 
 #include "MarbleGlobal.h"
 #include "MarbleDirs.h"
@@ -42,7 +45,10 @@ class TileCreatorPrivate
          m_tileFormat( "jpg" ),
          m_resume( false ),
          m_verify( false ),
-         m_source( source )
+         m_threadCount( 0 ),
+         m_source( source ),
+         m_createdTilesCount( 0 ),
+         m_handledTilesCount( 0 )
      {
         if ( m_dem == "true" ) {
             m_tileQuality = 70;
@@ -53,10 +59,49 @@ class TileCreatorPrivate
 
     ~TileCreatorPrivate()
     {
+        m_threadPool.waitForDone();
         delete m_source;
     }
 
+    QString tileName( int tileLevel, int n, int m ) const;
+
+    /**
+     * The number of threads encoding the tiles, one per processor core
+     * unless m_threadCount is set.
+     */
+    int threadCount() const;
+
+    /**
+     * Whether a tile couldn't be written or read back, which stops the
+     * tile creation.
+     */
+    bool failed() const;
+
+    /**
+     * Encodes and writes the tile on the thread pool. Blocks while too many
+     * tiles are waiting for being written, which bounds the memory used.
+     */
+    void saveTileAsync( const QImage &tile, const QString &tileName );
+    void saveTile( const QImage &tile, const QString &tileName );
+
+    /**
+     * Hands a finished tile to the tile one level up which covers it. The
+     * tiles of the lower levels are built in memory from the tiles of the
+     * level above, one row of tiles per level at a time.
+     *
+     * A null @p tile denotes a tile which has been written before and which
+     * is only read back if its parent needs to be built.
+     */
+    void tileCompleted( int tileLevel, int n, int m, QImage tile );
+
  public:
+    struct PyramidRow
+    {
+        QVector<QImage> tiles;
+        QVector<int> quadrants;
+        QVector<bool> build;
+    };
+
     QString  m_dem;
     QString  m_targetDir;
     bool     m_cancelled;
@@ -64,10 +109,184 @@ class TileCreatorPrivate
     int      m_tileQuality;
     bool     m_resume;
     bool     m_verify;
+    int      m_threadCount;
 
     TileCreatorSource  *m_source;
+
+    QVector<QRgb> m_grayScalePalette;
+    QVector<PyramidRow> m_pyramid;
+
+    QThreadPool m_threadPool;
+    QSemaphore m_jobSlots;
+    QAtomicInt m_createdTilesCount;
+    QAtomicInt m_failedTilesCount;
+    int m_handledTilesCount;
+};
+
+class TileCreatorSaveJob : public QRunnable
+{
+ public:
+    TileCreatorSaveJob( TileCreatorPrivate *creator, const QImage &tile, const QString &tileName )
+        : m_creator( creator ),
+          m_tile( tile ),
+          m_tileName( tileName )
+    {
+    }
+
+    virtual void run()
+    {
+        if ( !m_creator->m_cancelled ) {
+            m_creator->saveTile( m_tile, m_tileName );
+        }
+
+        m_creator->m_jobSlots.release();
+    }
+
+ private:
+    TileCreatorPrivate *const m_creator;
+    const QImage m_tile;
+    const QString m_tileName;
 };
 
+QString TileCreatorPrivate::tileName( int tileLevel, int n, int m ) const
+{
+    return m_targetDir + ( QString("%1/%2/%2_%3.%4")
+                           .arg( tileLevel )
+                           .arg( n, tileDigits, 10, QChar('0') )
+                           .arg( m, tileDigits, 10, QChar('0') ) )
+                           .arg( m_tileFormat );
+}
+
+int TileCreatorPrivate::threadCount() const
+{
+    return m_threadCount > 0 ? m_threadCount : qMax( 1, QThread::idealThreadCount() );
+}
+
+bool TileCreatorPrivate::failed() const
+{
+    return m_failedTilesCount > 0;
+}
+
+void TileCreatorPrivate::saveTileAsync( const QImage &tile, const QString &tileName )
+{
+    m_jobSlots.acquire();
+    m_threadPool.start( new TileCreatorSaveJob( this, tile, tileName ) );
+}
+
+void TileCreatorPrivate::saveTile( const QImage &tile, const QString &tileName )
+{
+    bool  ok = tile.save( tileName, m_tileFormat.toLatin1().data(), m_tileQuality );
+    if ( !ok ) {
+        mDebug() << "Error while writing Tile: " << tileName;
+        m_failedTilesCount.ref();
+        return;
+    }
+
+    m_createdTilesCount.ref();
+
+    if ( m_verify ) {
+        QImage writtenTile(tileName);
+        Q_ASSERT( writtenTile.size() == tile.size() );
+        for ( int i=0; i < writtenTile.size().width(); ++i) {
+            for ( int j=0; j < writtenTile.size().height(); ++j) {
+                if ( writtenTile.pixel( i, j ) != tile.pixel( i, j ) ) {
+                    unsigned int  pixel = tile.pixel( i, j);
+                    unsigned int  writtenPixel = writtenTile.pixel( i, j);
+                    qWarning() << "***** pixel" << i << j << "is off by" << (pixel - writtenPixel) << "pixel" << pixel << "writtenPixel" << writtenPixel;
+                    QByteArray baPixel((char*)&pixel, sizeof(unsigned int));
+                    qWarning() << "pixel" << baPixel.size() << "0x" << baPixel.toHex();
+                    QByteArray baWrittenPixel((char*)&writtenPixel, sizeof(unsigned int));
+                    qWarning() << "writtenPixel" << baWrittenPixel.size() << "0x" << baWrittenPixel.toHex();
+                    Q_ASSERT(false);
+                }
+            }
+        }
+    }
+}
+
+void TileCreatorPrivate::tileCompleted( int tileLevel, int n, int m, QImage tile )
+{
+    ++m_handledTilesCount;
+
+    if ( tileLevel == 0 || failed() ) {
+        return;
+    }
+
+    PyramidRow &parentRow = m_pyramid[ tileLevel - 1 ];
+    const int parentM = m / 2;
+    const bool dem = ( m_dem == "true" );
+
+    if ( parentRow.quadrants[ parentM ] == 0 ) {
+        parentRow.build[ parentM ] = !( m_resume && QFile::exists( tileName( tileLevel - 1, n / 2, parentM ) ) );
+        if ( parentRow.build[ parentM ] ) {
+            QImage parent( c_defaultTileSize, c_defaultTileSize,
+                           dem ? QImage::Format_Indexed8 : QImage::Format_ARGB32 );
+            if ( dem ) {
+                parent.setColorTable( m_grayScalePalette );
+            }
+            parentRow.tiles[ parentM ] = parent;
+        }
+    }
+
+    if ( parentRow.build[ parentM ] ) {
+        if ( tile.isNull() ) {
+            // written by a previous run which got interrupted
+            tile = QImage( tileName( tileLevel, n, m ) );
+            if ( tile.size() != QSize( c_defaultTileSize, c_defaultTileSize ) ) {
+                mDebug() << "Tile write failure. Missing write permissions?";
+                m_failedTilesCount.ref();
+                return;
+            }
+        }
+
+        if ( !dem ) {
+            tile = tile.convertToFormat( QImage::Format_ARGB32 );
+        }
+
+        // Pick every other pixel of the tile into its quadrant of the parent
+        const QImage &child = tile;
+        QImage &parent = parentRow.tiles[ parentM ];
+        const uint half = c_defaultTileSize / 2;
+        const uint startX = ( m % 2 ) ? half : 0;
+        const uint endX = ( m % 2 ) ? c_defaultTileSize : half;
+        const uint startY = ( n % 2 ) ? half : 0;
+        const uint endY = ( n % 2 ) ? c_defaultTileSize : half;
+
+        if ( dem ) {
+            for ( uint y = startY; y < endY; ++y ) {
+                uchar* destLine = parent.scanLine( y );
+                const uchar* srcLine = child.scanLine( 2 * ( y - startY ) );
+                for ( uint x = startX; x < endX; ++x )
+                    destLine[x] = srcLine[ 2 * ( x - startX ) ];
+            }
+        }
+        else {
+            for ( uint y = startY; y < endY; ++y ) {
+                QRgb* destLine = (QRgb*) parent.scanLine( y );
+                const QRgb* srcLine = (const QRgb*) child.scanLine( 2 * ( y - startY ) );
+                for ( uint x = startX; x < endX; ++x )
+                    destLine[x] = srcLine[ 2 * ( x - startX ) ];
+            }
+        }
+    }
+
+    if ( ++parentRow.quadrants[ parentM ] < 4 ) {
+        return;
+    }
+
+    // all four tiles covered by the parent are done
+    QImage parent;
+    if ( parentRow.build[ parentM ] ) {
+        parent = parentRow.tiles[ parentM ];
+        saveTileAsync( parent, tileName( tileLevel - 1, n / 2, parentM ) );
+    }
+
+    parentRow.tiles[ parentM ] = QImage();
+    parentRow.quadrants[ parentM ] = 0;
+
+    tileCompleted( tileLevel - 1, n / 2, parentM, parent );
+}
+
 class TileCreatorSourceImage : public TileCreatorSource
 {
 public:
@@ -222,9 +441,9 @@ void TileCreator::run()
 
     mDebug() << "Installing tiles to: " << d->m_targetDir;
 
-    QVector<QRgb> grayScalePalette;
+    d->m_grayScalePalette.clear();
     for ( int cnt = 0; cnt <= 255; ++cnt ) {
-        grayScalePalette.insert(cnt, qRgb(cnt, cnt, cnt));
+        d->m_grayScalePalette.insert(cnt, qRgb(cnt, cnt, cnt));
     }
 
     QSize fullImageSize = d->m_source->fullImageSize();
@@ -259,58 +478,71 @@ void TileCreator::run()
         ( QDir::root() ).mkpath( d->m_targetDir );
 
     // Counting total amount of tiles to be generated for the progressbar
-    // to prevent compiler warnings this var should
-    // match the type of maxTileLevel
+    // and creating the directory structure for all levels in advance, so
+    // that the tiles can be written from any thread.
+    d->m_pyramid.clear();
+    d->m_pyramid.resize( qMax( 0, maxTileLevel ) );
+
     int  tileLevel      = 0;
     int  totalTileCount = 0;
 
     while ( tileLevel <= maxTileLevel ) {
-        totalTileCount += ( TileLoaderHelper::levelToRow( defaultLevelZeroRows, tileLevel )
-                            * TileLoaderHelper::levelToColumn( defaultLevelZeroColumns, tileLevel ) );
+        int  nmaxit = TileLoaderHelper::levelToRow( defaultLevelZeroRows, tileLevel );
+        int  mmaxit = TileLoaderHelper::levelToColumn( defaultLevelZeroColumns, tileLevel );
+        totalTileCount += nmaxit * mmaxit;
+
+        for ( int n = 0; n < nmaxit; ++n ) {
+            QString dirName( d->m_targetDir
+                             + QString("%1/%2").arg(tileLevel).arg( n, tileDigits, 10, QChar('0') ) );
+            if ( !QDir( dirName ).exists() )
+                ( QDir::root() ).mkpath( dirName );
+        }
+
+        if ( tileLevel < maxTileLevel ) {
+            d->m_pyramid[tileLevel].tiles.resize( mmaxit );
+            d->m_pyramid[tileLevel].quadrants.fill( 0, mmaxit );
+            d->m_pyramid[tileLevel].build.fill( false, mmaxit );
+        }
+
         tileLevel++;
     }
 
     mDebug() << totalTileCount << " tiles to be created in total.";
 
+    const int threadCount = d->threadCount();
+    const int maxPendingTiles = 4 * threadCount;
+    d->m_threadPool.setMaxThreadCount( threadCount );
+    d->m_jobSlots.release( maxPendingTiles );
+    d->m_createdTilesCount = 0;
+    d->m_failedTilesCount = 0;
+    d->m_handledTilesCount = 0;
+
+    mDebug() << "Encoding tiles using" << threadCount << "threads";
+
     int  mmax = TileLoaderHelper::levelToColumn( defaultLevelZeroColumns, maxTileLevel );
     int  nmax = TileLoaderHelper::levelToRow( defaultLevelZeroRows, maxTileLevel );
 
-    // Loading each row at highest spatial resolution and cropping tiles
-    int      percentCompleted = 0;
-    int      createdTilesCount = 0;
-    QString  tileName;
-
-    // Creating directory structure for the highest level
-    QString  dirName( d->m_targetDir
-                      + QString("%1").arg(maxTileLevel) );
-    if ( !QDir( dirName ).exists() ) 
-        ( QDir::root() ).mkpath( dirName );
-
-    for ( int n = 0; n < nmax; ++n ) {
-        QString dirName( d->m_targetDir
-                         + QString("%1/%2").arg(maxTileLevel).arg( n, tileDigits, 10, QChar('0') ) );
-        if ( !QDir( dirName ).exists() ) 
-            ( QDir::root() ).mkpath( dirName );
-    }
+    // Loading each row at highest spatial resolution and cropping tiles.
+    // The tiles are encoded on the thread pool while the next ones are read,
+    // and the lower levels are built from them on the fly.
+    int  percentCompleted = 0;
+    bool readError = false;
 
-    for ( int n = 0; n < nmax; ++n ) {
+    for ( int n = 0; n < nmax && !d->m_cancelled && !d->failed() && !readError; ++n ) {
 
         for ( int m = 0; m < mmax; ++m ) {
 
             mDebug() << "** tile" << m << "x" << n;
 
-            if ( d->m_cancelled ) 
-                return;
+            if ( d->m_cancelled || d->failed() )
+                break;
 
-            tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                       .arg( maxTileLevel )
-                                       .arg( n, tileDigits, 10, QChar('0') )
-                                       .arg( m, tileDigits, 10, QChar('0') ) )
-                                       .arg( d->m_tileFormat );
+            QString tileName = d->tileName( maxTileLevel, n, m );
 
             if ( QFile::exists( tileName ) && d->m_resume ) {
 
                 //mDebug() << tileName << "exists already";
+                d->tileCompleted( maxTileLevel, n, m, QImage() );
 
             } else {
 
@@ -318,260 +550,46 @@ void TileCreator::run()
 
                 if ( tile.isNull() ) {
                     mDebug() << "Read-Error! Null QImage!";
-                    return;
+                    readError = true;
+                    break;
                 }
 
                 if ( d->m_dem == "true" ) {
                     tile = tile.convertToFormat(QImage::Format_Indexed8,
-                                                grayScalePalette,
+                                                d->m_grayScalePalette,
                                                 Qt::ThresholdDither);
                 }
 
-                bool  ok = tile.save( tileName, d->m_tileFormat.toLatin1().data(), d->m_tileFormat == "jpg" ? 100 : d->m_tileQuality );
-                if ( !ok )
-                    mDebug() << "Error while writing Tile: " << tileName;
-
-                mDebug() << tileName << "size" << QFile( tileName ).size();
-
-                if ( d->m_verify ) {
-                    QImage writtenTile(tileName);
-                    Q_ASSERT( writtenTile.size() == tile.size() );
-                    for ( int i=0; i < writtenTile.size().width(); ++i) {
-                        for ( int j=0; j < writtenTile.size().height(); ++j) {
-                            if ( writtenTile.pixel( i, j ) != tile.pixel( i, j ) ) {
-                                unsigned int  pixel = tile.pixel( i, j);
-                                unsigned int  writtenPixel = writtenTile.pixel( i, j);
-                                qWarning() << "***** pixel" << i << j << "is off by" << (pixel - writtenPixel) << "pixel" << pixel << "writtenPixel" << writtenPixel;
-                                QByteArray baPixel((char*)&pixel, sizeof(unsigned int));
-                                qWarning() << "pixel" << baPixel.size() << "0x" << baPixel.toHex();
-                                QByteArray baWrittenPixel((char*)&writtenPixel, sizeof(unsigned int));
-                                qWarning() << "writtenPixel" << baWrittenPixel.size() << "0x" << baWrittenPixel.toHex();
-                                Q_ASSERT(false);
-                            }
-                        }
-                    }
-                }
-
+                d->saveTileAsync( tile, tileName );
+                d->tileCompleted( maxTileLevel, n, m, tile );
             }
 
-            percentCompleted =  (int) ( 90 * (qreal)(createdTilesCount) 
-                                        / (qreal)(totalTileCount) );	
-            createdTilesCount++;
-
-            mDebug() << "percentCompleted" << percentCompleted;
-            emit progress( percentCompleted );
-        }
-    }
-
-    mDebug() << "tileLevel: " << maxTileLevel << " successfully created.";
-
-    tileLevel = maxTileLevel;
-
-    // Now that we have the tiles at the highest resolution lets build
-    // them together four by four.
-
-    while( tileLevel > 0 ) {
-        tileLevel--;
-
-        int  nmaxit =  TileLoaderHelper::levelToRow( defaultLevelZeroRows, tileLevel );
-
-        for ( int n = 0; n < nmaxit; ++n ) {
-            QString  dirName( d->m_targetDir
-                              + ( QString("%1/%2")
-                                  .arg(tileLevel)
-                                  .arg( n, tileDigits, 10, QChar('0') ) ) );
-
-            // mDebug() << "dirName: " << dirName;
-            if ( !QDir( dirName ).exists() ) 
-                ( QDir::root() ).mkpath( dirName );
-
-            int   mmaxit = TileLoaderHelper::levelToColumn( defaultLevelZeroColumns, tileLevel );
-            for ( int m = 0; m < mmaxit; ++m ) {
-
-                if ( d->m_cancelled )
-                    return;
-
-                QString newTileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                           .arg( tileLevel )
-                                           .arg( n, tileDigits, 10, QChar('0') )
-                                           .arg( m, tileDigits, 10, QChar('0') ) )
-                                           .arg( d->m_tileFormat );
-
-                if ( QFile::exists( newTileName ) && d->m_resume ) {
-                    //mDebug() << newTileName << "exists already";
-                } else {
-                    tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                            .arg( tileLevel + 1 )
-                                            .arg( 2*n, tileDigits, 10, QChar('0') )
-                                            .arg( 2*m, tileDigits, 10, QChar('0') ) )
-                                            .arg( d->m_tileFormat );
-                    QImage  img_topleft( tileName );
-
-                    tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                            .arg( tileLevel + 1 )
-                                            .arg( 2*n, tileDigits, 10, QChar('0') )
-                                            .arg( 2*m+1, tileDigits, 10, QChar('0') ) )
-                                            .arg( d->m_tileFormat );
-                    QImage  img_topright( tileName );
-
-                    tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                            .arg( tileLevel + 1 )
-                                            .arg( 2*n+1, tileDigits, 10, QChar('0') )
-                                            .arg( 2*m, tileDigits, 10, QChar('0') ) )
-                                            .arg( d->m_tileFormat );
-                    QImage  img_bottomleft( tileName );
-
-                    tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                            .arg( tileLevel + 1 )
-                                            .arg( 2*n+1, tileDigits, 10, QChar('0') )
-                                            .arg( 2*m+1, tileDigits, 10, QChar('0') ) )
-                                            .arg( d->m_tileFormat );
-                    QImage  img_bottomright( tileName );
-
-                    QSize const expectedSize( c_defaultTileSize, c_defaultTileSize );
-                    if ( img_topleft.size() != expectedSize ||
-                         img_topright.size() != expectedSize ||
-                         img_bottomleft.size() != expectedSize ||
-                         img_bottomright.size() != expectedSize ) {
-                        mDebug() << "Tile write failure. Missing write permissions?";
-                        emit progress( 100 );
-                        return;
-                    }
-                    QImage  tile = img_topleft;
-
-                    if ( d->m_dem == "true" ) {
-
-                        tile.setColorTable( grayScalePalette );
-                        uchar* destLine;
-
-                        for ( uint y = 0; y < c_defaultTileSize / 2; ++y ) {
-                            destLine = tile.scanLine( y );
-                            const uchar* srcLine = img_topleft.scanLine( 2 * y );
-                            for ( uint x = 0; x < c_defaultTileSize / 2; ++x )
-                                destLine[x] = srcLine[ 2*x ];
-                        }
-                        for ( uint y = 0; y < c_defaultTileSize / 2; ++y ) {
-                            destLine = tile.scanLine( y );
-                            const uchar* srcLine = img_topright.scanLine( 2 * y );
-                            for ( uint x = c_defaultTileSize / 2; x < c_defaultTileSize; ++x )
-                                destLine[x] = srcLine[ 2 * ( x - c_defaultTileSize / 2 ) ];
-                        }
-                        for ( uint y = c_defaultTileSize / 2; y < c_defaultTileSize; ++y ) {
-                            destLine = tile.scanLine( y );
-                            const uchar* srcLine = img_bottomleft.scanLine( 2 * ( y - c_defaultTileSize / 2 ) );
-                            for ( uint x = 0; x < c_defaultTileSize / 2; ++x )
-                                destLine[ x ] = srcLine[ 2 * x ];
-                        }
-                        for ( uint y = c_defaultTileSize / 2; y < c_defaultTileSize; ++y ) {
-                            destLine = tile.scanLine( y );
-                            const uchar* srcLine = img_bottomright.scanLine( 2 * ( y - c_defaultTileSize/2 ) );
-                            for ( uint x = c_defaultTileSize / 2; x < c_defaultTileSize; ++x )
-                                destLine[x] = srcLine[ 2 * ( x - c_defaultTileSize / 2 ) ];
-                        }
-                    }
-                    else {
-
-                        // tile.depth() != 8
-
-                        img_topleft = img_topleft.convertToFormat( QImage::Format_ARGB32 );
-                        img_topright = img_topright.convertToFormat( QImage::Format_ARGB32 );
-                        img_bottomleft = img_bottomleft.convertToFormat( QImage::Format_ARGB32 );
-                        img_bottomright = img_bottomright.convertToFormat( QImage::Format_ARGB32 );
-                        tile = img_topleft;
-
-                        QRgb* destLine;
-
-                        for ( uint y = 0; y < c_defaultTileSize / 2; ++y ) {
-                            destLine = (QRgb*) tile.scanLine( y );
-                            const QRgb* srcLine = (QRgb*) img_topleft.scanLine( 2 * y );
-                            for ( uint x = 0; x < c_defaultTileSize / 2; ++x )
-                                destLine[x] = srcLine[ 2 * x ];
-                        }
-                        for ( uint y = 0; y < c_defaultTileSize / 2; ++y ) {
-                            destLine = (QRgb*) tile.scanLine( y );
-                            const QRgb* srcLine = (QRgb*) img_topright.scanLine( 2 * y );
-                            for ( uint x = c_defaultTileSize / 2; x < c_defaultTileSize; ++x )
-                                destLine[x] = srcLine[ 2 * ( x - c_defaultTileSize / 2 ) ];
-                        }
-                        for ( uint y = c_defaultTileSize / 2; y < c_defaultTileSize; ++y ) {
-                            destLine = (QRgb*) tile.scanLine( y );
-                            const QRgb* srcLine = (QRgb*) img_bottomleft.scanLine( 2 * ( y-c_defaultTileSize/2 ) );
-                            for ( uint x = 0; x < c_defaultTileSize / 2; ++x )
-                                destLine[x] = srcLine[ 2 * x ];
-                        }
-                        for ( uint y = c_defaultTileSize / 2; y < c_defaultTileSize; ++y ) {
-                            destLine = (QRgb*) tile.scanLine( y );
-                            const QRgb* srcLine = (QRgb*) img_bottomright.scanLine( 2 * ( y-c_defaultTileSize / 2 ) );
-                            for ( uint x = c_defaultTileSize / 2; x < c_defaultTileSize; ++x )
-                                destLine[x] = srcLine[ 2*( x-c_defaultTileSize / 2 ) ];
-                        }
-                    }
-
-                    mDebug() << newTileName;
-
-                    // Saving at 100% JPEG quality to have a high-quality
-                    // version to create the remaining needed tiles from.
-                    bool  ok = tile.save( newTileName, d->m_tileFormat.toLatin1().data(), d->m_tileFormat == "jpg" ? 100 : d->m_tileQuality );
-                    if ( ! ok )
-                        mDebug() << "Error while writing Tile: " << newTileName;
-                }
-
-                percentCompleted =  (int) ( 90 * (qreal)(createdTilesCount)
-                                            / (qreal)(totalTileCount) );	
-                createdTilesCount++;
-						
-                emit progress( percentCompleted );
+            // Don't exceed 99% as this would cancel the thread unexpectedly
+            const int percent = (int) ( 99 * (qreal)(d->m_handledTilesCount)
+                                        / (qreal)(totalTileCount) );
+            if ( percent != percentCompleted ) {
+                percentCompleted = percent;
                 mDebug() << "percentCompleted" << percentCompleted;
+                emit progress( percentCompleted );
             }
         }
-        mDebug() << "tileLevel: " << tileLevel << " successfully created.";
     }
-    mDebug() << "Tile creation completed.";
-
-    if ( d->m_tileFormat == "jpg" && d->m_tileQuality != 100 ) {
-
-        // Applying correct lower JPEG compression now that we created all tiles
-        int savedTilesCount = 0;
 
-        tileLevel = 0;
-        while ( tileLevel <= maxTileLevel ) {
-            int nmaxit =  TileLoaderHelper::levelToRow( defaultLevelZeroRows, tileLevel );
-            for ( int n = 0; n < nmaxit; ++n) {
-                int mmaxit =  TileLoaderHelper::levelToColumn( defaultLevelZeroColumns, tileLevel );
-                for ( int m = 0; m < mmaxit; ++m) {
+    d->m_threadPool.waitForDone();
+    d->m_jobSlots.acquire( maxPendingTiles );
+    d->m_pyramid.clear();
 
-                    if ( d->m_cancelled )
-                        return;
-
-                    savedTilesCount++;
-
-                    tileName = d->m_targetDir + ( QString("%1/%2/%2_%3.%4")
-                                            .arg( tileLevel )
-                                            .arg( n, tileDigits, 10, QChar('0') )
-                                            .arg( m, tileDigits, 10, QChar('0') ) )
-                                            .arg( d->m_tileFormat );
-                    QImage tile( tileName );
-
-                    bool ok;
-
-                    ok = tile.save( tileName, d->m_tileFormat.toLatin1().data(), d->m_tileQuality );
+    if ( d->m_cancelled || readError )
+        return;
 
-                    if ( !ok )
-                        mDebug() << "Error while writing Tile: " << tileName;
-                    // Don't exceed 99% as this would cancel the thread unexpectedly
-                    percentCompleted = 90 + (int)( 9 * (qreal)(savedTilesCount)
-                                                / (qreal)(totalTileCount) );
-                    emit progress( percentCompleted );
-                    mDebug() << "percentCompleted" << percentCompleted;
-                    //mDebug() << "Saving Tile #" << savedTilesCount
-                    //         << " of " << totalTileCount
-                    //         << " Percent: " << percentCompleted;
-                }
-            }
-            tileLevel++;
-        }
+    if ( d->failed() ) {
+        mDebug() << int( d->m_failedTilesCount ) << "tiles could not be written.";
+        emit progress( 100 );
+        return;
     }
 
+    mDebug() << "Tile creation completed.";
+
     percentCompleted = 100;
     emit progress( percentCompleted );
 
@@ -618,6 +636,26 @@ bool TileCreator::verifyExactResult() const
     return d->m_verify;
 }
 
+void TileCreator::setThreadCount( int threadCount )
+{
+    d->m_threadCount = threadCount;
+}
+
+int TileCreator::threadCount() const
+{
+    return d->threadCount();
+}
+
+int TileCreator::createdTilesCount() const
+{
+    return d->m_createdTilesCount;
+}
+
+int TileCreator::failedTilesCount() const
+{
+    return d->m_failedTilesCount;
+}
+
 
 }
 
@@ -81,6 +81,34 @@ class MARBLE_EXPORT TileCreator : public QThread
     bool resume() const;
     bool verifyExactResult() const;
 
+    /**
+     * Sets the number of threads used for encoding the tiles.
+     * A value of 0, the default, uses one thread per processor core.
+     *
+     * The source is always read from the thread of the TileCreator, so
+     * TileCreatorSource::tile() doesn't need to be thread-safe.
+     */
+    void setThreadCount( int threadCount );
+
+    /**
+     * Returns the number of threads used for encoding the tiles.
+     */
+    int threadCount() const;
+
+    /**
+     * Returns the number of tiles written by the last run, not counting
+     * tiles which were kept because of resume().
+     */
+    int createdTilesCount() const;
+
+    /**
+     * Returns the number of tiles of the last run which couldn't be written,
+     * or read back to build the tiles of the lower levels. The tile creation
+     * stops at the first failure, so a value other than 0 means that the
+     * tiles are incomplete.
+     */
+    int failedTilesCount() const;
+
  protected:
     virtual void run();
 
@@ -33,6 +33,7 @@
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
 #include "ParsingRunnerManager.h"
+#include "StoragePolicy.h"
 #include "TileLoaderHelper.h"
 
 Q_DECLARE_METATYPE( Marble::DownloadUsage )
@@ -41,13 +42,17 @@ namespace Marble
 {
 
 TileLoader::TileLoader(HttpDownloadManager * const downloadManager, const PluginManager *pluginManager) :
+      m_storagePolicy( downloadManager ? downloadManager->storagePolicy() : 0 ),
       m_pluginManager( pluginManager )
 {
     qRegisterMetaType<DownloadUsage>( "DownloadUsage" );
-    connect( this, SIGNAL(downloadTile(QUrl,QString,QString,DownloadUsage)),
-             downloadManager, SLOT(addJob(QUrl,QString,QString,DownloadUsage)));
-    connect( downloadManager, SIGNAL(downloadComplete(QByteArray,QString)),
-             SLOT(updateTile(QByteArray,QString)));
+
+    if ( downloadManager ) {
+        connect( this, SIGNAL(downloadTile(QUrl,QString,QString,DownloadUsage)),
+                 downloadManager, SLOT(addJob(QUrl,QString,QString,DownloadUsage)));
+        connect( downloadManager, SIGNAL(downloadComplete(QByteArray,QString)),
+                 SLOT(updateTile(QByteArray,QString)));
+    }
 }
 
 // If the tile image file is locally available:
@@ -55,8 +60,6 @@ TileLoader::TileLoader(HttpDownloadManager * const downloadManager, const Plugin
 //     - if expired: create TextureTile, state is set to Expired by default, trigger dl,
 QImage TileLoader::loadTileImage( GeoSceneTextureTile const *textureLayer, TileId const & tileId, DownloadUsage const usage )
 {
-    QString const fileName = tileFileName( textureLayer, tileId );
-
     TileStatus status = tileStatus( textureLayer, tileId );
     if ( status != Missing ) {
         // check if an update should be triggered
@@ -69,7 +72,7 @@ QImage TileLoader::loadTileImage( GeoSceneTextureTile const *textureLayer, TileI
             triggerDownload( textureLayer, tileId, usage );
         }
 
-        QImage const image( fileName );
+        QImage const image = tileImage( textureLayer, tileId );
         if ( !image.isNull() ) {
             // file is there, so create and return a tile object in any case
             return image;
@@ -188,15 +191,23 @@ bool TileLoader::baseTilesAvailable( GeoSceneTiled const & texture )
     return result;
 }
 
-TileLoader::TileStatus TileLoader::tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId )
+TileLoader::TileStatus TileLoader::tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId ) const
 {
-    QString const fileName = tileFileName( textureLayer, tileId );
-    QFileInfo fileInfo( fileName );
-    if ( !fileInfo.exists() ) {
-        return Missing;
+    QDateTime lastModified;
+    if ( m_storagePolicy ) {
+        lastModified = m_storagePolicy->lastModified( textureLayer->relativeTileFileName( tileId ) );
+    }
+
+    if ( !lastModified.isValid() ) {
+        QString const fileName = tileFileName( textureLayer, tileId );
+        QFileInfo fileInfo( fileName );
+        if ( !fileInfo.exists() ) {
+            return Missing;
+        }
+
+        lastModified = fileInfo.lastModified();
     }
 
-    const QDateTime lastModified = fileInfo.lastModified();
     const int expireSecs = textureLayer->expire();
     const bool isExpired = lastModified.secsTo( QDateTime::currentDateTime() ) >= expireSecs;
     return isExpired ? Expired : Available;
@@ -244,9 +255,8 @@ QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTile * textureLaye
         int const deltaLevel = id.zoomLevel() - level;
         TileId const replacementTileId( id.mapThemeIdHash(), level,
                                         id.x() >> deltaLevel, id.y() >> deltaLevel );
-        QString const fileName = tileFileName( textureLayer, replacementTileId );
-        mDebug() << "TileLoader::scaledLowerLevelTile" << "trying" << fileName;
-        QImage toScale( fileName );
+        mDebug() << "TileLoader::scaledLowerLevelTile" << "trying" << replacementTileId;
+        QImage toScale = tileImage( textureLayer, replacementTileId );
 
         if ( level == 0 && toScale.isNull() ) {
             mDebug() << "No level zero tile installed in map theme dir. Falling back to a transparent image for now.";
@@ -275,6 +285,21 @@ QImage TileLoader::scaledLowerLevelTile( const GeoSceneTextureTile * textureLaye
     return QImage();
 }
 
+QImage TileLoader::tileImage( GeoSceneTextureTile const * textureLayer, TileId const & tileId ) const
+{
+    if ( m_storagePolicy ) {
+        QByteArray data;
+        if ( m_storagePolicy->readFile( textureLayer->relativeTileFileName( tileId ), data ) ) {
+            QImage const image = QImage::fromData( data );
+            if ( !image.isNull() ) {
+                return image;
+            }
+        }
+    }
+
+    return QImage( tileFileName( textureLayer, tileId ) );
+}
+
 }
 
 #include "TileLoader.moc"
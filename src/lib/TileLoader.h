@@ -36,6 +36,7 @@ class QUrl;
 namespace Marble
 {
 class HttpDownloadManager;
+class StoragePolicy;
 class GeoDataDocument;
 class GeoSceneTiled;
 class GeoSceneTextureTile;
@@ -71,8 +72,11 @@ class TileLoader: public QObject
       * - Missing when it has not been downloaded
       * - Expired when it has been downloaded, but is too old (as per .dgml expiration time)
       * - Available when it has been downloaded and is not expired
+      *
+      * Tiles kept by the storage policy of the download manager are looked up there
+      * before the file system is consulted.
       */
-    static TileStatus tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId );
+    TileStatus tileStatus( GeoSceneTiled const *textureLayer, const TileId &tileId ) const;
 
  public Q_SLOTS:
     void updateTile( QByteArray const & imageData, QString const & tileId );
@@ -89,6 +93,9 @@ class TileLoader: public QObject
     static QString tileFileName( GeoSceneTiled const * textureLayer, TileId const & );
     void triggerDownload( GeoSceneTiled const *textureLayer, TileId const &, DownloadUsage const );
     QImage scaledLowerLevelTile( GeoSceneTextureTile const * textureLayer, TileId const & ) const;
+    QImage tileImage( GeoSceneTextureTile const * textureLayer, TileId const & ) const;
+
+    StoragePolicy *const m_storagePolicy;
 
     // For vectorTile parsing
     const PluginManager * m_pluginManager;
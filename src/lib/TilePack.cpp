@@ -0,0 +1,554 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "TilePack.h"
+
+#include "MarbleDebug.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QList>
+#include <QMap>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#ifdef Q_OS_UNIX
+#include <sys/file.h>
+#endif
+
+namespace Marble
+{
+
+static const quint32 packMagic = 0x4d54504b;  // "MTPK"
+static const quint32 indexMagic = 0x4d545049; // "MTPI"
+static const quint32 formatVersion = 1;
+static const qint64 headerSize = 2 * sizeof( quint32 );
+
+enum IndexOperation {
+    InsertOperation = 1,
+    RemoveOperation = 2
+};
+
+static bool writeHeader( QFile &file, quint32 magic )
+{
+    QDataStream stream( &file );
+    stream << magic << formatVersion;
+    return stream.status() == QDataStream::Ok;
+}
+
+/**
+ * Replaces @p target by @p source. QFile::rename() doesn't overwrite files.
+ */
+static bool replaceFile( const QString &source, const QString &target )
+{
+    QFile::remove( target );
+    return QFile::rename( source, target );
+}
+
+static bool checkHeader( QFile &file, quint32 magic )
+{
+    QDataStream stream( &file );
+    quint32 fileMagic = 0;
+    quint32 fileVersion = 0;
+    stream >> fileMagic >> fileVersion;
+    return stream.status() == QDataStream::Ok && fileMagic == magic && fileVersion == formatVersion;
+}
+
+TilePack::TilePack( const QString &fileName )
+    : m_packFileName( fileName ),
+      m_indexFileName( fileName + ".idx" ),
+      m_lockFile( fileName + ".lock" ),
+      m_locked( false ),
+      m_packFile( m_packFileName ),
+      m_indexFile( m_indexFileName ),
+      m_map( 0 ),
+      m_mapSize( 0 ),
+      m_size( 0 ),
+      m_garbageSize( 0 )
+{
+    QWriteLocker locker( &m_lock );
+
+    const QString path = QFileInfo( m_packFileName ).absolutePath();
+    if ( !QDir( path ).exists() ) {
+        QDir::root().mkpath( path );
+    }
+
+    if ( lock() ) {
+        open();
+    }
+}
+
+TilePack::~TilePack()
+{
+    QWriteLocker locker( &m_lock );
+    close();
+
+    // closing the file releases the lock
+    m_lockFile.close();
+}
+
+bool TilePack::lock()
+{
+    if ( !m_lockFile.open( QIODevice::ReadWrite ) ) {
+        m_errorString = QString( "%1: %2" ).arg( m_lockFile.fileName() ).arg( m_lockFile.errorString() );
+        qWarning() << "TilePack:" << m_errorString;
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    if ( flock( m_lockFile.handle(), LOCK_EX | LOCK_NB ) != 0 ) {
+        m_errorString = QString( "%1: used by another process" ).arg( m_packFileName );
+        mDebug() << "TilePack:" << m_errorString;
+        m_lockFile.close();
+        return false;
+    }
+#endif
+
+    m_locked = true;
+    return true;
+}
+
+void TilePack::recover()
+{
+    const QString compactPackFileName = m_packFileName + ".compact";
+    const QString compactIndexFileName = m_indexFileName + ".compact";
+    const QString oldPackFileName = m_packFileName + ".old";
+    const QString oldIndexFileName = m_indexFileName + ".old";
+
+    if ( QFile::exists( compactPackFileName ) || QFile::exists( compactIndexFileName ) ) {
+        // the compacted files were not both in place yet, so go back to the old ones
+        if ( QFile::exists( oldPackFileName ) ) {
+            replaceFile( oldPackFileName, m_packFileName );
+        }
+        if ( QFile::exists( oldIndexFileName ) ) {
+            replaceFile( oldIndexFileName, m_indexFileName );
+        }
+        QFile::remove( compactPackFileName );
+        QFile::remove( compactIndexFileName );
+        mDebug() << "TilePack: rolled back an interrupted compaction of" << m_packFileName;
+    } else {
+        QFile::remove( oldPackFileName );
+        QFile::remove( oldIndexFileName );
+    }
+}
+
+bool TilePack::open()
+{
+    m_entries.clear();
+    m_size = 0;
+    m_garbageSize = 0;
+
+    if ( !m_locked ) {
+        return false;
+    }
+
+    recover();
+
+    if ( !m_packFile.open( QIODevice::ReadWrite | QIODevice::Unbuffered ) ) {
+        m_errorString = QString( "%1: %2" ).arg( m_packFileName ).arg( m_packFile.errorString() );
+        qWarning() << "TilePack:" << m_errorString;
+        return false;
+    }
+
+    if ( !m_indexFile.open( QIODevice::ReadWrite ) ) {
+        m_errorString = QString( "%1: %2" ).arg( m_indexFileName ).arg( m_indexFile.errorString() );
+        qWarning() << "TilePack:" << m_errorString;
+        m_packFile.close();
+        return false;
+    }
+
+    const bool isNew = m_packFile.size() == 0 || m_indexFile.size() == 0;
+    if ( isNew || !checkHeader( m_packFile, packMagic ) || !readIndex() ) {
+        if ( !isNew ) {
+            mDebug() << "TilePack: discarding unreadable pack" << m_packFileName;
+        }
+
+        m_entries.clear();
+        m_size = 0;
+        m_garbageSize = 0;
+
+        m_packFile.resize( 0 );
+        m_indexFile.resize( 0 );
+        m_packFile.seek( 0 );
+        m_indexFile.seek( 0 );
+        if ( !writeHeader( m_packFile, packMagic ) || !writeHeader( m_indexFile, indexMagic ) ) {
+            m_errorString = QString( "%1: could not write header" ).arg( m_packFileName );
+            close();
+            return false;
+        }
+        m_indexFile.flush();
+    }
+
+    return true;
+}
+
+void TilePack::close()
+{
+    if ( m_map ) {
+        m_packFile.unmap( m_map );
+        m_map = 0;
+        m_mapSize = 0;
+    }
+
+    m_packFile.close();
+    m_indexFile.close();
+}
+
+bool TilePack::readIndex()
+{
+    m_indexFile.seek( 0 );
+    if ( !checkHeader( m_indexFile, indexMagic ) ) {
+        return false;
+    }
+
+    const qint64 packSize = m_packFile.size();
+
+    QDataStream stream( &m_indexFile );
+    qint64 validEnd = m_indexFile.pos();
+
+    while ( !stream.atEnd() ) {
+        quint8 operation = 0;
+        QString key;
+        stream >> operation >> key;
+
+        if ( operation == InsertOperation ) {
+            Entry entry;
+            stream >> entry.offset >> entry.size >> entry.lastModified;
+            if ( stream.status() != QDataStream::Ok ) {
+                break;
+            }
+            if ( entry.offset < quint64( headerSize ) || entry.offset + entry.size > quint64( packSize ) ) {
+                // data was not completely written to the pack
+                break;
+            }
+            removeEntry( key );
+            m_entries.insert( key, entry );
+            m_size += entry.size;
+        } else if ( operation == RemoveOperation && stream.status() == QDataStream::Ok ) {
+            removeEntry( key );
+        } else {
+            break;
+        }
+
+        validEnd = m_indexFile.pos();
+    }
+
+    // drop a partially written record at the end of the log
+    if ( validEnd < m_indexFile.size() ) {
+        mDebug() << "TilePack: truncating index" << m_indexFileName << "at" << validEnd;
+        m_indexFile.resize( validEnd );
+    }
+    m_indexFile.seek( validEnd );
+
+    // anything in the pack which is not referenced by the index is garbage
+    m_garbageSize = packSize - headerSize - m_size;
+
+    return true;
+}
+
+bool TilePack::appendToIndex( quint8 operation, const QString &key, const Entry &entry )
+{
+    QDataStream stream( &m_indexFile );
+    stream << operation << key;
+    if ( operation == InsertOperation ) {
+        stream << entry.offset << entry.size << entry.lastModified;
+    }
+    m_indexFile.flush();
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool TilePack::remap( qint64 end ) const
+{
+    if ( m_map && end <= m_mapSize ) {
+        return true;
+    }
+
+    if ( m_map ) {
+        m_packFile.unmap( m_map );
+        m_map = 0;
+        m_mapSize = 0;
+    }
+
+    const qint64 size = m_packFile.size();
+    if ( end > size ) {
+        return false;
+    }
+
+    m_map = m_packFile.map( 0, size );
+    if ( !m_map ) {
+        return false;
+    }
+    m_mapSize = size;
+
+    return true;
+}
+
+void TilePack::removeEntry( const QString &key )
+{
+    QHash<QString, Entry>::iterator const pos = m_entries.find( key );
+    if ( pos == m_entries.end() ) {
+        return;
+    }
+
+    m_size -= pos->size;
+    m_garbageSize += pos->size;
+    m_entries.erase( pos );
+}
+
+bool TilePack::isValid() const
+{
+    QReadLocker locker( &m_lock );
+    return m_packFile.isOpen() && m_indexFile.isOpen();
+}
+
+bool TilePack::contains( const QString &key ) const
+{
+    QReadLocker locker( &m_lock );
+    return m_entries.contains( key );
+}
+
+QDateTime TilePack::lastModified( const QString &key ) const
+{
+    QReadLocker locker( &m_lock );
+
+    QHash<QString, Entry>::const_iterator const pos = m_entries.constFind( key );
+    if ( pos == m_entries.constEnd() ) {
+        return QDateTime();
+    }
+
+    return QDateTime::fromTime_t( pos->lastModified );
+}
+
+bool TilePack::read( const QString &key, QByteArray &data ) const
+{
+    m_lock.lockForRead();
+
+    QHash<QString, Entry>::const_iterator pos = m_entries.constFind( key );
+    if ( pos == m_entries.constEnd() ) {
+        m_lock.unlock();
+        return false;
+    }
+
+    Entry entry = *pos;
+    qint64 const end = entry.offset + entry.size;
+
+    if ( !m_map || end > m_mapSize ) {
+        // the pack grew since it was mapped
+        m_lock.unlock();
+        m_lock.lockForWrite();
+
+        pos = m_entries.constFind( key );
+        if ( pos == m_entries.constEnd() ) {
+            m_lock.unlock();
+            return false;
+        }
+        entry = *pos;
+
+        if ( !remap( entry.offset + entry.size ) ) {
+            mDebug() << "TilePack: could not map" << m_packFileName;
+            m_lock.unlock();
+            return false;
+        }
+    }
+
+    data = QByteArray( reinterpret_cast<const char *>( m_map + entry.offset ), entry.size );
+
+    m_lock.unlock();
+    return true;
+}
+
+bool TilePack::insert( const QString &key, const QByteArray &data )
+{
+    QWriteLocker locker( &m_lock );
+
+    if ( !m_packFile.isOpen() ) {
+        return false;
+    }
+
+    Entry entry;
+    entry.offset = m_packFile.size();
+    entry.size = data.size();
+    entry.lastModified = QDateTime::currentDateTime().toTime_t();
+
+    m_packFile.seek( entry.offset );
+    if ( m_packFile.write( data ) != data.size() ) {
+        m_errorString = QString( "%1: %2" ).arg( m_packFileName ).arg( m_packFile.errorString() );
+        m_packFile.resize( entry.offset );
+        return false;
+    }
+
+    if ( !appendToIndex( InsertOperation, key, entry ) ) {
+        m_errorString = QString( "%1: %2" ).arg( m_indexFileName ).arg( m_indexFile.errorString() );
+        return false;
+    }
+
+    removeEntry( key );
+    m_entries.insert( key, entry );
+    m_size += entry.size;
+
+    return true;
+}
+
+void TilePack::remove( const QString &key )
+{
+    QWriteLocker locker( &m_lock );
+
+    if ( !m_entries.contains( key ) ) {
+        return;
+    }
+
+    appendToIndex( RemoveOperation, key );
+    removeEntry( key );
+}
+
+void TilePack::clear()
+{
+    QWriteLocker locker( &m_lock );
+
+    close();
+    QFile::remove( m_packFileName );
+    QFile::remove( m_indexFileName );
+    open();
+}
+
+void TilePack::shrink( qint64 bytes )
+{
+    QWriteLocker locker( &m_lock );
+
+    if ( m_size <= bytes ) {
+        return;
+    }
+
+    QMap<uint, QString> byAge;
+    QHash<QString, Entry>::const_iterator pos = m_entries.constBegin();
+    QHash<QString, Entry>::const_iterator const end = m_entries.constEnd();
+    for (; pos != end; ++pos ) {
+        byAge.insertMulti( pos->lastModified, pos.key() );
+    }
+
+    QMap<uint, QString>::const_iterator oldest = byAge.constBegin();
+    for (; oldest != byAge.constEnd() && m_size > bytes; ++oldest ) {
+        appendToIndex( RemoveOperation, oldest.value() );
+        removeEntry( oldest.value() );
+    }
+}
+
+bool TilePack::compact()
+{
+    QWriteLocker locker( &m_lock );
+
+    if ( !m_packFile.isOpen() ) {
+        return false;
+    }
+
+    if ( m_garbageSize == 0 ) {
+        return true;
+    }
+
+    if ( !remap( m_packFile.size() ) && m_packFile.size() > headerSize ) {
+        m_errorString = QString( "%1: could not map pack for compaction" ).arg( m_packFileName );
+        return false;
+    }
+
+    const QString compactPackFileName = m_packFileName + ".compact";
+    const QString compactIndexFileName = m_indexFileName + ".compact";
+
+    QFile packFile( compactPackFileName );
+    QFile indexFile( compactIndexFileName );
+    if ( !packFile.open( QIODevice::WriteOnly | QIODevice::Truncate )
+         || !indexFile.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        m_errorString = QString( "%1: could not create compacted pack" ).arg( m_packFileName );
+        return false;
+    }
+
+    writeHeader( packFile, packMagic );
+    writeHeader( indexFile, indexMagic );
+
+    // keep the data in pack order to preserve locality of tiles written together
+    QMap<quint64, QString> byOffset;
+    QHash<QString, Entry>::const_iterator pos = m_entries.constBegin();
+    QHash<QString, Entry>::const_iterator const end = m_entries.constEnd();
+    for (; pos != end; ++pos ) {
+        byOffset.insert( pos->offset, pos.key() );
+    }
+
+    QHash<QString, Entry> entries;
+    QDataStream indexStream( &indexFile );
+    bool ok = true;
+
+    QMap<quint64, QString>::const_iterator it = byOffset.constBegin();
+    for (; ok && it != byOffset.constEnd(); ++it ) {
+        Entry entry = m_entries.value( it.value() );
+        const char *const data = reinterpret_cast<const char *>( m_map + entry.offset );
+        entry.offset = packFile.pos();
+        ok = packFile.write( data, entry.size ) == entry.size;
+
+        indexStream << quint8( InsertOperation ) << it.value() << entry.offset << entry.size << entry.lastModified;
+        entries.insert( it.value(), entry );
+    }
+
+    ok = ok && indexStream.status() == QDataStream::Ok;
+
+    packFile.close();
+    indexFile.close();
+
+    if ( !ok ) {
+        m_errorString = QString( "%1: could not write compacted pack" ).arg( m_packFileName );
+        QFile::remove( compactPackFileName );
+        QFile::remove( compactIndexFileName );
+        return false;
+    }
+
+    close();
+
+    // Keep the old files until both compacted ones are in place. If this is
+    // interrupted, open() goes back to the old files as long as a compacted
+    // file is left, and removes the old files otherwise.
+    const QString oldPackFileName = m_packFileName + ".old";
+    const QString oldIndexFileName = m_indexFileName + ".old";
+    ok = replaceFile( m_packFileName, oldPackFileName )
+         && replaceFile( m_indexFileName, oldIndexFileName )
+         && QFile::rename( compactPackFileName, m_packFileName )
+         && QFile::rename( compactIndexFileName, m_indexFileName );
+
+    if ( !ok ) {
+        m_errorString = QString( "%1: could not replace the pack by the compacted one" ).arg( m_packFileName );
+    }
+
+    // rolls back if a rename failed, removes the old files otherwise
+    return open() && ok;
+}
+
+qint64 TilePack::size() const
+{
+    QReadLocker locker( &m_lock );
+    return m_size;
+}
+
+qint64 TilePack::garbageSize() const
+{
+    QReadLocker locker( &m_lock );
+    return m_garbageSize;
+}
+
+int TilePack::count() const
+{
+    QReadLocker locker( &m_lock );
+    return m_entries.count();
+}
+
+QString TilePack::errorString() const
+{
+    QReadLocker locker( &m_lock );
+    return m_errorString;
+}
+
+}
@@ -0,0 +1,143 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILEPACK_H
+#define MARBLE_TILEPACK_H
+
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+
+class QByteArray;
+
+namespace Marble
+{
+
+/**
+ * @short Persistent store keeping many small files in a single pack file.
+ *
+ * The data of all files is appended to a pack file. An index file records for
+ * each file name the position of its data inside the pack and the time it was
+ * written. The index is an append-only log which is replayed into a hash on
+ * construction, so looking up a file neither touches the file system nor
+ * depends on the number of stored files.
+ *
+ * Replacing or removing a file leaves its old data in the pack until compact()
+ * is called, which rewrites both files with the live entries only. The old
+ * files are kept until the new ones are in place, so an interrupted compaction
+ * is rolled back or completed when the pack is opened the next time.
+ *
+ * Reading is thread-safe and done through a memory mapping of the pack file.
+ *
+ * Only one process at a time can use a pack. It holds a lock on a file with
+ * the suffix ".lock" next to the pack, other processes get an invalid pack.
+ * The lock is only supported on Unix, on other platforms several processes
+ * must not use the same pack.
+ */
+class TilePack
+{
+ public:
+    /**
+     * Opens or creates the pack @p fileName. The index is stored next to it
+     * with the suffix ".idx".
+     */
+    explicit TilePack( const QString &fileName );
+    ~TilePack();
+
+    /**
+     * Returns whether the pack could be opened, and is not used by
+     * another process.
+     */
+    bool isValid() const;
+
+    bool contains( const QString &key ) const;
+
+    /**
+     * Returns the time at which @p key was written, or an invalid QDateTime
+     * if it is not stored.
+     */
+    QDateTime lastModified( const QString &key ) const;
+
+    /**
+     * Reads the data stored for @p key. Returns false if it is not stored.
+     */
+    bool read( const QString &key, QByteArray &data ) const;
+
+    bool insert( const QString &key, const QByteArray &data );
+
+    void remove( const QString &key );
+
+    void clear();
+
+    /**
+     * Removes the least recently written entries until the live data
+     * takes at most @p bytes.
+     */
+    void shrink( qint64 bytes );
+
+    /**
+     * Rewrites the pack and index files without data of replaced or removed entries.
+     */
+    bool compact();
+
+    /**
+     * Returns the number of bytes taken by live entries.
+     */
+    qint64 size() const;
+
+    /**
+     * Returns the number of bytes taken by replaced or removed entries.
+     */
+    qint64 garbageSize() const;
+
+    int count() const;
+
+    QString errorString() const;
+
+ private:
+    Q_DISABLE_COPY( TilePack )
+
+    struct Entry
+    {
+        quint64 offset;
+        quint32 size;
+        uint lastModified;
+    };
+
+    bool lock();
+    void recover();
+    bool open();
+    void close();
+    bool readIndex();
+    bool appendToIndex( quint8 operation, const QString &key, const Entry &entry = Entry() );
+    bool remap( qint64 end ) const;
+    void removeEntry( const QString &key );
+
+    const QString m_packFileName;
+    const QString m_indexFileName;
+
+    QFile m_lockFile;
+    bool m_locked;
+
+    mutable QReadWriteLock m_lock;
+    mutable QFile m_packFile;
+    QFile m_indexFile;
+    mutable uchar *m_map;
+    mutable qint64 m_mapSize;
+
+    QHash<QString, Entry> m_entries;
+    qint64 m_size;
+    qint64 m_garbageSize;
+    QString m_errorString;
+};
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+// Own
+#include "TilePackStoragePolicy.h"
+
+// Qt
+#include <QFile>
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+// Marble
+#include "MarbleDebug.h"
+#include "MarbleDirs.h"
+#include "TilePack.h"
+
+using namespace Marble;
+
+static QString dataDirectoryOrDefault( const QString &dataDirectory )
+{
+    return dataDirectory.isEmpty() ? MarbleDirs::localPath() + "/cache/" : dataDirectory;
+}
+
+TilePackStoragePolicy::TilePackStoragePolicy( const QString &dataDirectory, QObject *parent )
+    : StoragePolicy( parent ),
+      m_dataDirectory( dataDirectoryOrDefault( dataDirectory ) ),
+      m_fileStoragePolicy( m_dataDirectory ),
+      m_pack( 0 ),
+      m_packingEnabled( false ),
+      m_cacheLimit( 0 )
+{
+    connect( &m_fileStoragePolicy, SIGNAL(cleared()), SIGNAL(cleared()) );
+    connect( &m_fileStoragePolicy, SIGNAL(sizeChanged(qint64)), SIGNAL(sizeChanged(qint64)) );
+
+    // keep the tiles of an earlier session readable
+    if ( QFile::exists( packFileName() ) ) {
+        m_pack = new TilePack( packFileName() );
+    }
+}
+
+TilePackStoragePolicy::~TilePackStoragePolicy()
+{
+    delete m_pack;
+}
+
+QString TilePackStoragePolicy::packFileName() const
+{
+    return m_dataDirectory + "/cache/tiles.pack";
+}
+
+void TilePackStoragePolicy::setPackingEnabled( bool enabled )
+{
+    m_packingEnabled = enabled;
+
+    if ( m_packingEnabled && !m_pack ) {
+        TilePack *const pack = new TilePack( packFileName() );
+        {
+            QWriteLocker locker( &m_packLock );
+            m_pack = pack;
+        }
+        ensureCacheLimit();
+    }
+}
+
+bool TilePackStoragePolicy::isPackingEnabled() const
+{
+    return m_packingEnabled;
+}
+
+void TilePackStoragePolicy::setCacheLimit( quint64 bytes )
+{
+    m_cacheLimit = bytes;
+    ensureCacheLimit();
+}
+
+bool TilePackStoragePolicy::isTile( const QString &fileName )
+{
+    if ( !fileName.startsWith( QLatin1String( "maps/" ) ) ) {
+        return false;
+    }
+
+    const QString suffix = QFileInfo( fileName ).suffix().toLower();
+    return suffix == "png" || suffix == "jpg" || suffix == "jpeg" || suffix == "gif";
+}
+
+bool TilePackStoragePolicy::fileExists( const QString &fileName ) const
+{
+    {
+        QReadLocker locker( &m_packLock );
+        if ( m_pack && m_pack->contains( fileName ) ) {
+            return true;
+        }
+    }
+
+    return m_fileStoragePolicy.fileExists( fileName );
+}
+
+bool TilePackStoragePolicy::updateFile( const QString &fileName, const QByteArray &data )
+{
+    if ( !m_packingEnabled || !isTile( fileName ) || !m_pack->isValid() ) {
+        // don't let an outdated packed tile shadow the new file
+        if ( m_pack ) {
+            m_pack->remove( fileName );
+        }
+        return m_fileStoragePolicy.updateFile( fileName, data );
+    }
+
+    if ( !m_pack->insert( fileName, data ) ) {
+        m_errorMsg = m_pack->errorString();
+        qCritical() << "TilePack::insert" << m_errorMsg;
+        return false;
+    }
+
+    // the packed tile takes precedence, a plain file left over from before is dead weight
+    QFile::remove( m_dataDirectory + '/' + fileName );
+
+    ensureCacheLimit();
+
+    return true;
+}
+
+bool TilePackStoragePolicy::readFile( const QString &fileName, QByteArray &data ) const
+{
+    QReadLocker locker( &m_packLock );
+    return m_pack && m_pack->read( fileName, data );
+}
+
+QDateTime TilePackStoragePolicy::lastModified( const QString &fileName ) const
+{
+    QReadLocker locker( &m_packLock );
+    return m_pack ? m_pack->lastModified( fileName ) : QDateTime();
+}
+
+void TilePackStoragePolicy::clearCache()
+{
+    if ( m_pack ) {
+        m_pack->clear();
+    }
+
+    m_fileStoragePolicy.clearCache();
+}
+
+QString TilePackStoragePolicy::lastErrorMessage() const
+{
+    return m_errorMsg.isEmpty() ? m_fileStoragePolicy.lastErrorMessage() : m_errorMsg;
+}
+
+void TilePackStoragePolicy::ensureCacheLimit()
+{
+    if ( !m_pack || m_cacheLimit == 0 || quint64( m_pack->size() ) <= m_cacheLimit ) {
+        return;
+    }
+
+    // leave some room so that the pack is not shrunk on every download
+    m_pack->shrink( m_cacheLimit * 9 / 10 );
+
+    if ( m_pack->garbageSize() > m_pack->size() ) {
+        mDebug() << "TilePackStoragePolicy: compacting tile pack";
+        m_pack->compact();
+    }
+}
+
+#include "TilePackStoragePolicy.moc"
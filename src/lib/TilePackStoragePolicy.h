@@ -0,0 +1,94 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILEPACKSTORAGEPOLICY_H
+#define MARBLE_TILEPACKSTORAGEPOLICY_H
+
+#include <QReadWriteLock>
+
+#include "FileStoragePolicy.h"
+
+namespace Marble
+{
+
+class TilePack;
+
+/**
+ * @short Storage policy which keeps downloaded map tiles in a TilePack.
+ *
+ * Tile images below "maps/" are appended to a single pack file in the cache
+ * directory instead of being written as one file each. All other files, and
+ * all files while packing is disabled, are handed to a FileStoragePolicy.
+ *
+ * The pack is created when packing is enabled for the first time. Tiles which
+ * have been written to the pack before can still be read while packing is
+ * disabled, but newly downloaded tiles replace them by plain files.
+ */
+class TilePackStoragePolicy : public StoragePolicy
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Creates a new tile pack storage policy.
+         *
+         * @param dataDirectory The directory where the data should go to.
+         */
+        explicit TilePackStoragePolicy( const QString &dataDirectory = QString(), QObject *parent = 0 );
+
+        ~TilePackStoragePolicy();
+
+        /**
+         * Sets whether tiles are written to the pack. Disabled by default.
+         */
+        void setPackingEnabled( bool enabled );
+        bool isPackingEnabled() const;
+
+        /**
+         * Limits the size of the packed tiles, dropping the least recently
+         * downloaded tiles. A limit of 0 means no limit.
+         *
+         * The packed tiles are not reported by sizeChanged(), which only
+         * accounts for the plain files of the FileStoragePolicy.
+         */
+        void setCacheLimit( quint64 bytes );
+
+        bool fileExists( const QString &fileName ) const;
+
+        bool updateFile( const QString &fileName, const QByteArray &data );
+
+        bool readFile( const QString &fileName, QByteArray &data ) const;
+
+        QDateTime lastModified( const QString &fileName ) const;
+
+        void clearCache();
+
+        QString lastErrorMessage() const;
+
+    private:
+        Q_DISABLE_COPY( TilePackStoragePolicy )
+
+        static bool isTile( const QString &fileName );
+        QString packFileName() const;
+        void ensureCacheLimit();
+
+        const QString m_dataDirectory;
+        FileStoragePolicy m_fileStoragePolicy;
+
+        // m_pack is only set in the thread of the policy, other threads
+        // read it under m_packLock
+        mutable QReadWriteLock m_packLock;
+        TilePack *m_pack;
+        bool m_packingEnabled;
+        quint64 m_cacheLimit;
+        QString m_errorMsg;
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "TilePrefetcher.h"
+
+#include <cmath>
+
+#include <qmath.h>
+#include <QThread>
+
+#include "GeoDataLatLonAltBox.h"
+#include "GeoSceneTiled.h"
+#include "MarbleDebug.h"
+#include "MathHelper.h"
+#include "StackedTileLoader.h"
+#include "ViewportParams.h"
+
+namespace Marble
+{
+
+// the number of frames predicted from the motion of the map center
+static const int predictedFrames = 8;
+
+// the maximum number of tiles prefetched for a prediction
+static const int maxPredictedTiles = 64;
+
+// frames further apart in milliseconds don't belong to the same motion
+static const int maxFrameInterval = 250;
+
+// motions of less pixels per frame are not predicted
+static const qreal minFrameMotion = 1.0;
+
+// the tiles of a destination are dropped after this many milliseconds
+static const int maxDestinationAge = 3000;
+
+// Returns the vertical position of @p lat on a tiled map of height 1.
+static qreal normalizedY( qreal lat, GeoSceneTiled::Projection projection )
+{
+    if ( projection == GeoSceneTiled::Mercator ) {
+        const qreal maxLat = atan( sinh( M_PI ) );
+        return 0.5 - 0.5 * asinh( tan( qBound( -maxLat, lat, maxLat ) ) ) / M_PI;
+    }
+
+    return 0.5 - lat / M_PI;
+}
+
+TilePrefetcher::TilePrefetcher( StackedTileLoader *tileLoader, QObject *parent )
+    : QObject( parent ),
+      m_tileLoader( tileLoader ),
+      m_frameTime(),
+      m_frameInterval( 0 ),
+      m_centerLon( 0.0 ),
+      m_centerLat( 0.0 ),
+      m_radius( 0 ),
+      m_size(),
+      m_projection( Spherical ),
+      m_tileLevel( -1 ),
+      m_lonSpeed( 0.0 ),
+      m_latSpeed( 0.0 ),
+      m_destinationTime()
+{
+    connect( m_tileLoader, SIGNAL(tilePrefetched(TileId)),
+             this, SLOT(startPrefetching()) );
+    connect( m_tileLoader, SIGNAL(cleared()),
+             this, SLOT(clear()) );
+}
+
+void TilePrefetcher::setViewport( const ViewportParams *viewport, int tileLevel )
+{
+    if ( !m_tileLoader->isAsynchronous() ) {
+        return;
+    }
+
+    const qreal centerLon = viewport->centerLongitude();
+    const qreal centerLat = viewport->centerLatitude();
+
+    const bool sameScale = viewport->radius() == m_radius
+                           && viewport->size() == m_size
+                           && viewport->projection() == m_projection
+                           && tileLevel == m_tileLevel;
+    const int elapsed = m_frameTime.isValid() ? m_frameTime.elapsed() : -1;
+
+    if ( sameScale && elapsed > 0 && elapsed <= maxFrameInterval ) {
+        qreal lonDelta = centerLon - m_centerLon;
+        if ( lonDelta > M_PI ) {
+            lonDelta -= 2 * M_PI;
+        } else if ( lonDelta < -M_PI ) {
+            lonDelta += 2 * M_PI;
+        }
+
+        // the same smoothing as in the kinetic model
+        m_lonSpeed = 0.2 * m_lonSpeed + 0.8 * lonDelta / elapsed;
+        m_latSpeed = 0.2 * m_latSpeed + 0.8 * ( centerLat - m_centerLat ) / elapsed;
+        m_frameInterval = elapsed;
+    } else {
+        m_lonSpeed = 0.0;
+        m_latSpeed = 0.0;
+    }
+
+    m_frameTime.start();
+    m_centerLon = centerLon;
+    m_centerLat = centerLat;
+    m_radius = viewport->radius();
+    m_size = viewport->size();
+    m_projection = viewport->projection();
+    m_tileLevel = tileLevel;
+
+    if ( m_destinationTime.isValid() && m_destinationTime.elapsed() > maxDestinationAge ) {
+        m_destinationTiles.clear();
+        m_destinationTime = QTime();
+    }
+
+    // predictions of earlier frames are stale now
+    m_motionTiles.clear();
+
+    const qreal frameMotion = qMax( qAbs( m_lonSpeed ), qAbs( m_latSpeed ) ) * m_frameInterval * m_radius;
+    if ( frameMotion >= minFrameMotion ) {
+        // only tiles which are not visible yet are of interest
+        QSet<TileId> seen;
+        QList<TileId> visibleTiles;
+        appendTiles( *viewport, tileLevel, &seen, &visibleTiles );
+
+        for ( int frame = 1; frame <= predictedFrames && m_motionTiles.size() < maxPredictedTiles; ++frame ) {
+            const qreal lon = centerLon + m_lonSpeed * frame * m_frameInterval;
+            const qreal lat = qBound<qreal>( -M_PI / 2, centerLat + m_latSpeed * frame * m_frameInterval, M_PI / 2 );
+            const ViewportParams predicted( m_projection, lon, lat, m_radius, m_size );
+            appendTiles( predicted, tileLevel, &seen, &m_motionTiles );
+        }
+
+        m_motionTiles = m_motionTiles.mid( 0, maxPredictedTiles );
+    }
+
+    startPrefetching();
+}
+
+void TilePrefetcher::setDestination( qreal lon, qreal lat, int radius, int tileLevel )
+{
+    m_destinationTiles.clear();
+
+    if ( !m_frameTime.isValid() ) {
+        // the size of the viewport is unknown before the first frame
+        return;
+    }
+
+    const ViewportParams destination( m_projection, lon, lat, radius, m_size );
+    QSet<TileId> seen;
+    appendTiles( destination, tileLevel, &seen, &m_destinationTiles );
+    m_destinationTiles = m_destinationTiles.mid( 0, maxPredictedTiles );
+    m_destinationTime.start();
+
+    mDebug() << Q_FUNC_INFO << m_destinationTiles.size() << "tiles at level" << tileLevel;
+
+    startPrefetching();
+}
+
+void TilePrefetcher::clear()
+{
+    m_motionTiles.clear();
+    m_destinationTiles.clear();
+}
+
+void TilePrefetcher::startPrefetching()
+{
+    // leave most threads to the loads of tiles on display
+    const int maxPrefetchingTiles = qMax( 1, QThread::idealThreadCount() / 2 );
+
+    // the tiles of the next frames are needed before the destination of an animation
+    while ( m_tileLoader->prefetchingTileCount() < maxPrefetchingTiles ) {
+        if ( !m_motionTiles.isEmpty() ) {
+            m_tileLoader->prefetchTile( m_motionTiles.takeFirst() );
+        } else if ( !m_destinationTiles.isEmpty() ) {
+            m_tileLoader->prefetchTile( m_destinationTiles.takeFirst() );
+        } else {
+            break;
+        }
+    }
+}
+
+void TilePrefetcher::appendTiles( const ViewportParams &viewport, int tileLevel,
+                                  QSet<TileId> *seen, QList<TileId> *tiles ) const
+{
+    const GeoDataLatLonAltBox &box = viewport.viewLatLonAltBox();
+    const GeoSceneTiled::Projection projection = m_tileLoader->tileProjection();
+    const int columns = m_tileLoader->tileColumnCount( tileLevel );
+    const int rows = m_tileLoader->tileRowCount( tileLevel );
+
+    const qreal west = box.west();
+    const qreal east = box.crossesDateLine() ? box.east() + 2 * M_PI : box.east();
+
+    const int minX = qFloor( ( west + M_PI ) / ( 2 * M_PI ) * columns );
+    const int maxX = qMin( qFloor( ( east + M_PI ) / ( 2 * M_PI ) * columns ), minX + columns - 1 );
+    const int minY = qBound( 0, qFloor( normalizedY( box.north(), projection ) * rows ), rows - 1 );
+    const int maxY = qBound( 0, qFloor( normalizedY( box.south(), projection ) * rows ), rows - 1 );
+
+    for ( int y = minY; y <= maxY; ++y ) {
+        for ( int x = minX; x <= maxX; ++x ) {
+            const TileId id( 0, tileLevel, ( ( x % columns ) + columns ) % columns, y );
+            if ( !seen->contains( id ) ) {
+                seen->insert( id );
+                tiles->append( id );
+            }
+        }
+    }
+}
+
+}
+
+#include "TilePrefetcher.moc"
@@ -0,0 +1,98 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_TILEPREFETCHER_H
+#define MARBLE_TILEPREFETCHER_H
+
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QTime>
+
+#include "MarbleGlobal.h"
+#include "TileId.h"
+
+namespace Marble
+{
+
+class StackedTileLoader;
+class ViewportParams;
+
+/**
+ * @short Loads the texture tiles of upcoming frames ahead of time.
+ *
+ * The motion of the map center between rendered frames is extrapolated to
+ * predict the viewports of the next frames, e.g. during kinetic spinning.
+ * The tiles which become visible in them are prefetched into the cache of
+ * the StackedTileLoader. Animations may also announce the viewport they
+ * will end in.
+ *
+ * Each new frame replaces the predictions made before. Only a few prefetch
+ * jobs are running at any time, so loads of tiles on display always find
+ * free threads.
+ */
+class TilePrefetcher : public QObject
+{
+    Q_OBJECT
+
+ public:
+    explicit TilePrefetcher( StackedTileLoader *tileLoader, QObject *parent = 0 );
+
+    /**
+     * Records the viewport of a frame which has been rendered at @p tileLevel
+     * and predicts the next frames.
+     */
+    void setViewport( const ViewportParams *viewport, int tileLevel );
+
+    /**
+     * Prefetches the tiles of the viewport an animation is going to end in.
+     */
+    void setDestination( qreal lon, qreal lat, int radius, int tileLevel );
+
+ public Q_SLOTS:
+    /**
+     * Drops all predictions, e.g. after the tiles have been cleared.
+     */
+    void clear();
+
+ private Q_SLOTS:
+    void startPrefetching();
+
+ private:
+    /**
+     * Appends the tiles of @p tileLevel covering @p viewport to @p tiles,
+     * skipping and extending those in @p seen.
+     */
+    void appendTiles( const ViewportParams &viewport, int tileLevel,
+                      QSet<TileId> *seen, QList<TileId> *tiles ) const;
+
+    StackedTileLoader *const m_tileLoader;
+
+    // the last rendered frame
+    QTime m_frameTime;
+    int m_frameInterval;
+    qreal m_centerLon;
+    qreal m_centerLat;
+    int m_radius;
+    QSize m_size;
+    Projection m_projection;
+    int m_tileLevel;
+
+    // the motion of the center in radians per millisecond
+    qreal m_lonSpeed;
+    qreal m_latSpeed;
+
+    QList<TileId> m_motionTiles;
+    QList<TileId> m_destinationTiles;
+    QTime m_destinationTime;
+};
+
+}
+
+#endif
@@ -42,6 +42,12 @@ bool VectorComposer::s_overlaysLoaded( false );
 VectorComposer::VectorComposer( QObject * parent )
     : QObject( parent ),
       m_vectorMap( new VectorMap() ),
+      m_showWaterBodies( false ),
+      m_showLakes( false ),
+      m_showIce( false ),
+      m_showCoastLines( false ),
+      m_showRivers( false ),
+      m_showBorders( false ),
       m_oceanPen( QPen( Qt::NoPen ) ),
       m_oceanBrush( QBrush( QColor( 153, 179, 204 ) ) ),
       m_landPen( QPen( Qt::NoPen ) ),
@@ -50,7 +56,8 @@ VectorComposer::VectorComposer( QObject * parent )
       m_textureLandBrush( QBrush( QColor( 255, 0, 0 ) ) ),
       m_textureGlacierBrush( QBrush( QColor( 0, 255, 0 ) ) ),
       m_textureLakeBrush( QBrush( QColor( 0, 0, 0 ) ) ),
-      m_dateLineBrush( QBrush( Qt::NoBrush ) )
+      m_dateLineBrush( QBrush( Qt::NoBrush ) ),
+      m_textureMapRevision( 0 )
 {
     if ( refCounter == 0 ) {
         s_coastLinesLoaded = false;
@@ -82,6 +89,8 @@ VectorComposer::VectorComposer( QObject * parent )
     connect( s_countries, SIGNAL(initialized()), SIGNAL(datasetLoaded()) );
     connect( s_usaStates, SIGNAL(initialized()), SIGNAL(datasetLoaded()) );
     connect( s_dateLine, SIGNAL(initialized()), SIGNAL(datasetLoaded()) );
+
+    connect( this, SIGNAL(datasetLoaded()), SLOT(increaseTextureMapRevision()) );
 }
 
 VectorComposer::~VectorComposer()
@@ -148,17 +157,26 @@ void VectorComposer::loadOverlays()
 
 void VectorComposer::setShowWaterBodies( bool show )
 {
-    m_showWaterBodies = show;
+    if ( m_showWaterBodies != show ) {
+        m_showWaterBodies = show;
+        increaseTextureMapRevision();
+    }
 }
 
 void VectorComposer::setShowLakes( bool show )
 {
-    m_showLakes = show;
+    if ( m_showLakes != show ) {
+        m_showLakes = show;
+        increaseTextureMapRevision();
+    }
 }
 
 void VectorComposer::setShowIce( bool show )
 {
-    m_showIce = show;
+    if ( m_showIce != show ) {
+        m_showIce = show;
+        increaseTextureMapRevision();
+    }
 }
 
 void VectorComposer::setShowCoastLines( bool show )
@@ -176,6 +194,16 @@ void VectorComposer::setShowBorders( bool show )
     m_showBorders = show;
 }
 
+int VectorComposer::textureMapRevision() const
+{
+    return m_textureMapRevision;
+}
+
+void VectorComposer::increaseTextureMapRevision()
+{
+    ++m_textureMapRevision;
+}
+
 void VectorComposer::drawTextureMap( GeoPainter *painter, const ViewportParams *viewport )
 {
     loadCoastlines();
@@ -55,6 +55,12 @@ class VectorComposer : public QObject
     void setShowRivers( bool show );
     void setShowBorders( bool show );
 
+    /**
+     * @brief  Returns a number which changes whenever drawTextureMap() would draw
+     *         something different for the same viewport.
+     */
+    int textureMapRevision() const;
+
     /**
      * @brief  Set color of the oceans
      * @param  color  ocean color
@@ -120,6 +126,9 @@ class VectorComposer : public QObject
  Q_SIGNALS:
     void datasetLoaded();
 
+ private Q_SLOTS:
+    void increaseTextureMapRevision();
+
  private:
     // This method contains all the polygons that define the coast lines.
     static inline void loadCoastlines();
@@ -182,6 +191,8 @@ class VectorComposer : public QObject
 
     QVector<qreal> m_dashes;
 
+    int m_textureMapRevision;
+
     static bool s_coastLinesLoaded;
     static bool s_overlaysLoaded;
 };
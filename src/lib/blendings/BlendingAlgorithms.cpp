@@ -25,6 +25,18 @@
 namespace Marble
 {
 
+// Returns the image unless its color channels differ from those of the image
+// converted to ARGB32_Premultiplied, in which case the converted image is returned.
+static QImage premultipliedChannels( QImage const & image )
+{
+    if ( image.format() == QImage::Format_ARGB32_Premultiplied
+         || image.format() == QImage::Format_RGB32 ) {
+        return image;
+    }
+
+    return image.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+}
+
 void OverpaintBlending::blend( QImage * const bottom, TextureTile const * const top ) const
 {
     Q_ASSERT( bottom );
@@ -45,18 +57,18 @@ void GrayscaleBlending::blend( QImage * const bottom, TextureTile const * const
     Q_ASSERT( top->image() );
     Q_ASSERT( bottom->size() == top->image()->size() );
     Q_ASSERT( bottom->format() == QImage::Format_ARGB32_Premultiplied );
-    QImage const topImagePremult = top->image()->convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    QImage const topImagePremult = premultipliedChannels( *top->image() );
 
     // Draw a grayscale version of the bottom image
     int const width = bottom->width();
     int const height = bottom->height();
 
     for ( int y = 0; y < height; ++y ) {
+        QRgb * const bottomLine = reinterpret_cast<QRgb *>( bottom->scanLine( y ) );
+        QRgb const * const topLine = reinterpret_cast<QRgb const *>( topImagePremult.scanLine( y ) );
         for ( int x = 0; x < width; ++x ) {
-            QRgb const topPixel = topImagePremult.pixel( x, y );
-            int const gray = qGray( topPixel );
-            QRgb const grayPixel = qRgb( gray, gray, gray );
-            bottom->setPixel( x, y,grayPixel );
+            int const gray = qGray( topLine[x] );
+            bottomLine[x] = qRgb( gray, gray, gray );
         }
     }
 
@@ -75,24 +87,41 @@ void IndependentChannelBlending::blend( QImage * const bottom,
 
     int const width = bottom->width();
     int const height = bottom->height();
-    QImage const topImagePremult = topImage->convertToFormat( QImage::Format_ARGB32_Premultiplied );
+    QImage const topImagePremult = premultipliedChannels( *topImage );
+    uchar const * const table = channelTable();
+
     for ( int y = 0; y < height; ++y ) {
+        QRgb * const bottomLine = reinterpret_cast<QRgb *>( bottom->scanLine( y ) );
+        QRgb const * const topLine = reinterpret_cast<QRgb const *>( topImagePremult.scanLine( y ) );
         for ( int x = 0; x < width; ++x ) {
-            QRgb const bottomPixel = bottom->pixel( x, y );
-            QRgb const topPixel = topImagePremult.pixel( x, y );
-            qreal const resultRed = blendChannel( qRed( bottomPixel ) / 255.0,
-                                                  qRed( topPixel ) / 255.0 );
-            qreal const resultGreen = blendChannel( qGreen( bottomPixel ) / 255.0,
-                                                    qGreen( topPixel ) / 255.0 );
-            qreal const resultBlue = blendChannel( qBlue( bottomPixel ) / 255.0,
-                                                   qBlue( topPixel ) / 255.0 );
-            bottom->setPixel( x, y, qRgb( resultRed * 255.0,
-                                          resultGreen * 255.0,
-                                          resultBlue * 255.0 ));
+            QRgb const bottomPixel = bottomLine[x];
+            QRgb const topPixel = topLine[x];
+            bottomLine[x] = qRgb( table[ ( qRed( bottomPixel ) << 8 ) | qRed( topPixel ) ],
+                                  table[ ( qGreen( bottomPixel ) << 8 ) | qGreen( topPixel ) ],
+                                  table[ ( qBlue( bottomPixel ) << 8 ) | qBlue( topPixel ) ] );
         }
     }
 }
 
+uchar const * IndependentChannelBlending::channelTable() const
+{
+    QMutexLocker locker( &m_channelTableMutex );
+
+    if ( m_channelTable.isEmpty() ) {
+        m_channelTable.resize( 256 * 256 );
+        for ( int bottom = 0; bottom < 256; ++bottom ) {
+            for ( int top = 0; top < 256; ++top ) {
+                qreal const result = blendChannel( bottom / 255.0, top / 255.0 );
+                // truncate like qRgb() does
+                m_channelTable[ ( bottom << 8 ) | top ] = uchar( int( result * 255.0 ) );
+            }
+        }
+    }
+
+    // the table isn't modified once it has been filled
+    return m_channelTable.constData();
+}
+
 
 // Neutral blendings
 
@@ -320,23 +349,51 @@ qreal HalfDifferenceBlending::blendChannel( qreal const bottomColorIntensity,
 
 // Special purpose blendings
 
+CloudsBlending::CloudsBlending()
+    : m_channelTable( 256 * 256 )
+{
+    for ( int bottom = 0; bottom < 256; ++bottom ) {
+        for ( int topRed = 0; topRed < 256; ++topRed ) {
+            qreal const c = topRed / 255.0;
+            m_channelTable[ ( bottom << 8 ) | topRed ] = ( int )( bottom + ( 255 - bottom ) * c );
+        }
+    }
+}
+
 void CloudsBlending::blend( QImage * const bottom, TextureTile const * const top ) const
 {
     QImage const * const topImage = top->image();
     Q_ASSERT( topImage );
     Q_ASSERT( bottom->size() == topImage->size() );
+    Q_ASSERT( bottom->format() == QImage::Format_ARGB32_Premultiplied );
+
+    // only the red channel of the top image is used, which QImage::pixel()
+    // returns unchanged for all 32 bit formats
+    QImage topImageRgb = *topImage;
+    if ( topImageRgb.format() != QImage::Format_ARGB32_Premultiplied
+         && topImageRgb.format() != QImage::Format_ARGB32
+         && topImageRgb.format() != QImage::Format_RGB32
+         && topImageRgb.format() != QImage::Format_Indexed8 ) {
+        topImageRgb = topImageRgb.convertToFormat( QImage::Format_ARGB32 );
+    }
+
+    bool const indexed = topImageRgb.format() == QImage::Format_Indexed8;
+    QVector<QRgb> const colorTable = topImageRgb.colorTable();
+    QImage const & topImageConst = topImageRgb;
+    uchar const * const table = m_channelTable.constData();
+
     int const width = bottom->width();
     int const height = bottom->height();
     for ( int y = 0; y < height; ++y ) {
+        QRgb * const bottomLine = reinterpret_cast<QRgb *>( bottom->scanLine( y ) );
+        uchar const * const topLine = topImageConst.scanLine( y );
         for ( int x = 0; x < width; ++x ) {
-            qreal const c = qRed( topImage->pixel( x, y )) / 255.0;
-            QRgb const bottomPixel = bottom->pixel( x, y );
-            int const bottomRed = qRed( bottomPixel );
-            int const bottomGreen = qGreen( bottomPixel );
-            int const bottomBlue = qBlue( bottomPixel );
-            bottom->setPixel( x, y, qRgb(( int )( bottomRed + ( 255 - bottomRed ) * c ),
-                                         ( int )( bottomGreen + ( 255 - bottomGreen ) * c ),
-                                         ( int )( bottomBlue + ( 255 - bottomBlue ) * c )));
+            int const topRed = indexed ? qRed( colorTable[ topLine[x] ] )
+                                       : qRed( reinterpret_cast<QRgb const *>( topLine )[x] );
+            QRgb const bottomPixel = bottomLine[x];
+            bottomLine[x] = qRgb( table[ ( qRed( bottomPixel ) << 8 ) | topRed ],
+                                  table[ ( qGreen( bottomPixel ) << 8 ) | topRed ],
+                                  table[ ( qBlue( bottomPixel ) << 8 ) | topRed ] );
         }
     }
 }
@@ -17,6 +17,8 @@
 #define MARBLE_BLENDING_ALGORITHMS_H
 
 #include <QtGlobal>
+#include <QMutex>
+#include <QVector>
 
 #include "Blending.h"
 
@@ -33,13 +35,25 @@ class IndependentChannelBlending: public Blending
 {
  public:
     virtual void blend( QImage * const bottom, TextureTile const * const top ) const;
+
  private:
+    // compares blend() with the results of blendChannel() for each pixel
+    friend class BlendingAlgorithmsTest;
+
     // bottomColorIntensity: intensity of one color channel (of one pixel) of the bottom image
     // topColorIntensity: intensity of one color channel (of one pixel) of the top image
     // return: intensity of the color channel (of a given pixel) of the result image
     // all color intensity values are in the range 0..1
     virtual qreal blendChannel( qreal const bottomColorIntensity,
                                 qreal const topColorIntensity ) const = 0;
+
+    // As the channels are 8 bit, blendChannel() is evaluated once for all
+    // 256 * 256 combinations of bottom and top intensity on first use.
+    // The table is indexed by 256 * bottom + top.
+    const uchar *channelTable() const;
+
+    mutable QMutex m_channelTableMutex;
+    mutable QVector<uchar> m_channelTable;
 };
 
 
@@ -244,7 +258,12 @@ class HalfDifferenceBlending: public IndependentChannelBlending
 class CloudsBlending: public Blending
 {
  public:
+    CloudsBlending();
     virtual void blend( QImage * const bottom, TextureTile const * const top ) const;
+
+ private:
+    // resulting channel intensity, indexed by 256 * bottom + top red intensity
+    QVector<uchar> m_channelTable;
 };
 
 class GrayscaleBlending: public Blending
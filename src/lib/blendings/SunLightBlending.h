@@ -20,6 +20,7 @@
 #include <QColor>
 
 #include "Blending.h"
+#include "SunShading.h"
 
 namespace Marble
 {
@@ -36,8 +37,7 @@ class SunLightBlending: public Blending
     void setLevelZeroLayout( int levelZeroColumns, int levelZeroRows );
 
  private:
-    static int maxDivisor( int maximum, int fullLength );
-    const SunLocator * const m_sunLocator;
+    const SunShading m_sunShading;
     int m_levelZeroColumns;
     int m_levelZeroRows;
 };
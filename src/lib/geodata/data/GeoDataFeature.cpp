@@ -16,6 +16,8 @@
 #include <QDataStream>
 #include <QSize>
 #include <QPixmap>
+#include <QAtomicInt>
+#include <QMutex>
 
 #include "MarbleDirs.h"
 #include "MarbleDebug.h"
@@ -39,6 +41,10 @@ bool GeoDataFeaturePrivate::s_defaultStyleInitialized = false;
 GeoDataStyle* GeoDataFeaturePrivate::s_defaultStyle[GeoDataFeature::LastIndex];
 QMap<QString, GeoDataFeature::GeoDataVisualCategory> GeoDataFeaturePrivate::s_visualCategories;
 
+// OSM files are parsed in several threads, the first lookup fills the visual categories
+static QMutex visualCategoriesMutex;
+static QAtomicInt visualCategoriesInitialized;
+
 GeoDataFeature::GeoDataFeature()
     :d( new GeoDataFeaturePrivate() )
 {
@@ -780,9 +786,14 @@ void GeoDataFeature::unpack( QDataStream& stream )
 
 GeoDataFeature::GeoDataVisualCategory GeoDataFeature::OsmVisualCategory(const QString &keyValue )
 {
-    if( GeoDataFeaturePrivate::s_visualCategories.isEmpty() ) {
-        GeoDataFeaturePrivate::initializeOsmVisualCategories();
+    if ( !visualCategoriesInitialized.testAndSetAcquire( 1, 1 ) ) {
+        QMutexLocker locker( &visualCategoriesMutex );
+        if ( GeoDataFeaturePrivate::s_visualCategories.isEmpty() ) {
+            GeoDataFeaturePrivate::initializeOsmVisualCategories();
+        }
+        visualCategoriesInitialized.fetchAndStoreRelease( 1 );
     }
+
     return GeoDataFeaturePrivate::s_visualCategories.value( keyValue );
 }
 
@@ -220,7 +220,7 @@ GeoDataLatLonAltBox GeoDataLatLonAltBox::fromLineString(  const GeoDataLineStrin
         return GeoDataLatLonAltBox();
     }
 
-    const qreal altitude = lineString.first().altitude();
+    const qreal altitude = lineString.altitude( 0 );
 
     GeoDataLatLonAltBox temp ( GeoDataLatLonBox::fromLineString( lineString ), altitude, altitude );
 
@@ -234,13 +234,11 @@ GeoDataLatLonAltBox GeoDataLatLonAltBox::fromLineString(  const GeoDataLineStrin
         return temp;
     }
 
-    QVector<GeoDataCoordinates>::ConstIterator it( lineString.constBegin() );
-    QVector<GeoDataCoordinates>::ConstIterator itEnd( lineString.constEnd() );
-
-    for ( ; it != itEnd; ++it )
+    const int size = lineString.size();
+    for ( int i = 0; i < size; ++i )
     {
         // Get coordinates and normalize them to the desired range.
-        const qreal altitude = (it)->altitude();
+        const qreal altitude = lineString.altitude( i );
 
         // Determining the maximum and minimum latitude
         if ( altitude > maxAltitude ) maxAltitude = altitude;
@@ -624,8 +624,8 @@ GeoDataLatLonBox GeoDataLatLonBox::fromLineString(  const GeoDataLineString& lin
         return GeoDataLatLonBox();
     }
 
-    qreal lon, lat;
-    lineString.first().geoCoordinates( lon, lat );
+    qreal lon = lineString.longitude( 0 );
+    qreal lat = lineString.latitude( 0 );
     GeoDataCoordinates::normalizeLonLat( lon, lat );
 
     qreal north = lat;
@@ -660,14 +660,15 @@ GeoDataLatLonBox GeoDataLatLonBox::fromLineString(  const GeoDataLineString& lin
     int currentSign = ( lon < 0 ) ? -1 : +1;
     int previousSign = currentSign;
 
-    QVector<GeoDataCoordinates>::ConstIterator it( lineString.constBegin() );
-    QVector<GeoDataCoordinates>::ConstIterator itEnd( lineString.constEnd() );
+    const int size = lineString.size();
+    int i = 0;
 
     bool processingLastNode = false;
 
-    while( it != itEnd ) {
+    while( i < size ) {
         // Get coordinates and normalize them to the desired range.
-        (it)->geoCoordinates( lon, lat );
+        lon = lineString.longitude( i );
+        lat = lineString.latitude( i );
         GeoDataCoordinates::normalizeLonLat( lon, lat );
 
         // Determining the maximum and minimum latitude
@@ -725,10 +726,10 @@ GeoDataLatLonBox GeoDataLatLonBox::fromLineString(  const GeoDataLineString& lin
         if ( processingLastNode ) {
             break;
         }
-        ++it;
+        ++i;
 
-        if( lineString.isClosed() && it == itEnd ) {
-                it = lineString.constBegin();
+        if( lineString.isClosed() && i == size ) {
+                i = 0;
                 processingLastNode = true;
         }
     }
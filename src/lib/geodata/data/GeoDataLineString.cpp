@@ -18,9 +18,25 @@
 #include "Quaternion.h"
 #include "MarbleDebug.h"
 
+#include <QMutex>
+
 
 namespace Marble
 {
+
+// Serializes computing the caches of line strings, which may be shared by
+// several threads. Once computed, the caches are read without locking.
+static QMutex s_cacheMutex;
+
+// counts the line string privates which have been created or copied
+static QAtomicInt s_revisionCount;
+
+quint64 GeoDataLineStringPrivate::initialRevision()
+{
+    // the changes of a private count up the lower half
+    return quint64( quint32( s_revisionCount.fetchAndAddRelaxed( 1 ) + 1 ) ) << 32;
+}
+
 GeoDataLineString::GeoDataLineString( TessellationFlags f )
   : GeoDataGeometry( new GeoDataLineStringPrivate( f ) )
 {
@@ -51,6 +67,95 @@ GeoDataLineStringPrivate* GeoDataLineString::p() const
     return static_cast<GeoDataLineStringPrivate*>(d);
 }
 
+// Appends @p value to @p values, which stays empty as long as all values are zero.
+template<class T>
+static void appendOptional( QVector<T> &values, T value, int precedingCount )
+{
+    if ( values.isEmpty() ) {
+        if ( value == T() ) {
+            return;
+        }
+        values.fill( T(), precedingCount );
+    }
+
+    values.append( value );
+}
+
+template<class T>
+static void removeOptional( QVector<T> &values, int i )
+{
+    if ( !values.isEmpty() ) {
+        values.remove( i );
+    }
+}
+
+void GeoDataLineStringPrivate::append( const GeoDataCoordinates &coordinates )
+{
+    if ( m_packed ) {
+        appendNode( coordinates.longitude(), coordinates.latitude(),
+                    coordinates.altitude(), coordinates.detail() );
+    }
+    else {
+        m_vector.append( coordinates );
+    }
+}
+
+void GeoDataLineStringPrivate::appendNode( qreal lon, qreal lat, qreal alt, int detail )
+{
+    if ( !m_packed ) {
+        m_vector.append( GeoDataCoordinates( lon, lat, alt, GeoDataCoordinates::Radian, detail ) );
+        return;
+    }
+
+    const int count = m_longitudes.size();
+    appendOptional( m_altitudes, alt, count );
+    appendOptional( m_details, detail, count );
+    m_longitudes.append( lon );
+    m_latitudes.append( lat );
+}
+
+void GeoDataLineStringPrivate::remove( int i )
+{
+    if ( m_packed ) {
+        m_longitudes.remove( i );
+        m_latitudes.remove( i );
+        removeOptional( m_altitudes, i );
+        removeOptional( m_details, i );
+    }
+    else {
+        m_vector.remove( i );
+    }
+}
+
+void GeoDataLineStringPrivate::clear()
+{
+    m_longitudes.clear();
+    m_latitudes.clear();
+    m_altitudes.clear();
+    m_details.clear();
+    m_vector.clear();
+    m_packed = true;
+}
+
+void GeoDataLineStringPrivate::unpackNodes()
+{
+    if ( !m_packed ) {
+        return;
+    }
+
+    const int count = m_longitudes.size();
+    m_vector.reserve( count );
+    for ( int i = 0; i < count; ++i ) {
+        m_vector.append( coordinates( i ) );
+    }
+
+    m_packed = false;
+    m_longitudes.clear();
+    m_latitudes.clear();
+    m_altitudes.clear();
+    m_details.clear();
+}
+
 void GeoDataLineStringPrivate::interpolateDateLine( const GeoDataCoordinates & previousCoords,
                                                     const GeoDataCoordinates & currentCoords,
                                                     GeoDataCoordinates & previousAtDateLine,
@@ -128,133 +233,216 @@ GeoDataCoordinates GeoDataLineStringPrivate::findDateLine( const GeoDataCoordina
 
 bool GeoDataLineString::isEmpty() const
 {
-    return p()->m_vector.isEmpty();
+    return p()->size() == 0;
 }
 
 int GeoDataLineString::size() const
 {
-    return p()->m_vector.size();
+    return p()->size();
+}
+
+qreal GeoDataLineString::longitude( int pos ) const
+{
+    return p()->longitude( pos );
+}
+
+qreal GeoDataLineString::latitude( int pos ) const
+{
+    return p()->latitude( pos );
+}
+
+qreal GeoDataLineString::altitude( int pos ) const
+{
+    return p()->altitude( pos );
+}
+
+int GeoDataLineString::detail( int pos ) const
+{
+    return p()->detail( pos );
 }
 
 GeoDataCoordinates& GeoDataLineString::at( int pos )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->unpackNodes();
     return p()->m_vector[ pos ];
 }
 
-const GeoDataCoordinates& GeoDataLineString::at( int pos ) const
+GeoDataCoordinates GeoDataLineString::at( int pos ) const
 {
-    return p()->m_vector.at( pos );
+    return p()->coordinates( pos );
 }
 
 GeoDataCoordinates& GeoDataLineString::operator[]( int pos )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->unpackNodes();
     return p()->m_vector[ pos ];
 }
 
-const GeoDataCoordinates& GeoDataLineString::operator[]( int pos ) const
+GeoDataCoordinates GeoDataLineString::operator[]( int pos ) const
 {
-    return p()->m_vector[ pos ];
+    return p()->coordinates( pos );
 }
 
 GeoDataCoordinates& GeoDataLineString::last()
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     p()->m_dirtyRange = true;
     p()->m_dirtyBox = true;
+    p()->unpackNodes();
     return p()->m_vector.last();
 }
 
 GeoDataCoordinates& GeoDataLineString::first()
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
+    p()->unpackNodes();
     return p()->m_vector.first();
 }
 
-const GeoDataCoordinates& GeoDataLineString::last() const
+GeoDataCoordinates GeoDataLineString::last() const
 {
-    return p()->m_vector.last();
+    return p()->coordinates( p()->size() - 1 );
 }
 
-const GeoDataCoordinates& GeoDataLineString::first() const
+GeoDataCoordinates GeoDataLineString::first() const
 {
-    return p()->m_vector.first();
+    return p()->coordinates( 0 );
+}
+
+GeoDataLineString::ConstIterator GeoDataLineString::constIterator( int index ) const
+{
+    const GeoDataLineStringPrivate *const d = p();
+
+    if ( !d->m_packed ) {
+        return ConstIterator( d->m_vector.constData() + index );
+    }
+
+    return ConstIterator( d->m_longitudes.constData(), d->m_latitudes.constData(),
+                          d->m_altitudes.isEmpty() ? 0 : d->m_altitudes.constData(),
+                          d->m_details.isEmpty() ? 0 : d->m_details.constData(),
+                          index );
 }
 
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::begin()
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
+    p()->unpackNodes();
     return p()->m_vector.begin();
 }
 
-QVector<GeoDataCoordinates>::ConstIterator GeoDataLineString::begin() const
+GeoDataLineString::ConstIterator GeoDataLineString::begin() const
 {
-    return p()->m_vector.constBegin();
+    return constIterator( 0 );
 }
 
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::end()
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
+    p()->unpackNodes();
     return p()->m_vector.end();
 }
 
-QVector<GeoDataCoordinates>::ConstIterator GeoDataLineString::end() const
+GeoDataLineString::ConstIterator GeoDataLineString::end() const
 {
-    return p()->m_vector.constEnd();
+    return constIterator( p()->size() );
 }
 
-QVector<GeoDataCoordinates>::ConstIterator GeoDataLineString::constBegin() const
+GeoDataLineString::ConstIterator GeoDataLineString::constBegin() const
 {
-    return p()->m_vector.constBegin();
+    return constIterator( 0 );
 }
 
-QVector<GeoDataCoordinates>::ConstIterator GeoDataLineString::constEnd() const
+GeoDataLineString::ConstIterator GeoDataLineString::constEnd() const
 {
-    return p()->m_vector.constEnd();
+    return constIterator( p()->size() );
 }
 
 void GeoDataLineString::append ( const GeoDataCoordinates& value )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
-    d->m_vector.append( value );
+    d->append( value );
+}
+
+void GeoDataLineString::appendNode( qreal lon, qreal lat, qreal alt, int detail )
+{
+    GeoDataGeometry::detach();
+    ++p()->m_revision;
+    GeoDataLineStringPrivate* d = p();
+    delete d->m_rangeCorrected;
+    d->m_rangeCorrected = 0;
+    d->m_dirtyRange = true;
+    d->m_dirtyBox = true;
+    d->appendNode( lon, lat, alt, detail );
+}
+
+void GeoDataLineString::reserve( int size )
+{
+    GeoDataGeometry::detach();
+    GeoDataLineStringPrivate* d = p();
+    if ( d->m_packed ) {
+        d->m_longitudes.reserve( size );
+        d->m_latitudes.reserve( size );
+    }
+    else {
+        d->m_vector.reserve( size );
+    }
 }
 
 GeoDataLineString& GeoDataLineString::operator << ( const GeoDataCoordinates& value )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
-    d->m_vector.append( value );
+    d->append( value );
     return *this;
 }
 
 GeoDataLineString& GeoDataLineString::operator << ( const GeoDataLineString& value )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
 
-    QVector<GeoDataCoordinates>::const_iterator itCoords = value.constBegin();
-    QVector<GeoDataCoordinates>::const_iterator itEnd = value.constEnd();
+    const GeoDataLineStringPrivate* const other = value.p();
+    const int size = other->size();
 
-    for( ; itCoords != itEnd; ++itCoords ) {
-        d->m_vector.append( *itCoords );
+    if ( d->m_packed ) {
+        // copy the nodes without creating GeoDataCoordinates objects
+        for ( int i = 0; i < size; ++i ) {
+            d->appendNode( other->longitude( i ), other->latitude( i ),
+                           other->altitude( i ), other->detail( i ) );
+        }
+    }
+    else {
+        for ( int i = 0; i < size; ++i ) {
+            d->append( other->coordinates( i ) );
+        }
     }
 
     return *this;
@@ -263,13 +451,14 @@ GeoDataLineString& GeoDataLineString::operator << ( const GeoDataLineString& val
 void GeoDataLineString::clear()
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
 
-    d->m_vector.clear();
+    d->clear();
 }
 
 bool GeoDataLineString::isClosed() const
@@ -285,6 +474,7 @@ bool GeoDataLineString::tessellate() const
 void GeoDataLineString::setTessellate( bool tessellate )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     // According to the KML reference the tesselation of line strings in Google Earth
     // is generally done along great circles. However for subsequent points that share
     // the same latitude the latitude circles are followed. Our Tesselate and RespectLatitude
@@ -306,9 +496,16 @@ TessellationFlags GeoDataLineString::tessellationFlags() const
 
 void GeoDataLineString::setTessellationFlags( TessellationFlags f )
 {
+    GeoDataGeometry::detach();
+    ++p()->m_revision;
     p()->m_tessellationFlags = f;
 }
 
+quint64 GeoDataLineString::revision() const
+{
+    return p()->m_revision;
+}
+
 GeoDataLineString GeoDataLineString::toNormalized() const
 {
     GeoDataLineString normalizedLineString;
@@ -320,19 +517,14 @@ GeoDataLineString GeoDataLineString::toNormalized() const
 
     // FIXME: Think about how we can avoid unnecessary copies
     //        if the linestring stays the same.
-    QVector<GeoDataCoordinates>::const_iterator end = p()->m_vector.constEnd();
-    for( QVector<GeoDataCoordinates>::const_iterator itCoords
-          = p()->m_vector.constBegin();
-         itCoords != end;
-         ++itCoords ) {
-
-        itCoords->geoCoordinates( lon, lat );
-        qreal alt = itCoords->altitude();
+    const GeoDataLineStringPrivate* const d = p();
+    const int size = d->size();
+    for( int i = 0; i < size; ++i ) {
+        lon = d->longitude( i );
+        lat = d->latitude( i );
         GeoDataCoordinates::normalizeLonLat( lon, lat );
 
-        GeoDataCoordinates normalizedCoords( *itCoords );
-        normalizedCoords.set( lon, lat, alt );
-        normalizedLineString << normalizedCoords;
+        normalizedLineString.p()->appendNode( lon, lat, d->altitude( i ), d->detail( i ) );
     }
 
     return normalizedLineString;
@@ -340,16 +532,19 @@ GeoDataLineString GeoDataLineString::toNormalized() const
 
 GeoDataLineString GeoDataLineString::toRangeCorrected() const
 {
-    if ( p()->m_dirtyRange ) {
+    if ( !p()->m_dirtyRange.testAndSetAcquire( 0, 0 ) ) {
+        QMutexLocker locker( &s_cacheMutex );
 
-        delete p()->m_rangeCorrected;
+        if ( p()->m_dirtyRange ) {
+            delete p()->m_rangeCorrected;
 
-        if( isClosed() ) {
-            p()->m_rangeCorrected = new GeoDataLinearRing( toPoleCorrected() );
-        } else {
-            p()->m_rangeCorrected = new GeoDataLineString( toPoleCorrected() );
+            if( isClosed() ) {
+                p()->m_rangeCorrected = new GeoDataLinearRing( toPoleCorrected() );
+            } else {
+                p()->m_rangeCorrected = new GeoDataLineString( toPoleCorrected() );
+            }
+            p()->m_dirtyRange.fetchAndStoreRelease( 0 );
         }
-        p()->m_dirtyRange = false;
     }
 
     return *p()->m_rangeCorrected;
@@ -384,24 +579,23 @@ void GeoDataLineStringPrivate::toPoleCorrected( const GeoDataLineString& q, GeoD
     GeoDataCoordinates previousCoords;
     GeoDataCoordinates currentCoords;
 
-    if ( q.isClosed() ) {
-        if ( !( m_vector.first().isPole() ) &&
-              ( m_vector.last().isPole() ) ) {
-                qreal firstLongitude = ( m_vector.first() ).longitude();
-                GeoDataCoordinates modifiedCoords( m_vector.last() );
+    const int size = this->size();
+
+    if ( q.isClosed() && size > 0 ) {
+        if ( !( coordinates( 0 ).isPole() ) &&
+              ( coordinates( size - 1 ).isPole() ) ) {
+                qreal firstLongitude = longitude( 0 );
+                GeoDataCoordinates modifiedCoords( coordinates( size - 1 ) );
                 modifiedCoords.setLongitude( firstLongitude );
                 poleCorrected << modifiedCoords;
         }
     }
 
-    QVector<GeoDataCoordinates>::const_iterator itCoords = m_vector.constBegin();
-    QVector<GeoDataCoordinates>::const_iterator itEnd = m_vector.constEnd();
-
-    for( ; itCoords != itEnd; ++itCoords ) {
+    for( int i = 0; i < size; ++i ) {
 
-        currentCoords  = *itCoords;
+        currentCoords  = coordinates( i );
 
-        if ( itCoords == m_vector.constBegin() ) {
+        if ( i == 0 ) {
             previousCoords = currentCoords;
         }
 
@@ -432,11 +626,11 @@ void GeoDataLineStringPrivate::toPoleCorrected( const GeoDataLineString& q, GeoD
         previousCoords = currentCoords;
     }
 
-    if ( q.isClosed() ) {
-        if (  ( m_vector.first().isPole() ) &&
-             !( m_vector.last().isPole() ) ) {
-                qreal lastLongitude = ( m_vector.last() ).longitude();
-                GeoDataCoordinates modifiedCoords( m_vector.first() );
+    if ( q.isClosed() && size > 0 ) {
+        if (  ( coordinates( 0 ).isPole() ) &&
+             !( coordinates( size - 1 ).isPole() ) ) {
+                qreal lastLongitude = longitude( size - 1 );
+                GeoDataCoordinates modifiedCoords( coordinates( 0 ) );
                 modifiedCoords.setLongitude( lastLongitude );
                 poleCorrected << modifiedCoords;
         }
@@ -450,10 +644,8 @@ void GeoDataLineStringPrivate::toDateLineCorrected(
 {
     const bool isClosed = q.isClosed();
 
-    const QVector<GeoDataCoordinates>::const_iterator itStartPoint = q.constBegin();
-    const QVector<GeoDataCoordinates>::const_iterator itEndPoint = q.constEnd();
-    QVector<GeoDataCoordinates>::const_iterator itPoint = itStartPoint;
-    QVector<GeoDataCoordinates>::const_iterator itPreviousPoint = itPoint;
+    const int size = this->size();
+    GeoDataCoordinates previousPoint;
 
     TessellationFlags f = q.tessellationFlags();
 
@@ -468,12 +660,13 @@ void GeoDataLineStringPrivate::toDateLineCorrected(
 
     bool unfinished = false;
 
-    for (; itPoint != itEndPoint; ++itPoint ) {
-        currentLon = itPoint->longitude();
+    for ( int i = 0; i < size; ++i ) {
+        const GeoDataCoordinates point = coordinates( i );
+        currentLon = point.longitude();
 
         int currentSign = ( currentLon < 0.0 ) ? -1 : +1 ;
 
-        if( itPoint == q.constBegin() ) {
+        if( i == 0 ) {
             previousSign = currentSign;
             previousLon  = currentLon;
         }
@@ -486,7 +679,7 @@ void GeoDataLineStringPrivate::toDateLineCorrected(
             GeoDataCoordinates previousTemp;
             GeoDataCoordinates currentTemp;
 
-            interpolateDateLine( *itPreviousPoint, *itPoint,
+            interpolateDateLine( previousPoint, point,
                                  previousTemp, currentTemp, q.tessellationFlags() );
 
             *dateLineCorrected << previousTemp;
@@ -520,16 +713,16 @@ void GeoDataLineStringPrivate::toDateLineCorrected(
             }
 
             *dateLineCorrected << currentTemp;
-            *dateLineCorrected << *itPoint;
+            *dateLineCorrected << point;
 
         }
         else {
-            *dateLineCorrected << *itPoint;
+            *dateLineCorrected << point;
         }
 
         previousSign = currentSign;
         previousLon  = currentLon;
-        itPreviousPoint = itPoint;
+        previousPoint = point;
     }
 
     // If the line string doesn't cross the dateline an even number of times
@@ -548,10 +741,14 @@ const GeoDataLatLonAltBox& GeoDataLineString::latLonAltBox() const
     // that's why we recreate it only if the m_dirtyBox
     // is TRUE.
     // DO NOT REMOVE THIS CONSTRUCT OR MARBLE WILL BE SLOW.
-    if ( p()->m_dirtyBox ) {
-        p()->m_latLonAltBox = GeoDataLatLonAltBox::fromLineString( *this );
+    if ( !p()->m_dirtyBox.testAndSetAcquire( 0, 0 ) ) {
+        QMutexLocker locker( &s_cacheMutex );
+
+        if ( p()->m_dirtyBox ) {
+            p()->m_latLonAltBox = GeoDataLatLonAltBox::fromLineString( *this );
+            p()->m_dirtyBox.fetchAndStoreRelease( 0 );
+        }
     }
-    p()->m_dirtyBox = false;
 
     return p()->m_latLonAltBox;
 }
@@ -563,12 +760,13 @@ qreal GeoDataLineString::length( qreal planetRadius, int offset ) const
     }
 
     qreal length = 0.0;
-    QVector<GeoDataCoordinates> const & vector = p()->m_vector;
+    const GeoDataLineStringPrivate* const d = p();
     int const start = qMax(offset+1, 1);
-    int const end = p()->m_vector.size();
+    int const end = d->size();
     for( int i=start; i<end; ++i )
     {
-        length += distanceSphere( vector[i-1], vector[i] );
+        length += distanceSphere( d->longitude( i-1 ), d->latitude( i-1 ),
+                                  d->longitude( i ), d->latitude( i ) );
     }
 
     return planetRadius * length;
@@ -577,11 +775,13 @@ qreal GeoDataLineString::length( qreal planetRadius, int offset ) const
 QVector<GeoDataCoordinates>::Iterator GeoDataLineString::erase ( QVector<GeoDataCoordinates>::Iterator pos )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
+    Q_ASSERT( !d->m_packed ); // the iterator was obtained from begin() or end()
     return d->m_vector.erase( pos );
 }
 
@@ -589,21 +789,24 @@ QVector<GeoDataCoordinates>::Iterator GeoDataLineString::erase ( QVector<GeoData
                                                                  QVector<GeoDataCoordinates>::Iterator end )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     delete d->m_rangeCorrected;
     d->m_rangeCorrected = 0;
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
+    Q_ASSERT( !d->m_packed ); // the iterators were obtained from begin() or end()
     return d->m_vector.erase( begin, end );
 }
 
 void GeoDataLineString::remove ( int i )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataLineStringPrivate* d = p();
     d->m_dirtyRange = true;
     d->m_dirtyBox = true;
-    d->m_vector.remove( i );
+    d->remove( i );
 }
 
 void GeoDataLineString::pack( QDataStream& stream ) const
@@ -613,13 +816,8 @@ void GeoDataLineString::pack( QDataStream& stream ) const
     stream << size();
     stream << (qint32)(p()->m_tessellationFlags);
 
-    for( QVector<GeoDataCoordinates>::const_iterator iterator
-          = p()->m_vector.constBegin();
-         iterator != p()->m_vector.constEnd();
-         ++iterator ) {
-        mDebug() << "innerRing: size" << p()->m_vector.size();
-        GeoDataCoordinates coord = ( *iterator );
-        coord.pack( stream );
+    for( int i = 0; i < size(); ++i ) {
+        p()->coordinates( i ).pack( stream );
     }
 
 }
@@ -627,6 +825,7 @@ void GeoDataLineString::pack( QDataStream& stream ) const
 void GeoDataLineString::unpack( QDataStream& stream )
 {
     GeoDataGeometry::detach();
+    ++p()->m_revision;
     GeoDataGeometry::unpack( stream );
     qint32 size;
     qint32 tessellationFlags;
@@ -639,7 +838,7 @@ void GeoDataLineString::unpack( QDataStream& stream )
     for(qint32 i = 0; i < size; i++ ) {
         GeoDataCoordinates coord;
         coord.unpack( stream );
-        p()->m_vector.append( coord );
+        p()->append( coord );
     }
 }
 
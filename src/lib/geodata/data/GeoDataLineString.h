@@ -13,6 +13,8 @@
 #ifndef MARBLE_GEODATALINESTRING_H
 #define MARBLE_GEODATALINESTRING_H
 
+#include <iterator>
+
 #include <QFlags>
 #include <QVector>
 #include <QMetaType>
@@ -53,6 +55,23 @@ class GeoDataLineStringPrivate;
     The API which provides access to the nodes is similar to the API of
     QVector.
 
+    Internally the nodes are kept as packed arrays of longitudes, latitudes
+    and altitudes. The first call of a non-const method which returns a
+    reference to or an iterator over the GeoDataCoordinates of the nodes
+    converts them into GeoDataCoordinates objects, which need considerably
+    more memory. The const methods never do so: they return copies, and
+    ConstIterator creates the GeoDataCoordinates of the node it points to on
+    demand. Hence line strings may be read concurrently. Code which only reads
+    the nodes should prefer longitude(), latitude(), altitude() and detail().
+
+    \note Since the introduction of the packed nodes the const overloads of
+    at(), operator[](), first() and last() as well as ConstIterator::operator*()
+    return GeoDataCoordinates by value instead of by const reference. This
+    changes the source and binary interface: callers which take the address of
+    the result or keep a reference to it beyond the full expression have to
+    keep a copy instead. Binding the result to a const reference is still
+    fine, it just binds to a temporary copy.
+
     GeoDataLineString allows LineStrings to be tessellated in order to make them
     follow the terrain and the curvature of the earth. The tessellation options
     allow for different ways of visualization:
@@ -77,8 +96,105 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
 
  public:
     typedef QVector<GeoDataCoordinates>::Iterator Iterator;
-    typedef QVector<GeoDataCoordinates>::ConstIterator ConstIterator;
-    typedef QVector<GeoDataCoordinates>::const_iterator const_iterator;
+
+    /*!
+        \brief A random access iterator over the nodes which doesn't unpack them.
+
+        Dereferencing the iterator returns a copy of the node, so the result
+        stays valid independently of the iterator and the line string.
+    */
+    class ConstIterator
+    {
+     public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef int difference_type;
+        typedef GeoDataCoordinates value_type;
+        typedef GeoDataCoordinates reference;
+
+        // keeps the copy returned by operator*() alive for operator->()
+        class ArrowProxy
+        {
+         public:
+            explicit ArrowProxy( const GeoDataCoordinates &node ) : m_node( node ) {}
+            const GeoDataCoordinates *operator->() const { return &m_node; }
+
+         private:
+            GeoDataCoordinates m_node;
+        };
+
+        typedef ArrowProxy pointer;
+
+        ConstIterator()
+            : m_nodes( 0 ), m_longitudes( 0 ), m_latitudes( 0 ), m_altitudes( 0 ), m_details( 0 ),
+              m_index( 0 )
+        {}
+
+        // iterates over unpacked nodes, e.g. from the non-const begin()
+        ConstIterator( const GeoDataCoordinates *node )
+            : m_nodes( node ), m_longitudes( 0 ), m_latitudes( 0 ), m_altitudes( 0 ), m_details( 0 ),
+              m_index( 0 )
+        {}
+
+        GeoDataCoordinates operator*() const
+        {
+            if ( m_nodes ) {
+                return m_nodes[ m_index ];
+            }
+
+            return GeoDataCoordinates( m_longitudes[ m_index ], m_latitudes[ m_index ],
+                                       m_altitudes ? m_altitudes[ m_index ] : 0.0,
+                                       GeoDataCoordinates::Radian,
+                                       m_details ? m_details[ m_index ] : 0 );
+        }
+
+        ArrowProxy operator->() const { return ArrowProxy( **this ); }
+        GeoDataCoordinates operator[]( int i ) const { return *( *this + i ); }
+
+        ConstIterator &operator++() { ++m_index; return *this; }
+        ConstIterator operator++( int ) { ConstIterator result = *this; ++m_index; return result; }
+        ConstIterator &operator--() { --m_index; return *this; }
+        ConstIterator operator--( int ) { ConstIterator result = *this; --m_index; return result; }
+        ConstIterator &operator+=( int n ) { m_index += n; return *this; }
+        ConstIterator &operator-=( int n ) { m_index -= n; return *this; }
+        ConstIterator operator+( int n ) const { ConstIterator result = *this; result.m_index += n; return result; }
+        ConstIterator operator-( int n ) const { ConstIterator result = *this; result.m_index -= n; return result; }
+
+        int operator-( const ConstIterator &other ) const
+        {
+            if ( m_nodes ) {
+                return ( m_nodes + m_index ) - ( other.m_nodes + other.m_index );
+            }
+
+            return ( m_longitudes + m_index ) - ( other.m_longitudes + other.m_index );
+        }
+
+        bool operator==( const ConstIterator &other ) const { return *this - other == 0; }
+        bool operator!=( const ConstIterator &other ) const { return *this - other != 0; }
+        bool operator<( const ConstIterator &other ) const { return *this - other < 0; }
+        bool operator<=( const ConstIterator &other ) const { return *this - other <= 0; }
+        bool operator>( const ConstIterator &other ) const { return *this - other > 0; }
+        bool operator>=( const ConstIterator &other ) const { return *this - other >= 0; }
+
+     private:
+        friend class GeoDataLineString;
+
+        // iterates over packed nodes
+        ConstIterator( const qreal *longitudes, const qreal *latitudes,
+                       const qreal *altitudes, const int *details, int index )
+            : m_nodes( 0 ), m_longitudes( longitudes ), m_latitudes( latitudes ),
+              m_altitudes( altitudes ), m_details( details ),
+              m_index( index )
+        {}
+
+        const GeoDataCoordinates *m_nodes;
+        const qreal *m_longitudes;
+        const qreal *m_latitudes;
+        const qreal *m_altitudes;
+        const int *m_details;
+        int m_index;
+    };
+
+    typedef ConstIterator const_iterator;
 
 
 /*!
@@ -138,6 +254,17 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
     void setTessellationFlags( TessellationFlags f );
 
 
+/*!
+    \brief Returns a number which changes whenever the LineString is changed.
+
+    Caches of data derived from the LineString can compare it to find out
+    whether they are outdated. Like the cached latLonAltBox(), it counts the
+    non-const access to a node as the change, not the later assignment
+    through the returned reference.
+*/
+    quint64 revision() const;
+
+
 /*!
     \brief Returns the smallest latLonAltBox that contains the LineString.
 
@@ -217,6 +344,34 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
     int size() const;
 
 
+/*!
+    \brief Returns the longitude of the node at a given position in radian.
+    Unlike at() this method doesn't unpack the nodes of the line string.
+*/
+    qreal longitude( int pos ) const;
+
+
+/*!
+    \brief Returns the latitude of the node at a given position in radian.
+    Unlike at() this method doesn't unpack the nodes of the line string.
+*/
+    qreal latitude( int pos ) const;
+
+
+/*!
+    \brief Returns the altitude of the node at a given position.
+    Unlike at() this method doesn't unpack the nodes of the line string.
+*/
+    qreal altitude( int pos ) const;
+
+
+/*!
+    \brief Returns the detail level of the node at a given position.
+    Unlike at() this method doesn't unpack the nodes of the line string.
+*/
+    int detail( int pos ) const;
+
+
 /*!
     \brief Returns a reference to the coordinates of a node at a given position.
     This method detaches the returned coordinate object from the line string.
@@ -225,10 +380,11 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
 
 
 /*!
-    \brief Returns a reference to the coordinates of a node at a given position.
-    This method does not detach the returned coordinate object from the line string.
+    \brief Returns the coordinates of a node at a given position.
+    Unlike the non-const overload this method doesn't unpack the nodes of the line string
+    and returns a copy of the node.
 */
-    const GeoDataCoordinates& at( int pos ) const;
+    GeoDataCoordinates at( int pos ) const;
 
 
 /*!
@@ -239,10 +395,11 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
 
 
 /*!
-    \brief Returns a reference to the coordinates of a node at a given position.
-    This method does not detach the returned coordinate object from the line string.
+    \brief Returns the coordinates of a node at a given position.
+    Unlike the non-const overload this method doesn't unpack the nodes of the line string
+    and returns a copy of the node.
 */
-    const GeoDataCoordinates& operator[]( int pos ) const;
+    GeoDataCoordinates operator[]( int pos ) const;
 
 
 /*!
@@ -253,10 +410,11 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
 
 
 /*!
-    \brief Returns a reference to the first node in the LineString.
-    This method does not detach the returned coordinate object from the line string.
+    \brief Returns the first node in the LineString.
+    Unlike the non-const overload this method doesn't unpack the nodes of the line string
+    and returns a copy of the node.
 */
-    const GeoDataCoordinates& first() const;
+    GeoDataCoordinates first() const;
 
 
 /*!
@@ -267,10 +425,11 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
 
 
 /*!
-    \brief Returns a reference to the last node in the LineString.
-    This method does not detach the returned coordinate object from the line string.
+    \brief Returns the last node in the LineString.
+    Unlike the non-const overload this method doesn't unpack the nodes of the line string
+    and returns a copy of the node.
 */
-    const GeoDataCoordinates& last() const;
+    GeoDataCoordinates last() const;
 
 
 /*!
@@ -279,6 +438,20 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
     void append ( const GeoDataCoordinates& position );
 
 
+/*!
+    \brief Appends a node given in radian to the LineString.
+    Unlike append() this method doesn't need a GeoDataCoordinates object and
+    doesn't unpack the nodes of the line string.
+*/
+    void appendNode( qreal lon, qreal lat, qreal alt = 0.0, int detail = 0 );
+
+
+/*!
+    \brief Reserves memory for @p size nodes, to be filled by appending nodes.
+*/
+    void reserve( int size );
+
+
 /*!
     \brief Appends a given geodesic position as a new node to the LineString.
 */
@@ -295,26 +468,26 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
     \brief Returns an iterator that points to the begin of the LineString.
 */
     QVector<GeoDataCoordinates>::Iterator begin();
-    QVector<GeoDataCoordinates>::ConstIterator begin() const;
+    ConstIterator begin() const;
 
 
 /*!
     \brief Returns an iterator that points to the end of the LineString.
 */
     QVector<GeoDataCoordinates>::Iterator end();
-    QVector<GeoDataCoordinates>::ConstIterator end() const;
+    ConstIterator end() const;
 
 
 /*!
     \brief Returns a const iterator that points to the begin of the LineString.
 */
-    QVector<GeoDataCoordinates>::ConstIterator constBegin() const;
+    ConstIterator constBegin() const;
 
 
 /*!
     \brief Returns a const iterator that points to the end of the LineString.
 */
-    QVector<GeoDataCoordinates>::ConstIterator constEnd() const;
+    ConstIterator constEnd() const;
 
 
 /*!
@@ -360,6 +533,9 @@ class GEODATA_EXPORT GeoDataLineString : public GeoDataGeometry
  protected:
     GeoDataLineStringPrivate *p() const;
     GeoDataLineString(GeoDataLineStringPrivate* priv);
+
+ private:
+    ConstIterator constIterator( int index ) const;
 };
 
 }
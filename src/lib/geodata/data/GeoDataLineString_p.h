@@ -15,6 +15,8 @@
 
 #include "GeoDataTypes.h"
 
+#include <QAtomicInt>
+
 namespace Marble
 {
 
@@ -22,17 +24,21 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
 {
   public:
     GeoDataLineStringPrivate( TessellationFlags f )
-        :  m_rangeCorrected( 0 ),
+        :  m_packed( true ),
+           m_rangeCorrected( 0 ),
            m_dirtyRange( true ),
            m_dirtyBox( true ),
-           m_tessellationFlags( f )
+           m_tessellationFlags( f ),
+           m_revision( initialRevision() )
     {
     }
 
     GeoDataLineStringPrivate()
-         : m_rangeCorrected( 0 ),
+         : m_packed( true ),
+           m_rangeCorrected( 0 ),
            m_dirtyRange( true ),
-           m_dirtyBox( true )
+           m_dirtyBox( true ),
+           m_revision( initialRevision() )
     {
     }
 
@@ -45,11 +51,19 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
     {
         GeoDataGeometryPrivate::operator=( other );
         m_vector = other.m_vector;
+        m_longitudes = other.m_longitudes;
+        m_latitudes = other.m_latitudes;
+        m_altitudes = other.m_altitudes;
+        m_details = other.m_details;
+        m_packed = other.m_packed;
         m_rangeCorrected = 0;
         m_dirtyRange = true;
+        // another thread may be computing the box of other, it is complete once it isn't dirty
+        const bool dirtyBox = !other.m_dirtyBox.testAndSetAcquire( 0, 0 );
         m_latLonAltBox = other.m_latLonAltBox;
-        m_dirtyBox = other.m_dirtyBox;
+        m_dirtyBox = dirtyBox;
         m_tessellationFlags = other.m_tessellationFlags;
+        m_revision = initialRevision();
     }
 
 
@@ -70,6 +84,63 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
         return GeoDataLineStringId;
     }
 
+    int size() const
+    {
+        return m_packed ? m_longitudes.size() : m_vector.size();
+    }
+
+    qreal longitude( int i ) const
+    {
+        return m_packed ? m_longitudes[ i ] : m_vector[ i ].longitude();
+    }
+
+    qreal latitude( int i ) const
+    {
+        return m_packed ? m_latitudes[ i ] : m_vector[ i ].latitude();
+    }
+
+    qreal altitude( int i ) const
+    {
+        if ( !m_packed )
+            return m_vector[ i ].altitude();
+
+        return m_altitudes.isEmpty() ? 0.0 : m_altitudes[ i ];
+    }
+
+    int detail( int i ) const
+    {
+        if ( !m_packed )
+            return m_vector[ i ].detail();
+
+        return m_details.isEmpty() ? 0 : m_details[ i ];
+    }
+
+    GeoDataCoordinates coordinates( int i ) const
+    {
+        if ( !m_packed )
+            return m_vector[ i ];
+
+        return GeoDataCoordinates( longitude( i ), latitude( i ), altitude( i ),
+                                   GeoDataCoordinates::Radian, detail( i ) );
+    }
+
+    /**
+     * Returns a revision which no other private started with.
+     */
+    static quint64 initialRevision();
+
+    void append( const GeoDataCoordinates &coordinates );
+    void appendNode( qreal lon, qreal lat, qreal alt, int detail );
+    void remove( int i );
+    void clear();
+
+    /**
+     * Moves the nodes into m_vector. This is needed as soon as non-const
+     * references to the GeoDataCoordinates of the nodes are handed out, so
+     * it may only be called after detaching.
+     */
+    void unpackNodes();
+
     void toPoleCorrected( const GeoDataLineString & q, GeoDataLineString & poleCorrected );
 
     void toDateLineCorrected( const GeoDataLineString & q,
@@ -85,15 +156,33 @@ class GeoDataLineStringPrivate : public GeoDataGeometryPrivate
                        const GeoDataCoordinates & currentCoords,
                        int recursionCounter );
 
+    // The nodes are stored as plain arrays (one entry per node) as long as no
+    // references to GeoDataCoordinates objects have been handed out. This saves
+    // one heap allocated GeoDataCoordinatesPrivate per node. m_altitudes and
+    // m_details stay empty as long as all their values are zero.
+    QVector<qreal>              m_longitudes;
+    QVector<qreal>              m_latitudes;
+    QVector<qreal>              m_altitudes;
+    QVector<int>                m_details;
+
+    // Holds the nodes once they got unpacked, empty while m_packed is true.
     QVector<GeoDataCoordinates> m_vector;
+    bool                        m_packed;
 
+    // The range corrected copy and the LatLonAltBox are computed on demand,
+    // possibly by several threads which share the line string. They are
+    // computed under GeoDataLineString's cache mutex and the dirty flags are
+    // cleared with release semantics afterwards.
     GeoDataLineString*          m_rangeCorrected;
-    bool                        m_dirtyRange;
+    mutable QAtomicInt          m_dirtyRange;
 
-    bool                        m_dirtyBox; // tells whether there have been changes to the
+    mutable QAtomicInt          m_dirtyBox; // tells whether there have been changes to the
                                             // GeoDataPoints since the LatLonAltBox has 
                                             // been calculated. Saves performance. 
     TessellationFlags           m_tessellationFlags;
+
+    // increased by every non-const access to the line string
+    quint64                     m_revision;
 };
 
 } // namespace Marble
@@ -41,7 +41,13 @@ qreal GeoDataLinearRing::length( qreal planetRadius, int offset ) const
 {
     qreal  length = GeoDataLineString::length( planetRadius, offset );
 
-    return length + planetRadius * distanceSphere( last(), first() );
+    if ( isEmpty() ) {
+        return length;
+    }
+
+    const int lastIndex = size() - 1;
+    return length + planetRadius * distanceSphere( longitude( lastIndex ), latitude( lastIndex ),
+                                                   longitude( 0 ), latitude( 0 ) );
 }
 
 bool GeoDataLinearRing::contains( const GeoDataCoordinates &coordinates ) const
@@ -55,13 +61,18 @@ bool GeoDataLinearRing::contains( const GeoDataCoordinates &coordinates ) const
     bool inside = false; // also true for points = 0
     int j = points - 1;
 
-    for ( int i=0; i<points; ++i ) {
-        GeoDataCoordinates const & one = at( i );
-        GeoDataCoordinates const & two = at( j );
+    qreal const lon = coordinates.longitude();
+    qreal const lat = coordinates.latitude();
 
-        if ( ( one.longitude() < coordinates.longitude() && two.longitude() >= coordinates.longitude() ) ||
-             ( two.longitude() < coordinates.longitude() && one.longitude() >= coordinates.longitude() ) ) {
-            if ( one.latitude() + ( coordinates.longitude() - one.longitude()) / ( two.longitude() - one.longitude()) * ( two.latitude()-one.latitude() ) < coordinates.latitude() ) {
+    for ( int i=0; i<points; ++i ) {
+        qreal const oneLon = longitude( i );
+        qreal const oneLat = latitude( i );
+        qreal const twoLon = longitude( j );
+        qreal const twoLat = latitude( j );
+
+        if ( ( oneLon < lon && twoLon >= lon ) ||
+             ( twoLon < lon && oneLon >= lon ) ) {
+            if ( oneLat + ( lon - oneLon ) / ( twoLon - oneLon ) * ( twoLat - oneLat ) < lat ) {
                 inside = !inside;
             }
         }
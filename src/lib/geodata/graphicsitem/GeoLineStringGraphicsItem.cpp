@@ -15,18 +15,30 @@
 #include "GeoPainter.h"
 #include "ViewportParams.h"
 #include "GeoDataStyle.h"
+#include "LineStringPyramid.h"
 
 namespace Marble
 {
 
 GeoLineStringGraphicsItem::GeoLineStringGraphicsItem( const GeoDataFeature *feature, const GeoDataLineString* lineString )
         : GeoGraphicsItem( feature ),
-          m_lineString( lineString )
+          m_lineString( lineString ),
+          m_pyramid( new LineStringPyramid( lineString ) ),
+          m_projected( false )
 {
 }
 
+GeoLineStringGraphicsItem::~GeoLineStringGraphicsItem()
+{
+    delete m_pyramid;
+}
+
 void GeoLineStringGraphicsItem::setLineString( const GeoDataLineString* lineString )
 {
+    delete m_pyramid;
+    m_pyramid = 0;
+    m_screenPolygons.clear();
+
     m_lineString = lineString;
 }
 
@@ -35,6 +47,17 @@ const GeoDataLatLonAltBox& GeoLineStringGraphicsItem::latLonAltBox() const
     return m_lineString->latLonAltBox();
 }
 
+const GeoDataLineString *GeoLineStringGraphicsItem::paintedLineString( const ViewportParams *viewport )
+{
+    return m_pyramid ? m_pyramid->lineString( viewport->angularResolution() ) : m_lineString;
+}
+
+void GeoLineStringGraphicsItem::project( const ViewportParams *viewport )
+{
+    m_screenPolygons.project( viewport, *paintedLineString( viewport ) );
+    m_projected = true;
+}
+
 void GeoLineStringGraphicsItem::paint( GeoPainter* painter, const ViewportParams* viewport )
 {
     LabelPositionFlags labelPositionFlags = NoLabel;
@@ -100,7 +123,14 @@ void GeoLineStringGraphicsItem::paint( GeoPainter* painter, const ViewportParams
         }
     }
 
-    painter->drawPolyline( *m_lineString, feature()->name(), labelPositionFlags );
+    if ( m_projected ) {
+        painter->drawPolyline( m_screenPolygons.polygons(), feature()->name(), labelPositionFlags );
+        m_screenPolygons.release();
+        m_projected = false;
+    }
+    else {
+        painter->drawPolyline( *paintedLineString( viewport ), feature()->name(), labelPositionFlags );
+    }
 
     painter->restore();
 }
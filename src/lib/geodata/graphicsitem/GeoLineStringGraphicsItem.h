@@ -12,6 +12,7 @@
 #define MARBLE_GEOLINESTRINGGRAPHICSITEM_H
 
 #include "GeoGraphicsItem.h"
+#include "ScreenPolygonCache.h"
 #include "marble_export.h"
 
 namespace Marble
@@ -19,20 +20,39 @@ namespace Marble
 
 class GeoDataLineString;
 class GeoDataLineStyle;
+class LineStringPyramid;
 
 class MARBLE_EXPORT GeoLineStringGraphicsItem : public GeoGraphicsItem
 {
 public:
     explicit GeoLineStringGraphicsItem( const GeoDataFeature *feature, const GeoDataLineString *lineString );
+    ~GeoLineStringGraphicsItem();
 
+    /**
+     * Replaces the line string painted. Line strings which change like this
+     * are painted without simplification.
+     */
     void setLineString( const GeoDataLineString* lineString );
 
     virtual const GeoDataLatLonAltBox& latLonAltBox() const;
 
+    virtual void project( const ViewportParams *viewport );
+
     virtual void paint( GeoPainter* painter, const ViewportParams *viewport );
 
 protected:
     const GeoDataLineString *m_lineString;
+
+private:
+    Q_DISABLE_COPY( GeoLineStringGraphicsItem )
+
+    const GeoDataLineString *paintedLineString( const ViewportParams *viewport );
+
+    LineStringPyramid *m_pyramid;
+
+    // the screen polygons for the next call of paint()
+    ScreenPolygonCache m_screenPolygons;
+    bool m_projected;
 };
 
 }
@@ -15,6 +15,7 @@
 #include "GeoPainter.h"
 #include "ViewportParams.h"
 #include "GeoDataStyle.h"
+#include "LineStringPyramid.h"
 
 namespace Marble
 {
@@ -22,15 +23,32 @@ namespace Marble
 GeoPolygonGraphicsItem::GeoPolygonGraphicsItem( const GeoDataFeature *feature, const GeoDataPolygon* polygon )
         : GeoGraphicsItem( feature ),
           m_polygon( polygon ),
-          m_ring( 0 )
+          m_ring( 0 ),
+          m_projected( false )
 {
+    m_rings.append( &polygon->outerBoundary() );
+    foreach ( const GeoDataLinearRing &innerBoundary, polygon->innerBoundaries() ) {
+        m_rings.append( &innerBoundary );
+    }
+
+    foreach ( const GeoDataLineString *ring, m_rings ) {
+        m_pyramids.append( new LineStringPyramid( ring ) );
+    }
 }
 
 GeoPolygonGraphicsItem::GeoPolygonGraphicsItem( const GeoDataFeature *feature, const GeoDataLinearRing* ring )
         : GeoGraphicsItem( feature ),
           m_polygon( 0 ),
-          m_ring( ring )
+          m_ring( ring ),
+          m_projected( false )
 {
+    m_rings.append( ring );
+    m_pyramids.append( new LineStringPyramid( ring ) );
+}
+
+GeoPolygonGraphicsItem::~GeoPolygonGraphicsItem()
+{
+    qDeleteAll( m_pyramids );
 }
 
 const GeoDataLatLonAltBox& GeoPolygonGraphicsItem::latLonAltBox() const
@@ -44,10 +62,43 @@ const GeoDataLatLonAltBox& GeoPolygonGraphicsItem::latLonAltBox() const
     }
 }
 
-void GeoPolygonGraphicsItem::paint( GeoPainter* painter, const ViewportParams* viewport )
+const GeoDataPolygon &GeoPolygonGraphicsItem::simplifiedPolygon( qreal angularResolution )
 {
-    Q_UNUSED( viewport );
+    QVector<const GeoDataLineString *> rings;
+    rings.reserve( m_pyramids.size() );
+    foreach ( LineStringPyramid *pyramid, m_pyramids ) {
+        rings.append( pyramid->lineString( angularResolution ) );
+    }
+
+    if ( rings == m_rings ) {
+        return *m_polygon;
+    }
+
+    if ( rings != m_simplifiedRings ) {
+        m_simplifiedRings = rings;
+        m_simplifiedPolygon = GeoDataPolygon( m_polygon->tessellationFlags() );
+        m_simplifiedPolygon.setOuterBoundary( *static_cast<const GeoDataLinearRing *>( rings.first() ) );
+        for ( int i = 1; i < rings.size(); ++i ) {
+            m_simplifiedPolygon.appendInnerBoundary( *static_cast<const GeoDataLinearRing *>( rings[i] ) );
+        }
+    }
 
+    return m_simplifiedPolygon;
+}
+
+void GeoPolygonGraphicsItem::project( const ViewportParams *viewport )
+{
+    if ( m_polygon ) {
+        m_screenPolygons.project( viewport, simplifiedPolygon( viewport->angularResolution() ) );
+    } else if ( m_ring ) {
+        m_screenPolygons.project( viewport, *m_pyramids.first()->lineString( viewport->angularResolution() ) );
+    }
+
+    m_projected = true;
+}
+
+void GeoPolygonGraphicsItem::paint( GeoPainter* painter, const ViewportParams* viewport )
+{
     painter->save();
 
     if ( !style() ) {
@@ -94,10 +145,15 @@ void GeoPolygonGraphicsItem::paint( GeoPainter* painter, const ViewportParams* v
         }
     }
 
-    if ( m_polygon ) {
-        painter->drawPolygon( *m_polygon );
+    if ( m_projected ) {
+        painter->drawPolygon( m_screenPolygons.polygons(), m_screenPolygons.outline() );
+        m_screenPolygons.release();
+        m_projected = false;
+    } else if ( m_polygon ) {
+        painter->drawPolygon( simplifiedPolygon( viewport->angularResolution() ) );
     } else if ( m_ring ) {
-        painter->drawPolygon( *m_ring );
+        const GeoDataLineString *ring = m_pyramids.first()->lineString( viewport->angularResolution() );
+        painter->drawPolygon( *static_cast<const GeoDataLinearRing *>( ring ) );
     }
 
     painter->restore();
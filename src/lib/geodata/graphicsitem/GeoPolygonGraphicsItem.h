@@ -11,28 +11,55 @@
 #ifndef MARBLE_GEOPOLYGONGRAPHICSITEM_H
 #define MARBLE_GEOPOLYGONGRAPHICSITEM_H
 
+#include <QVector>
+
+#include "GeoDataPolygon.h"
 #include "GeoGraphicsItem.h"
+#include "ScreenPolygonCache.h"
 #include "marble_export.h"
 
 namespace Marble
 {
 
-class GeoDataLinearRing;
-class GeoDataPolygon;
+class GeoDataLineString;
+class LineStringPyramid;
 
 class MARBLE_EXPORT GeoPolygonGraphicsItem : public GeoGraphicsItem
 {
 public:
     explicit GeoPolygonGraphicsItem( const GeoDataFeature *feature, const GeoDataPolygon* polygon );
     explicit GeoPolygonGraphicsItem( const GeoDataFeature *feature, const GeoDataLinearRing* ring );
+    ~GeoPolygonGraphicsItem();
 
     virtual const GeoDataLatLonAltBox& latLonAltBox() const;
 
+    virtual void project( const ViewportParams *viewport );
+
     virtual void paint( GeoPainter* painter, const ViewportParams *viewport );
 
 protected:
     const GeoDataPolygon *const m_polygon;
     const GeoDataLinearRing *const m_ring;
+
+private:
+    Q_DISABLE_COPY( GeoPolygonGraphicsItem )
+
+    /**
+     * Returns the polygon to paint at @p angularResolution, made of the
+     * simplified outer and inner boundaries.
+     */
+    const GeoDataPolygon &simplifiedPolygon( qreal angularResolution );
+
+    // one for each boundary, the outer one first
+    QVector<LineStringPyramid *> m_pyramids;
+    QVector<const GeoDataLineString *> m_rings;
+
+    QVector<const GeoDataLineString *> m_simplifiedRings;
+    GeoDataPolygon m_simplifiedPolygon;
+
+    // the screen polygons for the next call of paint()
+    ScreenPolygonCache m_screenPolygons;
+    bool m_projected;
 };
 
 }
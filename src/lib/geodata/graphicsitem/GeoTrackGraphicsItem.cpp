@@ -28,6 +28,13 @@ void GeoTrackGraphicsItem::setTrack( const GeoDataTrack* track )
     update();
 }
 
+void GeoTrackGraphicsItem::project( const ViewportParams *viewport )
+{
+    update();
+
+    GeoLineStringGraphicsItem::project( viewport );
+}
+
 void GeoTrackGraphicsItem::paint( GeoPainter *painter, const ViewportParams *viewport )
 {
     update();
@@ -26,6 +26,8 @@ public:
 
     void setTrack( const GeoDataTrack *track );
 
+    virtual void project( const ViewportParams *viewport );
+
     virtual void paint( GeoPainter *painter, const ViewportParams *viewport );
 
 private:
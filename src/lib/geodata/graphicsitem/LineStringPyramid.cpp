@@ -0,0 +1,294 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "LineStringPyramid.h"
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+
+#include <cmath>
+#include <limits>
+
+#include <qmath.h>
+
+#include "GeoDataLinearRing.h"
+
+namespace Marble
+{
+
+// line strings with fewer nodes are painted as they are
+static const int minimumNodeCount = 64;
+
+// levels which keep a larger share of the nodes are not worth their memory
+static const qreal maximumKeptShare = 0.75;
+
+namespace
+{
+
+struct Vector
+{
+    qreal x;
+    qreal y;
+    qreal z;
+};
+
+inline Vector cross( const Vector &a, const Vector &b )
+{
+    const Vector result = { a.y * b.z - a.z * b.y,
+                            a.z * b.x - a.x * b.z,
+                            a.x * b.y - a.y * b.x };
+    return result;
+}
+
+inline qreal dot( const Vector &a, const Vector &b )
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline qreal chord( const Vector &a, const Vector &b )
+{
+    const Vector delta = { a.x - b.x, a.y - b.y, a.z - b.z };
+    return sqrt( dot( delta, delta ) );
+}
+
+/**
+ * Returns the approximate angular distance of @p p to the great circle arc
+ * from @p a to @p b.
+ */
+qreal distanceToArc( const Vector &p, const Vector &a, const Vector &b )
+{
+    const Vector normal = cross( a, b );
+    const qreal length = sqrt( dot( normal, normal ) );
+
+    // the arc is too short (or too ambiguous) to define a great circle
+    if ( length < 1e-12 ) {
+        return qMin( chord( p, a ), chord( p, b ) );
+    }
+
+    // the closest point of the great circle is beyond one of the ends of the arc
+    if ( dot( cross( a, p ), normal ) < 0 || dot( cross( p, b ), normal ) < 0 ) {
+        return qMin( chord( p, a ), chord( p, b ) );
+    }
+
+    return qAbs( dot( p, normal ) ) / length;
+}
+
+struct Range
+{
+    int first;
+    int last;
+    float tolerance;
+};
+
+}
+
+class LineStringPyramid::Tolerances
+{
+ public:
+    explicit Tolerances( const GeoDataLineString *lineString )
+        : m_ready( 0 )
+    {
+        const int count = lineString->size();
+        m_longitudes.reserve( count );
+        m_latitudes.reserve( count );
+        for ( int i = 0; i < count; ++i ) {
+            m_longitudes.append( lineString->longitude( i ) );
+            m_latitudes.append( lineString->latitude( i ) );
+        }
+    }
+
+    void compute();
+
+    bool isReady() const
+    {
+        return m_ready.testAndSetAcquire( 1, 1 );
+    }
+
+    QVector<qreal> m_longitudes;
+    QVector<qreal> m_latitudes;
+
+    // the largest tolerance each node is kept at
+    QVector<float> m_tolerances;
+
+ private:
+    mutable QAtomicInt m_ready;
+};
+
+void LineStringPyramid::Tolerances::compute()
+{
+    const int count = m_longitudes.size();
+
+    QVector<Vector> nodes( count );
+    for ( int i = 0; i < count; ++i ) {
+        const qreal cosLat = cos( m_latitudes[i] );
+        nodes[i].x = cosLat * cos( m_longitudes[i] );
+        nodes[i].y = cosLat * sin( m_longitudes[i] );
+        nodes[i].z = sin( m_latitudes[i] );
+    }
+
+    // the ends are always kept
+    const float infinity = std::numeric_limits<float>::max();
+    m_tolerances.fill( 0.0f, count );
+    m_tolerances[0] = infinity;
+    m_tolerances[count - 1] = infinity;
+
+    // Douglas-Peucker without recursion: a node is kept as long as the tolerance
+    // is below its own distance and the tolerances of the nodes splitting
+    // the ranges it is in.
+    QVector<Range> ranges;
+    const Range all = { 0, count - 1, infinity };
+    ranges.append( all );
+
+    while ( !ranges.isEmpty() ) {
+        const Range range = ranges.last();
+        ranges.pop_back();
+
+        if ( range.last - range.first < 2 ) {
+            continue;
+        }
+
+        const Vector &first = nodes[range.first];
+        const Vector &last = nodes[range.last];
+
+        int farthest = range.first + 1;
+        qreal maximumDistance = -1.0;
+        for ( int i = range.first + 1; i < range.last; ++i ) {
+            const qreal distance = distanceToArc( nodes[i], first, last );
+            if ( distance > maximumDistance ) {
+                maximumDistance = distance;
+                farthest = i;
+            }
+        }
+
+        const float tolerance = qMin<float>( maximumDistance, range.tolerance );
+        m_tolerances[farthest] = tolerance;
+
+        const Range before = { range.first, farthest, tolerance };
+        const Range after = { farthest, range.last, tolerance };
+        ranges.append( before );
+        ranges.append( after );
+    }
+
+    m_ready.fetchAndStoreRelease( 1 );
+}
+
+class LineStringPyramid::ToleranceJob : public QRunnable
+{
+ public:
+    explicit ToleranceJob( const QSharedPointer<Tolerances> &tolerances );
+
+    virtual void run();
+
+ private:
+    // keeps the tolerances alive if the pyramid is destroyed in the meantime
+    const QSharedPointer<Tolerances> m_tolerances;
+};
+
+LineStringPyramid::LineStringPyramid( const GeoDataLineString *lineString )
+    : m_lineString( lineString ),
+      m_revision( 0 )
+{
+}
+
+LineStringPyramid::~LineStringPyramid()
+{
+    qDeleteAll( m_levels );
+}
+
+void LineStringPyramid::clear()
+{
+    // a job still computing the old tolerances keeps them alive until it is done
+    m_tolerances.clear();
+    qDeleteAll( m_levels );
+    m_levels.clear();
+}
+
+const GeoDataLineString *LineStringPyramid::lineString( qreal angularResolution )
+{
+    if ( m_tolerances && m_revision != m_lineString->revision() ) {
+        clear();
+    }
+
+    if ( m_lineString->size() < minimumNodeCount ) {
+        return m_lineString;
+    }
+
+    if ( !m_tolerances ) {
+        m_revision = m_lineString->revision();
+        m_tolerances = QSharedPointer<Tolerances>( new Tolerances( m_lineString ) );
+        QThreadPool::globalInstance()->start( new ToleranceJob( m_tolerances ) );
+        return m_lineString;
+    }
+
+    if ( !m_tolerances->isReady() ) {
+        return m_lineString;
+    }
+
+    const int level = LineStringPyramid::level( angularResolution );
+    QHash<int, const GeoDataLineString *>::const_iterator it = m_levels.constFind( level );
+    if ( it == m_levels.constEnd() ) {
+        it = m_levels.insert( level, createLevel( level ) );
+    }
+
+    return it.value() ? it.value() : m_lineString;
+}
+
+int LineStringPyramid::level( qreal angularResolution )
+{
+    return qFloor( log( angularResolution ) / M_LN2 );
+}
+
+const GeoDataLineString *LineStringPyramid::createLevel( int level ) const
+{
+    // half a pixel at the finest resolution of the level
+    const qreal tolerance = ldexp( 0.5, level );
+
+    const QVector<float> &tolerances = m_tolerances->m_tolerances;
+    const int count = tolerances.size();
+
+    int kept = 0;
+    for ( int i = 0; i < count; ++i ) {
+        if ( tolerances[i] > tolerance ) {
+            ++kept;
+        }
+    }
+
+    if ( kept > maximumKeptShare * count ) {
+        return 0;
+    }
+
+    GeoDataLineString *simplified = m_lineString->isClosed()
+                                  ? new GeoDataLinearRing( m_lineString->tessellationFlags() )
+                                  : new GeoDataLineString( m_lineString->tessellationFlags() );
+
+    for ( int i = 0; i < count; ++i ) {
+        if ( tolerances[i] > tolerance ) {
+            simplified->append( GeoDataCoordinates( m_tolerances->m_longitudes[i],
+                                                    m_tolerances->m_latitudes[i],
+                                                    m_lineString->altitude( i ),
+                                                    GeoDataCoordinates::Radian,
+                                                    m_lineString->detail( i ) ) );
+        }
+    }
+
+    return simplified;
+}
+
+LineStringPyramid::ToleranceJob::ToleranceJob( const QSharedPointer<Tolerances> &tolerances )
+    : m_tolerances( tolerances )
+{
+}
+
+void LineStringPyramid::ToleranceJob::run()
+{
+    m_tolerances->compute();
+}
+
+}
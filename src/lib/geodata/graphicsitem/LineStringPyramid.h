@@ -0,0 +1,78 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_LINESTRINGPYRAMID_H
+#define MARBLE_LINESTRINGPYRAMID_H
+
+#include <QHash>
+#include <QSharedPointer>
+
+namespace Marble
+{
+
+class GeoDataLineString;
+
+/**
+ * @short Simplified versions of a line string for coarse resolutions.
+ *
+ * Once for the whole line string, the Douglas-Peucker algorithm determines the
+ * largest tolerance each node is kept at. This is done on a background thread,
+ * the original line string is painted in the meantime.
+ *
+ * The simplified line strings form a pyramid whose levels double the tolerance.
+ * A level consists of the nodes whose tolerance exceeds half a pixel at the
+ * resolution of the level. It is created when it is asked for the first time.
+ *
+ * Tolerances are measured as angular distances to the great circle through the
+ * neighbouring nodes kept.
+ *
+ * Any change of the line string, as told by GeoDataLineString::revision(),
+ * drops the levels and starts the computation of the tolerances over.
+ */
+class LineStringPyramid
+{
+ public:
+    explicit LineStringPyramid( const GeoDataLineString *lineString );
+    ~LineStringPyramid();
+
+    /**
+     * Returns the line string to paint at @p angularResolution (in radian per
+     * pixel). This is the original line string if the simplification is not
+     * ready yet or wouldn't save many nodes.
+     *
+     * The returned line string is a GeoDataLinearRing if the original one is.
+     */
+    const GeoDataLineString *lineString( qreal angularResolution );
+
+    /**
+     * Returns the level of the pyramid used at @p angularResolution.
+     */
+    static int level( qreal angularResolution );
+
+ private:
+    Q_DISABLE_COPY( LineStringPyramid )
+
+    class Tolerances;
+    class ToleranceJob;
+
+    const GeoDataLineString *createLevel( int level ) const;
+    void clear();
+
+    const GeoDataLineString *const m_lineString;
+    QSharedPointer<Tolerances> m_tolerances;
+
+    // the revision of the line string the tolerances are computed for
+    quint64 m_revision;
+
+    // 0 if the level is the original line string
+    QHash<int, const GeoDataLineString *> m_levels;
+};
+
+}
+
+#endif
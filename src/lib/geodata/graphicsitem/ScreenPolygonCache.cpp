@@ -0,0 +1,420 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "ScreenPolygonCache.h"
+
+#include "AbstractProjection.h"
+#include "CylindricalProjection.h"
+#include "GeoDataCoordinates.h"
+#include "GeoDataLatLonAltBox.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPolygon.h"
+#include "ViewportParams.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace Marble
+{
+
+// 16 bytes per point, so the caches take up to 64 MB
+static const qint64 defaultMaximumCost = 4 * 1024 * 1024;
+
+// guards the list of caches, their costs, and the polygons of caches which aren't acquired
+static QMutex s_mutex;
+
+ScreenPolygonCache *ScreenPolygonCache::s_first = 0;
+ScreenPolygonCache *ScreenPolygonCache::s_last = 0;
+qint64 ScreenPolygonCache::s_totalCost = 0;
+qint64 ScreenPolygonCache::s_maximumCost = defaultMaximumCost;
+
+static inline bool isCylindrical( const ViewportParams *viewport )
+{
+    return viewport->currentProjection()->surfaceType() == AbstractProjection::Cylindrical;
+}
+
+ScreenPolygonCache::ScreenPolygonCache()
+    : m_valid( false ),
+      m_baseX( 0.0 ),
+      m_updated( false ),
+      m_dx( 0.0 ),
+      m_interval( 0.0 ),
+      m_westRepeats( 0 ),
+      m_eastRepeats( 0 ),
+      m_previous( 0 ),
+      m_next( 0 ),
+      m_linked( false ),
+      m_acquired( false ),
+      m_cost( 0 )
+{
+}
+
+ScreenPolygonCache::~ScreenPolygonCache()
+{
+    QMutexLocker locker( &s_mutex );
+    clearPolygons();
+    unlink();
+}
+
+bool ScreenPolygonCache::project( const ViewportParams *viewport, const GeoDataLineString &lineString )
+{
+    acquire();
+
+    if ( !isVisible( viewport, lineString.latLonAltBox() ) ) {
+        m_polygons.clear();
+        m_outline.clear();
+        m_updated = false;
+        return false;
+    }
+
+    m_newRevisions.resize( 1 );
+    m_newRevisions[0] = lineString.revision();
+
+    if ( !isCached( viewport, m_newRevisions ) ) {
+        clearBase();
+        projectBase( viewport, lineString, m_basePolygons );
+        m_baseX = referenceX( viewport );
+        m_key = key( viewport );
+        qSwap( m_revisions, m_newRevisions );
+        m_valid = true;
+    }
+
+    update( viewport );
+    updateCost();
+    return true;
+}
+
+bool ScreenPolygonCache::project( const ViewportParams *viewport, const GeoDataPolygon &polygon )
+{
+    acquire();
+
+    if ( !isVisible( viewport, polygon.outerBoundary().latLonAltBox() ) ) {
+        m_polygons.clear();
+        m_outline.clear();
+        m_updated = false;
+        return false;
+    }
+
+    m_newRevisions.resize( 1 + polygon.innerBoundaries().size() );
+    m_newRevisions[0] = polygon.outerBoundary().revision();
+    for ( int i = 0; i < polygon.innerBoundaries().size(); ++i ) {
+        m_newRevisions[i + 1] = polygon.innerBoundaries()[i].revision();
+    }
+
+    if ( !isCached( viewport, m_newRevisions ) ) {
+        clearBase();
+
+        // like GeoPainter::screenPolygons(), but before the repetitions are added
+        projectBase( viewport, polygon.outerBoundary(), m_basePolygons );
+
+        const bool needOutline = !polygon.innerBoundaries().isEmpty();
+        if ( needOutline ) {
+            foreach ( QPolygonF *outerPolygon, m_basePolygons ) {
+                m_baseOutline << *outerPolygon;
+            }
+        }
+
+        foreach ( const GeoDataLinearRing &innerBoundary, polygon.innerBoundaries() ) {
+            QVector<QPolygonF *> innerPolygons;
+            projectBase( viewport, innerBoundary, innerPolygons );
+
+            foreach ( QPolygonF *innerPolygon, innerPolygons ) {
+                if ( needOutline ) {
+                    m_baseOutline << *innerPolygon;
+                }
+                foreach ( QPolygonF *outerPolygon, m_basePolygons ) {
+                    *outerPolygon = outerPolygon->subtracted( *innerPolygon );
+                }
+            }
+            qDeleteAll( innerPolygons );
+        }
+
+        m_baseX = referenceX( viewport );
+        m_key = key( viewport );
+        qSwap( m_revisions, m_newRevisions );
+        m_valid = true;
+    }
+
+    update( viewport );
+    updateCost();
+    return true;
+}
+
+const QVector<QPolygonF *> &ScreenPolygonCache::polygons() const
+{
+    return m_polygons;
+}
+
+const QVector<QPolygonF> &ScreenPolygonCache::outline() const
+{
+    return m_outline;
+}
+
+void ScreenPolygonCache::release()
+{
+    QMutexLocker locker( &s_mutex );
+    m_acquired = false;
+    evict();
+}
+
+void ScreenPolygonCache::clear()
+{
+    QMutexLocker locker( &s_mutex );
+    clearPolygons();
+}
+
+qint64 ScreenPolygonCache::cost() const
+{
+    QMutexLocker locker( &s_mutex );
+    return m_cost;
+}
+
+qint64 ScreenPolygonCache::totalCost()
+{
+    QMutexLocker locker( &s_mutex );
+    return s_totalCost;
+}
+
+qint64 ScreenPolygonCache::maximumCost()
+{
+    QMutexLocker locker( &s_mutex );
+    return s_maximumCost;
+}
+
+void ScreenPolygonCache::setMaximumCost( qint64 cost )
+{
+    QMutexLocker locker( &s_mutex );
+    s_maximumCost = cost;
+    evict();
+}
+
+void ScreenPolygonCache::clearBase()
+{
+    qDeleteAll( m_basePolygons );
+    m_basePolygons.clear();
+    m_baseOutline.clear();
+    m_valid = false;
+    m_updated = false;
+}
+
+void ScreenPolygonCache::clearPolygons()
+{
+    clearBase();
+
+    m_polygons.clear();
+    m_outline.clear();
+    qDeleteAll( m_buffers );
+    m_buffers.clear();
+
+    s_totalCost -= m_cost;
+    m_cost = 0;
+}
+
+void ScreenPolygonCache::acquire()
+{
+    QMutexLocker locker( &s_mutex );
+    m_acquired = true;
+
+    // move to the front of the list
+    unlink();
+    m_next = s_first;
+    if ( s_first ) {
+        s_first->m_previous = this;
+    }
+    s_first = this;
+    if ( !s_last ) {
+        s_last = this;
+    }
+    m_linked = true;
+}
+
+void ScreenPolygonCache::unlink()
+{
+    if ( !m_linked ) {
+        return;
+    }
+
+    if ( m_previous ) {
+        m_previous->m_next = m_next;
+    } else {
+        s_first = m_next;
+    }
+    if ( m_next ) {
+        m_next->m_previous = m_previous;
+    } else {
+        s_last = m_previous;
+    }
+
+    m_previous = 0;
+    m_next = 0;
+    m_linked = false;
+}
+
+void ScreenPolygonCache::updateCost()
+{
+    qint64 cost = 0;
+    foreach ( const QPolygonF *polygon, m_basePolygons ) {
+        cost += polygon->capacity();
+    }
+    foreach ( const QPolygonF &polygon, m_baseOutline ) {
+        cost += polygon.capacity();
+    }
+    foreach ( const QPolygonF *polygon, m_buffers ) {
+        cost += polygon->capacity();
+    }
+    foreach ( const QPolygonF &polygon, m_outline ) {
+        cost += polygon.capacity();
+    }
+
+    QMutexLocker locker( &s_mutex );
+    s_totalCost += cost - m_cost;
+    m_cost = cost;
+    evict();
+}
+
+void ScreenPolygonCache::evict()
+{
+    ScreenPolygonCache *cache = s_last;
+    while ( s_totalCost > s_maximumCost && cache ) {
+        ScreenPolygonCache *const previous = cache->m_previous;
+
+        if ( !cache->m_acquired ) {
+            cache->clearPolygons();
+            cache->unlink();
+        }
+
+        cache = previous;
+    }
+}
+
+bool ScreenPolygonCache::isCached( const ViewportParams *viewport, const QVector<quint64> &revisions ) const
+{
+    return m_valid && key( viewport ) == m_key && revisions == m_revisions;
+}
+
+bool ScreenPolygonCache::Key::operator==( const Key &other ) const
+{
+    return projection == other.projection
+        && radius == other.radius
+        && centerLatitude == other.centerLatitude
+        && height == other.height
+        && centerLongitude == other.centerLongitude
+        && width == other.width;
+}
+
+ScreenPolygonCache::Key ScreenPolygonCache::key( const ViewportParams *viewport )
+{
+    const bool translatable = isCylindrical( viewport );
+
+    Key key;
+    key.projection = viewport->projection();
+    key.radius = viewport->radius();
+    key.centerLatitude = viewport->centerLatitude();
+    key.height = viewport->height();
+    key.centerLongitude = translatable ? 0.0 : viewport->centerLongitude();
+    key.width = translatable ? 0 : viewport->width();
+
+    return key;
+}
+
+bool ScreenPolygonCache::isVisible( const ViewportParams *viewport, const GeoDataLatLonAltBox &box )
+{
+    return viewport->viewLatLonAltBox().intersects( box ) && viewport->resolves( box );
+}
+
+void ScreenPolygonCache::projectBase( const ViewportParams *viewport, const GeoDataLineString &lineString,
+                                      QVector<QPolygonF *> &polygons )
+{
+    if ( isCylindrical( viewport ) ) {
+        const CylindricalProjection *projection = static_cast<const CylindricalProjection *>( viewport->currentProjection() );
+        projection->unrepeatedScreenCoordinates( lineString, viewport, polygons );
+    }
+    else {
+        viewport->screenCoordinates( lineString, polygons );
+    }
+}
+
+qreal ScreenPolygonCache::referenceX( const ViewportParams *viewport )
+{
+    if ( !isCylindrical( viewport ) ) {
+        return 0.0;
+    }
+
+    qreal x = 0.0;
+    qreal y = 0.0;
+    viewport->currentProjection()->screenCoordinates( GeoDataCoordinates( 0.0, viewport->centerLatitude() ), viewport, x, y );
+
+    return x;
+}
+
+void ScreenPolygonCache::update( const ViewportParams *viewport )
+{
+    qreal dx = 0.0;
+    qreal interval = 0.0;
+    int westRepeats = 0;
+    int eastRepeats = 0;
+    if ( isCylindrical( viewport ) ) {
+        const CylindricalProjection *projection = static_cast<const CylindricalProjection *>( viewport->currentProjection() );
+        dx = referenceX( viewport ) - m_baseX;
+        projection->repeats( viewport, interval, westRepeats, eastRepeats );
+    }
+
+    if ( m_updated && dx == m_dx && interval == m_interval
+         && westRepeats == m_westRepeats && eastRepeats == m_eastRepeats ) {
+        return;
+    }
+
+    // the repetitions in the order of CylindricalProjection::screenCoordinates(): west, base, east
+    const int copies = westRepeats + 1 + eastRepeats;
+    const int polygonCount = copies * m_basePolygons.size();
+    while ( m_buffers.size() < polygonCount ) {
+        m_buffers.append( new QPolygonF );
+    }
+    m_polygons.resize( polygonCount );
+    m_outline.resize( copies * m_baseOutline.size() );
+
+    int polygon = 0;
+    int outline = 0;
+    for ( int repeat = -westRepeats; repeat <= eastRepeats; ++repeat ) {
+        const qreal offset = dx + repeat * interval;
+
+        for ( int i = 0; i < m_basePolygons.size(); ++i ) {
+            copyTranslated( *m_basePolygons[i], offset, m_buffers[polygon] );
+            m_polygons[polygon] = m_buffers[polygon];
+            ++polygon;
+        }
+
+        for ( int i = 0; i < m_baseOutline.size(); ++i ) {
+            copyTranslated( m_baseOutline[i], offset, &m_outline[outline] );
+            ++outline;
+        }
+    }
+
+    m_updated = true;
+    m_dx = dx;
+    m_interval = interval;
+    m_westRepeats = westRepeats;
+    m_eastRepeats = eastRepeats;
+}
+
+void ScreenPolygonCache::copyTranslated( const QPolygonF &source, qreal dx, QPolygonF *target )
+{
+    const int size = source.size();
+
+    // reserving first keeps the buffer from being shrunk
+    target->reserve( size );
+    target->resize( size );
+
+    const QPointF *from = source.constData();
+    QPointF *to = target->data();
+    for ( int i = 0; i < size; ++i ) {
+        to[i] = QPointF( from[i].x() + dx, from[i].y() );
+    }
+}
+
+}
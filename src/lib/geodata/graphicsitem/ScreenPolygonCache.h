@@ -0,0 +1,195 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_SCREENPOLYGONCACHE_H
+#define MARBLE_SCREENPOLYGONCACHE_H
+
+#include <QPolygonF>
+#include <QVector>
+
+#include "MarbleGlobal.h"
+
+namespace Marble
+{
+
+class GeoDataLatLonAltBox;
+class GeoDataLineString;
+class GeoDataPolygon;
+class ViewportParams;
+
+/**
+ * @short The screen polygons of a geometry, kept from one frame to the next.
+ *
+ * The geometry is projected again only if the view changed in a way which
+ * moves its polygons other than horizontally. On the globe this means any
+ * change of the view. In the cylindrical projections panning the map changes
+ * the center longitude only, which translates the polygons horizontally, and
+ * the polygons are moved instead of projected. The repetitions of the map
+ * to the west and the east are copies of the same polygons.
+ *
+ * The buffers of the polygons are kept as well, so translating the polygons
+ * doesn't allocate memory either.
+ *
+ * The geometry is identified by the revisions of its line strings, which
+ * change with its coordinates and differ between line strings even if one
+ * gets the address of another one which was deleted.
+ *
+ * All caches share a maximum cost, the number of points they keep. If it is
+ * exceeded, the caches used least recently are cleared. The polygons of a
+ * cache are kept from project() until release(), so call release() once
+ * they are painted.
+ */
+class ScreenPolygonCache
+{
+ public:
+    ScreenPolygonCache();
+    ~ScreenPolygonCache();
+
+    /**
+     * Projects @p lineString into polygons(). Returns false if it is not
+     * visible in the @p viewport, polygons() is empty then.
+     */
+    bool project( const ViewportParams *viewport, const GeoDataLineString &lineString );
+
+    /**
+     * Projects @p polygon into polygons(), with its inner boundaries cut out.
+     * The outline() is needed to paint the edges of polygons with inner
+     * boundaries.
+     */
+    bool project( const ViewportParams *viewport, const GeoDataPolygon &polygon );
+
+    /**
+     * The polygons of the last call of project(). They belong to the cache
+     * and stay valid until the next call of project(), release() or clear().
+     */
+    const QVector<QPolygonF *> &polygons() const;
+
+    const QVector<QPolygonF> &outline() const;
+
+    /**
+     * Allows the polygons to be cleared if the caches exceed their maximum cost.
+     */
+    void release();
+
+    void clear();
+
+    /**
+     * The number of points this cache keeps.
+     */
+    qint64 cost() const;
+
+    static qint64 totalCost();
+
+    static qint64 maximumCost();
+    static void setMaximumCost( qint64 cost );
+
+ private:
+    Q_DISABLE_COPY( ScreenPolygonCache )
+
+    struct Key
+    {
+        Projection projection;
+        int radius;
+        qreal centerLatitude;
+        int height;
+
+        // only used by projections which don't translate the polygons
+        qreal centerLongitude;
+        int width;
+
+        bool operator==( const Key &other ) const;
+    };
+
+    static Key key( const ViewportParams *viewport );
+
+    /**
+     * Returns whether the polygons are cached for @p viewport and the line
+     * strings with the revisions @p revisions.
+     */
+    bool isCached( const ViewportParams *viewport, const QVector<quint64> &revisions ) const;
+
+    static bool isVisible( const ViewportParams *viewport, const GeoDataLatLonAltBox &box );
+
+    /**
+     * Projects @p lineString without repeating it, appends the polygons
+     * to @p polygons.
+     */
+    static void projectBase( const ViewportParams *viewport, const GeoDataLineString &lineString,
+                             QVector<QPolygonF *> &polygons );
+
+    /**
+     * The horizontal position of the projected longitude 0, which moves
+     * the base polygons along when the view is panned.
+     */
+    static qreal referenceX( const ViewportParams *viewport );
+
+    /**
+     * Copies the translated and repeated base polygons to the output.
+     */
+    void update( const ViewportParams *viewport );
+
+    static void copyTranslated( const QPolygonF &source, qreal dx, QPolygonF *target );
+
+    /**
+     * Keeps the polygons until release() and makes the cache the one used most recently.
+     */
+    void acquire();
+
+    /**
+     * Updates the cost of the cache and clears the caches used least recently
+     * which are not acquired, until the maximum cost is kept.
+     */
+    void updateCost();
+
+    void clearBase();
+
+    // to be called with s_mutex locked
+    void clearPolygons();
+    void unlink();
+    static void evict();
+
+    bool m_valid;
+    Key m_key;
+    // the revisions of the line strings the polygons were projected from
+    QVector<quint64> m_revisions;
+    QVector<quint64> m_newRevisions;
+
+    // the polygons projected for m_key, not repeated
+    QVector<QPolygonF *> m_basePolygons;
+    QVector<QPolygonF> m_baseOutline;
+    qreal m_baseX;
+
+    // the translation and the repetitions of the output
+    bool m_updated;
+    qreal m_dx;
+    qreal m_interval;
+    int m_westRepeats;
+    int m_eastRepeats;
+
+    QVector<QPolygonF *> m_polygons;
+    QVector<QPolygonF> m_outline;
+
+    // the buffers of m_polygons, followed by unused ones
+    QVector<QPolygonF *> m_buffers;
+
+    // the list of all caches, the one used most recently first
+    ScreenPolygonCache *m_previous;
+    ScreenPolygonCache *m_next;
+    bool m_linked;
+    bool m_acquired;
+    qint64 m_cost;
+
+    static ScreenPolygonCache *s_first;
+    static ScreenPolygonCache *s_last;
+    static qint64 s_totalCost;
+    static qint64 s_maximumCost;
+};
+
+}
+
+#endif
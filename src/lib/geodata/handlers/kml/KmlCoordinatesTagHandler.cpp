@@ -21,8 +21,7 @@
 
 #include "KmlCoordinatesTagHandler.h"
 
-#include <QStringList>
-#include <QRegExp>
+#include <QString>
 
 #include "MarbleDebug.h"
 #include "KmlElementDictionary.h"
@@ -44,13 +43,207 @@ namespace kml
 {
 KML_DEFINE_TAG_HANDLER( coordinates )
 
-static const bool kmlStrictSpecs = false;
-
 // We can't use KML_DEFINE_TAG_HANDLER_GX22 because the name of the tag ("coord")
 // and the TagHandler ("KmlcoordinatesTagHandler") don't match
 static GeoTagHandlerRegistrar s_handlercoordkmlTag_nameSpaceGx22(GeoParser::QualifiedName(kmlTag_coord, kmlTag_nameSpaceGx22 ),
                                                                  new KmlcoordinatesTagHandler());
 
+/**
+ * Reads the "lon,lat[,alt]" tuples of a coordinates element one after the
+ * other, straight from the characters of the element text. Spaces around
+ * the commas are tolerated although the KML specification forbids them.
+ */
+class CoordinatesTokenizer
+{
+ public:
+    explicit CoordinatesTokenizer( const QString &text )
+        : m_pos( text.constData() ),
+          m_end( text.constData() + text.size() )
+    {
+    }
+
+    /**
+     * Reads the next tuple into @p coordinates, in degrees. Malformed tuples
+     * give default coordinates. Returns false at the end of the text.
+     */
+    bool nextTuple( GeoDataCoordinates &coordinates )
+    {
+        skipSpaces();
+        if ( m_pos == m_end ) {
+            return false;
+        }
+
+        qreal values[3];
+        int count = 0;
+        bool valid = true;
+        forever {
+            qreal value;
+            if ( !readNumber( value ) ) {
+                valid = false;
+                break;
+            }
+            if ( count < 3 ) {
+                values[count] = value;
+            }
+            ++count;
+
+            skipSpaces();
+            if ( m_pos == m_end || *m_pos != QLatin1Char( ',' ) ) {
+                break;
+            }
+            ++m_pos;
+            skipSpaces();
+        }
+
+        if ( !valid ) {
+            // skip the rest of the tuple
+            while ( m_pos != m_end && !isSpace( *m_pos ) ) {
+                ++m_pos;
+            }
+        }
+
+        if ( valid && count == 2 ) {
+            coordinates.set( values[0], values[1], 0.0, GeoDataCoordinates::Degree );
+        } else if ( valid && count == 3 ) {
+            coordinates.set( values[0], values[1], values[2], GeoDataCoordinates::Degree );
+        } else {
+            coordinates = GeoDataCoordinates();
+        }
+        return true;
+    }
+
+    /**
+     * Reads the next number, skipping the spaces and commas before it.
+     * Returns false at the end of the text or if no number follows.
+     */
+    bool nextNumber( qreal &value )
+    {
+        while ( m_pos != m_end && ( isSpace( *m_pos ) || *m_pos == QLatin1Char( ',' ) ) ) {
+            ++m_pos;
+        }
+
+        return m_pos != m_end && readNumber( value );
+    }
+
+ private:
+    static bool isSpace( QChar c )
+    {
+        const ushort u = c.unicode();
+        return u == ' ' || ( u >= '\t' && u <= '\r' ) || ( u > 127 && c.isSpace() );
+    }
+
+    static bool isDigit( QChar c )
+    {
+        return c.unicode() >= '0' && c.unicode() <= '9';
+    }
+
+    void skipSpaces()
+    {
+        while ( m_pos != m_end && isSpace( *m_pos ) ) {
+            ++m_pos;
+        }
+    }
+
+    /**
+     * Reads a decimal number like "-12.345e2" which must be followed by a
+     * space, a comma or the end of the text.
+     *
+     * Numbers whose digits fit into the 53 bits of a double's mantissa and
+     * whose power of ten is exact, which covers the coordinates found in
+     * practice, are divided or multiplied by that power of ten. That is a
+     * single rounding, so the result is the same as QString::toDouble().
+     * Other numbers are passed to QString::toDouble().
+     */
+    bool readNumber( qreal &value )
+    {
+        static const double powersOfTen[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        static const int maxExactPower = 22;
+        static const quint64 maxExactMantissa = Q_UINT64_C( 1 ) << 53;
+
+        const QChar *const start = m_pos;
+
+        bool negative = false;
+        if ( m_pos != m_end && ( *m_pos == QLatin1Char( '-' ) || *m_pos == QLatin1Char( '+' ) ) ) {
+            negative = *m_pos == QLatin1Char( '-' );
+            ++m_pos;
+        }
+
+        quint64 mantissa = 0;
+        bool exact = true;
+        int exponent = 0;
+        int digits = 0;
+
+        for ( ; m_pos != m_end && isDigit( *m_pos ); ++m_pos, ++digits ) {
+            if ( mantissa < maxExactMantissa ) {
+                mantissa = 10 * mantissa + ( m_pos->unicode() - '0' );
+            } else {
+                exact = false;
+            }
+        }
+
+        if ( m_pos != m_end && *m_pos == QLatin1Char( '.' ) ) {
+            ++m_pos;
+            for ( ; m_pos != m_end && isDigit( *m_pos ); ++m_pos, ++digits ) {
+                if ( mantissa < maxExactMantissa ) {
+                    mantissa = 10 * mantissa + ( m_pos->unicode() - '0' );
+                    --exponent;
+                } else {
+                    exact = false;
+                }
+            }
+        }
+
+        if ( digits == 0 ) {
+            m_pos = start;
+            return false;
+        }
+
+        if ( m_pos != m_end && ( *m_pos == QLatin1Char( 'e' ) || *m_pos == QLatin1Char( 'E' ) ) ) {
+            ++m_pos;
+            bool negativeExponent = false;
+            if ( m_pos != m_end && ( *m_pos == QLatin1Char( '-' ) || *m_pos == QLatin1Char( '+' ) ) ) {
+                negativeExponent = *m_pos == QLatin1Char( '-' );
+                ++m_pos;
+            }
+            if ( m_pos == m_end || !isDigit( *m_pos ) ) {
+                return false;
+            }
+            int written = 0;
+            for ( ; m_pos != m_end && isDigit( *m_pos ); ++m_pos ) {
+                if ( written < 10000 ) {
+                    written = 10 * written + ( m_pos->unicode() - '0' );
+                }
+            }
+            exponent += negativeExponent ? -written : written;
+        }
+
+        if ( m_pos != m_end && !isSpace( *m_pos ) && *m_pos != QLatin1Char( ',' ) ) {
+            return false;
+        }
+
+        if ( exact && mantissa <= maxExactMantissa && qAbs( exponent ) <= maxExactPower ) {
+            double result = static_cast<double>( mantissa );
+            if ( exponent < 0 ) {
+                result /= powersOfTen[-exponent];
+            } else {
+                result *= powersOfTen[exponent];
+            }
+            value = negative ? -result : result;
+            return true;
+        }
+
+        bool ok = false;
+        value = QString::fromRawData( start, m_pos - start ).toDouble( &ok );
+        return ok;
+    }
+
+    const QChar *m_pos;
+    const QChar *const m_end;
+};
+
 GeoNode* KmlcoordinatesTagHandler::parse( GeoParser& parser ) const
 {
     Q_ASSERT( parser.isStartElement()
@@ -64,76 +257,23 @@ GeoNode* KmlcoordinatesTagHandler::parse( GeoParser& parser ) const
      || parentItem.represents( kmlTag_MultiGeometry )
      || parentItem.represents( kmlTag_LinearRing )
      || parentItem.represents( kmlTag_LatLonQuad ) ) {
-        QStringList  coordinatesLines;// = parser.readElementText().trimmed().split( QRegExp("\\s"), QString::SkipEmptyParts );
-        // Splitting using the "\\s" regexp is slow, split manually instead.
-        QString text = parser.readElementText().trimmed();
-
-        if ( !kmlStrictSpecs ) {
-            // Removing spaces before and after commas
-            for ( int i = 1; i < text.size() - 1; ++i ) {
-                if ( text[i] == ',' ) {
-                    // Before
-                    int l = i - 1;
-                    while ( l > 0 && text[l].isSpace() ) {
-                        --l;
-                    }
-
-                    // After
-                    int r = i + 1;
-                    while ( r < text.size() && text[r].isSpace() ) {
-                        ++r;
-                    }
-
-                    text.remove( l + 1, r - l - 1 ).insert( l + 1, ',' );
-                }
-            }
-        }
+        const QString text = parser.readElementText();
+        CoordinatesTokenizer tokenizer( text );
+        GeoDataCoordinates coord;
 
-        int index = 0;
-        bool inside = true;
-        int const size = text.size();
-        for ( int i=0; i<size; ++i ) {
-            if ( text[i].isSpace() ) {
-                if ( inside ) {
-                    coordinatesLines.append( text.mid( index, i-index ) );
-                    inside = false;
-                }
-                index = i+1;
-            } else {
-                inside = true;
+        if ( parentItem.represents( kmlTag_LineString ) || parentItem.represents( kmlTag_LinearRing ) ) {
+            // the bulk of the coordinates, appended without looking at the parent again
+            GeoDataLineString *lineString = parentItem.represents( kmlTag_LineString )
+                                          ? parentItem.nodeAs<GeoDataLineString>()
+                                          : static_cast<GeoDataLineString *>( parentItem.nodeAs<GeoDataLinearRing>() );
+            while ( tokenizer.nextTuple( coord ) ) {
+                lineString->append( coord );
             }
-        }
-        coordinatesLines.append( text.mid( index ) );
-        int coordinatesIndex = 0;
-        Q_FOREACH( const QString& line, coordinatesLines ) {
-            QStringList coordinates = line.trimmed().split( ',' );
-            if ( parentItem.represents( kmlTag_Point ) && parentItem.is<GeoDataFeature>() ) {
-                GeoDataCoordinates coord;
-                if ( coordinates.size() == 2 ) {
-                    coord.set( coordinates.at( 0 ).toDouble(),
-                              coordinates.at( 1 ).toDouble(), 0.0, GeoDataCoordinates::Degree );
-                } else if( coordinates.size() == 3 ) {
-                    coord.set( coordinates.at( 0 ).toDouble(),
-                               coordinates.at( 1 ).toDouble(),
-                               coordinates.at( 2 ).toDouble(),
-                               GeoDataCoordinates::Degree );
-                }
-                parentItem.nodeAs<GeoDataPlacemark>()->setCoordinate( coord );
-            } else {
-                GeoDataCoordinates coord;
-                if ( coordinates.size() == 2 ) {
-                    coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                              DEG2RAD * coordinates.at( 1 ).toDouble() );
-                } else if( coordinates.size() == 3 ) {
-                    coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                              DEG2RAD * coordinates.at( 1 ).toDouble(),
-                              coordinates.at( 2 ).toDouble() );
-                }
-
-                if ( parentItem.represents( kmlTag_LineString ) ) {
-                    parentItem.nodeAs<GeoDataLineString>()->append( coord );
-                } else if ( parentItem.represents( kmlTag_LinearRing ) ) {
-                    parentItem.nodeAs<GeoDataLinearRing>()->append( coord );
+        } else {
+            int coordinatesIndex = 0;
+            while ( tokenizer.nextTuple( coord ) ) {
+                if ( parentItem.represents( kmlTag_Point ) && parentItem.is<GeoDataFeature>() ) {
+                    parentItem.nodeAs<GeoDataPlacemark>()->setCoordinate( coord );
                 } else if ( parentItem.represents( kmlTag_MultiGeometry ) ) {
                     GeoDataPoint *point = new GeoDataPoint( coord );
                     parentItem.nodeAs<GeoDataMultiGeometry>()->append( point );
@@ -166,27 +306,32 @@ GeoNode* KmlcoordinatesTagHandler::parse( GeoParser& parser ) const
                 } else {
                     // raise warning as coordinates out of valid parents found
                 }
-            }
 
-            ++coordinatesIndex;
+                ++coordinatesIndex;
+            }
         }
     }
 
     if( parentItem.represents( kmlTag_Track ) ) {
-        QString input = parser.readElementText().trimmed();
-        if ( !kmlStrictSpecs ) {
-            input = input.replace( QRegExp( "\\s*,\\s*" ), "," );
+        // gx:coord separates the values by spaces
+        const QString text = parser.readElementText();
+        CoordinatesTokenizer tokenizer( text );
+
+        qreal values[3];
+        int count = 0;
+        qreal value;
+        while ( tokenizer.nextNumber( value ) ) {
+            if ( count < 3 ) {
+                values[count] = value;
+            }
+            ++count;
         }
-        QStringList coordinates = input.split( ' ' );
 
         GeoDataCoordinates coord;
-        if ( coordinates.size() == 2 ) {
-            coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                       DEG2RAD * coordinates.at( 1 ).toDouble() );
-        } else if( coordinates.size() == 3 ) {
-            coord.set( DEG2RAD * coordinates.at( 0 ).toDouble(),
-                       DEG2RAD * coordinates.at( 1 ).toDouble(),
-                       coordinates.at( 2 ).toDouble() );
+        if ( count == 2 ) {
+            coord.set( values[0], values[1], 0.0, GeoDataCoordinates::Degree );
+        } else if( count == 3 ) {
+            coord.set( values[0], values[1], values[2], GeoDataCoordinates::Degree );
         }
         parentItem.nodeAs<GeoDataTrack>()->appendCoordinates( coord );
     }
@@ -94,6 +94,11 @@ void GeoGraphicsItem::setZValue( qreal z )
     p()->m_zValue = z;
 }
 
+void GeoGraphicsItem::project( const ViewportParams *viewport )
+{
+    Q_UNUSED( viewport );
+}
+
 GeoGraphicsItemPrivate *GeoGraphicsItem::p() const
 {
     return reinterpret_cast<GeoGraphicsItemPrivate *>( d );
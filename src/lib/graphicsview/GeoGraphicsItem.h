@@ -118,6 +118,17 @@ class MARBLE_EXPORT GeoGraphicsItem
      */
     virtual void paint( GeoPainter *painter, const ViewportParams *viewport ) = 0;
 
+    /**
+     * Prepares painting the item in the given viewport, e.g. by projecting
+     * its geometry into screen coordinates ahead of paint().
+     *
+     * This may be called on another thread, concurrently with the other items
+     * of a layer, so it must only touch the item and its geometry.
+     *
+     * The default implementation does nothing.
+     */
+    virtual void project( const ViewportParams *viewport );
+
  protected:
     GeoGraphicsItemPrivate *p() const;
 
@@ -46,14 +46,26 @@
 #include <qmath.h>
 #include <QAbstractItemModel>
 #include <QModelIndex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
 
 namespace Marble
 {
+
+// smaller batches of items are projected on the GUI thread
+static const int minimumItemsPerJob = 32;
+
 class GeometryLayerPrivate
 {
 public:
     GeometryLayerPrivate( const QAbstractItemModel *model );
 
+    /**
+     * Projects @p items into @p viewport on the thread pool.
+     */
+    void projectItems( const QVector<GeoGraphicsItem*> &items, const ViewportParams *viewport );
+
     void createGraphicsItems( const GeoDataObject *object );
     void createGraphicsItemFromGeometry( const GeoDataGeometry *object, const GeoDataPlacemark *placemark );
     void createGraphicsItemFromOverlay( const GeoDataOverlay *overlay );
@@ -65,8 +77,11 @@ public:
     GeoGraphicsScene m_scene;
     QString m_runtimeTrace;
     QList<ScreenOverlayGraphicsItem*> m_items;
+    QThreadPool m_threadPool;
 
 private:
+    class ProjectionJob;
+
     static void initializeDefaultValues();
 
     static int s_defaultZValues[GeoDataFeature::LastIndex];
@@ -88,6 +103,57 @@ GeometryLayerPrivate::GeometryLayerPrivate( const QAbstractItemModel *model )
     initializeDefaultValues();
 }
 
+/**
+ * Projects every n-th item of a list, so the jobs of a frame get a similar
+ * mix of small and large geometries.
+ */
+class GeometryLayerPrivate::ProjectionJob : public QRunnable
+{
+public:
+    ProjectionJob( const QVector<GeoGraphicsItem*> *items, const ViewportParams *viewport,
+                   int first, int stride )
+        : m_items( items ),
+          m_viewport( viewport ),
+          m_first( first ),
+          m_stride( stride )
+    {
+    }
+
+    virtual void run()
+    {
+        for ( int i = m_first; i < m_items->size(); i += m_stride ) {
+            m_items->at( i )->project( m_viewport );
+        }
+    }
+
+private:
+    const QVector<GeoGraphicsItem*> *const m_items;
+    const ViewportParams *const m_viewport;
+    const int m_first;
+    const int m_stride;
+};
+
+void GeometryLayerPrivate::projectItems( const QVector<GeoGraphicsItem*> &items, const ViewportParams *viewport )
+{
+    const int jobCount = qMin( m_threadPool.maxThreadCount(), items.size() / minimumItemsPerJob );
+
+    if ( jobCount <= 1 ) {
+        foreach ( GeoGraphicsItem *item, items ) {
+            item->project( viewport );
+        }
+        return;
+    }
+
+    // the view box is computed on demand, which must not happen on several threads
+    viewport->viewLatLonAltBox();
+
+    for ( int i = 0; i < jobCount; ++i ) {
+        m_threadPool.start( new ProjectionJob( &items, viewport, i, jobCount ) );
+    }
+
+    m_threadPool.waitForDone();
+}
+
 int GeometryLayerPrivate::maximumZoomLevel()
 {
     return s_maximumZoomLevel;
@@ -245,15 +311,23 @@ bool GeometryLayer::render( GeoPainter *painter, ViewportParams *viewport,
     int maxZoomLevel = qMin<int>( qMax<int>( qLn( viewport->radius() *4 / 256 ) / qLn( 2.0 ), 1), GeometryLayerPrivate::maximumZoomLevel() );
     QList<GeoGraphicsItem*> items = d->m_scene.items( viewport->viewLatLonAltBox(), maxZoomLevel );
 
-    int painted = 0;
+    QVector<GeoGraphicsItem*> visibleItems;
+    visibleItems.reserve( items.size() );
     foreach( GeoGraphicsItem* item, items )
     {
         if ( item->latLonAltBox().intersects( viewport->viewLatLonAltBox() ) ) {
-            item->paint( painter, viewport );
-            ++painted;
+            visibleItems.append( item );
         }
     }
 
+    // projecting is most of the work, only painting has to be serial
+    d->projectItems( visibleItems, viewport );
+
+    foreach( GeoGraphicsItem* item, visibleItems ) {
+        item->paint( painter, viewport );
+    }
+    const int painted = visibleItems.size();
+
     foreach( ScreenOverlayGraphicsItem* item, d->m_items ) {
         item->paintEvent( painter, viewport );
     }
@@ -12,6 +12,8 @@
 
 #include "TextureLayer.h"
 
+#include <cmath>
+
 #include <qmath.h>
 #include <QTimer>
 #include <QList>
@@ -22,9 +24,12 @@
 #include "MercatorScanlineTextureMapper.h"
 #include "TileScalingTextureMapper.h"
 #include "GeoDataGroundOverlay.h"
+#include "GeoDataLatLonAltBox.h"
 #include "GeoPainter.h"
 #include "GeoSceneGroup.h"
+#include "GeoSceneTextureTile.h"
 #include "GeoSceneTypes.h"
+#include "HttpDownloadManager.h"
 #include "MergedLayerDecorator.h"
 #include "MarbleDebug.h"
 #include "MarbleDirs.h"
@@ -34,6 +39,8 @@
 #include "SunLocator.h"
 #include "TextureColorizer.h"
 #include "TileLoader.h"
+#include "TileLoaderHelper.h"
+#include "TilePrefetcher.h"
 #include "VectorComposer.h"
 #include "ViewportParams.h"
 
@@ -42,6 +49,118 @@ namespace Marble
 
 const int REPAINT_SCHEDULING_INTERVAL = 1000;
 
+/**
+ * Prefers the downloads of tiles which are visible at the current tile level,
+ * then those closer to the center of the view and then those of levels close
+ * to the current one. Downloads of tiles outside of the view are cancelled,
+ * and their ids are collected so that the stacked tiles which wait for them
+ * can be dropped.
+ */
+class TileDownloadPrioritizer : public DownloadPrioritizer
+{
+public:
+    TileDownloadPrioritizer( const ViewportParams *viewport, int tileLevel,
+                             const QVector<const GeoSceneTextureTile *> &textures,
+                             QList<TileId> *cancelledTiles )
+        : m_viewport( viewport ),
+          m_viewBox( viewport->viewLatLonAltBox() ),
+          m_tileLevel( tileLevel ),
+          m_textures( textures ),
+          m_cancelledTiles( cancelledTiles )
+    {
+    }
+
+    virtual bool priority( const QString &initiatorId, int &priority ) const
+    {
+        // see TileLoader::triggerDownload() for the format "sourceDir:level:x:y"
+        const GeoSceneTextureTile *texture = 0;
+        foreach ( const GeoSceneTextureTile *candidate, m_textures ) {
+            const QString &sourceDir = candidate->sourceDir();
+            if ( initiatorId.size() > sourceDir.size()
+                 && initiatorId.at( sourceDir.size() ) == QLatin1Char( ':' )
+                 && initiatorId.startsWith( sourceDir ) ) {
+                texture = candidate;
+                break;
+            }
+        }
+
+        // downloads of other layers are none of our business
+        if ( !texture )
+            return true;
+
+        int pos = texture->sourceDir().size() + 1;
+        int level;
+        int x;
+        int y;
+        if ( !parseNumber( initiatorId, pos, level ) ||
+             !parseNumber( initiatorId, pos, x ) ||
+             !parseNumber( initiatorId, pos, y ) ||
+             pos <= initiatorId.size() )
+            return true;
+
+        const qreal columns = TileLoaderHelper::levelToColumn( texture->levelZeroColumns(), level );
+        const qreal rows = TileLoaderHelper::levelToRow( texture->levelZeroRows(), level );
+
+        const qreal west = x / columns * 2 * M_PI - M_PI;
+        const qreal east = ( x + 1 ) / columns * 2 * M_PI - M_PI;
+        const qreal north = latitude( y / rows, texture->projection() );
+        const qreal south = latitude( ( y + 1 ) / rows, texture->projection() );
+
+        if ( !m_viewBox.intersects( GeoDataLatLonBox( north, south, east, west ) ) ) {
+            m_cancelledTiles->append( TileId( 0, level, x, y ) );
+            return false;
+        }
+
+        qreal screenX;
+        qreal screenY;
+        int distance = 0xffff;
+        if ( m_viewport->screenCoordinates( ( west + east ) / 2, ( north + south ) / 2, screenX, screenY ) ) {
+            const qreal dx = screenX - m_viewport->width() / 2;
+            const qreal dy = screenY - m_viewport->height() / 2;
+            distance = qMin<int>( sqrt( dx * dx + dy * dy ), 0xffff );
+        }
+
+        const int visible = level == m_tileLevel ? 0 : 1;
+        const int levelDelta = qMin( qAbs( level - m_tileLevel ), 0xff );
+
+        priority = ( visible << 24 ) | ( distance << 8 ) | levelDelta;
+        return true;
+    }
+
+private:
+    /**
+     * Parses the decimal number which starts at @p pos and ends at the next
+     * colon or at the end of @p id. Afterwards, @p pos points behind the colon.
+     */
+    static bool parseNumber( const QString &id, int &pos, int &number )
+    {
+        const int start = pos;
+        number = 0;
+        for (; pos < id.size() && id.at( pos ) != QLatin1Char( ':' ); ++pos ) {
+            const int digit = id.at( pos ).digitValue();
+            if ( digit < 0 )
+                return false;
+            number = number * 10 + digit;
+        }
+
+        return pos++ > start;
+    }
+
+    static qreal latitude( qreal normalizedY, GeoSceneTiled::Projection projection )
+    {
+        if ( projection == GeoSceneTiled::Mercator )
+            return atan( sinh( ( 1.0 - 2.0 * normalizedY ) * M_PI ) );
+
+        return ( 0.5 - normalizedY ) * M_PI;
+    }
+
+    const ViewportParams *const m_viewport;
+    const GeoDataLatLonAltBox m_viewBox;
+    const int m_tileLevel;
+    const QVector<const GeoSceneTextureTile *> &m_textures;
+    QList<TileId> *const m_cancelledTiles;
+};
+
 class TextureLayer::Private
 {
 public:
@@ -62,15 +181,22 @@ public:
 
     void updateGroundOverlays();
 
+    /**
+     * Returns the tile level used for showing the globe with @p radius.
+     */
+    int tileLevel( int radius ) const;
+
     static bool drawOrderLessThan( const GeoDataGroundOverlay* o1, const GeoDataGroundOverlay* o2 );
 
 public:
     TextureLayer  *const m_parent;
+    HttpDownloadManager *const m_downloadManager;
     const SunLocator *const m_sunLocator;
     VectorComposer *const m_veccomposer;
     TileLoader m_loader;
     MergedLayerDecorator m_layerDecorator;
     StackedTileLoader    m_tileLoader;
+    TilePrefetcher m_prefetcher;
     GeoDataCoordinates m_centerCoordinates;
     int m_tileZoomLevel;
     TextureMapperInterface *m_texmapper;
@@ -91,11 +217,13 @@ TextureLayer::Private::Private( HttpDownloadManager *downloadManager,
                                 QAbstractItemModel *groundOverlayModel,
                                 TextureLayer *parent )
     : m_parent( parent )
+    , m_downloadManager( downloadManager )
     , m_sunLocator( sunLocator )
     , m_veccomposer( veccomposer )
     , m_loader( downloadManager, pluginManager )
     , m_layerDecorator( &m_loader, sunLocator )
     , m_tileLoader( &m_layerDecorator )
+    , m_prefetcher( &m_tileLoader )
     , m_centerCoordinates()
     , m_tileZoomLevel( -1 )
     , m_texmapper( 0 )
@@ -230,6 +358,25 @@ void TextureLayer::Private::updateGroundOverlays()
     }
 }
 
+int TextureLayer::Private::tileLevel( int radius ) const
+{
+    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
+    const int levelZeroWidth = m_layerDecorator.tileSize().width() * m_layerDecorator.tileColumnCount( 0 );
+    const int levelZeroHight = m_layerDecorator.tileSize().height() * m_layerDecorator.tileRowCount( 0 );
+    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
+
+    // limit to 1 as dirty fix for invalid entry linearLevel
+    const qreal linearLevel = qMax( 1.0, radius * 4.0 / levelZeroMinDimension );
+
+    // As our tile resolution doubles with each level we calculate
+    // the tile level from tilesize and the globe radius via log(2)
+    const qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 ) * 1.00001;  // snap to the sharper tile level a tiny bit earlier
+                                                                         // to work around rounding errors when the radius
+                                                                         // roughly equals the global texture width
+
+    return qMin<int>( m_layerDecorator.maximumTileLevel(), tileLevelF );
+}
+
 
 TextureLayer::TextureLayer( HttpDownloadManager *downloadManager,
                             const SunLocator *sunLocator,
@@ -290,6 +437,11 @@ bool TextureLayer::showCityLights() const
     return d->m_layerDecorator.showCityLights();
 }
 
+bool TextureLayer::asynchronousTileLoading() const
+{
+    return d->m_tileLoader.isAsynchronous();
+}
+
 bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
                            const QString &renderPos, GeoSceneLayer *layer )
 {
@@ -312,24 +464,10 @@ bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
          d->m_centerCoordinates.latitude() != viewport->centerLatitude() ) {
         d->m_centerCoordinates.setLongitude( viewport->centerLongitude() );
         d->m_centerCoordinates.setLatitude( viewport->centerLatitude() );
-        d->m_texmapper->setRepaintNeeded();
+        d->m_texmapper->setViewportChanged();
     }
 
-    // choose the smaller dimension for selecting the tile level, leading to higher-resolution results
-    const int levelZeroWidth = d->m_layerDecorator.tileSize().width() * d->m_layerDecorator.tileColumnCount( 0 );
-    const int levelZeroHight = d->m_layerDecorator.tileSize().height() * d->m_layerDecorator.tileRowCount( 0 );
-    const int levelZeroMinDimension = qMin( levelZeroWidth, levelZeroHight );
-
-    // limit to 1 as dirty fix for invalid entry linearLevel
-    const qreal linearLevel = qMax( 1.0, viewport->radius() * 4.0 / levelZeroMinDimension );
-
-    // As our tile resolution doubles with each level we calculate
-    // the tile level from tilesize and the globe radius via log(2)
-    const qreal tileLevelF = qLn( linearLevel ) / qLn( 2.0 ) * 1.00001;  // snap to the sharper tile level a tiny bit earlier
-                                                                         // to work around rounding errors when the radius
-                                                                         // roughly equals the global texture width
-
-    const int tileLevel = qMin<int>( d->m_layerDecorator.maximumTileLevel(), tileLevelF );
+    const int tileLevel = d->tileLevel( viewport->radius() );
 
     if ( tileLevel != d->m_tileZoomLevel ) {
         d->m_tileZoomLevel = tileLevel;
@@ -338,7 +476,24 @@ bool TextureLayer::render( GeoPainter *painter, ViewportParams *viewport,
 
     const QRect dirtyRect = QRect( QPoint( 0, 0), viewport->size() );
     d->m_texmapper->mapTexture( painter, viewport, d->m_tileZoomLevel, dirtyRect, d->m_texcolorizer );
-    d->m_runtimeTrace = QString("Texture Cache: %1 ").arg(d->m_tileLoader.tileCount());
+    d->m_prefetcher.setViewport( viewport, d->m_tileZoomLevel );
+
+    if ( d->m_downloadManager ) {
+        QList<TileId> cancelledTiles;
+        const TileDownloadPrioritizer prioritizer( viewport, d->m_tileZoomLevel, d->m_textures, &cancelledTiles );
+        d->m_downloadManager->updateJobPriorities( prioritizer, DownloadBrowse );
+
+        // otherwise the scaled placeholders of these tiles would stay in memory for good
+        foreach ( const TileId &id, cancelledTiles ) {
+            d->m_tileLoader.dropTile( id );
+        }
+    }
+    d->m_runtimeTrace = QString( "Texture Cache: %1 tiles, %2 kB, %3 hits, %4 misses, %5 evictions" )
+                            .arg( d->m_tileLoader.tileCount() )
+                            .arg( d->m_tileLoader.tileByteCount() / 1024 )
+                            .arg( d->m_tileLoader.cacheHitCount() )
+                            .arg( d->m_tileLoader.cacheMissCount() )
+                            .arg( d->m_tileLoader.cacheEvictionCount() );
     return true;
 }
 
@@ -383,6 +538,19 @@ void TextureLayer::setShowTileId( bool show )
     reset();
 }
 
+void TextureLayer::setAsynchronousTileLoading( bool asynchronous )
+{
+    disconnect( &d->m_tileLoader, SIGNAL(tileLoaded(TileId)),
+                this, SLOT(requestDelayedRepaint()) );
+
+    if ( asynchronous ) {
+        connect( &d->m_tileLoader, SIGNAL(tileLoaded(TileId)),
+                 this, SLOT(requestDelayedRepaint()) );
+    }
+
+    d->m_tileLoader.setAsynchronous( asynchronous );
+}
+
 void TextureLayer::setProjection( Projection projection )
 {
     if ( d->m_textures.isEmpty() ) {
@@ -449,6 +617,14 @@ void TextureLayer::downloadStackedTile( const TileId &stackedTileId )
     d->m_layerDecorator.downloadStackedTile( stackedTileId, DownloadBulk );
 }
 
+void TextureLayer::prefetchDestination( qreal lon, qreal lat, int radius )
+{
+    if ( d->m_textures.isEmpty() || d->m_layerDecorator.textureLayersSize() == 0 )
+        return;
+
+    d->m_prefetcher.setDestination( lon, lat, radius, d->tileLevel( radius ) );
+}
+
 void TextureLayer::setMapTheme( const QVector<const GeoSceneTextureTile *> &textures, const GeoSceneGroup *textureLayerSettings, const QString &seaFile, const QString &landFile )
 {
     delete d->m_texcolorizer;
@@ -58,6 +58,8 @@ class MARBLE_EXPORT TextureLayer : public QObject, public LayerInterface
     bool showSunShading() const;
     bool showCityLights() const;
 
+    bool asynchronousTileLoading() const;
+
     /**
      * @brief Return the current tile zoom level. For example for OpenStreetMap
      *        possible values are 1..18, for BlueMarble 0..6.
@@ -90,6 +92,14 @@ public Q_SLOTS:
 
     void setShowTileId( bool show );
 
+    /**
+     * @brief  Set whether tiles missing in memory are loaded in the background
+     *
+     * While a tile is being loaded, a scaled version of an ancestor tile is
+     * shown in its place.
+     */
+    void setAsynchronousTileLoading( bool asynchronous );
+
     /**
      * @brief  Set the Projection used for the map
      * @param  projection projection type (e.g. Spherical, Equirectangular, Mercator)
@@ -108,6 +118,16 @@ public Q_SLOTS:
 
     void downloadStackedTile( const TileId &stackedTileId );
 
+    /**
+     * @brief  Load the tiles of a viewport in the background ahead of time
+     * @param  lon the longitude of the center in radians
+     * @param  lat the latitude of the center in radians
+     * @param  radius the radius of the globe in the viewport
+     *
+     * Used for the viewport an animation is going to end in.
+     */
+    void prefetchDestination( qreal lon, qreal lat, int radius );
+
  Q_SIGNALS:
     void tileLevelChanged( int );
     void repaintNeeded();
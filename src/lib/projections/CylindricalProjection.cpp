@@ -82,7 +82,23 @@ bool CylindricalProjection::screenCoordinates( const GeoDataLineString &lineStri
                                                   const ViewportParams *viewport,
                                                   QVector<QPolygonF *> &polygons ) const
 {
+    Q_D( const CylindricalProjection );
+
+    QVector<QPolygonF *> subPolygons;
+    if ( !unrepeatedScreenCoordinates( lineString, viewport, subPolygons ) ) {
+        return false;
+    }
+
+    d->repeatPolygons( viewport, subPolygons );
+
+    polygons << subPolygons;
+    return polygons.isEmpty();
+}
 
+bool CylindricalProjection::unrepeatedScreenCoordinates( const GeoDataLineString &lineString,
+                                                         const ViewportParams *viewport,
+                                                         QVector<QPolygonF *> &polygons ) const
+{
     Q_D( const CylindricalProjection );
     // Compare bounding box size of the line string with the angularResolution
     // Immediately return if the latLonAltBox is smaller.
@@ -91,12 +107,39 @@ bool CylindricalProjection::screenCoordinates( const GeoDataLineString &lineStri
         return false;
     }
 
-    QVector<QPolygonF *> subPolygons;
-    d->lineStringToPolygon( lineString, viewport, subPolygons );
+    d->lineStringToPolygon( lineString, viewport, polygons );
+    return true;
+}
 
-    polygons << subPolygons;
-    return polygons.isEmpty();
+void CylindricalProjection::repeats( const ViewportParams *viewport,
+                                     qreal &interval, int &westRepeats, int &eastRepeats ) const
+{
+    // Choose a latitude that is inside the viewport.
+    const qreal centerLatitude = viewport->viewLatLonAltBox().center().latitude();
+
+    qreal xWest = 0;
+    qreal xEast = 0;
+    qreal y = 0;
+    screenCoordinates( GeoDataCoordinates( -M_PI, centerLatitude ), viewport, xWest, y );
+    screenCoordinates( GeoDataCoordinates( +M_PI, centerLatitude ), viewport, xEast, y );
+
+    interval = xEast - xWest;
+    westRepeats = 0;
+    eastRepeats = 0;
+
+    if ( xWest <= 0 && xEast >= viewport->width() - 1 ) {
+        // mDebug() << "No repeats";
+        return;
+    }
+
+    if ( xWest > 0 ) {
+        westRepeats = (int)( xWest / interval ) + 1;
+    }
+    if ( xEast < viewport->width() ) {
+        eastRepeats = (int)( ( viewport->width() - xEast ) / interval ) + 1;
+    }
 }
+
 int CylindricalProjectionPrivate::tessellateLineSegment( const GeoDataCoordinates &aCoords,
                                                 qreal ax, qreal ay,
                                                 const GeoDataCoordinates &bCoords,
@@ -279,11 +322,15 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
 
     polygons.append( new QPolygonF );
 
-    GeoDataLineString::ConstIterator itCoords = lineString.constBegin();
-    GeoDataLineString::ConstIterator itPreviousCoords = lineString.constBegin();
+    // The nodes are read from the packed arrays of the line string into two
+    // GeoDataCoordinates objects which take turns holding the current and
+    // the previous node. This avoids unpacking the line string.
+    GeoDataCoordinates nodes[ 2 ];
+    int currentNode = 0;
+    const GeoDataCoordinates *previousCoords = &nodes[ 0 ];
 
-    GeoDataLineString::ConstIterator itBegin = lineString.constBegin();
-    GeoDataLineString::ConstIterator itEnd = lineString.constEnd();
+    const int size = lineString.size();
+    int index = 0;
 
     bool processingLastNode = false;
 
@@ -299,24 +346,33 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
                               ( viewport->radius() >   50 ) ? 1 :
                                                               0;
 
-    while ( itCoords != itEnd )
+    const qreal angularResolution = viewport->angularResolution();
+
+    while ( index < size )
     {
+        const qreal lon = lineString.longitude( index );
+        const qreal lat = lineString.latitude( index );
 
         // Optimization for line strings with a big amount of nodes
-        bool skipNode = itCoords != itBegin && isLong && !processingLastNode &&
-                ( (*itCoords).detail() > maximumDetail
-                  || viewport->resolves( *itPreviousCoords, *itCoords ) );
+        // (the same check as ViewportParams::resolves())
+        bool skipNode = index != 0 && isLong && !processingLastNode &&
+                ( lineString.detail( index ) > maximumDetail
+                  || fabs( lon - previousCoords->longitude() )
+                     + fabs( lat - previousCoords->latitude() ) < angularResolution );
 
         if ( !skipNode ) {
 
 
             Q_Q( const CylindricalProjection );
 
-            q->screenCoordinates( *itCoords, viewport, x, y );
+            GeoDataCoordinates &coords = nodes[ currentNode ];
+            coords.set( lon, lat, lineString.altitude( index ) );
+
+            q->screenCoordinates( coords, viewport, x, y );
 
             // Initializing variables that store the values of the previous iteration
-            if ( !processingLastNode && itCoords == itBegin ) {
-                itPreviousCoords = itCoords;
+            if ( !processingLastNode && index == 0 ) {
+                previousCoords = &coords;
                 previousX = x;
                 previousY = y;
             }
@@ -327,8 +383,8 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
 
             if ( lineString.tessellate() ) {
 
-                mirrorCount = tessellateLineSegment( *itPreviousCoords, previousX, previousY,
-                                           *itCoords, x, y,
+                mirrorCount = tessellateLineSegment( *previousCoords, previousX, previousY,
+                                           coords, x, y,
                                            polygons, viewport,
                                            f, mirrorCount, distance );
             }
@@ -337,12 +393,13 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
                 // special case for polys which cross dateline but have no Tesselation Flag
                 // the expected rendering is a screen coordinates straight line between
                 // points, but in projections with repeatX things are not smooth
-                mirrorCount = crossDateLine( *itPreviousCoords, *itCoords, x, y, polygons, mirrorCount, distance );
+                mirrorCount = crossDateLine( *previousCoords, coords, x, y, polygons, mirrorCount, distance );
             }
 
-            itPreviousCoords = itCoords;
+            previousCoords = &coords;
             previousX = x;
             previousY = y;
+            currentNode = 1 - currentNode;
         }
 
         // Here we modify the condition to be able to process the
@@ -351,10 +408,10 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
         if ( processingLastNode ) {
             break;
         }
-        ++itCoords;
+        ++index;
 
-        if ( itCoords == itEnd  && lineString.isClosed() ) {
-            itCoords = itBegin;
+        if ( index == size  && lineString.isClosed() ) {
+            index = 0;
             processingLastNode = true;
         }
     }
@@ -373,8 +430,6 @@ bool CylindricalProjectionPrivate::lineStringToPolygon( const GeoDataLineString
         }
     }
 
-    repeatPolygons( viewport, polygons );
-
     return polygons.isEmpty();
 }
 
@@ -400,41 +455,20 @@ void CylindricalProjectionPrivate::repeatPolygons( const ViewportParams *viewpor
 {
     Q_Q( const CylindricalProjection );
 
-    qreal xEast = 0;
-    qreal xWest = 0;
-    qreal y = 0;
+    qreal repeatXInterval = 0;
+    int repeatsLeft = 0;
+    int repeatsRight = 0;
+    q->repeats( viewport, repeatXInterval, repeatsLeft, repeatsRight );
 
-    // Choose a latitude that is inside the viewport.
-    qreal centerLatitude = viewport->viewLatLonAltBox().center().latitude();
-    
-    GeoDataCoordinates westCoords( -M_PI, centerLatitude );
-    GeoDataCoordinates eastCoords( +M_PI, centerLatitude );
-
-    q->screenCoordinates( westCoords, viewport, xWest, y );
-    q->screenCoordinates( eastCoords, viewport, xEast, y );
-
-    if ( xWest <= 0 && xEast >= viewport->width() - 1 ) {
-        // mDebug() << "No repeats";
+    if ( repeatsLeft == 0 && repeatsRight == 0 ) {
         return;
     }
 
-    qreal repeatXInterval = xEast - xWest;
-
-    qreal repeatsLeft  = 0;
-    qreal repeatsRight = 0;
-
-    if ( xWest > 0 ) {
-        repeatsLeft = (int)( xWest / repeatXInterval ) + 1;
-    }
-    if ( xEast < viewport->width() ) {
-        repeatsRight = (int)( ( viewport->width() - xEast ) / repeatXInterval ) + 1;
-    }
-
     QVector<QPolygonF *> repeatedPolygons;
     QVector<QPolygonF *> translatedPolygons;
 
     qreal xOffset = 0;
-    qreal it = repeatsLeft;
+    int it = repeatsLeft;
     
     while ( it > 0 ) {
         xOffset = -it * repeatXInterval;
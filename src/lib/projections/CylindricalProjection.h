@@ -52,6 +52,30 @@ class CylindricalProjection : public AbstractProjection
 
     using AbstractProjection::screenCoordinates;
 
+    /**
+     * @brief Get the screen polygons of a line string without their repetitions.
+     *
+     * Like screenCoordinates(), but without the copies of the polygons which
+     * repeat the map to the west and the east. The polygons only depend on
+     * the radius, the center latitude and the height of the @p viewport.
+     * A different center longitude or width translates them horizontally.
+     *
+     * @see repeats()
+     */
+    bool unrepeatedScreenCoordinates( const GeoDataLineString &lineString,
+                                      const ViewportParams *viewport,
+                                      QVector<QPolygonF*> &polygons ) const;
+
+    /**
+     * @brief Get the repetitions of the map which are visible in the viewport.
+     *
+     * @param interval the horizontal distance between two repetitions in pixels
+     * @param westRepeats the number of repetitions visible west of the map
+     * @param eastRepeats the number of repetitions visible east of the map
+     */
+    void repeats( const ViewportParams *viewport,
+                  qreal &interval, int &westRepeats, int &eastRepeats ) const;
+
     virtual QPainterPath mapShape( const ViewportParams *viewport ) const;
 
  protected: 
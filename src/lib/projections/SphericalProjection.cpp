@@ -459,8 +459,12 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
 
     polygons.append( new QPolygonF );
 
-    GeoDataLineString::ConstIterator itCoords = lineString.constBegin();
-    GeoDataLineString::ConstIterator itPreviousCoords = lineString.constBegin();
+    // The nodes are read from the packed arrays of the line string into two
+    // GeoDataCoordinates objects which take turns holding the current and
+    // the previous node. This avoids unpacking the line string.
+    GeoDataCoordinates nodes[ 2 ];
+    int currentNode = 0;
+    const GeoDataCoordinates *previousCoords = &nodes[ 0 ];
 
     // Some projections display the earth in a way so that there is a
     // foreside and a backside.
@@ -483,8 +487,8 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
     bool horizonOrphan = false;
     GeoDataCoordinates horizonOrphanCoords;
 
-    GeoDataLineString::ConstIterator itBegin = lineString.constBegin();
-    GeoDataLineString::ConstIterator itEnd = lineString.constEnd();
+    const int size = lineString.size();
+    int index = 0;
 
     bool processingLastNode = false;
 
@@ -500,22 +504,31 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
                               ( viewport->radius() >   50 ) ? 1 :
                                                               0;
 
-    while ( itCoords != itEnd )
+    const qreal angularResolution = viewport->angularResolution();
+
+    while ( index < size )
     {
+        const qreal lon = lineString.longitude( index );
+        const qreal lat = lineString.latitude( index );
 
         // Optimization for line strings with a big amount of nodes
-        bool skipNode = itCoords != itBegin && isLong && !processingLastNode &&
-                ( (*itCoords).detail() > maximumDetail
-                  || viewport->resolves( *itPreviousCoords, *itCoords ) );
+        // (the same check as ViewportParams::resolves())
+        bool skipNode = index != 0 && isLong && !processingLastNode &&
+                ( lineString.detail( index ) > maximumDetail
+                  || fabs( lon - previousCoords->longitude() )
+                     + fabs( lat - previousCoords->latitude() ) < angularResolution );
 
         if ( !skipNode ) {
 
-            q->screenCoordinates( *itCoords, viewport, x, y, globeHidesPoint );
+            GeoDataCoordinates &coords = nodes[ currentNode ];
+            coords.set( lon, lat, lineString.altitude( index ) );
+
+            q->screenCoordinates( coords, viewport, x, y, globeHidesPoint );
 
             // Initializing variables that store the values of the previous iteration
-            if ( !processingLastNode && itCoords == itBegin ) {
+            if ( !processingLastNode && index == 0 ) {
                 previousGlobeHidesPoint = globeHidesPoint;
-                itPreviousCoords = itCoords;
+                previousCoords = &coords;
                 previousX = x;
                 previousY = y;
             }
@@ -526,7 +539,7 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
      
             if ( isAtHorizon ) {
                 // Handle the "horizon case"
-                horizonCoords = findHorizon( *itPreviousCoords, *itCoords, viewport, f );
+                horizonCoords = findHorizon( *previousCoords, coords, viewport, f );
 
                 if ( lineString.isClosed() ) {
                     if ( horizonPair ) {
@@ -562,8 +575,8 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
 
                 if ( !isAtHorizon ) {
 
-                    tessellateLineSegment( *itPreviousCoords, previousX, previousY,
-                                           *itCoords, x, y,
+                    tessellateLineSegment( *previousCoords, previousX, previousY,
+                                           coords, x, y,
                                            polygons, viewport,
                                            f );
 
@@ -573,12 +586,12 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
                     // current or previous point in the line. 
                     if ( previousGlobeHidesPoint ) {
                         tessellateLineSegment( horizonCoords, horizonX, horizonY,
-                                               *itCoords, x, y,
+                                               coords, x, y,
                                                polygons, viewport,
                                                f );
                     }
                     else {
-                        tessellateLineSegment( *itPreviousCoords, previousX, previousY,
+                        tessellateLineSegment( *previousCoords, previousX, previousY,
                                                horizonCoords, horizonX, horizonY,
                                                polygons, viewport,
                                                f );
@@ -605,9 +618,10 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
             }
 
             previousGlobeHidesPoint = globeHidesPoint;
-            itPreviousCoords = itCoords;
+            previousCoords = &coords;
             previousX = x;
             previousY = y;
+            currentNode = 1 - currentNode;
         }
 
         // Here we modify the condition to be able to process the
@@ -616,10 +630,10 @@ bool SphericalProjectionPrivate::lineStringToPolygon( const GeoDataLineString &l
         if ( processingLastNode ) {
             break;
         }
-        ++itCoords;
+        ++index;
 
-        if ( itCoords == itEnd  && lineString.isClosed() ) {
-            itCoords = itBegin;
+        if ( index == size  && lineString.isClosed() ) {
+            index = 0;
             processingLastNode = true;
         }
     }
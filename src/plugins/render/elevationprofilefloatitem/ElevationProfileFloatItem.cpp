@@ -58,6 +58,8 @@ ElevationProfileFloatItem::ElevationProfileFloatItem( const MarbleModel *marbleM
         m_marbleWidget( 0 ),
         m_routingModel( 0 ),
         m_routeAvailable( false ),
+        m_heightsRequest( 0 ),
+        m_heightsOutdated( false ),
         m_firstVisiblePoint( 0 ),
         m_lastVisiblePoint( 0 ),
         m_zoomToViewport( false )
@@ -139,6 +141,8 @@ QIcon ElevationProfileFloatItem::icon () const
 void ElevationProfileFloatItem::initialize ()
 {
     connect( marbleModel()->elevationModel(), SIGNAL(updateAvailable()), SLOT(updateData()) );
+    connect( marbleModel()->elevationModel(), SIGNAL(heightsAvailable(int,QVector<qreal>)),
+             SLOT(updateHeights(int,QVector<qreal>)) );
 
     m_routingModel = marbleModel()->routingManager()->routingModel();
     connect( m_routingModel, SIGNAL(currentRouteChanged()), this, SLOT(updateData()) );
@@ -515,9 +519,30 @@ bool ElevationProfileFloatItem::eventFilter( QObject *object, QEvent *e )
 
 void ElevationProfileFloatItem::updateData()
 {
+    if ( m_heightsRequest ) {
+        // each loaded tile updates the data, so these are requested again at most once
+        m_heightsOutdated = true;
+        return;
+    }
+    m_heightsOutdated = false;
+
     m_routeAvailable = m_routingModel && m_routingModel->rowCount() > 0;
-    m_points = m_routeAvailable ? m_routingModel->route().path() : GeoDataLineString();
-    m_eleData = calculateElevationData( m_points );
+    m_requestedPoints = m_routeAvailable ? m_routingModel->route().path() : GeoDataLineString();
+
+    // the heights are calculated in the background
+    m_heightsRequest = marbleModel()->elevationModel()->requestHeights( m_requestedPoints );
+}
+
+void ElevationProfileFloatItem::updateHeights( int request, const QVector<qreal> &heights )
+{
+    if ( request != m_heightsRequest ) {
+        // requested by someone else
+        return;
+    }
+    m_heightsRequest = 0;
+
+    m_points = m_requestedPoints;
+    m_eleData = calculateElevationData( m_points, heights );
 
     calculateStatistics( m_eleData );
     if ( m_eleData.length() >= 2 ) {
@@ -527,6 +552,10 @@ void ElevationProfileFloatItem::updateData()
     emit dataUpdated();
 
     forceRepaint();
+
+    if ( m_heightsOutdated ) {
+        updateData();
+    }
 }
 
 void ElevationProfileFloatItem::updateVisiblePoints()
@@ -534,7 +563,8 @@ void ElevationProfileFloatItem::updateVisiblePoints()
     if ( ! ( m_routeAvailable && m_routingModel ) ) {
         return;
     }
-    GeoDataLineString points = m_routingModel->route().path();
+    // the points of the elevation data, the route may have changed meanwhile
+    const GeoDataLineString &points = m_points;
     if ( points.size() < 2 ) {
         return;
     }
@@ -586,18 +616,14 @@ void ElevationProfileFloatItem::updateVisiblePoints()
     return;
 }
 
-QList<QPointF> ElevationProfileFloatItem::calculateElevationData( const GeoDataLineString &lineString ) const
+QList<QPointF> ElevationProfileFloatItem::calculateElevationData( const GeoDataLineString &lineString, const QVector<qreal> &heights )
 {
     // TODO: Don't re-calculate the whole route if only a small part of it was changed
     QList<QPointF> result;
 
-    GeoDataLineString path;
+    Q_ASSERT( heights.size() == lineString.size() );
     for ( int i = 0; i < lineString.size(); i++ ) {
-        path.append( lineString[i] );
-
-        const qreal lat = lineString[i].latitude ( GeoDataCoordinates::Degree );
-        const qreal lon = lineString[i].longitude( GeoDataCoordinates::Degree );
-        qreal ele = marbleModel()->elevationModel()->height( lon, lat );
+        qreal ele = heights[i];
         if ( ele == invalidElevationData ) { // no data
             ele = 0;
         }
@@ -90,6 +90,7 @@ class ElevationProfileFloatItem : public AbstractFloatItem, public DialogConfigu
 
  private Q_SLOTS:
     void updateData();
+    void updateHeights( int request, const QVector<qreal> &heights );
     void updateVisiblePoints();
     void forceRepaint();
     void readSettings();
@@ -127,18 +128,21 @@ class ElevationProfileFloatItem : public AbstractFloatItem, public DialogConfigu
     MarbleWidget*     m_marbleWidget;
     const RoutingModel* m_routingModel;
     bool              m_routeAvailable;
+    int               m_heightsRequest;
+    bool              m_heightsOutdated;
 
     int               m_firstVisiblePoint;
     int               m_lastVisiblePoint;
     bool              m_zoomToViewport;
     QList<QPointF>    m_eleData;
     GeoDataLineString m_points;
+    GeoDataLineString m_requestedPoints;
     qreal             m_minElevation;
     qreal             m_maxElevation;
     qreal             m_gain;
     qreal             m_loss;
 
-    QList<QPointF> calculateElevationData( const GeoDataLineString &lineString ) const;
+    static QList<QPointF> calculateElevationData( const GeoDataLineString &lineString, const QVector<qreal> &heights );
     void calculateStatistics( const QList<QPointF> &eleData );
 };
 
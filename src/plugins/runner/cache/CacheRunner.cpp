@@ -9,6 +9,7 @@
 
 #include "CacheRunner.h"
 
+#include "DocumentCache.h"
 #include "GeoDataDocument.h"
 #include "GeoDataExtendedData.h"
 #include "GeoDataPlacemark.h"
@@ -38,6 +39,14 @@ void CacheRunner::parseFile( const QString &fileName, DocumentRole role = Unknow
         return;
     }
 
+    if ( DocumentCache::isDocumentCache( fileName ) ) {
+        QString error;
+        GeoDataDocument *document = DocumentCache::read( fileName, role, &error );
+        emit parsingFinished( document, error );
+        return;
+    }
+
+    // cache files of older versions which only keep points
     file.open( QIODevice::ReadOnly );
     QDataStream in( &file );
 
@@ -62,7 +62,7 @@ void GosmoreRunnerPrivate::merge( GeoDataLineString* one, const GeoDataLineStrin
 {
     Q_ASSERT( one );
 
-    QVector<GeoDataCoordinates>::const_iterator iter = two.constBegin();
+    GeoDataLineString::ConstIterator iter = two.constBegin();
     for( ; iter != two.constEnd(); ++iter ) {
         /** @todo: It might be needed to cut off some points at the start or end */
         one->append( *iter );
@@ -12,18 +12,12 @@
 #include "LocalDatabaseRunner.h"
 
 #include "MarbleModel.h"
-#include "MarblePlacemarkModel.h"
-#include "GeoDataFeature.h"
+#include "PlacemarkSearchIndex.h"
 #include "GeoDataPlacemark.h"
-#include "GeoDataCoordinates.h"
 
-#include "MarbleDebug.h"
 #include <QString>
-#include <QStringList>
 #include <QVector>
 
-#include <QtDebug>
-
 namespace Marble
 {
 
@@ -42,27 +36,10 @@ void LocalDatabaseRunner::search( const QString &searchTerm, const GeoDataLatLon
     QVector<GeoDataPlacemark*> vector;
 
     if (model()) {
-        const QAbstractItemModel * placemarkModel = model()->placemarkModel();
-
-        if (placemarkModel) {
-            QModelIndexList resultList;
-            QModelIndex firstIndex = placemarkModel->index( 0, 0 );
-            resultList = placemarkModel->match( firstIndex,
-                                    Qt::DisplayRole, searchTerm, -1,
-                                    Qt::MatchStartsWith );
+        const PlacemarkSearchIndex *searchIndex = model()->placemarkSearchIndex();
 
-            foreach ( const QModelIndex& index, resultList )
-            {
-                if( !index.isValid() ) {
-                    mDebug() << "invalid index!!!";
-                    continue;
-                }
-                GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(qvariant_cast<GeoDataObject*>( index.data( MarblePlacemarkModel::ObjectPointerRole )));
-                if ( placemark &&
-                     ( preferred.isEmpty() || preferred.contains( placemark->coordinate() ) ) ) {
-                    vector.append( new GeoDataPlacemark( *placemark ));
-                }
-            }
+        foreach ( const GeoDataPlacemark *placemark, searchIndex->search( searchTerm, preferred ) ) {
+            vector.append( new GeoDataPlacemark( *placemark ));
         }
     }
 
@@ -10,10 +10,8 @@
 #include "OsmParser.h"
 #include "OsmElementDictionary.h"
 #include "GeoDataDocument.h"
+#include "GeoDataPlacemark.h"
 
-#include "OsmNodeFactory.h"
-#include "OsmWayFactory.h"
-#include "OsmRelationFactory.h"
 #include "OsmGlobals.h"
 
 namespace Marble {
@@ -21,14 +19,37 @@ namespace Marble {
 OsmParser::OsmParser()
     : GeoParser( 0 )
 {
+    osm::OsmGlobals::setupAreaTags();
 }
 
 OsmParser::~OsmParser()
 {
-    osm::OsmRelationFactory::clear();
-    osm::OsmWayFactory::clear();
-    osm::OsmNodeFactory::clear();
-    osm::OsmGlobals::cleanUpDummyPlacemarks();
+    qDeleteAll( m_dummyPlacemarks );
+}
+
+osm::OsmNodeFactory &OsmParser::nodes()
+{
+    return m_nodes;
+}
+
+osm::OsmWayFactory &OsmParser::ways()
+{
+    return m_ways;
+}
+
+osm::OsmRelationFactory &OsmParser::relations()
+{
+    return m_relations;
+}
+
+GeoDataPoint *OsmParser::nodePoint()
+{
+    return &m_nodePoint;
+}
+
+QList<GeoDataPlacemark *> &OsmParser::dummyPlacemarks()
+{
+    return m_dummyPlacemarks;
 }
 
 bool OsmParser::isValidRootElement()
@@ -50,4 +71,10 @@ GeoDocument* OsmParser::createDocument() const
     return new GeoDataDocument;
 }
 
+OsmParser &osmParser( GeoParser &parser )
+{
+    Q_ASSERT( dynamic_cast<OsmParser *>( &parser ) );
+    return static_cast<OsmParser &>( parser );
+}
+
 }
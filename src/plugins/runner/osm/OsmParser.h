@@ -11,23 +11,59 @@
 #define OSMPARSER_H
 
 #include "GeoParser.h"
+#include "GeoDataPoint.h"
+#include "OsmNodeFactory.h"
+#include "OsmWayFactory.h"
+#include "OsmRelationFactory.h"
+
+#include <QList>
 
 namespace Marble {
 
+class GeoDataPlacemark;
+
+/**
+ * The state of the import of one file is kept in the parser, so several
+ * files can be imported at the same time in different threads.
+ */
 class OsmParser : public GeoParser
 {
 public:
     OsmParser();
     virtual ~OsmParser();
 
+    osm::OsmNodeFactory &nodes();
+    osm::OsmWayFactory &ways();
+    osm::OsmRelationFactory &relations();
+
+    /**
+     * The geometry of the node being parsed. The same point is reused
+     * for all nodes, only nodes which become placemarks are copied.
+     */
+    GeoDataPoint *nodePoint();
+
+    /**
+     * The placemarks of ways converted to polygons. They are
+     * deleted with the parser.
+     */
+    QList<GeoDataPlacemark *> &dummyPlacemarks();
+
 private:
     virtual bool isValidElement(const QString& tagName) const;
     virtual bool isValidRootElement();
 
     virtual GeoDocument* createDocument() const;
 
+    osm::OsmNodeFactory m_nodes;
+    osm::OsmWayFactory m_ways;
+    osm::OsmRelationFactory m_relations;
+    GeoDataPoint m_nodePoint;
+    QList<GeoDataPlacemark *> m_dummyPlacemarks;
 };
 
+// Helper function for the tag handlers
+OsmParser &osmParser( GeoParser &parser );
+
 }
 
 #endif // OSMPARSER_H
@@ -0,0 +1,285 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "OsmElementBuilder.h"
+
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataLineString.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataPolyStyle.h"
+#include "GeoDataStyle.h"
+#include "MarbleDebug.h"
+#include "OsmGlobals.h"
+
+#include <QStringList>
+
+namespace Marble
+{
+
+namespace osm
+{
+
+static QStringList tagBlackList = QStringList() << "created_by";
+
+void OsmElementBuilder::addDocumentStyles( GeoDataDocument *doc )
+{
+    GeoDataPolyStyle backgroundPolyStyle;
+    backgroundPolyStyle.setFill( true );
+    backgroundPolyStyle.setOutline( false );
+    backgroundPolyStyle.setColor( OsmGlobals::backgroundColor );
+    GeoDataStyle backgroundStyle;
+    backgroundStyle.setPolyStyle( backgroundPolyStyle );
+    backgroundStyle.setStyleId( "background" );
+    doc->addStyle( backgroundStyle );
+}
+
+void OsmElementBuilder::addTag( GeoDataDocument *doc, ElementType type, GeoDataGeometry *geometry,
+                                const QString &key, const QString &value,
+                                QList<GeoDataPlacemark *> &dummyPlacemarks )
+{
+    if ( tagBlackList.contains( key ) )
+        return;
+
+    GeoDataGeometry *placemarkGeometry = geometry;
+    
+    //If node geometry is part of multigeometry -> go up to placemark geometry.
+    while( dynamic_cast<GeoDataMultiGeometry*>(placemarkGeometry->parent()) )
+        placemarkGeometry = dynamic_cast<GeoDataMultiGeometry*>(placemarkGeometry->parent());
+    
+    GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark*>(placemarkGeometry->parent());
+
+    if ( key == "name" )
+    {
+        if ( !placemark )
+        {
+            if ( type == Node )
+                placemark = createPOI( doc, geometry );
+            else
+                return;
+        }
+        placemark->setName( value );
+        return;
+    }
+
+    // Ways or relations can represent closed areas such as buildings
+    if ( type == Way || type == Relation )
+    {
+        Q_ASSERT( placemark );
+
+        //Convert area ways or relations to polygons
+        if( !dynamic_cast<GeoDataPolygon*>( geometry ) && OsmGlobals::tagNeedArea( key + '=' + value ) )
+        {
+            placemark = convertWayToPolygon( doc, placemark, geometry, dummyPlacemarks );
+        }
+        if ( key == "building" && value == "yes" && placemark->visualCategory() == GeoDataFeature::Default )
+        {
+            placemark->setVisualCategory( GeoDataFeature::Building );
+            placemark->setVisible( true );
+        }
+    }
+    else if ( type == Node ) //POI
+    {
+        GeoDataFeature::GeoDataVisualCategory poiCategory = GeoDataFeature::OsmVisualCategory( key + '=' + value );
+
+        //Placemark is an accepted POI
+        if ( poiCategory )
+        {
+            if ( !placemark )
+                placemark = createPOI( doc, geometry );
+
+            placemark->setVisible( true );
+        }
+    }
+
+    if ( placemark )
+    {
+        GeoDataFeature::GeoDataVisualCategory category;
+
+        if ( ( category = GeoDataFeature::OsmVisualCategory( key + '=' + value ) ) )
+        {
+            if( placemark->visualCategory() != GeoDataFeature::Default 
+             && placemark->visualCategory() != GeoDataFeature::Building )
+            {
+                GeoDataPlacemark* newPlacemark = new GeoDataPlacemark( *placemark );
+                newPlacemark->setVisualCategory( category );
+                newPlacemark->setStyle( 0 );
+                newPlacemark->setVisible( true );
+                doc->append( newPlacemark );
+            }
+            else
+            {
+                //Remove assigned style (i.e. building style)
+                placemark->setStyle( 0 );
+                placemark->setVisualCategory( category );
+                placemark->setVisible( true );
+            }
+        }
+        else if ( ( category = GeoDataFeature::OsmVisualCategory( key ) ) )
+        {
+            if( placemark->visualCategory() != GeoDataFeature::Default )
+            {
+                GeoDataPlacemark* newPlacemark = new GeoDataPlacemark( *placemark );
+                newPlacemark->setVisualCategory( category );
+                newPlacemark->setStyle( 0 );
+                newPlacemark->setVisible( true );
+                doc->append( newPlacemark );
+            }
+            else
+            {
+                //Remove assigned style (i.e. building style)
+                placemark->setStyle( 0 );
+                placemark->setVisualCategory( category );
+                placemark->setVisible( true );
+            }
+        }
+    }
+}
+
+void OsmElementBuilder::addWayMember( GeoDataPolygon *polygon, const QString &role, const GeoDataLineString &line )
+{
+    // Outer poligons (sometimes the role is empty)
+    if ( role == "outer" || role.isEmpty() )
+    {
+        // Some of the ways that build the relation
+        // might be in opposite directions
+        // so the final linearRing would be wrong.
+        // It is needed to seek in the linearRing
+        // to know if the new way should be added
+        // at the beginning or end and in which order.
+        // Also the shared node (which will be in both
+        // geometries) has to be removed to avoid having
+        // it repeated.
+
+        GeoDataLinearRing envelope = polygon->outerBoundary();
+
+        // Case 0: envelope is empty
+        if ( envelope.isEmpty() )
+        {
+            envelope = line;
+        }
+
+        // Case 1: line.first = envelope.first
+        else if ( line.first() == envelope.first() )
+        {
+            GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
+
+            // Invert envelopes direction
+            for (int x = envelope.size()-1; x > -1; x--)
+            {
+                temp.append( GeoDataCoordinates ( envelope.at(x) ) );
+            }
+            envelope = temp;
+
+            // Now its the same as case 2
+            // envelope-last not to repeat the shared node
+            envelope.remove( envelope.size() - 1 );
+            envelope << line;
+        }
+
+        // Case 2: line.first = envelope.last
+        else if (line.first() == envelope.last() )
+        {
+            // envelope-last not to repeat the shared node
+            envelope.remove( envelope.size() - 1 );
+            envelope << line;
+        }
+
+        // Case 3: line.last = envelope.first
+        else if (line.last() == envelope.first() )
+        {
+            GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
+
+            // Invert envelopes direction
+            for (int x = envelope.size()-1; x > -1; x--)
+            {
+                temp.append( GeoDataCoordinates ( envelope.at(x) ) );
+            }
+            envelope = temp;
+
+            // Now its the same as case 4
+            // size-2 not to repeat the shared node
+            for (int x = line.size()-2; x > -1; x--)
+            {
+                envelope.append( GeoDataCoordinates ( line.at(x) ) );
+            }
+        }
+
+        // Case 4: line.last = envelope.last
+        else if (line.last() == envelope.last() )
+        {
+            // size-2 not to repeat the shared node
+            for (int x = line.size()-2; x > -1; x--)
+            {
+                envelope.append( GeoDataCoordinates ( line.at(x) ) );
+            }
+        }
+
+        // Update the outer boundary
+        polygon->setOuterBoundary( envelope );
+    }
+
+    // Inner poligons
+    if ( role == "inner" )
+    {
+        polygon->appendInnerBoundary( GeoDataLinearRing( line ) );
+    }
+}
+
+void OsmElementBuilder::addRelationMember( GeoDataPolygon *polygon, const QString &role, const GeoDataPolygon &member )
+{
+    // Never seen this case
+    if ( role == "outer" )
+    {
+        mDebug() << "Parsed relation with a relation outer member";
+    }
+
+    // It only can be an inner relation or subarea
+    // Subarea is mainly used for administrative boundaries
+    else if ( role == "inner" || role == "subarea" || role.isEmpty() )
+    {
+        polygon->appendInnerBoundary( member.outerBoundary() );
+    }
+}
+
+GeoDataPlacemark *OsmElementBuilder::createPOI( GeoDataDocument *doc, GeoDataGeometry *geometry )
+{
+    GeoDataPoint *point = dynamic_cast<GeoDataPoint *>( geometry );
+    Q_ASSERT( point );
+    GeoDataPlacemark *placemark = new GeoDataPlacemark();
+    placemark->setGeometry( new GeoDataPoint( *point ) );
+    point->setParent( placemark );
+    placemark->setVisible( false );
+    placemark->setZoomLevel( 18 );
+    doc->append( placemark );
+    return placemark;
+}
+
+GeoDataPlacemark *OsmElementBuilder::convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry,
+                                                          QList<GeoDataPlacemark *> &dummyPlacemarks )
+{
+    GeoDataLineString *polyline = dynamic_cast<GeoDataLineString *>( geometry );
+    Q_ASSERT( polyline );
+    doc->remove( doc->childPosition( placemark ) );
+    dummyPlacemarks << placemark;
+    GeoDataPlacemark *newPlacemark = new GeoDataPlacemark( *placemark );
+    GeoDataPolygon *polygon = new GeoDataPolygon;
+    polygon->setOuterBoundary( *polyline );
+    //FIXME: Dirty hack to change placemark associated with node, for parsing purposes.
+    polyline->setParent( newPlacemark );
+    newPlacemark->setGeometry( polygon );
+    doc->append( newPlacemark );
+    return newPlacemark;
+}
+
+}
+
+}
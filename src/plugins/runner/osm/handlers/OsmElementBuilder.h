@@ -0,0 +1,78 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_OSMELEMENTBUILDER_H
+#define MARBLE_OSMELEMENTBUILDER_H
+
+#include <QList>
+#include <QString>
+
+namespace Marble
+{
+
+class GeoDataDocument;
+class GeoDataGeometry;
+class GeoDataLineString;
+class GeoDataPlacemark;
+class GeoDataPolygon;
+
+namespace osm
+{
+
+// This is a class for turning the tags and members of OSM
+// elements into placemarks, independent of the file format.
+// The XML tag handlers and other OSM readers share it, so
+// the data looks the same whatever file it comes from.
+
+class OsmElementBuilder
+{
+public:
+    enum ElementType {
+        Node,
+        Way,
+        Relation
+    };
+
+    /**
+     * @brief Add the styles every OSM document has to @p doc
+     */
+    static void addDocumentStyles( GeoDataDocument *doc );
+
+    /**
+     * @brief Apply the tag @p key = @p value to an element
+     * @p geometry is the point of a node, the line string of a way or
+     * the polygon of a relation. Nodes become placemarks of @p doc
+     * when they have a name or a category. Ways may be converted to
+     * polygons, the placemarks they leave are appended to
+     * @p dummyPlacemarks and have to be deleted after the file is read.
+     */
+    static void addTag( GeoDataDocument *doc, ElementType type, GeoDataGeometry *geometry,
+                        const QString &key, const QString &value,
+                        QList<GeoDataPlacemark *> &dummyPlacemarks );
+
+    /**
+     * @brief Add the way @p line with @p role to the relation @p polygon
+     * The outer ways are joined into the outer boundary.
+     */
+    static void addWayMember( GeoDataPolygon *polygon, const QString &role, const GeoDataLineString &line );
+
+    /**
+     * @brief Add the relation @p member with @p role to the relation @p polygon
+     */
+    static void addRelationMember( GeoDataPolygon *polygon, const QString &role, const GeoDataPolygon &member );
+
+private:
+    static GeoDataPlacemark *convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry,
+                                                  QList<GeoDataPlacemark *> &dummyPlacemarks );
+    static GeoDataPlacemark *createPOI( GeoDataDocument *doc, GeoDataGeometry *geometry );
+};
+
+}
+}
+
+#endif // MARBLE_OSMELEMENTBUILDER_H
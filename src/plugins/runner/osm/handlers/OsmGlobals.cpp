@@ -16,6 +16,9 @@
 #include "MarbleGlobal.h"
 #include "MarbleDirs.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+
 namespace Marble
 {
 namespace osm
@@ -23,13 +26,13 @@ namespace osm
 QList<QString> OsmGlobals::m_areaTags;
 
 QColor OsmGlobals::backgroundColor( 0xF1, 0xEE, 0xE8 );
-QList<GeoDataPlacemark*> OsmGlobals::dummyPlacemarks;
+
+static QMutex areaTagsMutex;
 
 bool OsmGlobals::tagNeedArea(const QString& keyValue)
 {
-    if ( m_areaTags.count() < 1 )
-        setupAreaTags();
-    
+    Q_ASSERT( !m_areaTags.isEmpty() );
+
     return qBinaryFind( m_areaTags.constBegin(), m_areaTags.constEnd(), keyValue ) != m_areaTags.constEnd();
 }
 
@@ -38,6 +41,10 @@ void OsmGlobals::setupAreaTags()
     // All these tags can be found updated at
     // http://wiki.openstreetmap.org/wiki/Map_Features#Landuse
 
+    QMutexLocker locker( &areaTagsMutex );
+    if ( !m_areaTags.isEmpty() )
+        return;
+
     m_areaTags.append( "landuse=forest" );
     m_areaTags.append( "natural=wood" );
     m_areaTags.append( "area=yes" );
@@ -71,20 +78,6 @@ void OsmGlobals::setupAreaTags()
     qSort( m_areaTags.begin(), m_areaTags.end() );
 }
 
-void OsmGlobals::addDummyPlacemark( GeoDataPlacemark* placemark )
-{
-    dummyPlacemarks << placemark;
-}
-
-void OsmGlobals::cleanUpDummyPlacemarks()
-{
-    foreach( GeoDataFeature* placemark, dummyPlacemarks )
-    {
-        delete placemark;
-    }
-    dummyPlacemarks.clear();
-}
-
 }
 }
 
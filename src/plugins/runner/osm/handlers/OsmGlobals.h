@@ -29,18 +29,20 @@ class OsmGlobals
 {
 public:
     static bool tagNeedArea( const QString& keyValue );
-    static void addDummyPlacemark( GeoDataPlacemark *placemark );
-    static void cleanUpDummyPlacemarks();
+
+    /**
+     * Sets up the tags of areas, must be called before tagNeedArea().
+     * It is safe to call it from several threads.
+     */
+    static void setupAreaTags();
 
     static QColor buildingColor;
     static QColor backgroundColor;
 
 private:
     static void setupCategories();
-    static void setupAreaTags();
-    
+
     static QList<QString> m_areaTags;
-    static QList<GeoDataPlacemark*> dummyPlacemarks;
 };
 
 }
@@ -13,12 +13,11 @@
 #include "OsmMemberTagHandler.h"
 
 #include "GeoParser.h"
-#include "OsmWayFactory.h"
-#include "OsmRelationFactory.h"
+#include "OsmParser.h"
 #include "GeoDataParser.h"
 #include "GeoDataPolygon.h"
+#include "OsmElementBuilder.h"
 #include "OsmElementDictionary.h"
-#include "MarbleDebug.h"
 
 namespace Marble
 {
@@ -40,139 +39,28 @@ GeoNode* OsmMemberTagHandler::parse( GeoParser& parser ) const
 
     if ( parentItem.represents( osmTag_relation ) )
     {
+        GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
+        Q_ASSERT( polygon );
+        quint64 id = parser.attribute( "ref" ).toULongLong();
+
         // Never heard of a type different from "way" but
         // maybe it should be checked
 
         if (parser.attribute( "type" ) == "way")
         {
-            // Outer poligons (sometimes the role is empty)
-            if (parser.attribute( "role" ) == "outer" || parser.attribute( "role" ) == "")
-            {
-
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
-
-                // With the id we get the way geometry
-                if ( GeoDataLineString *line =  osm::OsmWayFactory::line( id )  )
-                {
-                    // Some of the ways that build the relation
-                    // might be in opposite directions
-                    // so the final linearRing would be wrong.
-                    // It is needed to seek in the linearRing
-                    // to know if the new way should be added
-                    // at the beginning or end and in which order.
-                    // Also the shared node (which will be in both
-                    // geometries) has to be removed to avoid having
-                    // it repeated.
-
-                    GeoDataLinearRing envelope = polygon->outerBoundary();
-
-                    // Case 0: envelope is empty
-                    if ( envelope.isEmpty() )
-                    {
-                        envelope = *line;
-                    }
-
-                    // Case 1: line.first = envelope.first
-                    else if ( line->first() == envelope.first() )
-                    {
-                        GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
-
-                        // Invert envelopes direction
-                        for (int x = envelope.size()-1; x > -1; x--)
-                        {
-                            temp.append( GeoDataCoordinates ( envelope.at(x) ) );
-                        }
-                        envelope = temp;
-
-                        // Now its the same as case 2
-                        // envelope-last not to repeat the shared node
-                        envelope.remove( envelope.size() - 1 );
-                        envelope << *line;
-                    }
-
-                    // Case 2: line.first = envelope.last
-                    else if (line->first() == envelope.last() )
-                    {
-                        // envelope-last not to repeat the shared node
-                        envelope.remove( envelope.size() - 1 );
-                        envelope << *line;
-                    }
-
-                    // Case 3: line.last = envelope.first
-                    else if (line->last() == envelope.first() )
-                    {
-                        GeoDataLinearRing temp = GeoDataLinearRing( envelope.tessellationFlags() );
-
-                        // Invert envelopes direction
-                        for (int x = envelope.size()-1; x > -1; x--)
-                        {
-                            temp.append( GeoDataCoordinates ( envelope.at(x) ) );
-                        }
-                        envelope = temp;
-
-                        // Now its the same as case 4
-                        // size-2 not to repeat the shared node
-                        for (int x = line->size()-2; x > -1; x--)
-                        {
-                            envelope.append( GeoDataCoordinates ( line->at(x) ) );
-                        }
-                    }
-
-                    // Case 4: line.last = envelope.last
-                    else if (line->last() == envelope.last() )
-                    {
-                        // size-2 not to repeat the shared node
-                        for (int x = line->size()-2; x > -1; x--)
-                        {
-                            envelope.append( GeoDataCoordinates ( line->at(x) ) );
-                        }
-                    }
-
-                    // Update the outer boundary
-                    polygon->setOuterBoundary( envelope );
-                }
-            }
-
-            // Inner poligons
-            if (parser.attribute( "role" ) == "inner")
+            // With the id we get the way geometry
+            if ( GeoDataLineString *line = osmParser( parser ).ways().line( id ) )
             {
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
-
-                // With the id we get the way geometry
-                if ( GeoDataLineString *line = osm::OsmWayFactory::line( id ) )
-                {
-                    polygon->appendInnerBoundary( GeoDataLinearRing( *line ) );
-                }
+                OsmElementBuilder::addWayMember( polygon, parser.attribute( "role" ), *line );
             }
         }
 
         else if (parser.attribute( "type" ) == "relation")
         {
-            // Never seen this case
-            if ( parser.attribute( "role" ) == "outer" )
-            {
-                mDebug() << "Parsed relation with a relation outer member";
-            }
-
-            // It only can be an inner relation or subarea
-            // Subarea is mainly used for administrative boundaries
-            else if (parser.attribute( "role" ) == "inner"
-                     || parser.attribute( "role" ) == "subarea"
-                     || parser.attribute( "role" ) == "")
+            // With the id we get the relation geometry
+            if ( GeoDataPolygon *p = osmParser( parser ).relations().polygon( id ) )
             {
-                GeoDataPolygon *polygon = parentItem.nodeAs<GeoDataPolygon>();
-                Q_ASSERT( polygon );
-                quint64 id = parser.attribute( "ref" ).toULongLong();
-
-                // With the id we get the relation geometry
-                if ( GeoDataPolygon *p =  osm::OsmRelationFactory::polygon( id ) )
-                {
-                    polygon->appendInnerBoundary( p->outerBoundary() );
-                }
+                OsmElementBuilder::addRelationMember( polygon, parser.attribute( "role" ), *p );
             }
         }
 
@@ -11,10 +11,9 @@
 #include "OsmNdTagHandler.h"
 
 #include "GeoParser.h"
-#include "OsmNodeFactory.h"
+#include "OsmParser.h"
 #include "GeoDataCoordinates.h"
 #include "GeoDataLineString.h"
-#include "GeoDataPoint.h"
 #include "OsmElementDictionary.h"
 
 namespace Marble
@@ -37,9 +36,10 @@ GeoNode* OsmNdTagHandler::parse( GeoParser& parser ) const
         GeoDataLineString *s = parentItem.nodeAs<GeoDataLineString>();
         Q_ASSERT( s );
         quint64 id = parser.attribute( "ref" ).toULongLong();
-        if ( GeoDataPoint *p = osm::OsmNodeFactory::getPoint( id ) )
+        GeoDataCoordinates coordinates;
+        if ( osmParser( parser ).nodes().coordinates( id, coordinates ) )
         {
-            s->append( GeoDataCoordinates( p->coordinates().longitude(), p->coordinates().latitude() ) );
+            s->append( coordinates );
         }
 
         return 0;
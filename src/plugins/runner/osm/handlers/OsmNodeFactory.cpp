@@ -9,35 +9,81 @@
 //
 
 #include "OsmNodeFactory.h"
-#include "GeoDataPoint.h"
+#include "GeoDataCoordinates.h"
+
+#include <QtAlgorithms>
 
 namespace Marble
 {
 namespace osm
 {
-QMap<quint64, GeoDataPoint *> OsmNodeFactory::m_points;
 
-// This is a class for keeping all the nodes accessible
-// for when needed by ways. Ways have only the ids of
-// nodes so with that id the GeoDataPoint is returned
+static const qreal nodeUnitsPerDegree = 1e7;
+
+class NodeIdLessThan
+{
+public:
+    bool operator()( const OsmNodeFactory::Node &a, const OsmNodeFactory::Node &b ) const
+    {
+        return a.id < b.id;
+    }
+};
 
-void OsmNodeFactory::appendPoint( quint64 id, GeoDataPoint* p )
+OsmNodeFactory::OsmNodeFactory()
+    : m_sorted( true )
 {
-    m_points[id] = p;
 }
 
-GeoDataPoint* OsmNodeFactory::getPoint( quint64 id )
+void OsmNodeFactory::appendPoint( quint64 id, qreal lon, qreal lat )
 {
-    return m_points.value( id );
+    // Files written by the OSM tools have their nodes ordered by id,
+    // then the array stays sorted without any work
+    if ( m_sorted && !m_nodes.isEmpty() && id < m_nodes.last().id ) {
+        m_sorted = false;
+    }
+
+    Node node;
+    node.id = id;
+    node.lon = qRound( lon * nodeUnitsPerDegree );
+    node.lat = qRound( lat * nodeUnitsPerDegree );
+    m_nodes.append( node );
 }
 
-void OsmNodeFactory::clear()
+bool OsmNodeFactory::coordinates( quint64 id, GeoDataCoordinates &coordinates )
 {
-    foreach( GeoDataPoint *p, m_points )
-    {
-        delete p;
+    if ( !m_sorted ) {
+        sort();
+    }
+
+    Node key;
+    key.id = id;
+
+    // the last one of nodes with the same id wins, like the later node replaced the earlier one
+    QVector<Node>::const_iterator it = qUpperBound( m_nodes.constBegin(), m_nodes.constEnd(), key, NodeIdLessThan() );
+    if ( it == m_nodes.constBegin() || ( it - 1 )->id != id ) {
+        return false;
     }
-    m_points.clear();
+
+    --it;
+    coordinates.set( it->lon / nodeUnitsPerDegree, it->lat / nodeUnitsPerDegree, 0, GeoDataCoordinates::Degree );
+    return true;
+}
+
+int OsmNodeFactory::size() const
+{
+    return m_nodes.size();
+}
+
+void OsmNodeFactory::clear()
+{
+    m_nodes = QVector<Node>();
+    m_sorted = true;
+}
+
+void OsmNodeFactory::sort()
+{
+    qStableSort( m_nodes.begin(), m_nodes.end(), NodeIdLessThan() );
+    m_sorted = true;
 }
 
 }
@@ -11,38 +11,63 @@
 #ifndef MARBLE_OSMNODEFACTORY_H
 #define MARBLE_OSMNODEFACTORY_H
 
-#include <QMap>
+#include <QVector>
 
 namespace Marble
 {
 
-class GeoDataPoint;
+class GeoDataCoordinates;
 
 namespace osm
 {
 
 // This is a class for keeping all the nodes accessible
 // for when needed by ways. Ways have only the ids of
-// nodes so with that id the GeoDataPoint is returned
+// nodes so with that id the coordinates are returned.
+//
+// A file can have millions of nodes, so they are kept
+// as packed id and coordinates in an array sorted by id
+// instead of as GeoDataPoints. Each node takes 16 bytes.
 
 class OsmNodeFactory
 {
 public:
-    static void appendPoint( quint64 id, GeoDataPoint *p );
-    static GeoDataPoint *getPoint( quint64 id );
+    OsmNodeFactory();
+
+    void appendPoint( quint64 id, qreal lon, qreal lat );
+
+    /**
+     * @brief Look up the coordinates of the node @p id
+     * Returns false if there is no such node.
+     */
+    bool coordinates( quint64 id, GeoDataCoordinates &coordinates );
+
+    int size() const;
 
     /**
      * @brief Clean up nodes
-     * Removes all nodes from factory.
-     * This function must be called only after file loaded.
+     * Removes all nodes from factory and frees their memory.
      */
-    static void clear();
+    void clear();
+
+    // the coordinates are stored in 1e-7 degrees like in the OSM database
+    struct Node
+    {
+        quint64 id;
+        qint32 lon;
+        qint32 lat;
+    };
 
 private:
-    static QMap<quint64, GeoDataPoint *> m_points;
+    void sort();
+
+    QVector<Node> m_nodes;
+    bool m_sorted;
 };
 
 }
 }
 
+Q_DECLARE_TYPEINFO( Marble::osm::OsmNodeFactory::Node, Q_PRIMITIVE_TYPE );
+
 #endif // MARBLE_OSMNODEFACTORY_H
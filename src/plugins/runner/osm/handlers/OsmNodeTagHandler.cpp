@@ -13,7 +13,7 @@
 #include "GeoParser.h"
 #include "GeoDataCoordinates.h"
 #include "GeoDataPoint.h"
-#include "OsmNodeFactory.h"
+#include "OsmParser.h"
 #include "OsmElementDictionary.h"
 
 namespace Marble
@@ -34,8 +34,14 @@ GeoNode* OsmNodeTagHandler::parse( GeoParser& parser ) const
     qreal lon = parser.attribute( "lon" ).toDouble();
     qreal lat = parser.attribute( "lat" ).toDouble();
 
-    GeoDataPoint *point = new GeoDataPoint( lon, lat, 0, GeoDataCoordinates::Degree );
-    osm::OsmNodeFactory::appendPoint( parser.attribute( "id" ).toULongLong(), point );
+    osmParser( parser ).nodes().appendPoint( parser.attribute( "id" ).toULongLong(), lon, lat );
+
+    // Most nodes are only the vertices of ways and are never
+    // shown on their own, so no point is allocated for them.
+    // The tags of the node turn the point into a placemark.
+    GeoDataPoint *point = osmParser( parser ).nodePoint();
+    point->setCoordinates( GeoDataCoordinates( lon, lat, 0, GeoDataCoordinates::Degree ) );
+    point->setParent( 0 );
     return point;
 }
 
@@ -11,15 +11,10 @@
 #include "OsmOsmTagHandler.h"
 
 #include "GeoParser.h"
-#include "GeoDataPoint.h"
 #include "GeoDataDocument.h"
-#include "MarbleGlobal.h"
 #include "GeoDataParser.h"
-#include "GeoDataLineStyle.h"
-#include "GeoDataStyleMap.h"
-#include "GeoDataStyle.h"
+#include "OsmElementBuilder.h"
 #include "OsmElementDictionary.h"
-#include "OsmGlobals.h"
 
 namespace Marble
 {
@@ -34,15 +29,7 @@ GeoNode* OsmOsmTagHandler::parse( GeoParser& parser ) const
     // Osm Node http://wiki.openstreetmap.org/wiki/Data_Primitives#Node
 
     GeoDataDocument* doc = geoDataDoc( parser );
-
-    GeoDataPolyStyle backgroundPolyStyle;
-    backgroundPolyStyle.setFill( true );
-    backgroundPolyStyle.setOutline( false );
-    backgroundPolyStyle.setColor( OsmGlobals::backgroundColor );
-    GeoDataStyle backgroundStyle;
-    backgroundStyle.setPolyStyle( backgroundPolyStyle );
-    backgroundStyle.setStyleId( "background" );
-    doc->addStyle( backgroundStyle );
+    OsmElementBuilder::addDocumentStyles( doc );
 
     return doc;
 }
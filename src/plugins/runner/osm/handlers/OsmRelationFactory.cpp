@@ -17,7 +17,6 @@ namespace Marble
 {
 namespace osm
 {
-QMap<quint64, GeoDataPolygon *> OsmRelationFactory::m_polygons;
 
 // This is a class for keeping all the relations accessible
 // for when needed by other relations. As OSM detail level
@@ -13,7 +13,7 @@
 #include "OsmRelationTagHandler.h"
 
 #include "GeoParser.h"
-#include "OsmRelationFactory.h"
+#include "OsmParser.h"
 #include "GeoDataDocument.h"
 #include "GeoDataPlacemark.h"
 #include "GeoDataParser.h"
@@ -48,7 +48,7 @@ GeoNode* OsmRelationTagHandler::parse( GeoParser& parser ) const
     placemark->setVisible( false );
     doc->append( placemark );
 
-    osm::OsmRelationFactory::appendPolygon( parser.attribute( "id" ).toULongLong(), polygon );
+    osmParser( parser ).relations().appendPolygon( parser.attribute( "id" ).toULongLong(), polygon );
 
     return polygon;
 }
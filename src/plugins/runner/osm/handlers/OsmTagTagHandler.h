@@ -14,9 +14,6 @@
 #include "GeoTagHandler.h"
 namespace Marble
 {
-class GeoDataGeometry;
-class GeoDataPlacemark;
-class GeoDataDocument;
 
 namespace osm
 {
@@ -25,10 +22,6 @@ class OsmTagTagHandler : public GeoTagHandler
 {
 public:
     virtual GeoNode* parse( GeoParser& ) const;
-
-private:
-    GeoDataPlacemark *convertWayToPolygon( GeoDataDocument *doc, GeoDataPlacemark *placemark, GeoDataGeometry *geometry ) const;
-    GeoDataPlacemark *createPOI( GeoDataDocument *doc, GeoDataGeometry *geometry ) const;
 };
 
 }
@@ -17,7 +17,6 @@ namespace Marble
 {
 namespace osm
 {
-QMap<quint64, GeoDataLineString *> OsmWayFactory::m_lines;
 
 // This is a class for keeping all the ways accessible
 // for when needed by relations. Relations have only the ids of
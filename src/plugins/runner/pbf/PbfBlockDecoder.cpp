@@ -0,0 +1,502 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PbfBlockDecoder.h"
+
+#include "PbfMessage.h"
+
+namespace Marble
+{
+
+const int PbfBlockDecoder::maxBlobSize = 32 * 1024 * 1024;
+
+// coordinates are stored in units of nanodegrees
+static const qreal nanoDegree = 1e-9;
+
+// the field numbers of the messages of the OSM PBF format
+enum BlobField {
+    BlobRaw = 1,
+    BlobRawSize = 2,
+    BlobZlibData = 3,
+    BlobLzmaData = 4
+};
+
+enum PrimitiveBlockField {
+    PrimitiveBlockStringTable = 1,
+    PrimitiveBlockGroup = 2,
+    PrimitiveBlockGranularity = 17,
+    PrimitiveBlockLatOffset = 19,
+    PrimitiveBlockLonOffset = 20
+};
+
+enum PrimitiveGroupField {
+    GroupNode = 1,
+    GroupDenseNodes = 2,
+    GroupWay = 3,
+    GroupRelation = 4
+};
+
+// the fields of nodes, dense nodes, ways and relations
+enum ElementField {
+    ElementId = 1,
+    ElementKeys = 2,
+    ElementValues = 3,
+    NodeLat = 8,
+    NodeLon = 9,
+    DenseKeysValues = 10,
+    WayRefs = 8,
+    RelationRoles = 8,
+    RelationMemberIds = 9,
+    RelationMemberTypes = 10
+};
+
+static inline QString string( const QVector<QString> &strings, qint64 index )
+{
+    return index >= 0 && index < strings.size() ? strings[int( index )] : QString();
+}
+
+static void appendTags( PbfBlock *block, const QVector<QString> &strings,
+                        const QVector<qint64> &keys, const QVector<qint64> &values )
+{
+    for ( int i = 0; i < qMin( keys.size(), values.size() ); ++i ) {
+        block->tags.append( qMakePair( string( strings, keys[i] ), string( strings, values[i] ) ) );
+    }
+}
+
+/**
+ * The decoding of the elements of a primitive block, which share its
+ * string table, granularity and offsets.
+ */
+class PrimitiveBlockDecoder
+{
+ public:
+    PrimitiveBlockDecoder( PbfBlock *block );
+
+    bool decode( const QByteArray &data );
+
+ private:
+    bool decodeGroup( PbfMessage group );
+    bool decodeNode( PbfMessage input );
+    bool decodeDenseNodes( PbfMessage input );
+    bool decodeWay( PbfMessage input );
+    bool decodeRelation( PbfMessage input );
+
+    qreal lat( qint64 value ) const;
+    qreal lon( qint64 value ) const;
+
+    PbfBlock *const m_block;
+    QVector<QString> m_strings;
+    qint64 m_granularity;
+    qint64 m_latOffset;
+    qint64 m_lonOffset;
+
+    // reused for the repeated fields of each element
+    QVector<qint64> m_keys;
+    QVector<qint64> m_values;
+};
+
+PrimitiveBlockDecoder::PrimitiveBlockDecoder( PbfBlock *block ) :
+    m_block( block ),
+    m_granularity( 100 ),
+    m_latOffset( 0 ),
+    m_lonOffset( 0 )
+{
+}
+
+qreal PrimitiveBlockDecoder::lat( qint64 value ) const
+{
+    return nanoDegree * ( m_latOffset + m_granularity * value );
+}
+
+qreal PrimitiveBlockDecoder::lon( qint64 value ) const
+{
+    return nanoDegree * ( m_lonOffset + m_granularity * value );
+}
+
+bool PrimitiveBlockDecoder::decode( const QByteArray &data )
+{
+    // the granularity and offsets follow the groups, so the
+    // groups are decoded once the whole block has been read
+    QVector<PbfMessage> groups;
+
+    PbfMessage block( data.constData(), data.size() );
+    while ( block.next() ) {
+        switch ( block.field() ) {
+        case PrimitiveBlockStringTable: {
+            PbfMessage stringTable = block.message();
+            while ( stringTable.next() ) {
+                if ( stringTable.field() == 1 ) {
+                    m_strings.append( stringTable.string() );
+                }
+            }
+            if ( stringTable.hasError() ) {
+                return false;
+            }
+            break;
+        }
+        case PrimitiveBlockGroup:
+            groups.append( block.message() );
+            break;
+        case PrimitiveBlockGranularity:
+            m_granularity = qint64( block.varint() );
+            break;
+        case PrimitiveBlockLatOffset:
+            m_latOffset = qint64( block.varint() );
+            break;
+        case PrimitiveBlockLonOffset:
+            m_lonOffset = qint64( block.varint() );
+            break;
+        }
+    }
+
+    if ( block.hasError() ) {
+        return false;
+    }
+
+    foreach ( const PbfMessage &group, groups ) {
+        if ( !decodeGroup( group ) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PrimitiveBlockDecoder::decodeGroup( PbfMessage group )
+{
+    bool ok = true;
+    while ( ok && group.next() ) {
+        switch ( group.field() ) {
+        case GroupNode:
+            ok = decodeNode( group.message() );
+            break;
+        case GroupDenseNodes:
+            ok = decodeDenseNodes( group.message() );
+            break;
+        case GroupWay:
+            ok = decodeWay( group.message() );
+            break;
+        case GroupRelation:
+            ok = decodeRelation( group.message() );
+            break;
+        }
+    }
+
+    return ok && !group.hasError();
+}
+
+bool PrimitiveBlockDecoder::decodeNode( PbfMessage input )
+{
+    PbfNode node;
+    node.id = 0;
+    qint64 latValue = 0;
+    qint64 lonValue = 0;
+    m_keys.clear();
+    m_values.clear();
+
+    bool ok = true;
+    while ( ok && input.next() ) {
+        switch ( input.field() ) {
+        case ElementId:
+            node.id = input.sint64();
+            break;
+        case ElementKeys:
+            ok = input.appendInt64s( m_keys );
+            break;
+        case ElementValues:
+            ok = input.appendInt64s( m_values );
+            break;
+        case NodeLat:
+            latValue = input.sint64();
+            break;
+        case NodeLon:
+            lonValue = input.sint64();
+            break;
+        }
+    }
+
+    if ( !ok || input.hasError() ) {
+        return false;
+    }
+
+    node.lat = lat( latValue );
+    node.lon = lon( lonValue );
+    node.firstTag = m_block->tags.size();
+    appendTags( m_block, m_strings, m_keys, m_values );
+    node.tagCount = m_block->tags.size() - node.firstTag;
+    m_block->nodes.append( node );
+
+    return true;
+}
+
+bool PrimitiveBlockDecoder::decodeDenseNodes( PbfMessage input )
+{
+    QVector<qint64> ids;
+    QVector<qint64> lats;
+    QVector<qint64> lons;
+    QVector<qint64> keysValues;
+
+    bool ok = true;
+    while ( ok && input.next() ) {
+        switch ( input.field() ) {
+        case ElementId:
+            ok = input.appendSInt64s( ids );
+            break;
+        case NodeLat:
+            ok = input.appendSInt64s( lats );
+            break;
+        case NodeLon:
+            ok = input.appendSInt64s( lons );
+            break;
+        case DenseKeysValues:
+            ok = input.appendInt64s( keysValues );
+            break;
+        }
+    }
+
+    if ( !ok || input.hasError() ) {
+        return false;
+    }
+
+    // ids and coordinates are delta coded, the tags of all
+    // nodes are in one array with 0 after the tags of each node
+    const int count = qMin( ids.size(), qMin( lats.size(), lons.size() ) );
+    m_block->nodes.reserve( m_block->nodes.size() + count );
+
+    qint64 id = 0;
+    qint64 latValue = 0;
+    qint64 lonValue = 0;
+    int keyValue = 0;
+    for ( int i = 0; i < count; ++i ) {
+        id += ids[i];
+        latValue += lats[i];
+        lonValue += lons[i];
+
+        PbfNode node;
+        node.id = id;
+        node.lat = lat( latValue );
+        node.lon = lon( lonValue );
+        node.firstTag = m_block->tags.size();
+        while ( keyValue + 1 < keysValues.size() && keysValues[keyValue] != 0 ) {
+            m_block->tags.append( qMakePair( string( m_strings, keysValues[keyValue] ),
+                                             string( m_strings, keysValues[keyValue + 1] ) ) );
+            keyValue += 2;
+        }
+        ++keyValue;
+        node.tagCount = m_block->tags.size() - node.firstTag;
+        m_block->nodes.append( node );
+    }
+
+    return true;
+}
+
+bool PrimitiveBlockDecoder::decodeWay( PbfMessage input )
+{
+    PbfWay way;
+    way.id = 0;
+    way.firstRef = m_block->refs.size();
+    m_keys.clear();
+    m_values.clear();
+
+    bool ok = true;
+    while ( ok && input.next() ) {
+        switch ( input.field() ) {
+        case ElementId:
+            way.id = qint64( input.varint() );
+            break;
+        case ElementKeys:
+            ok = input.appendInt64s( m_keys );
+            break;
+        case ElementValues:
+            ok = input.appendInt64s( m_values );
+            break;
+        case WayRefs:
+            ok = input.appendSInt64s( m_block->refs );
+            break;
+        }
+    }
+
+    if ( !ok || input.hasError() ) {
+        m_block->refs.resize( way.firstRef );
+        return false;
+    }
+
+    // the node references are delta coded
+    way.refCount = m_block->refs.size() - way.firstRef;
+    for ( int r = way.firstRef + 1; r < m_block->refs.size(); ++r ) {
+        m_block->refs[r] += m_block->refs[r - 1];
+    }
+
+    way.firstTag = m_block->tags.size();
+    appendTags( m_block, m_strings, m_keys, m_values );
+    way.tagCount = m_block->tags.size() - way.firstTag;
+    m_block->ways.append( way );
+
+    return true;
+}
+
+bool PrimitiveBlockDecoder::decodeRelation( PbfMessage input )
+{
+    PbfRelation relation;
+    relation.id = 0;
+    m_keys.clear();
+    m_values.clear();
+    QVector<qint64> roles;
+    QVector<qint64> memberIds;
+    QVector<qint64> types;
+
+    bool ok = true;
+    while ( ok && input.next() ) {
+        switch ( input.field() ) {
+        case ElementId:
+            relation.id = qint64( input.varint() );
+            break;
+        case ElementKeys:
+            ok = input.appendInt64s( m_keys );
+            break;
+        case ElementValues:
+            ok = input.appendInt64s( m_values );
+            break;
+        case RelationRoles:
+            ok = input.appendInt64s( roles );
+            break;
+        case RelationMemberIds:
+            ok = input.appendSInt64s( memberIds );
+            break;
+        case RelationMemberTypes:
+            ok = input.appendInt64s( types );
+            break;
+        }
+    }
+
+    if ( !ok || input.hasError() ) {
+        return false;
+    }
+
+    // the member ids are delta coded
+    relation.firstMember = m_block->members.size();
+    const int memberCount = qMin( memberIds.size(), qMin( types.size(), roles.size() ) );
+    qint64 ref = 0;
+    for ( int m = 0; m < memberCount; ++m ) {
+        ref += memberIds[m];
+
+        PbfMember member;
+        member.ref = ref;
+        member.role = string( m_strings, roles[m] );
+        switch ( types[m] ) {
+        case 0:
+            member.type = PbfMember::Node;
+            break;
+        case 1:
+            member.type = PbfMember::Way;
+            break;
+        case 2:
+            member.type = PbfMember::Relation;
+            break;
+        default:
+            // unknown types of members are skipped
+            continue;
+        }
+        m_block->members.append( member );
+    }
+    relation.memberCount = m_block->members.size() - relation.firstMember;
+
+    relation.firstTag = m_block->tags.size();
+    appendTags( m_block, m_strings, m_keys, m_values );
+    relation.tagCount = m_block->tags.size() - relation.firstTag;
+    m_block->relations.append( relation );
+
+    return true;
+}
+
+PbfBlockDecoder::PbfBlockDecoder( const QByteArray &blob, PbfBlock *block ) :
+    m_blob( blob ),
+    m_block( block )
+{
+}
+
+bool PbfBlockDecoder::blobData( const QByteArray &blob, QByteArray &data, QString &error )
+{
+    PbfMessage message( blob.constData(), blob.size() );
+    qint64 rawSize = -1;
+    QByteArray zlibData;
+    bool hasZlibData = false;
+    bool hasLzmaData = false;
+
+    while ( message.next() ) {
+        switch ( message.field() ) {
+        case BlobRaw:
+            data = message.bytes();
+            return true;
+        case BlobRawSize:
+            rawSize = qint64( message.varint() );
+            break;
+        case BlobZlibData:
+            hasZlibData = true;
+            zlibData = message.bytes();
+            break;
+        case BlobLzmaData:
+            hasLzmaData = true;
+            break;
+        }
+    }
+
+    if ( message.hasError() ) {
+        error = QString( "Unable to parse a blob" );
+        return false;
+    }
+
+    if ( hasZlibData ) {
+        // checked before the size is used to allocate the data
+        if ( rawSize < 0 || rawSize > maxBlobSize ) {
+            error = QString( "Invalid uncompressed blob size %1" ).arg( rawSize );
+            return false;
+        }
+
+        // qUncompress() expects the uncompressed size in front of the zlib stream
+        const char size[4] = { char( rawSize >> 24 ), char( rawSize >> 16 ), char( rawSize >> 8 ), char( rawSize ) };
+        zlibData.prepend( QByteArray::fromRawData( size, 4 ) );
+        data = qUncompress( zlibData );
+        if ( data.size() != rawSize ) {
+            error = QString( "Unable to inflate a blob" );
+            return false;
+        }
+        return true;
+    }
+
+    if ( hasLzmaData ) {
+        error = QString( "LZMA compressed blobs are not supported" );
+        return false;
+    }
+
+    error = QString( "A blob contains no data" );
+    return false;
+}
+
+bool PbfBlockDecoder::decode( const QByteArray &data, PbfBlock *block )
+{
+    PrimitiveBlockDecoder decoder( block );
+    if ( !decoder.decode( data ) ) {
+        block->error = QString( "Unable to parse a primitive block" );
+        return false;
+    }
+
+    return true;
+}
+
+void PbfBlockDecoder::run()
+{
+    QByteArray data;
+    if ( !blobData( m_blob, data, m_block->error ) ) {
+        return;
+    }
+
+    decode( data, m_block );
+}
+
+}
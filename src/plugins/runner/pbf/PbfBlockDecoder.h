@@ -0,0 +1,126 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PBFBLOCKDECODER_H
+#define MARBLE_PBFBLOCKDECODER_H
+
+#include <QByteArray>
+#include <QPair>
+#include <QRunnable>
+#include <QString>
+#include <QVector>
+
+namespace Marble
+{
+
+// The elements of a block have ranges into the shared arrays of the block,
+// which keeps the number of allocations per element low.
+
+struct PbfNode
+{
+    qint64 id;
+    qreal lon;
+    qreal lat;
+    int firstTag;
+    int tagCount;
+};
+
+struct PbfWay
+{
+    qint64 id;
+    int firstRef;
+    int refCount;
+    int firstTag;
+    int tagCount;
+};
+
+struct PbfMember
+{
+    enum Type {
+        Node,
+        Way,
+        Relation
+    };
+
+    qint64 ref;
+    Type type;
+    QString role;
+};
+
+struct PbfRelation
+{
+    qint64 id;
+    int firstMember;
+    int memberCount;
+    int firstTag;
+    int tagCount;
+};
+
+/**
+ * The elements of one data block of an OSM PBF file, in file order.
+ */
+struct PbfBlock
+{
+    QVector<PbfNode> nodes;
+    QVector<PbfWay> ways;
+    QVector<PbfRelation> relations;
+
+    QVector<qint64> refs;
+    QVector<PbfMember> members;
+    QVector<QPair<QString, QString> > tags;
+
+    // set if the block could not be decoded
+    QString error;
+};
+
+/**
+ * @short Decodes a data block of an OSM PBF file.
+ *
+ * The blocks of a file are independent of each other, so they are
+ * inflated and decoded in parallel on a thread pool. The elements are
+ * put into the block passed to the constructor, which stays owned by
+ * the caller.
+ */
+class PbfBlockDecoder : public QRunnable
+{
+ public:
+    PbfBlockDecoder( const QByteArray &blob, PbfBlock *block );
+
+    virtual void run();
+
+    /**
+     * Returns the uncompressed contents of the serialized @p blob in
+     * @p data. Returns false and sets @p error if this fails.
+     */
+    static bool blobData( const QByteArray &blob, QByteArray &data, QString &error );
+
+    /**
+     * Decodes the uncompressed primitive block @p data into @p block.
+     * Returns false and sets the error of @p block if this fails.
+     */
+    static bool decode( const QByteArray &data, PbfBlock *block );
+
+    /**
+     * The limit of the size of a blob, compressed or not, by the file
+     * format specification.
+     */
+    static const int maxBlobSize;
+
+ private:
+    const QByteArray m_blob;
+    PbfBlock *const m_block;
+};
+
+}
+
+Q_DECLARE_TYPEINFO( Marble::PbfNode, Q_PRIMITIVE_TYPE );
+Q_DECLARE_TYPEINFO( Marble::PbfWay, Q_PRIMITIVE_TYPE );
+Q_DECLARE_TYPEINFO( Marble::PbfMember, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( Marble::PbfRelation, Q_PRIMITIVE_TYPE );
+
+#endif
@@ -0,0 +1,189 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PbfMessage.h"
+
+namespace Marble
+{
+
+PbfMessage::PbfMessage() :
+    m_pos( 0 ),
+    m_end( 0 ),
+    m_error( false ),
+    m_field( 0 ),
+    m_wireType( Varint ),
+    m_varint( 0 ),
+    m_data( 0 ),
+    m_size( 0 )
+{
+}
+
+PbfMessage::PbfMessage( const char *data, int size ) :
+    m_pos( reinterpret_cast<const uchar *>( data ) ),
+    m_end( reinterpret_cast<const uchar *>( data ) + size ),
+    m_error( false ),
+    m_field( 0 ),
+    m_wireType( Varint ),
+    m_varint( 0 ),
+    m_data( 0 ),
+    m_size( 0 )
+{
+}
+
+bool PbfMessage::readVarint( const uchar *&pos, const uchar *end, quint64 &value )
+{
+    // seven bits per byte, least significant group first
+    value = 0;
+    for ( int shift = 0; shift < 64 && pos != end; shift += 7 ) {
+        const uchar byte = *pos++;
+        value |= quint64( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+qint64 PbfMessage::decodeZigZag( quint64 value )
+{
+    return qint64( value >> 1 ) ^ -qint64( value & 1 );
+}
+
+bool PbfMessage::next()
+{
+    if ( m_error || m_pos == m_end ) {
+        return false;
+    }
+
+    quint64 key;
+    if ( !readVarint( m_pos, m_end, key ) || ( key >> 3 ) == 0 ) {
+        m_error = true;
+        return false;
+    }
+
+    m_field = int( key >> 3 );
+    m_wireType = int( key & 0x7 );
+    m_varint = 0;
+    m_data = 0;
+    m_size = 0;
+
+    switch ( m_wireType ) {
+    case Varint:
+        m_error = !readVarint( m_pos, m_end, m_varint );
+        break;
+    case Fixed64:
+        m_error = m_end - m_pos < 8;
+        m_pos += m_error ? 0 : 8;
+        break;
+    case Fixed32:
+        m_error = m_end - m_pos < 4;
+        m_pos += m_error ? 0 : 4;
+        break;
+    case LengthDelimited: {
+        quint64 size;
+        m_error = !readVarint( m_pos, m_end, size ) || size > quint64( m_end - m_pos );
+        if ( !m_error ) {
+            m_data = m_pos;
+            m_size = int( size );
+            m_pos += m_size;
+        }
+        break;
+    }
+    default:
+        // groups are deprecated and not used by the OSM PBF format
+        m_error = true;
+    }
+
+    return !m_error;
+}
+
+bool PbfMessage::hasError() const
+{
+    return m_error;
+}
+
+int PbfMessage::field() const
+{
+    return m_field;
+}
+
+quint64 PbfMessage::varint() const
+{
+    return m_varint;
+}
+
+qint64 PbfMessage::sint64() const
+{
+    return decodeZigZag( m_varint );
+}
+
+const char *PbfMessage::data() const
+{
+    return reinterpret_cast<const char *>( m_data );
+}
+
+int PbfMessage::size() const
+{
+    return m_size;
+}
+
+QByteArray PbfMessage::bytes() const
+{
+    return QByteArray( data(), m_size );
+}
+
+QString PbfMessage::string() const
+{
+    return QString::fromUtf8( data(), m_size );
+}
+
+PbfMessage PbfMessage::message() const
+{
+    return PbfMessage( data(), m_size );
+}
+
+bool PbfMessage::appendInt64s( QVector<qint64> &values ) const
+{
+    if ( m_wireType == Varint ) {
+        values.append( qint64( m_varint ) );
+        return true;
+    }
+
+    if ( m_wireType != LengthDelimited ) {
+        return false;
+    }
+
+    const uchar *pos = m_data;
+    const uchar *const end = m_data + m_size;
+    quint64 value;
+    while ( pos != end ) {
+        if ( !readVarint( pos, end, value ) ) {
+            return false;
+        }
+        values.append( qint64( value ) );
+    }
+
+    return true;
+}
+
+bool PbfMessage::appendSInt64s( QVector<qint64> &values ) const
+{
+    const int first = values.size();
+    if ( !appendInt64s( values ) ) {
+        return false;
+    }
+
+    for ( int i = first; i < values.size(); ++i ) {
+        values[i] = decodeZigZag( quint64( values[i] ) );
+    }
+
+    return true;
+}
+
+}
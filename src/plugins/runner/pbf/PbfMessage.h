@@ -0,0 +1,100 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLE_PBFMESSAGE_H
+#define MARBLE_PBFMESSAGE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+namespace Marble
+{
+
+/**
+ * @short Reads the fields of a message in the Protocol Buffers wire format.
+ *
+ * The OSM PBF format only needs a small part of Protocol Buffers, so its
+ * messages are read directly instead of through generated code. The
+ * message refers to the data passed to the constructor, which has to
+ * outlive it and all messages embedded into it.
+ *
+ * Repeated numbers are accepted both packed and as a field per number.
+ */
+class PbfMessage
+{
+ public:
+    PbfMessage();
+    PbfMessage( const char *data, int size );
+
+    /**
+     * Moves to the next field. Returns false at the end of the message,
+     * or if the message is malformed, see hasError().
+     */
+    bool next();
+
+    bool hasError() const;
+
+    /**
+     * Returns the number of the current field.
+     */
+    int field() const;
+
+    /**
+     * Returns the value of the current field if it is a number.
+     */
+    quint64 varint() const;
+
+    /**
+     * Returns the value of the current field if it is a ZigZag encoded number.
+     */
+    qint64 sint64() const;
+
+    /**
+     * Returns the contents of the current field if it is a string, bytes
+     * or an embedded message.
+     */
+    const char *data() const;
+    int size() const;
+
+    QByteArray bytes() const;
+    QString string() const;
+    PbfMessage message() const;
+
+    /**
+     * Appends the numbers of the current field to @p values.
+     * Returns false if they are malformed.
+     */
+    bool appendInt64s( QVector<qint64> &values ) const;
+    bool appendSInt64s( QVector<qint64> &values ) const;
+
+ private:
+    enum WireType {
+        Varint = 0,
+        Fixed64 = 1,
+        LengthDelimited = 2,
+        Fixed32 = 5
+    };
+
+    static bool readVarint( const uchar *&pos, const uchar *end, quint64 &value );
+    static qint64 decodeZigZag( quint64 value );
+
+    const uchar *m_pos;
+    const uchar *m_end;
+    bool m_error;
+
+    int m_field;
+    int m_wireType;
+    quint64 m_varint;
+    const uchar *m_data;
+    int m_size;
+};
+
+}
+
+#endif
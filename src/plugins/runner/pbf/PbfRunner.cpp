@@ -0,0 +1,293 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include "PbfRunner.h"
+
+#include "GeoDataDocument.h"
+#include "GeoDataLineString.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "OsmGlobals.h"
+#include "PbfBlockDecoder.h"
+#include "PbfMessage.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QThreadPool>
+
+namespace Marble
+{
+
+// limit of the file format specification
+static const int maxBlobHeaderSize = 64 * 1024;
+
+// the field numbers of the BlobHeader and HeaderBlock messages
+enum BlobHeaderField {
+    BlobHeaderType = 1,
+    BlobHeaderDataSize = 3
+};
+
+enum HeaderBlockField {
+    HeaderBlockRequiredFeatures = 4
+};
+
+PbfRunner::PbfRunner( QObject *parent ) :
+    ParsingRunner( parent ),
+    m_document( 0 )
+{
+}
+
+PbfRunner::~PbfRunner()
+{
+    qDeleteAll( m_dummyPlacemarks );
+}
+
+void PbfRunner::parseFile( const QString &fileName, DocumentRole role = UnknownDocument )
+{
+    QFile file( fileName );
+    if ( !file.exists() ) {
+        qWarning( "File does not exist!" );
+        emit parsingFinished( 0 );
+        return;
+    }
+
+    // Open file in right mode
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        emit parsingFinished( 0, QString( "Unable to open %1: %2" ).arg( fileName ).arg( file.errorString() ) );
+        return;
+    }
+
+    QDataStream stream( &file );
+    stream.setByteOrder( QDataStream::BigEndian );
+
+    QString type;
+    QByteArray blob;
+    QString error;
+    if ( !readBlob( stream, type, blob, error ) || !checkHeader( blob, error ) ) {
+        emit parsingFinished( 0, error );
+        return;
+    }
+    if ( type != "OSMHeader" ) {
+        emit parsingFinished( 0, QString( "The file does not start with an OSM header" ) );
+        return;
+    }
+
+    osm::OsmGlobals::setupAreaTags();
+
+    m_document = new GeoDataDocument;
+    osm::OsmElementBuilder::addDocumentStyles( m_document );
+
+    // The blocks are decoded in batches of a few blocks per thread,
+    // then added to the document in their order in the file. This
+    // keeps only a batch of decoded blocks in memory at a time.
+    QThreadPool threadPool;
+    const int batchSize = 2 * qMax( 1, threadPool.maxThreadCount() );
+    QVector<PbfBlock *> blocks;
+    blocks.reserve( batchSize );
+
+    while ( error.isEmpty() && !stream.atEnd() ) {
+        while ( blocks.size() < batchSize && !stream.atEnd() ) {
+            if ( !readBlob( stream, type, blob, error ) ) {
+                break;
+            }
+
+            // unknown types of blobs are to be skipped
+            if ( type == "OSMData" ) {
+                PbfBlock *block = new PbfBlock;
+                blocks << block;
+                threadPool.start( new PbfBlockDecoder( blob, block ) );
+            }
+        }
+        threadPool.waitForDone();
+
+        foreach ( const PbfBlock *block, blocks ) {
+            if ( error.isEmpty() ) {
+                error = block->error;
+            }
+            if ( error.isEmpty() ) {
+                addBlock( *block );
+            }
+        }
+        qDeleteAll( blocks );
+        blocks.clear();
+    }
+
+    m_nodes.clear();
+    m_ways.clear();
+    m_relations.clear();
+
+    if ( !error.isEmpty() ) {
+        delete m_document;
+        m_document = 0;
+        emit parsingFinished( 0, error );
+        return;
+    }
+
+    m_document->setDocumentRole( role );
+    m_document->setFileName( fileName );
+
+    file.close();
+    emit parsingFinished( m_document );
+}
+
+bool PbfRunner::readBlob( QDataStream &stream, QString &type, QByteArray &blob, QString &error )
+{
+    // Each blob is preceded by the size of its header and the header
+    qint32 headerSize = -1;
+    stream >> headerSize;
+    if ( stream.status() != QDataStream::Ok || headerSize < 0 || headerSize > maxBlobHeaderSize ) {
+        error = QString( "Invalid blob header size %1" ).arg( headerSize );
+        return false;
+    }
+
+    QByteArray header( headerSize, 0 );
+    if ( stream.readRawData( header.data(), headerSize ) != headerSize ) {
+        error = QString( "Unable to read a blob header" );
+        return false;
+    }
+
+    PbfMessage blobHeader( header.constData(), header.size() );
+    qint64 size = -1;
+    type.clear();
+    while ( blobHeader.next() ) {
+        if ( blobHeader.field() == BlobHeaderType ) {
+            type = blobHeader.string();
+        } else if ( blobHeader.field() == BlobHeaderDataSize ) {
+            size = qint64( blobHeader.varint() );
+        }
+    }
+
+    if ( blobHeader.hasError() ) {
+        error = QString( "Unable to read a blob header" );
+        return false;
+    }
+
+    if ( size < 0 || size > PbfBlockDecoder::maxBlobSize ) {
+        error = QString( "Invalid blob size %1" ).arg( size );
+        return false;
+    }
+
+    blob.resize( int( size ) );
+    if ( stream.readRawData( blob.data(), blob.size() ) != size ) {
+        error = QString( "Unable to read a blob" );
+        return false;
+    }
+
+    return true;
+}
+
+bool PbfRunner::checkHeader( const QByteArray &blob, QString &error )
+{
+    QByteArray data;
+    if ( !PbfBlockDecoder::blobData( blob, data, error ) ) {
+        return false;
+    }
+
+    PbfMessage headerBlock( data.constData(), data.size() );
+    while ( headerBlock.next() ) {
+        if ( headerBlock.field() != HeaderBlockRequiredFeatures ) {
+            continue;
+        }
+
+        const QString feature = headerBlock.string();
+        if ( feature != "OsmSchema-V0.6" && feature != "DenseNodes" ) {
+            error = QString( "The file needs the unsupported feature %1" ).arg( feature );
+            return false;
+        }
+    }
+
+    if ( headerBlock.hasError() ) {
+        error = QString( "Unable to parse the header block" );
+        return false;
+    }
+
+    return true;
+}
+
+void PbfRunner::addBlock( const PbfBlock &block )
+{
+    // Like the XML parser, the nodes are kept until the ways are built,
+    // the ways until the relations are built. Only nodes with tags
+    // become placemarks.
+    foreach ( const PbfNode &node, block.nodes ) {
+        m_nodes.appendPoint( node.id, node.lon, node.lat );
+
+        if ( node.tagCount > 0 ) {
+            GeoDataPoint point( node.lon, node.lat, 0, GeoDataCoordinates::Degree );
+            addTags( block, node.firstTag, node.tagCount, osm::OsmElementBuilder::Node, &point );
+        }
+    }
+
+    GeoDataCoordinates coordinates;
+    foreach ( const PbfWay &way, block.ways ) {
+        GeoDataLineString *polyline = new GeoDataLineString();
+        GeoDataPlacemark *placemark = new GeoDataPlacemark();
+        placemark->setGeometry( polyline );
+
+        // At the beginning visibility = false. Afterwards when parsing
+        // the tags for the placemark it will decide if it should be displayed or not
+        placemark->setVisible( false );
+        m_document->append( placemark );
+        m_ways.appendLine( way.id, polyline );
+
+        for ( int i = way.firstRef; i < way.firstRef + way.refCount; ++i ) {
+            if ( m_nodes.coordinates( block.refs[i], coordinates ) ) {
+                polyline->append( coordinates );
+            }
+        }
+
+        addTags( block, way.firstTag, way.tagCount, osm::OsmElementBuilder::Way, polyline );
+    }
+
+    if ( !block.relations.isEmpty() ) {
+        // Relations follow the nodes and ways and only refer to ways
+        m_nodes.clear();
+    }
+
+    foreach ( const PbfRelation &relation, block.relations ) {
+        GeoDataPolygon *polygon = new GeoDataPolygon();
+        GeoDataPlacemark *placemark = new GeoDataPlacemark();
+        placemark->setGeometry( polygon );
+
+        // In the beginning visibility = false. Afterwards when it parses
+        // the tags for the placemark it will decide if it should be displayed or not
+        placemark->setVisible( false );
+        m_document->append( placemark );
+        m_relations.appendPolygon( relation.id, polygon );
+
+        for ( int i = relation.firstMember; i < relation.firstMember + relation.memberCount; ++i ) {
+            const PbfMember &member = block.members[i];
+            if ( member.type == PbfMember::Way ) {
+                if ( GeoDataLineString *line = m_ways.line( member.ref ) ) {
+                    osm::OsmElementBuilder::addWayMember( polygon, member.role, *line );
+                }
+            }
+            else if ( member.type == PbfMember::Relation ) {
+                if ( GeoDataPolygon *p = m_relations.polygon( member.ref ) ) {
+                    osm::OsmElementBuilder::addRelationMember( polygon, member.role, *p );
+                }
+            }
+        }
+
+        addTags( block, relation.firstTag, relation.tagCount, osm::OsmElementBuilder::Relation, polygon );
+    }
+}
+
+void PbfRunner::addTags( const PbfBlock &block, int firstTag, int tagCount,
+                         osm::OsmElementBuilder::ElementType type, GeoDataGeometry *geometry )
+{
+    for ( int i = firstTag; i < firstTag + tagCount; ++i ) {
+        const QPair<QString, QString> &tag = block.tags[i];
+        osm::OsmElementBuilder::addTag( m_document, type, geometry, tag.first, tag.second, m_dummyPlacemarks );
+    }
+}
+
+}
+
+#include "PbfRunner.moc"
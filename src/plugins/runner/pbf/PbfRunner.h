@@ -0,0 +1,59 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#ifndef MARBLEPBFRUNNER_H
+#define MARBLEPBFRUNNER_H
+
+#include "ParsingRunner.h"
+
+#include "OsmElementBuilder.h"
+#include "OsmNodeFactory.h"
+#include "OsmWayFactory.h"
+#include "OsmRelationFactory.h"
+
+#include <QList>
+
+class QDataStream;
+
+namespace Marble
+{
+
+class GeoDataGeometry;
+class GeoDataPlacemark;
+struct PbfBlock;
+
+/**
+ * Reads OpenStreetMap data in the PBF format. The blocks of the file are
+ * decoded on a thread pool, then the placemarks are built from them in the
+ * order of the file like the XML parser of the Osm plugin does.
+ */
+class PbfRunner : public ParsingRunner
+{
+    Q_OBJECT
+public:
+    explicit PbfRunner( QObject *parent = 0 );
+    ~PbfRunner();
+    virtual void parseFile( const QString &fileName, DocumentRole role );
+
+private:
+    static bool readBlob( QDataStream &stream, QString &type, QByteArray &blob, QString &error );
+    static bool checkHeader( const QByteArray &blob, QString &error );
+
+    void addBlock( const PbfBlock &block );
+    void addTags( const PbfBlock &block, int firstTag, int tagCount,
+                  osm::OsmElementBuilder::ElementType type, GeoDataGeometry *geometry );
+
+    GeoDataDocument *m_document;
+    osm::OsmNodeFactory m_nodes;
+    osm::OsmWayFactory m_ways;
+    osm::OsmRelationFactory m_relations;
+    QList<GeoDataPlacemark *> m_dummyPlacemarks;
+};
+
+}
+#endif // MARBLEPBFRUNNER_H
@@ -40,6 +40,7 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <QtEndian>
 
 namespace Marble
 {
@@ -47,6 +48,15 @@ namespace Marble
 // Polygon header flags, representing the type of polygon
 enum polygonFlagType { LINESTRING = 0, LINEARRING = 1, OUTERBOUNDARY = 2, INNERBOUNDARY = 3, MULTIGEOMETRY = 4 };
 
+// Sizes of the big endian records in the file
+static const int fileHeaderSize = 1 + 4;            // version, number of polygons
+static const int polygonHeaderSize = 4 + 4 + 1;     // id, number of absolute nodes, flag
+static const int absoluteNodeSize = 2 + 2 + 2;      // lat, lon, number of relative nodes
+static const int relativeNodeSize = 1 + 1;          // lat, lon
+
+// Coordinates are stored in units of half an arcminute
+static const qreal unitToRad = M_PI / ( 120.0 * 180.0 );
+
 
 Pn2Runner::Pn2Runner(QObject *parent) :
     ParsingRunner(parent)
@@ -57,59 +67,63 @@ Pn2Runner::~Pn2Runner()
 {
 }
 
-bool Pn2Runner::errorCheckLat( qint16 lat ) 
-{
-    if ( lat >= -10800 && lat <= +10800 )
-        return false;
-    else
-        return true;
-}
-
-bool Pn2Runner::errorCheckLon( qint16 lon )
+bool Pn2Runner::importPolygon( const uchar *&data, const uchar *end, GeoDataLineString* linestring, quint32 nrAbsoluteNodes )
 {
-    if ( lon >= -21600 && lon <= +21600 )
-        return false;
-    else
-        return true;
-}
-
-bool Pn2Runner::importPolygon( QDataStream &stream, GeoDataLineString* linestring, quint32 nrAbsoluteNodes ) 
-{
-    qint16 lat, lon, nrRelativeNodes;
-    qint8 relativeLat, relativeLon;
-    bool error = false;
-
-
-    for ( quint32 absoluteNode = 1; absoluteNode <= nrAbsoluteNodes; absoluteNode++ ) {
-        stream >> lat >> lon >> nrRelativeNodes;
-
-        error = error | errorCheckLat( lat ) | errorCheckLon( lon );
-
-        qreal degLat = ( 1.0 * lat / 120.0 );
-        qreal degLon = ( 1.0 * lon / 120.0 );
-
-        GeoDataCoordinates *coord = new GeoDataCoordinates( degLon / 180 * M_PI, degLat / 180 * M_PI );
-        linestring->append( *coord );
-
-        for ( qint16 relativeNode = 1; relativeNode <= nrRelativeNodes; ++relativeNode ) {
-            stream >> relativeLat >> relativeLon;
-
-            qint16 currLat = relativeLat + lat; 
-            qint16 currLon = relativeLon + lon;
-
-
-            error = error | errorCheckLat( currLat ) | errorCheckLon( currLon );
-
-            qreal currDegLat = ( 1.0 * currLat / 120.0 );
-            qreal currDegLon = ( 1.0 * currLon / 120.0 );
+    // Find the number of nodes and make sure that all of them are inside the file,
+    // so the nodes can be decoded without further checks
+    const uchar *position = data;
+    int nrNodes = 0;
+    for ( quint32 absoluteNode = 0; absoluteNode < nrAbsoluteNodes; ++absoluteNode ) {
+        if ( end - position < absoluteNodeSize ) {
+            return true;
+        }
+        const int nrRelativeNodes = qMax<qint16>( 0, qFromBigEndian<qint16>( position + 4 ) );
+        position += absoluteNodeSize;
 
+        if ( end - position < nrRelativeNodes * relativeNodeSize ) {
+            return true;
+        }
+        position += nrRelativeNodes * relativeNodeSize;
+        nrNodes += 1 + nrRelativeNodes;
+    }
 
-            GeoDataCoordinates *currCoord = new GeoDataCoordinates( currDegLon / 180 * M_PI, currDegLat / 180 * M_PI );
-            linestring->append( *currCoord );
+    linestring->reserve( nrNodes );
+
+    // The range of the coordinates is checked once for the whole polygon
+    int minLat = 0;
+    int maxLat = 0;
+    int minLon = 0;
+    int maxLon = 0;
+
+    const uchar *node = data;
+    for ( quint32 absoluteNode = 0; absoluteNode < nrAbsoluteNodes; ++absoluteNode ) {
+        const int lat = qFromBigEndian<qint16>( node );
+        const int lon = qFromBigEndian<qint16>( node + 2 );
+        const int nrRelativeNodes = qFromBigEndian<qint16>( node + 4 );
+        node += absoluteNodeSize;
+
+        minLat = qMin( minLat, lat );
+        maxLat = qMax( maxLat, lat );
+        minLon = qMin( minLon, lon );
+        maxLon = qMax( maxLon, lon );
+        linestring->appendNode( lon * unitToRad, lat * unitToRad );
+
+        for ( int relativeNode = 0; relativeNode < nrRelativeNodes; ++relativeNode ) {
+            const int currLat = lat + qint8( node[0] );
+            const int currLon = lon + qint8( node[1] );
+            node += relativeNodeSize;
+
+            minLat = qMin( minLat, currLat );
+            maxLat = qMax( maxLat, currLat );
+            minLon = qMin( minLon, currLon );
+            maxLon = qMax( maxLon, currLon );
+            linestring->appendNode( currLon * unitToRad, currLat * unitToRad );
         }
     }
 
-    return error;
+    data = position;
+
+    return minLat < -10800 || maxLat > 10800 || minLon < -21600 || maxLon > 21600;
 }
 
 void Pn2Runner::parseFile( const QString &fileName, DocumentRole role = UnknownDocument )
@@ -128,60 +142,91 @@ void Pn2Runner::parseFile( const QString &fileName, DocumentRole role = UnknownD
     }
 
     file.open( QIODevice::ReadOnly );
-    QDataStream stream( &file );  // read the data serialized from the file
 
-    GeoDataDocument *document = new GeoDataDocument();
-    document->setDocumentRole( role );
+    qint64 size = file.size();
+    const uchar *data = file.map( 0, size );
+    QByteArray contents;
+    if ( !data ) {
+        // not every file system supports mappings
+        contents = file.readAll();
+        data = reinterpret_cast<const uchar *>( contents.constData() );
+        size = contents.size();
+    }
+    const uchar *const end = data + size;
 
-    quint8 fileHeaderVersion;
-    quint32 fileHeaderPolygons;
+    if ( size < fileHeaderSize ) {
+        emit parsingFinished( 0, "Errors occurred while parsing the .pn2 file!" );
+        return;
+    }
 
-    stream >> fileHeaderVersion >> fileHeaderPolygons;
+    // The file header version is not needed yet
+    const quint32 fileHeaderPolygons = qFromBigEndian<quint32>( data + 1 );
+    data += fileHeaderSize;
+
+    GeoDataDocument *document = new GeoDataDocument();
+    document->setDocumentRole( role );
 
     bool error = false;
 
-    quint32 ID, nrAbsoluteNodes;
     quint8 flag, prevFlag = -1;
 
-    GeoDataPolygon *polygon = new GeoDataPolygon;
+    GeoDataPolygon *polygon = 0;
 
-    for ( quint32 currentPoly = 1; ( currentPoly <= fileHeaderPolygons ) && ( !error ) && ( !stream.atEnd() ); currentPoly++ ) {
+    for ( quint32 currentPoly = 1; ( currentPoly <= fileHeaderPolygons ) && ( !error ) && ( data != end ); currentPoly++ ) {
 
-        stream >> ID >> nrAbsoluteNodes >> flag;
+        if ( end - data < polygonHeaderSize ) {
+            error = true;
+            break;
+        }
+
+        // The feature id is not needed yet
+        const quint32 nrAbsoluteNodes = qFromBigEndian<quint32>( data + 4 );
+        flag = data[8];
+        data += polygonHeaderSize;
 
         if ( flag != INNERBOUNDARY && ( prevFlag == INNERBOUNDARY || prevFlag == OUTERBOUNDARY ) ) {
 
             GeoDataPlacemark *placemark = new GeoDataPlacemark;
             placemark->setGeometry( polygon );
             document->append( placemark );
+            polygon = 0;
         }
 
         if ( flag == LINESTRING ) {
             GeoDataLineString *linestring = new GeoDataLineString;
-            error = error | importPolygon( stream, linestring, nrAbsoluteNodes );
+            error = error | importPolygon( data, end, linestring, nrAbsoluteNodes );
 
             GeoDataPlacemark *placemark = new GeoDataPlacemark;
             placemark->setGeometry( linestring );
             document->append( placemark );
         }
 
-        if ( ( flag == LINEARRING ) || ( flag == OUTERBOUNDARY ) || ( flag == INNERBOUNDARY ) ) {
+        if ( flag == LINEARRING ) {
             GeoDataLinearRing* linearring = new GeoDataLinearRing;
-            error = error | importPolygon( stream, linearring, nrAbsoluteNodes );
+            error = error | importPolygon( data, end, linearring, nrAbsoluteNodes );
 
-            if ( flag == LINEARRING ) {
-                GeoDataPlacemark *placemark = new GeoDataPlacemark;
-                placemark->setGeometry( linearring );
-                document->append( placemark );
-            }
+            GeoDataPlacemark *placemark = new GeoDataPlacemark;
+            placemark->setGeometry( linearring );
+            document->append( placemark );
+        }
+
+        if ( ( flag == OUTERBOUNDARY ) || ( flag == INNERBOUNDARY ) ) {
+            GeoDataLinearRing linearring;
+            error = error | importPolygon( data, end, &linearring, nrAbsoluteNodes );
 
             if ( flag == OUTERBOUNDARY ) {
+                delete polygon;
                 polygon = new GeoDataPolygon;
-                polygon->setOuterBoundary( *linearring );
+                polygon->setOuterBoundary( linearring );
             }
 
             if ( flag == INNERBOUNDARY ) {
-                polygon->appendInnerBoundary( *linearring );
+                if ( !polygon ) {
+                    // an inner boundary without its outer boundary
+                    error = true;
+                    break;
+                }
+                polygon->appendInnerBoundary( linearring );
             }
         }
 
@@ -194,7 +239,7 @@ void Pn2Runner::parseFile( const QString &fileName, DocumentRole role = UnknownD
         prevFlag = flag;
     }
 
-    if ( prevFlag == INNERBOUNDARY || prevFlag == OUTERBOUNDARY ) {
+    if ( polygon ) {
         GeoDataPlacemark *placemark = new GeoDataPlacemark;
         placemark->setGeometry( polygon );
         document->append( placemark );
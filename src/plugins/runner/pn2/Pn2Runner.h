@@ -23,15 +23,10 @@ class Pn2Runner : public ParsingRunner
 public:
     explicit Pn2Runner(QObject *parent = 0);
     ~Pn2Runner();
-    bool errorCheckLat( qint16 lat );
-    bool errorCheckLon( qint16 lon );
-    bool importPolygon( QDataStream &stream, GeoDataLineString* linestring, quint32 nrAbsoluteNodes );
     virtual void parseFile( const QString &fileName, DocumentRole role );
 
-signals:
-
-public slots:
-
+private:
+    static bool importPolygon( const uchar *&data, const uchar *end, GeoDataLineString* linestring, quint32 nrAbsoluteNodes );
 };
 
 }
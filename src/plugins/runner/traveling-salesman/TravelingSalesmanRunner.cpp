@@ -46,7 +46,7 @@ void TravelingSalesmanRunnerPrivate::merge( GeoDataLineString* one, const GeoDat
 {
     Q_ASSERT( one );
 
-    QVector<GeoDataCoordinates>::const_iterator iter = two.constBegin();
+    GeoDataLineString::ConstIterator iter = two.constBegin();
     for ( ; iter != two.constEnd(); ++iter ) {
         /** @todo: It might be needed to cut off some points at the start or end */
         one->append( *iter );
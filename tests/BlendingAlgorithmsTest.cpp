@@ -0,0 +1,246 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QImage>
+#include <QtTest>
+
+#include "blendings/BlendingAlgorithms.h"
+#include "TextureTile.h"
+#include "TileId.h"
+
+Q_DECLARE_METATYPE( QImage::Format )
+
+namespace Marble
+{
+
+class BlendingAlgorithmsTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+
+    void testBlend_data();
+    void testBlend();
+
+    void benchmarkPixelBlend_data();
+    void benchmarkPixelBlend();
+
+    void benchmarkBlend_data();
+    void benchmarkBlend();
+
+ private:
+    static Blending *createBlending( const QString &name );
+    static QStringList blendingNames();
+
+    // the pixel by pixel implementations which were used before the scanline kernels
+    static void pixelBlend( const QString &name, const Blending *blending, QImage *bottom, const QImage &top );
+
+    QImage m_bottom;
+    QImage m_top;
+};
+
+Blending *BlendingAlgorithmsTest::createBlending( const QString &name )
+{
+    if ( name == "AllanonBlending" ) return new AllanonBlending;
+    if ( name == "ArcusTangentBlending" ) return new ArcusTangentBlending;
+    if ( name == "GeometricMeanBlending" ) return new GeometricMeanBlending;
+    if ( name == "LinearLightBlending" ) return new LinearLightBlending;
+    if ( name == "OverlayBlending" ) return new OverlayBlending;
+    if ( name == "ColorBurnBlending" ) return new ColorBurnBlending;
+    if ( name == "DarkBlending" ) return new DarkBlending;
+    if ( name == "DarkenBlending" ) return new DarkenBlending;
+    if ( name == "DivideBlending" ) return new DivideBlending;
+    if ( name == "GammaDarkBlending" ) return new GammaDarkBlending;
+    if ( name == "LinearBurnBlending" ) return new LinearBurnBlending;
+    if ( name == "MultiplyBlending" ) return new MultiplyBlending;
+    if ( name == "SubtractiveBlending" ) return new SubtractiveBlending;
+    if ( name == "AdditiveBlending" ) return new AdditiveBlending;
+    if ( name == "ColorDodgeBlending" ) return new ColorDodgeBlending;
+    if ( name == "GammaLightBlending" ) return new GammaLightBlending;
+    if ( name == "HardLightBlending" ) return new HardLightBlending;
+    if ( name == "LightBlending" ) return new LightBlending;
+    if ( name == "LightenBlending" ) return new LightenBlending;
+    if ( name == "PinLightBlending" ) return new PinLightBlending;
+    if ( name == "ScreenBlending" ) return new ScreenBlending;
+    if ( name == "SoftLightBlending" ) return new SoftLightBlending;
+    if ( name == "VividLightBlending" ) return new VividLightBlending;
+    if ( name == "BleachBlending" ) return new BleachBlending;
+    if ( name == "DifferenceBlending" ) return new DifferenceBlending;
+    if ( name == "EquivalenceBlending" ) return new EquivalenceBlending;
+    if ( name == "HalfDifferenceBlending" ) return new HalfDifferenceBlending;
+    if ( name == "CloudsBlending" ) return new CloudsBlending;
+    if ( name == "GrayscaleBlending" ) return new GrayscaleBlending;
+
+    return 0;
+}
+
+QStringList BlendingAlgorithmsTest::blendingNames()
+{
+    return QStringList()
+        << "AllanonBlending" << "ArcusTangentBlending" << "GeometricMeanBlending"
+        << "LinearLightBlending" << "OverlayBlending"
+        << "ColorBurnBlending" << "DarkBlending" << "DarkenBlending" << "DivideBlending"
+        << "GammaDarkBlending" << "LinearBurnBlending" << "MultiplyBlending" << "SubtractiveBlending"
+        << "AdditiveBlending" << "ColorDodgeBlending" << "GammaLightBlending" << "HardLightBlending"
+        << "LightBlending" << "LightenBlending" << "PinLightBlending" << "ScreenBlending"
+        << "SoftLightBlending" << "VividLightBlending"
+        << "BleachBlending" << "DifferenceBlending" << "EquivalenceBlending" << "HalfDifferenceBlending"
+        << "CloudsBlending" << "GrayscaleBlending";
+}
+
+void BlendingAlgorithmsTest::pixelBlend( const QString &name, const Blending *blending, QImage *bottom, const QImage &top )
+{
+    int const width = bottom->width();
+    int const height = bottom->height();
+
+    if ( name == "CloudsBlending" ) {
+        for ( int y = 0; y < height; ++y ) {
+            for ( int x = 0; x < width; ++x ) {
+                qreal const c = qRed( top.pixel( x, y )) / 255.0;
+                QRgb const bottomPixel = bottom->pixel( x, y );
+                int const bottomRed = qRed( bottomPixel );
+                int const bottomGreen = qGreen( bottomPixel );
+                int const bottomBlue = qBlue( bottomPixel );
+                bottom->setPixel( x, y, qRgb(( int )( bottomRed + ( 255 - bottomRed ) * c ),
+                                             ( int )( bottomGreen + ( 255 - bottomGreen ) * c ),
+                                             ( int )( bottomBlue + ( 255 - bottomBlue ) * c )));
+            }
+        }
+        return;
+    }
+
+    QImage const topImagePremult = top.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+
+    if ( name == "GrayscaleBlending" ) {
+        for ( int y = 0; y < height; ++y ) {
+            for ( int x = 0; x < width; ++x ) {
+                int const gray = qGray( topImagePremult.pixel( x, y ) );
+                bottom->setPixel( x, y, qRgb( gray, gray, gray ) );
+            }
+        }
+        return;
+    }
+
+    IndependentChannelBlending const * const channelBlending = static_cast<IndependentChannelBlending const *>( blending );
+    for ( int y = 0; y < height; ++y ) {
+        for ( int x = 0; x < width; ++x ) {
+            QRgb const bottomPixel = bottom->pixel( x, y );
+            QRgb const topPixel = topImagePremult.pixel( x, y );
+            qreal const resultRed = channelBlending->blendChannel( qRed( bottomPixel ) / 255.0,
+                                                                   qRed( topPixel ) / 255.0 );
+            qreal const resultGreen = channelBlending->blendChannel( qGreen( bottomPixel ) / 255.0,
+                                                                     qGreen( topPixel ) / 255.0 );
+            qreal const resultBlue = channelBlending->blendChannel( qBlue( bottomPixel ) / 255.0,
+                                                                    qBlue( topPixel ) / 255.0 );
+            bottom->setPixel( x, y, qRgb( resultRed * 255.0,
+                                          resultGreen * 255.0,
+                                          resultBlue * 255.0 ));
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::initTestCase()
+{
+    qsrand( 42 );
+
+    m_bottom = QImage( 256, 256, QImage::Format_ARGB32_Premultiplied );
+    m_top = QImage( 256, 256, QImage::Format_ARGB32 );
+
+    // every combination of channel intensities, plus some noise
+    for ( int y = 0; y < 256; ++y ) {
+        for ( int x = 0; x < 256; ++x ) {
+            m_bottom.setPixel( x, y, qRgb( x, y, qrand() % 256 ) );
+            m_top.setPixel( x, y, qRgba( y, x, qrand() % 256, qrand() % 256 ) );
+        }
+    }
+}
+
+void BlendingAlgorithmsTest::testBlend_data()
+{
+    QTest::addColumn<QString>( "name" );
+    QTest::addColumn<QImage::Format>( "topFormat" );
+
+    foreach ( const QString &name, blendingNames() ) {
+        QTest::newRow( QString( "%1 ARGB32" ).arg( name ).toLatin1() ) << name << QImage::Format_ARGB32;
+        QTest::newRow( QString( "%1 ARGB32_Premultiplied" ).arg( name ).toLatin1() ) << name << QImage::Format_ARGB32_Premultiplied;
+        QTest::newRow( QString( "%1 RGB32" ).arg( name ).toLatin1() ) << name << QImage::Format_RGB32;
+        QTest::newRow( QString( "%1 Indexed8" ).arg( name ).toLatin1() ) << name << QImage::Format_Indexed8;
+    }
+}
+
+void BlendingAlgorithmsTest::testBlend()
+{
+    QFETCH( QString, name );
+    QFETCH( QImage::Format, topFormat );
+
+    Blending const * const blending = createBlending( name );
+    QVERIFY( blending );
+
+    QImage const top = m_top.convertToFormat( topFormat );
+    TextureTile const tile( TileId( 0, 0, 0, 0 ), top, blending );
+
+    QImage expected = m_bottom;
+    pixelBlend( name, blending, &expected, top );
+
+    QImage result = m_bottom;
+    blending->blend( &result, &tile );
+
+    QVERIFY( result == expected );
+
+    delete blending;
+}
+
+void BlendingAlgorithmsTest::benchmarkPixelBlend_data()
+{
+    QTest::addColumn<QString>( "name" );
+
+    foreach ( const QString &name, blendingNames() ) {
+        QTest::newRow( name.toLatin1() ) << name;
+    }
+}
+
+void BlendingAlgorithmsTest::benchmarkPixelBlend()
+{
+    QFETCH( QString, name );
+
+    Blending const * const blending = createBlending( name );
+    QImage result = m_bottom;
+
+    QBENCHMARK {
+        pixelBlend( name, blending, &result, m_top );
+    }
+
+    delete blending;
+}
+
+void BlendingAlgorithmsTest::benchmarkBlend_data()
+{
+    benchmarkPixelBlend_data();
+}
+
+void BlendingAlgorithmsTest::benchmarkBlend()
+{
+    QFETCH( QString, name );
+
+    Blending const * const blending = createBlending( name );
+    TextureTile const tile( TileId( 0, 0, 0, 0 ), m_top, blending );
+    QImage result = m_bottom;
+
+    QBENCHMARK {
+        blending->blend( &result, &tile );
+    }
+
+    delete blending;
+}
+
+}
+
+QTEST_MAIN( Marble::BlendingAlgorithmsTest )
+
+#include "BlendingAlgorithmsTest.moc"
@@ -0,0 +1,343 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QtTest>
+
+#include "TestUtils.h"
+#include "DocumentCache.h"
+#include "GeoDataData.h"
+#include "GeoDataExtendedData.h"
+#include "GeoDataFolder.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataLineStyle.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataStyle.h"
+#include "GeoDataTimeSpan.h"
+#include "GeoDataTimeStamp.h"
+
+namespace Marble
+{
+
+class DocumentCacheTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testRoundTrip();
+    void testStyles();
+    void testInlineStylesAndTimes();
+    void testDamagedFile();
+    void testOldFormat();
+    void testIsCacheable();
+
+    void benchmarkRead_data();
+    void benchmarkRead();
+
+ private:
+    GeoDataDocument *roundTrip( const GeoDataDocument *document );
+    static GeoDataPlacemark *placemark( const GeoDataContainer *container, int index );
+    static void compareLineStrings( const GeoDataLineString &actual, const GeoDataLineString &expected );
+
+    QString m_cacheFileName;
+    GeoDataDocument *m_document;
+};
+
+void DocumentCacheTest::initTestCase()
+{
+    QTemporaryFile file;
+    QVERIFY( file.open() );
+    m_cacheFileName = file.fileName() + ".cache";
+
+    m_document = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+        "<Document>"
+        "<Style id=\"border\"><LineStyle><color>ff0000ff</color><width>3</width></LineStyle></Style>"
+        "<Folder><name>Folder</name>"
+        "<Placemark><name>Point</name><description>Caf&#233;</description>"
+        "<ExtendedData>"
+        "<Data name=\"gmt\"><value>60</value></Data>"
+        "<Data name=\"note\"><displayName>Note</displayName><value>text</value></Data>"
+        "</ExtendedData>"
+        "<Point><coordinates>7.5,45.25,800</coordinates></Point>"
+        "</Placemark>"
+        "</Folder>"
+        "<Placemark><name>Line</name><styleUrl>#border</styleUrl>"
+        "<LineString><tessellate>1</tessellate><coordinates>1,2 3,4,5 6,7</coordinates></LineString>"
+        "</Placemark>"
+        "<Placemark><name>Polygon</name><Polygon>"
+        "<outerBoundaryIs><LinearRing><coordinates>0,0 10,0 10,10 0,10 0,0</coordinates></LinearRing></outerBoundaryIs>"
+        "<innerBoundaryIs><LinearRing><coordinates>2,2 4,2 4,4 2,2</coordinates></LinearRing></innerBoundaryIs>"
+        "</Polygon></Placemark>"
+        "<Placemark><name>Multi</name><MultiGeometry>"
+        "<Point><coordinates>-1,-2</coordinates></Point>"
+        "<LineString><coordinates>8,9 10,11</coordinates></LineString>"
+        "</MultiGeometry></Placemark>"
+        "</Document>"
+        "</kml>" );
+    QVERIFY( m_document != 0 );
+}
+
+void DocumentCacheTest::cleanupTestCase()
+{
+    delete m_document;
+}
+
+GeoDataDocument *DocumentCacheTest::roundTrip( const GeoDataDocument *document )
+{
+    QFile::remove( m_cacheFileName );
+    if ( !DocumentCache::write( m_cacheFileName, document ) || !DocumentCache::isDocumentCache( m_cacheFileName ) ) {
+        return 0;
+    }
+
+    GeoDataDocument *result = DocumentCache::read( m_cacheFileName, UserDocument );
+    QFile::remove( m_cacheFileName );
+    return result;
+}
+
+GeoDataPlacemark *DocumentCacheTest::placemark( const GeoDataContainer *container, int index )
+{
+    if ( index >= container->size() ) {
+        return 0;
+    }
+
+    return dynamic_cast<GeoDataPlacemark *>( container->featureList().at( index ) );
+}
+
+void DocumentCacheTest::compareLineStrings( const GeoDataLineString &actual, const GeoDataLineString &expected )
+{
+    QCOMPARE( actual.size(), expected.size() );
+    QCOMPARE( int( actual.tessellationFlags() ), int( expected.tessellationFlags() ) );
+    for ( int i = 0; i < expected.size(); ++i ) {
+        QCOMPARE( actual.at( i ), expected.at( i ) );
+    }
+}
+
+void DocumentCacheTest::testRoundTrip()
+{
+    GeoDataDocument *document = roundTrip( m_document );
+    QVERIFY( document != 0 );
+    QCOMPARE( document->documentRole(), UserDocument );
+    QCOMPARE( document->size(), m_document->size() );
+
+    GeoDataFolder *folder = dynamic_cast<GeoDataFolder *>( document->child( 0 ) );
+    QVERIFY( folder != 0 );
+    QCOMPARE( folder->name(), QString( "Folder" ) );
+
+    GeoDataPlacemark *point = placemark( folder, 0 );
+    QVERIFY( point != 0 );
+    QCOMPARE( point->name(), QString( "Point" ) );
+    QCOMPARE( point->description(), QString( "Caf" ).append( QChar( 0xe9 ) ) );
+    QCOMPARE( point->coordinate(), GeoDataCoordinates( 7.5, 45.25, 800.0, GeoDataCoordinates::Degree ) );
+    QCOMPARE( point->extendedData().size(), 2 );
+    QCOMPARE( point->extendedData().value( "gmt" ).value().toInt(), 60 );
+    QCOMPARE( point->extendedData().value( "note" ).displayName(), QString( "Note" ) );
+    QCOMPARE( point->extendedData().value( "note" ).value().toString(), QString( "text" ) );
+
+    const GeoDataPlacemark *expectedLine = placemark( m_document, 1 );
+    GeoDataPlacemark *line = placemark( document, 1 );
+    QVERIFY( line != 0 );
+    QCOMPARE( line->styleUrl(), QString( "#border" ) );
+    QVERIFY( dynamic_cast<GeoDataLineString *>( line->geometry() ) != 0 );
+    compareLineStrings( *static_cast<GeoDataLineString *>( line->geometry() ),
+                        *static_cast<const GeoDataLineString *>( expectedLine->geometry() ) );
+
+    const GeoDataPlacemark *expectedPolygon = placemark( m_document, 2 );
+    GeoDataPlacemark *polygon = placemark( document, 2 );
+    QVERIFY( polygon != 0 );
+    GeoDataPolygon *actualPolygon = dynamic_cast<GeoDataPolygon *>( polygon->geometry() );
+    QVERIFY( actualPolygon != 0 );
+    const GeoDataPolygon *expectedGeometry = static_cast<const GeoDataPolygon *>( expectedPolygon->geometry() );
+    compareLineStrings( actualPolygon->outerBoundary(), expectedGeometry->outerBoundary() );
+    QCOMPARE( actualPolygon->innerBoundaries().size(), 1 );
+    compareLineStrings( actualPolygon->innerBoundaries().first(), expectedGeometry->innerBoundaries().first() );
+    QVERIFY( actualPolygon->outerBoundary().isClosed() );
+
+    GeoDataPlacemark *multi = placemark( document, 3 );
+    QVERIFY( multi != 0 );
+    GeoDataMultiGeometry *multiGeometry = dynamic_cast<GeoDataMultiGeometry *>( multi->geometry() );
+    QVERIFY( multiGeometry != 0 );
+    QCOMPARE( multiGeometry->size(), 2 );
+    GeoDataPoint *multiPoint = dynamic_cast<GeoDataPoint *>( multiGeometry->child( 0 ) );
+    QVERIFY( multiPoint != 0 );
+    QCOMPARE( multiPoint->coordinates(), GeoDataCoordinates( -1.0, -2.0, 0.0, GeoDataCoordinates::Degree ) );
+    GeoDataLineString *multiLine = dynamic_cast<GeoDataLineString *>( multiGeometry->child( 1 ) );
+    QVERIFY( multiLine != 0 );
+    QCOMPARE( multiLine->size(), 2 );
+
+    delete document;
+}
+
+void DocumentCacheTest::testStyles()
+{
+    GeoDataDocument *document = roundTrip( m_document );
+    QVERIFY( document != 0 );
+
+    QCOMPARE( document->styles().size(), m_document->styles().size() );
+    const GeoDataStyle &style = document->style( "border" );
+    QCOMPARE( style.styleId(), QString( "border" ) );
+    QCOMPARE( style.lineStyle().width(), float( 3.0 ) );
+    QCOMPARE( style.lineStyle().color(), m_document->style( "border" ).lineStyle().color() );
+
+    delete document;
+}
+
+void DocumentCacheTest::testInlineStylesAndTimes()
+{
+    GeoDataDocument *expected = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+        "<Document>"
+        "<Placemark><name>Styled</name>"
+        "<Style><LineStyle><color>ff00ff00</color><width>5</width></LineStyle></Style>"
+        "<TimeSpan><begin>2011-05-01T10:00:00Z</begin><end>2011-05-02T12:30:00Z</end></TimeSpan>"
+        "<LineString><coordinates>1,2 3,4</coordinates></LineString>"
+        "</Placemark>"
+        "<Placemark><name>Stamped</name>"
+        "<TimeStamp><when>2012-03-04</when></TimeStamp>"
+        "<Point><coordinates>7.5,45.25</coordinates></Point>"
+        "</Placemark>"
+        "</Document>"
+        "</kml>" );
+    QVERIFY( expected != 0 );
+    QVERIFY( DocumentCache::isCacheable( expected ) );
+
+    GeoDataDocument *document = roundTrip( expected );
+    QVERIFY( document != 0 );
+
+    const GeoDataPlacemark *expectedStyled = placemark( expected, 0 );
+    const GeoDataPlacemark *styled = placemark( document, 0 );
+    QVERIFY( styled != 0 );
+    QVERIFY( styled->style()->parent() == styled );
+    QCOMPARE( styled->style()->lineStyle().width(), float( 5.0 ) );
+    QCOMPARE( styled->style()->lineStyle().color(), expectedStyled->style()->lineStyle().color() );
+    QCOMPARE( styled->timeSpan().begin(), expectedStyled->timeSpan().begin() );
+    QCOMPARE( styled->timeSpan().end(), expectedStyled->timeSpan().end() );
+    QVERIFY( styled->timeSpan().begin().isValid() );
+    QVERIFY( !styled->timeStamp().when().isValid() );
+
+    const GeoDataPlacemark *expectedStamped = placemark( expected, 1 );
+    const GeoDataPlacemark *stamped = placemark( document, 1 );
+    QVERIFY( stamped != 0 );
+    QVERIFY( stamped->style()->parent() == 0 );
+    QVERIFY( stamped->timeStamp().when().isValid() );
+    QCOMPARE( stamped->timeStamp().when(), expectedStamped->timeStamp().when() );
+    QCOMPARE( int( stamped->timeStamp().resolution() ), int( expectedStamped->timeStamp().resolution() ) );
+    QVERIFY( !stamped->timeSpan().begin().isValid() );
+
+    delete document;
+    delete expected;
+}
+
+void DocumentCacheTest::testDamagedFile()
+{
+    QFile::remove( m_cacheFileName );
+    QVERIFY( DocumentCache::write( m_cacheFileName, m_document ) );
+
+    QFile file( m_cacheFileName );
+    QVERIFY( file.open( QIODevice::ReadWrite ) );
+    const qint64 size = file.size();
+    QVERIFY( file.resize( size / 2 ) );
+    file.close();
+
+    QString error;
+    QVERIFY( DocumentCache::read( m_cacheFileName, UserDocument, &error ) == 0 );
+    QVERIFY( !error.isEmpty() );
+
+    QFile::remove( m_cacheFileName );
+    QVERIFY( DocumentCache::read( m_cacheFileName, UserDocument ) == 0 );
+}
+
+void DocumentCacheTest::testOldFormat()
+{
+    // the header of the point only caches in data/placemarks
+    QFile file( m_cacheFileName );
+    QVERIFY( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+    QDataStream stream( &file );
+    stream << quint32( 0x31415926 ) << qint32( 015 );
+    file.close();
+
+    QVERIFY( !DocumentCache::isDocumentCache( m_cacheFileName ) );
+
+    QFile::remove( m_cacheFileName );
+}
+
+void DocumentCacheTest::testIsCacheable()
+{
+    QVERIFY( DocumentCache::isCacheable( m_document ) );
+
+    GeoDataDocument *document = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+        "<Document><Folder>"
+        "<Placemark><name>Point</name><Point><coordinates>7.5,45.25</coordinates></Point></Placemark>"
+        "<GroundOverlay><name>Overlay</name>"
+        "<LatLonBox><north>1</north><south>0</south><east>1</east><west>0</west></LatLonBox>"
+        "</GroundOverlay>"
+        "</Folder></Document>"
+        "</kml>" );
+    QVERIFY( document != 0 );
+
+    // overlays are not cached
+    QVERIFY( !DocumentCache::isCacheable( document ) );
+
+    delete document;
+}
+
+void DocumentCacheTest::benchmarkRead_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+
+    addNamedRow( "boundaries" ) << QString( MARBLE_SRC_DIR ).append( "/data/placemarks/boundaryplacemarks.kml" );
+    addNamedRow( "other placemarks" ) << QString( MARBLE_SRC_DIR ).append( "/data/placemarks/otherplacemarks.kml" );
+}
+
+void DocumentCacheTest::benchmarkRead()
+{
+    QFETCH( QString, fileName );
+
+    QFile file( fileName );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+    QByteArray content = file.readAll();
+
+    GeoDataParser parser( GeoData_KML );
+    QBuffer buffer( &content );
+    buffer.open( QIODevice::ReadOnly );
+    QVERIFY( parser.read( &buffer ) );
+    GeoDataDocument *document = static_cast<GeoDataDocument *>( parser.releaseDocument() );
+
+    QFile::remove( m_cacheFileName );
+    QVERIFY( DocumentCache::write( m_cacheFileName, document ) );
+    const int size = document->size();
+    delete document;
+
+    // compare with benchmarkDataFiles of KmlCoordinatesTest
+    QBENCHMARK {
+        GeoDataDocument *cached = DocumentCache::read( m_cacheFileName, UserDocument );
+        QVERIFY( cached != 0 );
+        QCOMPARE( cached->size(), size );
+        delete cached;
+    }
+
+    QFile::remove( m_cacheFileName );
+}
+
+}
+
+QTEST_MAIN( Marble::DocumentCacheTest )
+
+#include "DocumentCacheTest.moc"
@@ -0,0 +1,232 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QSignalSpy>
+#include <QtTest>
+
+#include "ElevationModel.h"
+#include "GeoDataLineString.h"
+#include "HttpDownloadManager.h"
+#include "MarbleDirs.h"
+#include "MarbleGlobal.h"
+#include "MarbleModel.h"
+
+Q_DECLARE_METATYPE( QVector<qreal> )
+
+namespace Marble
+{
+
+namespace {
+    // the level 9 tiles of srtm2 are 675 samples wide, 1024 of them around the globe
+    int const tileSize = 675;
+    qreal const samplesPerDegree = 1024 * tileSize / 360.0;
+
+    // the tiles written by the test, across the Alps
+    int const firstTileX = 529;
+    int const firstTileY = 124;
+}
+
+class ElevationModelTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testHeight();
+    void testBatch();
+    void testRequestHeights();
+
+    void benchmarkRequestHeights();
+
+ private:
+    static qreal knownHeight( qreal lon, qreal lat );
+    static qreal textureHeight( qreal textureX, qreal textureY );
+    static bool waitFor( const QSignalSpy &spy, int count );
+    static GeoDataLineString path( int size );
+
+    QString m_dataHome;
+    QStringList m_tileFiles;
+};
+
+void ElevationModelTest::initTestCase()
+{
+    MarbleDirs::setMarbleDataPath( DATA_PATH );
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+
+    // the tiles written below are found before the ones of the user
+    m_dataHome = QDir::tempPath() + "/ElevationModelTest-" + QString::number( QCoreApplication::applicationPid() );
+    qputenv( "XDG_DATA_HOME", QFile::encodeName( m_dataHome ) );
+    QDir localDir( MarbleDirs::localPath() );
+
+    // heights rising linearly, which the bilinear interpolation reproduces exactly
+    for ( int tileY = firstTileY; tileY < firstTileY + 2; ++tileY ) {
+        for ( int tileX = firstTileX; tileX < firstTileX + 2; ++tileX ) {
+            QImage image( tileSize, tileSize, QImage::Format_RGB32 );
+            for ( int y = 0; y < tileSize; ++y ) {
+                for ( int x = 0; x < tileSize; ++x ) {
+                    const int height = textureHeight( tileX * tileSize + x, tileY * tileSize + y );
+                    image.setPixel( x, y, qRgb( 0, height >> 8, height & 0xff ) );
+                }
+            }
+
+            const QString fileName = QString( "maps/earth/srtm2/9/%1/%1_%2.png" )
+                                     .arg( tileY, tileDigits, 10, QChar( '0' ) )
+                                     .arg( tileX, tileDigits, 10, QChar( '0' ) );
+            QVERIFY( localDir.mkpath( QFileInfo( fileName ).path() ) );
+            QVERIFY( image.save( localDir.filePath( fileName ) ) );
+            m_tileFiles << fileName;
+        }
+    }
+}
+
+void ElevationModelTest::cleanupTestCase()
+{
+    QDir localDir( MarbleDirs::localPath() );
+    foreach ( const QString &fileName, m_tileFiles ) {
+        localDir.remove( fileName );
+    }
+
+    const QStringList dirs = QStringList() << QString( "maps/earth/srtm2/9/%1" ).arg( firstTileY, tileDigits, 10, QChar( '0' ) )
+                                           << QString( "maps/earth/srtm2/9/%1" ).arg( firstTileY + 1, tileDigits, 10, QChar( '0' ) )
+                                           << "maps/earth/srtm2/9" << "maps/earth/srtm2" << "maps/earth" << "maps";
+    foreach ( const QString &dir, dirs ) {
+        localDir.rmdir( dir );
+    }
+    QDir::root().rmdir( MarbleDirs::localPath() );
+    QDir::root().rmdir( m_dataHome );
+}
+
+qreal ElevationModelTest::knownHeight( qreal lon, qreal lat )
+{
+    return textureHeight( ( 180 + lon ) * samplesPerDegree, ( 90 - lat ) * samplesPerDegree );
+}
+
+qreal ElevationModelTest::textureHeight( qreal textureX, qreal textureY )
+{
+    // at most 1000 + 5 * 2 * tileSize meters, well within the 16 bits of the samples
+    return 1000 + 2 * ( textureX - firstTileX * tileSize ) + 3 * ( textureY - firstTileY * tileSize );
+}
+
+bool ElevationModelTest::waitFor( const QSignalSpy &spy, int count )
+{
+    for ( int i = 0; i < 600 && spy.count() < count; ++i ) {
+        QTest::qWait( 50 );
+    }
+
+    return spy.count() >= count;
+}
+
+GeoDataLineString ElevationModelTest::path( int size )
+{
+    // across the Alps, about one node per sample of the elevation tiles
+    GeoDataLineString result;
+    for ( int i = 0; i < size; ++i ) {
+        result << GeoDataCoordinates( 6.0 + i / 1920.0, 46.0 + 0.5 * i / 1920.0, 0.0, GeoDataCoordinates::Degree );
+    }
+
+    return result;
+}
+
+void ElevationModelTest::testHeight()
+{
+    MarbleModel model;
+    model.downloadManager()->setDownloadEnabled( false );
+    const ElevationModel *elevationModel = model.elevationModel();
+    QSignalSpy updateSpy( elevationModel, SIGNAL(updateAvailable()) );
+
+    // the tile is loaded in the background
+    QCOMPARE( elevationModel->height( 6.2, 46.1 ), qreal( invalidElevationData ) );
+    QVERIFY( waitFor( updateSpy, 1 ) );
+
+    QVERIFY( qAbs( elevationModel->height( 6.2, 46.1 ) - knownHeight( 6.2, 46.1 ) ) < 1e-3 );
+}
+
+void ElevationModelTest::testBatch()
+{
+    MarbleModel model;
+    model.downloadManager()->setDownloadEnabled( false );
+    const ElevationModel *elevationModel = model.elevationModel();
+    QSignalSpy updateSpy( elevationModel, SIGNAL(updateAvailable()) );
+
+    // within one tile
+    const GeoDataLineString nodes = path( 100 );
+    QVector<qreal> lon;
+    QVector<qreal> lat;
+    for ( int i = 0; i < nodes.size(); ++i ) {
+        lon << nodes.at( i ).longitude( GeoDataCoordinates::Degree );
+        lat << nodes.at( i ).latitude( GeoDataCoordinates::Degree );
+    }
+
+    QVector<qreal> heights( nodes.size() );
+    elevationModel->heights( lon.constData(), lat.constData(), heights.data(), heights.size() );
+    QVERIFY( waitFor( updateSpy, 1 ) );
+
+    elevationModel->heights( lon.constData(), lat.constData(), heights.data(), heights.size() );
+    for ( int i = 0; i < heights.size(); ++i ) {
+        QVERIFY( qAbs( heights[i] - knownHeight( lon[i], lat[i] ) ) < 1e-3 );
+    }
+}
+
+void ElevationModelTest::testRequestHeights()
+{
+    MarbleModel model;
+    model.downloadManager()->setDownloadEnabled( false );
+    const ElevationModel *elevationModel = model.elevationModel();
+    QSignalSpy heightsSpy( elevationModel, SIGNAL(heightsAvailable(int,QVector<qreal>)) );
+
+    // across the four tiles, which are loaded by the request
+    const GeoDataLineString nodes = path( 1000 );
+    const int first = elevationModel->requestHeights( nodes );
+    const int second = elevationModel->requestHeights( nodes );
+    QVERIFY( first != second );
+    QVERIFY( waitFor( heightsSpy, 2 ) );
+
+    QCOMPARE( heightsSpy.at( 0 ).at( 0 ).toInt(), first );
+    QCOMPARE( heightsSpy.at( 1 ).at( 0 ).toInt(), second );
+
+    for ( int i = 0; i < 2; ++i ) {
+        const QVector<qreal> heights = heightsSpy.at( i ).at( 1 ).value<QVector<qreal> >();
+        QCOMPARE( heights.size(), nodes.size() );
+        for ( int j = 0; j < nodes.size(); ++j ) {
+            const qreal lon = nodes.at( j ).longitude( GeoDataCoordinates::Degree );
+            const qreal lat = nodes.at( j ).latitude( GeoDataCoordinates::Degree );
+            QVERIFY( qAbs( heights[j] - knownHeight( lon, lat ) ) < 1e-3 );
+        }
+    }
+}
+
+void ElevationModelTest::benchmarkRequestHeights()
+{
+    MarbleModel model;
+    model.downloadManager()->setDownloadEnabled( false );
+    const ElevationModel *elevationModel = model.elevationModel();
+    QSignalSpy heightsSpy( elevationModel, SIGNAL(heightsAvailable(int,QVector<qreal>)) );
+
+    // like the profile of a long route, mostly over tiles scaled from the lower levels
+    const GeoDataLineString nodes = path( 20000 );
+
+    QBENCHMARK {
+        const int count = heightsSpy.count();
+        elevationModel->requestHeights( nodes );
+        while ( heightsSpy.count() == count ) {
+            QCoreApplication::processEvents( QEventLoop::WaitForMoreEvents );
+        }
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::ElevationModelTest )
+
+#include "ElevationModelTest.moc"
@@ -0,0 +1,152 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QSignalSpy>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QtTest>
+
+#include "FileManager.h"
+#include "GeoDataTreeModel.h"
+#include "MarbleDirs.h"
+#include "MarbleModel.h"
+
+namespace Marble
+{
+
+class FileManagerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+
+    void loadFiles();
+    void removeWhileLoading();
+    void slowFileDoesNotHoldBack();
+    void benchmarkStartup();
+
+ private:
+    static bool waitFor( const QSignalSpy &spy, int count );
+
+    QStringList m_fileNames;
+};
+
+void FileManagerTest::initTestCase()
+{
+    MarbleDirs::setMarbleDataPath( DATA_PATH );
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+
+    // the placemarks of the earth map themes, loaded at startup
+    const QString placemarks = QString( MARBLE_SRC_DIR ).append( "/data/placemarks/" );
+    m_fileNames << placemarks + "baseplacemarks.kml"
+                << placemarks + "elevplacemarks.kml"
+                << placemarks + "otherplacemarks.kml"
+                << placemarks + "boundaryplacemarks.kml";
+}
+
+bool FileManagerTest::waitFor( const QSignalSpy &spy, int count )
+{
+    for ( int i = 0; i < 600 && spy.count() < count; ++i ) {
+        QTest::qWait( 50 );
+    }
+
+    return spy.count() == count;
+}
+
+void FileManagerTest::loadFiles()
+{
+    MarbleModel model;
+    QSignalSpy addedSpy( model.fileManager(), SIGNAL(fileAdded(QString)) );
+    QSignalSpy insertedSpy( model.treeModel(), SIGNAL(rowsInserted(QModelIndex,int,int)) );
+
+    foreach ( const QString &fileName, m_fileNames ) {
+        model.addGeoDataFile( fileName );
+    }
+
+    QVERIFY( waitFor( addedSpy, m_fileNames.size() ) );
+
+    // documents finishing together are added at once
+    QVERIFY( insertedSpy.count() < m_fileNames.size() );
+    int rows = 0;
+    foreach ( const QList<QVariant> &arguments, insertedSpy ) {
+        rows += arguments.at( 2 ).toInt() - arguments.at( 1 ).toInt() + 1;
+    }
+    QCOMPARE( rows, m_fileNames.size() );
+    QCOMPARE( model.treeModel()->rowCount(), m_fileNames.size() );
+}
+
+void FileManagerTest::removeWhileLoading()
+{
+    MarbleModel model;
+    QSignalSpy addedSpy( model.fileManager(), SIGNAL(fileAdded(QString)) );
+
+    foreach ( const QString &fileName, m_fileNames ) {
+        model.addGeoDataFile( fileName );
+    }
+    model.removeGeoData( m_fileNames.first() );
+
+    QVERIFY( waitFor( addedSpy, m_fileNames.size() - 1 ) );
+    QTest::qWait( 100 );
+
+    QCOMPARE( addedSpy.count(), m_fileNames.size() - 1 );
+    QCOMPARE( model.treeModel()->rowCount(), m_fileNames.size() - 1 );
+}
+
+void FileManagerTest::slowFileDoesNotHoldBack()
+{
+    QTemporaryFile slowFile( QDir::tempPath() + "/XXXXXX.kml" );
+    QVERIFY( slowFile.open() );
+    {
+        QTextStream stream( &slowFile );
+        stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+               << "<kml xmlns=\"http://www.opengis.net/kml/2.2\"><Document>";
+        for ( int i = 0; i < 200000; ++i ) {
+            stream << "<Placemark><name>" << i << "</name><Point><coordinates>"
+                   << ( i % 360 ) - 180 << "," << ( i % 180 ) - 90
+                   << "</coordinates></Point></Placemark>\n";
+        }
+        stream << "</Document></kml>";
+    }
+    slowFile.close();
+
+    MarbleModel model;
+    QSignalSpy addedSpy( model.fileManager(), SIGNAL(fileAdded(QString)) );
+
+    model.addGeoDataFile( slowFile.fileName() );
+    model.addGeoDataFile( m_fileNames.first() );
+
+    QVERIFY( waitFor( addedSpy, 2 ) );
+
+    // the small file is in the model before the large one is parsed
+    QCOMPARE( addedSpy.at( 0 ).at( 0 ).toString(), m_fileNames.first() );
+    QCOMPARE( addedSpy.at( 1 ).at( 0 ).toString(), slowFile.fileName() );
+}
+
+void FileManagerTest::benchmarkStartup()
+{
+    // from adding the files until all documents are in the tree model
+    QBENCHMARK {
+        MarbleModel model;
+        QSignalSpy addedSpy( model.fileManager(), SIGNAL(fileAdded(QString)) );
+
+        foreach ( const QString &fileName, m_fileNames ) {
+            model.addGeoDataFile( fileName );
+        }
+
+        while ( addedSpy.count() < m_fileNames.size() ) {
+            QCoreApplication::processEvents( QEventLoop::WaitForMoreEvents );
+        }
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::FileManagerTest )
+
+#include "FileManagerTest.moc"
@@ -0,0 +1,265 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest>
+
+#include "GeoDataLatLonAltBox.h"
+#include "GeoDataPlacemark.h"
+#include "GeoGraphicsItem.h"
+#include "GeoGraphicsScene.h"
+
+namespace Marble
+{
+
+class TestItem : public GeoGraphicsItem
+{
+ public:
+    TestItem( const GeoDataFeature *feature, qreal north, qreal south, qreal east, qreal west, qreal zValue = 0.0 )
+        : GeoGraphicsItem( feature )
+    {
+        setLatLonAltBox( GeoDataLatLonAltBox( GeoDataLatLonBox( north, south, east, west, GeoDataCoordinates::Degree ), 0, 0 ) );
+        setZValue( zValue );
+    }
+
+    virtual void paint( GeoPainter *painter, const ViewportParams *viewport )
+    {
+        Q_UNUSED( painter );
+        Q_UNUSED( viewport );
+    }
+};
+
+class GeoGraphicsSceneTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testItemsInBox();
+    void testZOrder();
+    void testDateLine();
+    void testFilters();
+    void testRemoveItem();
+    void testIncrementalInsertion();
+    void benchmarkItems_data();
+    void benchmarkItems();
+
+ private:
+    // adds @p count small random items in a box of 40 by 20 degrees, like a big OSM document
+    static QList<GeoGraphicsItem *> addRandomItems( GeoGraphicsScene *scene, const GeoDataFeature *feature, int count );
+
+    static QList<GeoGraphicsItem *> expectedItems( const QList<GeoGraphicsItem *> &items, const GeoDataLatLonBox &box );
+
+    static GeoDataLatLonBox degrees( qreal north, qreal south, qreal east, qreal west )
+    {
+        return GeoDataLatLonBox( north, south, east, west, GeoDataCoordinates::Degree );
+    }
+};
+
+QList<GeoGraphicsItem *> GeoGraphicsSceneTest::addRandomItems( GeoGraphicsScene *scene, const GeoDataFeature *feature, int count )
+{
+    QList<GeoGraphicsItem *> items;
+    for ( int i = 0; i < count; ++i ) {
+        const qreal west = -10.0 + 40.0 * qrand() / RAND_MAX;
+        const qreal south = 35.0 + 20.0 * qrand() / RAND_MAX;
+        const qreal width = 0.1 * qrand() / RAND_MAX;
+        const qreal height = 0.1 * qrand() / RAND_MAX;
+
+        GeoGraphicsItem *item = new TestItem( feature, south + height, south, west + width, west, qrand() % 4 );
+        scene->addItem( item );
+        items.append( item );
+    }
+
+    return items;
+}
+
+QList<GeoGraphicsItem *> GeoGraphicsSceneTest::expectedItems( const QList<GeoGraphicsItem *> &items, const GeoDataLatLonBox &box )
+{
+    QList<GeoGraphicsItem *> result;
+    for ( qreal z = 0.0; z < 4.0; z += 1.0 ) {
+        foreach ( GeoGraphicsItem *item, items ) {
+            if ( item->zValue() == z && item->latLonAltBox().intersects( box ) ) {
+                result.append( item );
+            }
+        }
+    }
+
+    return result;
+}
+
+void GeoGraphicsSceneTest::testItemsInBox()
+{
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    TestItem berlin( &placemark, 52.7, 52.3, 13.8, 13.0 );
+    TestItem paris( &placemark, 49.0, 48.7, 2.5, 2.1 );
+    TestItem sydney( &placemark, -33.6, -34.1, 151.3, 150.6 );
+    scene.addItem( &berlin );
+    scene.addItem( &paris );
+    scene.addItem( &sydney );
+
+    QCOMPARE( scene.items( degrees( 60.0, 40.0, 20.0, 0.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &berlin << &paris );
+    QCOMPARE( scene.items( degrees( 60.0, 50.0, 20.0, 10.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &berlin );
+    QCOMPARE( scene.items( degrees( 0.0, -60.0, 180.0, 100.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &sydney );
+    QCOMPARE( scene.items( degrees( 10.0, -10.0, 10.0, -10.0 ), 20 ),
+              QList<GeoGraphicsItem *>() );
+
+    scene.clear();
+}
+
+void GeoGraphicsSceneTest::testZOrder()
+{
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    TestItem first( &placemark, 10.0, 0.0, 10.0, 0.0, 2.0 );
+    TestItem second( &placemark, 10.0, 0.0, 10.0, 0.0, 1.0 );
+    TestItem third( &placemark, 10.0, 0.0, 10.0, 0.0, 1.0 );
+    TestItem fourth( &placemark, 10.0, 0.0, 10.0, 0.0, 0.0 );
+    scene.addItem( &first );
+    scene.addItem( &second );
+    scene.addItem( &third );
+    scene.addItem( &fourth );
+
+    QCOMPARE( scene.items( degrees( 5.0, 4.0, 5.0, 4.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &fourth << &second << &third << &first );
+
+    scene.clear();
+}
+
+void GeoGraphicsSceneTest::testDateLine()
+{
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    TestItem fiji( &placemark, -15.0, -20.0, -178.0, 177.0 );
+    TestItem samoa( &placemark, -13.0, -14.5, -171.0, -173.0 );
+    scene.addItem( &fiji );
+    scene.addItem( &samoa );
+
+    // the item crossing the date line is returned once
+    QCOMPARE( scene.items( degrees( 0.0, -30.0, -170.0, 170.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &fiji << &samoa );
+    QCOMPARE( scene.items( degrees( 0.0, -30.0, 180.0, 170.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &fiji );
+    QCOMPARE( scene.items( degrees( 0.0, -30.0, -175.0, -180.0 ), 20 ),
+              QList<GeoGraphicsItem *>() << &fiji );
+
+    scene.clear();
+}
+
+void GeoGraphicsSceneTest::testFilters()
+{
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    TestItem visible( &placemark, 10.0, 0.0, 10.0, 0.0 );
+    TestItem hidden( &placemark, 10.0, 0.0, 10.0, 0.0 );
+    hidden.setVisible( false );
+    TestItem detail( &placemark, 10.0, 0.0, 10.0, 0.0 );
+    detail.setMinZoomLevel( 15 );
+    scene.addItem( &visible );
+    scene.addItem( &hidden );
+    scene.addItem( &detail );
+
+    QCOMPARE( scene.items( degrees( 20.0, -20.0, 20.0, -20.0 ), 14 ),
+              QList<GeoGraphicsItem *>() << &visible );
+    QCOMPARE( scene.items( degrees( 20.0, -20.0, 20.0, -20.0 ), 15 ),
+              QList<GeoGraphicsItem *>() << &visible << &detail );
+
+    scene.clear();
+}
+
+void GeoGraphicsSceneTest::testRemoveItem()
+{
+    GeoDataPlacemark placemark;
+    GeoDataPlacemark multiGeometry;
+    GeoGraphicsScene scene;
+
+    qsrand( 1 );
+    const QList<GeoGraphicsItem *> items = addRandomItems( &scene, &placemark, 200 );
+
+    TestItem part1( &multiGeometry, 40.0, 39.0, 1.0, 0.0 );
+    TestItem part2( &multiGeometry, -15.0, -20.0, -178.0, 177.0 );
+    scene.addItem( &part1 );
+    scene.addItem( &part2 );
+
+    const GeoDataLatLonBox world = degrees( 90.0, -90.0, 180.0, -180.0 );
+    QCOMPARE( scene.items( world, 20 ).size(), 202 );
+
+    // all items of the feature are removed, but not deleted
+    scene.removeItem( &multiGeometry );
+    QCOMPARE( scene.items( world, 20 ), expectedItems( items, world ) );
+
+    // removing items before the first query
+    TestItem part3( &multiGeometry, 40.0, 39.0, 1.0, 0.0 );
+    scene.addItem( &part3 );
+    scene.removeItem( &multiGeometry );
+    QCOMPARE( scene.items( world, 20 ), expectedItems( items, world ) );
+
+    scene.eraseAll();
+    QCOMPARE( scene.items( world, 20 ), QList<GeoGraphicsItem *>() );
+}
+
+void GeoGraphicsSceneTest::testIncrementalInsertion()
+{
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    qsrand( 2 );
+
+    // loaded in bulk
+    QList<GeoGraphicsItem *> items = addRandomItems( &scene, &placemark, 1000 );
+    const GeoDataLatLonBox box = degrees( 50.0, 45.0, 10.0, 5.0 );
+    QCOMPARE( scene.items( box, 20 ), expectedItems( items, box ) );
+
+    // inserted into the existing index
+    for ( int i = 0; i < 10; ++i ) {
+        items << addRandomItems( &scene, &placemark, 20 );
+        QCOMPARE( scene.items( box, 20 ), expectedItems( items, box ) );
+    }
+
+    scene.eraseAll();
+}
+
+void GeoGraphicsSceneTest::benchmarkItems_data()
+{
+    QTest::addColumn<int>( "count" );
+
+    QTest::newRow( "10000" ) << 10000;
+    QTest::newRow( "100000" ) << 100000;
+}
+
+void GeoGraphicsSceneTest::benchmarkItems()
+{
+    QFETCH( int, count );
+
+    GeoDataPlacemark placemark;
+    GeoGraphicsScene scene;
+
+    qsrand( 3 );
+    addRandomItems( &scene, &placemark, count );
+
+    // a city viewport
+    const GeoDataLatLonBox box = degrees( 48.5, 48.0, 12.0, 11.0 );
+    scene.items( box, 20 );
+
+    QBENCHMARK {
+        scene.items( box, 20 );
+    }
+
+    scene.eraseAll();
+}
+
+}
+
+QTEST_MAIN( Marble::GeoGraphicsSceneTest )
+
+#include "GeoGraphicsSceneTest.moc"
@@ -0,0 +1,318 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QEventLoop>
+#include <QHash>
+#include <QSignalSpy>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QtTest>
+
+#include "DownloadPolicy.h"
+#include "HttpDownloadManager.h"
+
+namespace Marble
+{
+
+/**
+ * A local stand-in for a tile server. It records the order and the hosts of
+ * the requests and can hold back its responses until it is released.
+ */
+class TestHttpServer : public QObject
+{
+    Q_OBJECT
+
+ public:
+    explicit TestHttpServer( QObject *parent = 0 )
+        : QObject( parent ),
+          m_holding( false ),
+          m_maximumPendingPerHost( 0 )
+    {
+        connect( &m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()) );
+    }
+
+    bool listen() { return m_server.listen( QHostAddress::LocalHost ); }
+
+    QUrl url( const QString &host, const QString &path ) const
+    {
+        return QUrl( QString( "http://%1:%2%3" ).arg( host ).arg( m_server.serverPort() ).arg( path ) );
+    }
+
+    void setHolding( bool holding )
+    {
+        m_holding = holding;
+        if ( !holding ) {
+            while ( !m_pending.isEmpty() ) {
+                const Request request = m_pending.takeFirst();
+                respond( request );
+            }
+        }
+    }
+
+    QStringList requestedPaths() const { return m_requestedPaths; }
+
+    int pendingCount() const { return m_pending.count(); }
+
+    /**
+     * Returns the maximum number of requests to a single host which were
+     * held back at the same time.
+     */
+    int maximumPendingPerHost() const { return m_maximumPendingPerHost; }
+
+ Q_SIGNALS:
+    void requestReceived();
+
+ private Q_SLOTS:
+    void acceptConnection()
+    {
+        while ( m_server.hasPendingConnections() ) {
+            QTcpSocket *socket = m_server.nextPendingConnection();
+            connect( socket, SIGNAL(readyRead()), this, SLOT(readRequests()) );
+            connect( socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()) );
+        }
+    }
+
+    void readRequests()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket *>( sender() );
+        QByteArray &buffer = m_buffers[ socket ];
+        buffer += socket->readAll();
+
+        // requests may be pipelined
+        int end;
+        while ( ( end = buffer.indexOf( "\r\n\r\n" ) ) >= 0 ) {
+            const QList<QByteArray> lines = buffer.left( end ).split( '\n' );
+            buffer.remove( 0, end + 4 );
+
+            Request request;
+            request.socket = socket;
+            request.path = QString::fromLatin1( lines.first().split( ' ' ).value( 1 ) );
+            foreach ( const QByteArray &line, lines ) {
+                if ( line.toLower().startsWith( "host:" ) ) {
+                    request.host = QString::fromLatin1( line.mid( 5 ).trimmed() ).section( ':', 0, 0 );
+                }
+            }
+
+            m_requestedPaths.append( request.path );
+
+            if ( m_holding ) {
+                m_pending.append( request );
+
+                int pendingPerHost = 0;
+                foreach ( const Request &pending, m_pending ) {
+                    if ( pending.host == request.host ) {
+                        ++pendingPerHost;
+                    }
+                }
+                m_maximumPendingPerHost = qMax( m_maximumPendingPerHost, pendingPerHost );
+            }
+            else {
+                respond( request );
+            }
+
+            emit requestReceived();
+        }
+    }
+
+ private:
+    struct Request
+    {
+        QTcpSocket *socket;
+        QString path;
+        QString host;
+    };
+
+    static void respond( const Request &request )
+    {
+        const QByteArray body = request.path.toLatin1();
+        request.socket->write( "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/plain\r\n"
+                               "Content-Length: " + QByteArray::number( body.size() ) + "\r\n"
+                               "\r\n" + body );
+    }
+
+    QTcpServer m_server;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QList<Request> m_pending;
+    QStringList m_requestedPaths;
+    bool m_holding;
+    int m_maximumPendingPerHost;
+};
+
+/**
+ * Assigns fixed priorities to the job ids and cancels the jobs it doesn't know.
+ */
+class TestPrioritizer : public DownloadPrioritizer
+{
+ public:
+    virtual bool priority( const QString &initiatorId, int &priority ) const
+    {
+        if ( !m_priorities.contains( initiatorId ) )
+            return false;
+
+        priority = m_priorities.value( initiatorId );
+        return true;
+    }
+
+    QHash<QString, int> m_priorities;
+};
+
+class HttpDownloadManagerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testPriorityOrder();
+    void testCancelQueuedJobs();
+    void testMaximumConnectionsPerHost();
+
+ private:
+    static void waitFor( QObject *sender, const char *signal, const QSignalSpy &spy, int count );
+};
+
+void HttpDownloadManagerTest::waitFor( QObject *sender, const char *signal, const QSignalSpy &spy, int count )
+{
+    QEventLoop loop;
+    connect( sender, signal, &loop, SLOT(quit()) );
+    QTimer watchdog;
+    watchdog.setSingleShot( true );
+    connect( &watchdog, SIGNAL(timeout()), &loop, SLOT(quit()) );
+    watchdog.start( 5000 );
+
+    while ( spy.count() < count && watchdog.isActive() ) {
+        loop.exec();
+    }
+}
+
+void HttpDownloadManagerTest::testPriorityOrder()
+{
+    TestHttpServer server;
+    QVERIFY( server.listen() );
+    server.setHolding( true );
+
+    DownloadPolicy policy( DownloadPolicyKey( "127.0.0.1", DownloadBrowse ) );
+    policy.setMaximumConnections( 1 );
+
+    HttpDownloadManager manager( 0 );
+    manager.addDownloadPolicy( policy );
+    QSignalSpy completed( &manager, SIGNAL(downloadComplete(QByteArray,QString)) );
+    QSignalSpy requested( &server, SIGNAL(requestReceived()) );
+
+    // the first job blocks the only connection, the others are queued
+    manager.addJob( server.url( "127.0.0.1", "/a" ), "a", "a", DownloadBrowse );
+    waitFor( &server, SIGNAL(requestReceived()), requested, 1 );
+    QCOMPARE( server.requestedPaths(), QStringList() << "/a" );
+
+    manager.addJob( server.url( "127.0.0.1", "/b" ), "b", "b", DownloadBrowse );
+    manager.addJob( server.url( "127.0.0.1", "/c" ), "c", "c", DownloadBrowse );
+    manager.addJob( server.url( "127.0.0.1", "/d" ), "d", "d", DownloadBrowse );
+
+    TestPrioritizer prioritizer;
+    prioritizer.m_priorities["b"] = 2;
+    prioritizer.m_priorities["c"] = 3;
+    prioritizer.m_priorities["d"] = 1;
+    manager.updateJobPriorities( prioritizer, DownloadBrowse );
+
+    // jobs of equal priority are started in reverse order of their arrival
+    manager.addJob( server.url( "127.0.0.1", "/e" ), "e", "e", DownloadBrowse );
+    manager.addJob( server.url( "127.0.0.1", "/f" ), "f", "f", DownloadBrowse );
+
+    server.setHolding( false );
+    waitFor( &manager, SIGNAL(downloadComplete(QByteArray,QString)), completed, 6 );
+
+    QCOMPARE( completed.count(), 6 );
+    QCOMPARE( server.requestedPaths(), QStringList() << "/a" << "/f" << "/e" << "/d" << "/b" << "/c" );
+}
+
+void HttpDownloadManagerTest::testCancelQueuedJobs()
+{
+    TestHttpServer server;
+    QVERIFY( server.listen() );
+    server.setHolding( true );
+
+    DownloadPolicy policy( DownloadPolicyKey( "127.0.0.1", DownloadBrowse ) );
+    policy.setMaximumConnections( 1 );
+
+    HttpDownloadManager manager( 0 );
+    manager.addDownloadPolicy( policy );
+    QSignalSpy completed( &manager, SIGNAL(downloadComplete(QByteArray,QString)) );
+    QSignalSpy removed( &manager, SIGNAL(jobRemoved()) );
+    QSignalSpy requested( &server, SIGNAL(requestReceived()) );
+
+    manager.addJob( server.url( "127.0.0.1", "/a" ), "a", "a", DownloadBrowse );
+    waitFor( &server, SIGNAL(requestReceived()), requested, 1 );
+
+    manager.addJob( server.url( "127.0.0.1", "/b" ), "b", "b", DownloadBrowse );
+    manager.addJob( server.url( "127.0.0.1", "/c" ), "c", "c", DownloadBrowse );
+    manager.addJob( server.url( "127.0.0.1", "/d" ), "d", "d", DownloadBrowse );
+
+    // the running job is kept although the prioritizer doesn't know it
+    TestPrioritizer prioritizer;
+    prioritizer.m_priorities["c"] = 0;
+    manager.updateJobPriorities( prioritizer, DownloadBrowse );
+    QCOMPARE( removed.count(), 2 );
+
+    // bulk downloads are not affected
+    manager.updateJobPriorities( TestPrioritizer(), DownloadBulk );
+    QCOMPARE( removed.count(), 2 );
+
+    server.setHolding( false );
+    waitFor( &manager, SIGNAL(downloadComplete(QByteArray,QString)), completed, 2 );
+    QTest::qWait( 100 );
+
+    QCOMPARE( completed.count(), 2 );
+    QCOMPARE( server.requestedPaths(), QStringList() << "/a" << "/c" );
+
+    // cancelled jobs can be added again
+    manager.addJob( server.url( "127.0.0.1", "/b" ), "b", "b", DownloadBrowse );
+    waitFor( &manager, SIGNAL(downloadComplete(QByteArray,QString)), completed, 3 );
+    QCOMPARE( server.requestedPaths(), QStringList() << "/a" << "/c" << "/b" );
+}
+
+void HttpDownloadManagerTest::testMaximumConnectionsPerHost()
+{
+    TestHttpServer server;
+    QVERIFY( server.listen() );
+    server.setHolding( true );
+
+    DownloadPolicy policy( DownloadPolicyKey( QStringList() << "127.0.0.1" << "localhost", DownloadBrowse ) );
+    policy.setMaximumConnections( 4 );
+    policy.setMaximumConnectionsPerHost( 1 );
+
+    HttpDownloadManager manager( 0 );
+    manager.addDownloadPolicy( policy );
+    QSignalSpy completed( &manager, SIGNAL(downloadComplete(QByteArray,QString)) );
+    QSignalSpy requested( &server, SIGNAL(requestReceived()) );
+
+    for ( int i = 0; i < 3; ++i ) {
+        manager.addJob( server.url( "127.0.0.1", QString( "/ip%1" ).arg( i ) ),
+                        QString( "ip%1" ).arg( i ), QString( "ip%1" ).arg( i ), DownloadBrowse );
+        manager.addJob( server.url( "localhost", QString( "/name%1" ).arg( i ) ),
+                        QString( "name%1" ).arg( i ), QString( "name%1" ).arg( i ), DownloadBrowse );
+    }
+
+    // one job per host is running although the policy allows four connections
+    waitFor( &server, SIGNAL(requestReceived()), requested, 2 );
+    QTest::qWait( 100 );
+    QCOMPARE( server.pendingCount(), 2 );
+
+    server.setHolding( false );
+    waitFor( &manager, SIGNAL(downloadComplete(QByteArray,QString)), completed, 6 );
+
+    QCOMPARE( completed.count(), 6 );
+    QCOMPARE( server.maximumPendingPerHost(), 1 );
+}
+
+}
+
+QTEST_MAIN( Marble::HttpDownloadManagerTest )
+
+#include "HttpDownloadManagerTest.moc"
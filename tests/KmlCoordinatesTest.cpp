@@ -0,0 +1,223 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QBuffer>
+#include <QFile>
+#include <QtTest>
+
+#include "TestUtils.h"
+#include "GeoDataLineString.h"
+#include "GeoDataMultiGeometry.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPoint.h"
+#include "GeoDataTrack.h"
+
+namespace Marble
+{
+
+class KmlCoordinatesTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testLineString_data();
+    void testLineString();
+    void testPoint();
+    void testMultiGeometry();
+    void testTrack();
+
+    void benchmarkDataFiles_data();
+    void benchmarkDataFiles();
+    void benchmarkLongLineString();
+
+ private:
+    static GeoDataLineString *lineString( GeoDataDocument *document );
+    static QString lineStringKml( const QString &coordinates );
+};
+
+GeoDataLineString *KmlCoordinatesTest::lineString( GeoDataDocument *document )
+{
+    if ( document->size() != 1 ) {
+        return 0;
+    }
+
+    GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark *>( document->child( 0 ) );
+    return placemark ? dynamic_cast<GeoDataLineString *>( placemark->geometry() ) : 0;
+}
+
+QString KmlCoordinatesTest::lineStringKml( const QString &coordinates )
+{
+    return QString( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                    "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+                    "<Document><Placemark><LineString>"
+                    "<coordinates>%1</coordinates>"
+                    "</LineString></Placemark></Document>"
+                    "</kml>" ).arg( coordinates );
+}
+
+void KmlCoordinatesTest::testLineString_data()
+{
+    QTest::addColumn<QString>( "coordinates" );
+    QTest::addColumn<GeoDataLineString>( "expected" );
+
+    GeoDataLineString twoNodes;
+    twoNodes << GeoDataCoordinates( 1.5, -2.25, 0.0, GeoDataCoordinates::Degree )
+             << GeoDataCoordinates( 3.0, 4.0, 100.0, GeoDataCoordinates::Degree );
+
+    addNamedRow( "strict" ) << QString( "1.5,-2.25 3,4,100" ) << twoNodes;
+    addNamedRow( "surrounding spaces" ) << QString( "\n\t 1.5,-2.25 3,4,100 \n" ) << twoNodes;
+    addNamedRow( "spaces around commas" ) << QString( "1.5 , -2.25\n3 ,4,  100" ) << twoNodes;
+    addNamedRow( "line breaks between tuples" ) << QString( "1.5,-2.25\r\n\r\n3,4,100" ) << twoNodes;
+    addNamedRow( "exponents and signs" ) << QString( "+15e-1,-225E-2 0.3e1,4.,1e2" ) << twoNodes;
+
+    GeoDataLineString precise;
+    precise << GeoDataCoordinates( 13.404954000000001, 52.520007000000003, 0.0, GeoDataCoordinates::Degree );
+    addNamedRow( "more digits than a double" ) << QString( "13.404954000000001,52.520007000000003" ) << precise;
+
+    GeoDataLineString malformed;
+    malformed << GeoDataCoordinates( 1.0, 2.0, 0.0, GeoDataCoordinates::Degree )
+              << GeoDataCoordinates()
+              << GeoDataCoordinates()
+              << GeoDataCoordinates( 3.0, 4.0, 0.0, GeoDataCoordinates::Degree );
+    addNamedRow( "malformed tuples" ) << QString( "1,2 1,x,3 1,2,3,4 3,4" ) << malformed;
+
+    addNamedRow( "empty" ) << QString( " \n " ) << GeoDataLineString();
+}
+
+void KmlCoordinatesTest::testLineString()
+{
+    QFETCH( QString, coordinates );
+    QFETCH( GeoDataLineString, expected );
+
+    GeoDataDocument *document = parseKml( lineStringKml( coordinates ) );
+    const GeoDataLineString *actual = lineString( document );
+    QVERIFY( actual != 0 );
+
+    QCOMPARE( actual->size(), expected.size() );
+    for ( int i = 0; i < expected.size(); ++i ) {
+        QCOMPARE( actual->at( i ), expected.at( i ) );
+    }
+
+    delete document;
+}
+
+void KmlCoordinatesTest::testPoint()
+{
+    GeoDataDocument *document = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+        "<Document><Placemark><Point>"
+        "<coordinates> 7.5, 45.25, 800 </coordinates>"
+        "</Point></Placemark></Document>"
+        "</kml>" );
+
+    QCOMPARE( document->size(), 1 );
+    GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark *>( document->child( 0 ) );
+    QVERIFY( placemark != 0 );
+    QCOMPARE( placemark->coordinate(), GeoDataCoordinates( 7.5, 45.25, 800.0, GeoDataCoordinates::Degree ) );
+
+    delete document;
+}
+
+void KmlCoordinatesTest::testMultiGeometry()
+{
+    GeoDataDocument *document = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">"
+        "<Document><Placemark><MultiGeometry>"
+        "<coordinates>1,2 3,4</coordinates>"
+        "</MultiGeometry></Placemark></Document>"
+        "</kml>" );
+
+    QCOMPARE( document->size(), 1 );
+    GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark *>( document->child( 0 ) );
+    QVERIFY( placemark != 0 );
+    GeoDataMultiGeometry *multiGeometry = dynamic_cast<GeoDataMultiGeometry *>( placemark->geometry() );
+    QVERIFY( multiGeometry != 0 );
+    QCOMPARE( multiGeometry->size(), 2 );
+
+    GeoDataPoint *point = dynamic_cast<GeoDataPoint *>( multiGeometry->child( 1 ) );
+    QVERIFY( point != 0 );
+    QCOMPARE( point->coordinates(), GeoDataCoordinates( 3.0, 4.0, 0.0, GeoDataCoordinates::Degree ) );
+
+    delete document;
+}
+
+void KmlCoordinatesTest::testTrack()
+{
+    GeoDataDocument *document = parseKml(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\" xmlns:gx=\"http://www.google.com/kml/ext/2.2\">"
+        "<Document><Placemark><gx:Track>"
+        "<gx:coord>-122.207881 37.371915 156</gx:coord>"
+        "<gx:coord> -122.205712  37.373288 152 </gx:coord>"
+        "</gx:Track></Placemark></Document>"
+        "</kml>" );
+
+    QCOMPARE( document->size(), 1 );
+    GeoDataPlacemark *placemark = dynamic_cast<GeoDataPlacemark *>( document->child( 0 ) );
+    QVERIFY( placemark != 0 );
+    GeoDataTrack *track = dynamic_cast<GeoDataTrack *>( placemark->geometry() );
+    QVERIFY( track != 0 );
+    QCOMPARE( track->size(), 2 );
+    QCOMPARE( track->coordinatesList().at( 1 ), GeoDataCoordinates( -122.205712, 37.373288, 152.0, GeoDataCoordinates::Degree ) );
+
+    delete document;
+}
+
+void KmlCoordinatesTest::benchmarkDataFiles_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+
+    addNamedRow( "boundaries" ) << QString( MARBLE_SRC_DIR ).append( "/data/placemarks/boundaryplacemarks.kml" );
+    addNamedRow( "moon terrain" ) << QString( MARBLE_SRC_DIR ).append( "/data/placemarks/moonterrain.kml" );
+    addNamedRow( "other placemarks" ) << QString( MARBLE_SRC_DIR ).append( "/data/placemarks/otherplacemarks.kml" );
+}
+
+void KmlCoordinatesTest::benchmarkDataFiles()
+{
+    QFETCH( QString, fileName );
+
+    QFile file( fileName );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+    QByteArray content = file.readAll();
+
+    QBENCHMARK {
+        GeoDataParser parser( GeoData_KML );
+        QBuffer buffer( &content );
+        buffer.open( QIODevice::ReadOnly );
+        QVERIFY( parser.read( &buffer ) );
+        delete parser.releaseDocument();
+    }
+}
+
+void KmlCoordinatesTest::benchmarkLongLineString()
+{
+    // like a detailed country boundary
+    QString coordinates;
+    for ( int i = 0; i < 100000; ++i ) {
+        coordinates += QString( "%1, %2,0\n" ).arg( 0.0001 * i, 0, 'f', 7 ).arg( 45.0 + 0.00001 * ( i % 97 ), 0, 'f', 7 );
+    }
+    QByteArray content = lineStringKml( coordinates ).toUtf8();
+
+    QBENCHMARK {
+        GeoDataParser parser( GeoData_KML );
+        QBuffer buffer( &content );
+        buffer.open( QIODevice::ReadOnly );
+        QVERIFY( parser.read( &buffer ) );
+        GeoDataDocument *document = static_cast<GeoDataDocument *>( parser.releaseDocument() );
+        QCOMPARE( lineString( document )->size(), 100000 );
+        delete document;
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::KmlCoordinatesTest )
+
+#include "KmlCoordinatesTest.moc"
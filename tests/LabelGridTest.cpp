@@ -0,0 +1,82 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest>
+
+#include "LabelGrid.h"
+
+namespace Marble
+{
+
+class LabelGridTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testIntersects();
+    void testSpanningCells();
+    void testOutsideScreen();
+    void testReset();
+};
+
+void LabelGridTest::testIntersects()
+{
+    LabelGrid grid;
+    grid.reset( QSize( 200, 100 ), 32 );
+
+    QVERIFY( !grid.intersects( QRectF( 10, 10, 50, 15 ) ) );
+    grid.insert( QRectF( 10, 10, 50, 15 ) );
+
+    QVERIFY( grid.intersects( QRectF( 40, 20, 50, 15 ) ) );
+    QVERIFY( !grid.intersects( QRectF( 40, 26, 50, 15 ) ) );
+    QVERIFY( !grid.intersects( QRectF( 61, 10, 50, 15 ) ) );
+}
+
+void LabelGridTest::testSpanningCells()
+{
+    LabelGrid grid;
+    grid.reset( QSize( 200, 100 ), 32 );
+
+    // a long label spanning many cells collides with a small one in its last cell
+    grid.insert( QRectF( 5, 40, 180, 15 ) );
+    QVERIFY( grid.intersects( QRectF( 170, 50, 10, 10 ) ) );
+    QVERIFY( !grid.intersects( QRectF( 190, 50, 10, 10 ) ) );
+}
+
+void LabelGridTest::testOutsideScreen()
+{
+    LabelGrid grid;
+    grid.reset( QSize( 200, 100 ), 32 );
+
+    grid.insert( QRectF( -40, -10, 50, 15 ) );
+    QVERIFY( grid.intersects( QRectF( 0, 0, 5, 5 ) ) );
+    QVERIFY( grid.intersects( QRectF( -30, -8, 5, 5 ) ) );
+    QVERIFY( !grid.intersects( QRectF( 20, 0, 5, 5 ) ) );
+
+    grid.insert( QRectF( 190, 95, 50, 15 ) );
+    QVERIFY( grid.intersects( QRectF( 230, 105, 5, 5 ) ) );
+}
+
+void LabelGridTest::testReset()
+{
+    LabelGrid grid;
+    grid.reset( QSize( 200, 100 ), 32 );
+    grid.insert( QRectF( 10, 10, 50, 15 ) );
+
+    grid.reset( QSize( 400, 300 ), 32 );
+    QVERIFY( !grid.intersects( QRectF( 10, 10, 50, 15 ) ) );
+
+    grid.insert( QRectF( 350, 250, 20, 20 ) );
+    QVERIFY( grid.intersects( QRectF( 360, 260, 20, 20 ) ) );
+}
+
+}
+
+QTEST_MAIN( Marble::LabelGridTest )
+
+#include "LabelGridTest.moc"
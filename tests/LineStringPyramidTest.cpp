@@ -0,0 +1,160 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QThreadPool>
+#include <QtTest>
+
+#include "GeoDataLinearRing.h"
+#include "LineStringPyramid.h"
+
+namespace Marble
+{
+
+class LineStringPyramidTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testLevel();
+    void testShortLineString();
+    void testSimplification();
+    void testRing();
+    void testChangedNode();
+    void testChangedNodeCount();
+
+ private:
+    // a zigzag of @p count nodes along the equator
+    static void appendZigzag( GeoDataLineString *lineString, int count, qreal amplitude );
+};
+
+void LineStringPyramidTest::appendZigzag( GeoDataLineString *lineString, int count, qreal amplitude )
+{
+    for ( int i = 0; i < count; ++i ) {
+        const qreal lat = i % 2 == 0 ? amplitude : -amplitude;
+        lineString->append( GeoDataCoordinates( 0.5 * i / count, lat, 0.0, GeoDataCoordinates::Radian ) );
+    }
+}
+
+void LineStringPyramidTest::testLevel()
+{
+    QCOMPARE( LineStringPyramid::level( 1.0 ), 0 );
+    QCOMPARE( LineStringPyramid::level( 1.5 ), 0 );
+    QCOMPARE( LineStringPyramid::level( 0.5 ), -1 );
+    QCOMPARE( LineStringPyramid::level( 0.3 ), -2 );
+    QCOMPARE( LineStringPyramid::level( 4.0 ), 2 );
+}
+
+void LineStringPyramidTest::testShortLineString()
+{
+    GeoDataLineString lineString;
+    appendZigzag( &lineString, 10, 0.01 );
+
+    LineStringPyramid pyramid( &lineString );
+    QVERIFY( pyramid.lineString( 0.1 ) == &lineString );
+    QThreadPool::globalInstance()->waitForDone();
+    QVERIFY( pyramid.lineString( 0.1 ) == &lineString );
+}
+
+void LineStringPyramidTest::testSimplification()
+{
+    GeoDataLineString lineString( Tessellate | RespectLatitudeCircle );
+    appendZigzag( &lineString, 200, 1e-5 );
+
+    LineStringPyramid pyramid( &lineString );
+
+    // the original is painted while the tolerances are computed
+    QVERIFY( pyramid.lineString( 1e-3 ) == &lineString );
+    QThreadPool::globalInstance()->waitForDone();
+
+    // the zigzag is far below a pixel, only the ends are left
+    const GeoDataLineString *coarse = pyramid.lineString( 1e-3 );
+    QVERIFY( coarse != &lineString );
+    QVERIFY( !coarse->isClosed() );
+    QCOMPARE( coarse->size(), 2 );
+    QVERIFY( coarse->tessellationFlags() == lineString.tessellationFlags() );
+    QCOMPARE( coarse->first(), lineString.first() );
+    QCOMPARE( coarse->last(), lineString.last() );
+
+    // levels are created once
+    QVERIFY( pyramid.lineString( 1.5e-3 ) == coarse );
+
+    // the zigzag is visible, simplifying wouldn't save enough
+    QVERIFY( pyramid.lineString( 1e-7 ) == &lineString );
+}
+
+void LineStringPyramidTest::testRing()
+{
+    GeoDataLinearRing ring;
+    appendZigzag( &ring, 200, 1e-5 );
+    ring.append( GeoDataCoordinates( 0.25, 0.1, 0.0, GeoDataCoordinates::Radian ) );
+
+    LineStringPyramid pyramid( &ring );
+    pyramid.lineString( 1e-3 );
+    QThreadPool::globalInstance()->waitForDone();
+
+    const GeoDataLineString *coarse = pyramid.lineString( 1e-3 );
+    QVERIFY( coarse != &ring );
+    QVERIFY( coarse->isClosed() );
+    QCOMPARE( coarse->size(), 3 );
+}
+
+}
+
+void LineStringPyramidTest::testChangedNode()
+{
+    GeoDataLineString lineString;
+    appendZigzag( &lineString, 200, 1e-5 );
+
+    LineStringPyramid pyramid( &lineString );
+    pyramid.lineString( 1e-3 );
+    QThreadPool::globalInstance()->waitForDone();
+    QCOMPARE( pyramid.lineString( 1e-3 )->size(), 2 );
+
+    // a spike in the middle keeps the number of nodes
+    lineString[100] = GeoDataCoordinates( 0.25, 0.1, 0.0, GeoDataCoordinates::Radian );
+
+    QVERIFY( pyramid.lineString( 1e-3 ) == &lineString );
+    QThreadPool::globalInstance()->waitForDone();
+
+    const GeoDataLineString *coarse = pyramid.lineString( 1e-3 );
+    QVERIFY( coarse != &lineString );
+    QCOMPARE( coarse->size(), 3 );
+    QCOMPARE( coarse->at( 1 ), lineString.at( 100 ) );
+}
+
+void LineStringPyramidTest::testChangedNodeCount()
+{
+    GeoDataLineString lineString;
+    appendZigzag( &lineString, 200, 1e-5 );
+
+    LineStringPyramid pyramid( &lineString );
+    pyramid.lineString( 1e-3 );
+    QThreadPool::globalInstance()->waitForDone();
+    QCOMPARE( pyramid.lineString( 1e-3 )->size(), 2 );
+
+    lineString.append( GeoDataCoordinates( 0.5, 0.1, 0.0, GeoDataCoordinates::Radian ) );
+
+    // the simplification of the longer line string is used once it is ready
+    QVERIFY( pyramid.lineString( 1e-3 ) == &lineString );
+    QThreadPool::globalInstance()->waitForDone();
+
+    const GeoDataLineString *coarse = pyramid.lineString( 1e-3 );
+    QVERIFY( coarse != &lineString );
+    QCOMPARE( coarse->last(), lineString.last() );
+
+    // too short to be simplified
+    lineString.clear();
+    appendZigzag( &lineString, 10, 1e-5 );
+    QVERIFY( pyramid.lineString( 1e-3 ) == &lineString );
+}
+
+}
+
+QTEST_MAIN( Marble::LineStringPyramidTest )
+
+#include "LineStringPyramidTest.moc"
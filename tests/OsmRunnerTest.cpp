@@ -0,0 +1,169 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QDir>
+#include <QRunnable>
+#include <QTemporaryFile>
+#include <QThreadPool>
+#include <QtTest>
+
+#include "GeoDataDocument.h"
+#include "GeoDataLineString.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataTypes.h"
+#include "MarbleDirs.h"
+#include "ParseRunnerPlugin.h"
+#include "ParsingRunner.h"
+#include "PluginManager.h"
+
+namespace Marble
+{
+
+class OsmRunnerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+
+    void testVisualCategoriesInThreads();
+    void testWayAfterRelation();
+
+    void documentParsed( GeoDataDocument *document, const QString &error );
+
+ private:
+    GeoDataDocument *parse( const QByteArray &content );
+
+    PluginManager m_pluginManager;
+    GeoDataDocument *m_document;
+    QString m_error;
+};
+
+/**
+ * Looks up visual categories like the tag handler of an OSM import does.
+ */
+class VisualCategoryJob : public QRunnable
+{
+ public:
+    VisualCategoryJob()
+    {
+        setAutoDelete( false );
+    }
+
+    virtual void run()
+    {
+        for ( int i = 0; i < 1000; ++i ) {
+            m_categories << GeoDataFeature::OsmVisualCategory( "amenity=restaurant" )
+                         << GeoDataFeature::OsmVisualCategory( "highway=residential" )
+                         << GeoDataFeature::OsmVisualCategory( "building=yes" );
+        }
+    }
+
+    QList<GeoDataFeature::GeoDataVisualCategory> m_categories;
+};
+
+void OsmRunnerTest::initTestCase()
+{
+    MarbleDirs::setMarbleDataPath( DATA_PATH );
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+}
+
+void OsmRunnerTest::documentParsed( GeoDataDocument *document, const QString &error )
+{
+    m_document = document;
+    m_error = error;
+}
+
+GeoDataDocument *OsmRunnerTest::parse( const QByteArray &content )
+{
+    QTemporaryFile file( QDir::tempPath() + "/OsmRunnerTest-XXXXXX.osm" );
+    if ( !file.open() || file.write( content ) != content.size() ) {
+        return 0;
+    }
+    file.close();
+
+    const QList<const ParseRunnerPlugin *> plugins = m_pluginManager.parsingRunnerPlugins( file.fileName() );
+    if ( plugins.isEmpty() ) {
+        return 0;
+    }
+
+    m_document = 0;
+    m_error.clear();
+
+    ParsingRunner *runner = plugins.first()->newRunner();
+    connect( runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
+             this, SLOT(documentParsed(GeoDataDocument*,QString)), Qt::DirectConnection );
+    runner->parseFile( file.fileName(), UserDocument );
+    delete runner;
+
+    return m_document;
+}
+
+void OsmRunnerTest::testVisualCategoriesInThreads()
+{
+    // this must be the first lookup of the process, so the threads fill the categories
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount( 8 );
+    QList<VisualCategoryJob *> jobs;
+    for ( int i = 0; i < 8; ++i ) {
+        jobs << new VisualCategoryJob;
+        threadPool.start( jobs.last() );
+    }
+    threadPool.waitForDone();
+
+    foreach ( const VisualCategoryJob *job, jobs ) {
+        QCOMPARE( job->m_categories.size(), 3000 );
+        for ( int i = 0; i < job->m_categories.size(); i += 3 ) {
+            QCOMPARE( job->m_categories[i], GeoDataFeature::FoodRestaurant );
+            QCOMPARE( job->m_categories[i+1], GeoDataFeature::HighwayRoad );
+            QCOMPARE( job->m_categories[i+2], GeoDataFeature::Building );
+        }
+    }
+
+    qDeleteAll( jobs );
+}
+
+void OsmRunnerTest::testWayAfterRelation()
+{
+    // merged files don't keep the order of nodes, ways and relations
+    GeoDataDocument *document = parse(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<osm version=\"0.6\">"
+        "<node id=\"1\" lat=\"48.0\" lon=\"8.0\"/>"
+        "<node id=\"2\" lat=\"48.1\" lon=\"8.1\"/>"
+        "<node id=\"3\" lat=\"48.2\" lon=\"8.0\"/>"
+        "<relation id=\"20\"><tag k=\"type\" v=\"multipolygon\"/></relation>"
+        "<way id=\"10\">"
+        "<nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/>"
+        "<tag k=\"highway\" v=\"residential\"/>"
+        "</way>"
+        "</osm>" );
+    QVERIFY( document != 0 );
+    QVERIFY( m_error.isEmpty() );
+
+    const GeoDataLineString *way = 0;
+    foreach ( const GeoDataPlacemark *placemark, document->placemarkList() ) {
+        if ( placemark->geometry()->nodeType() == GeoDataTypes::GeoDataLineStringType ) {
+            way = static_cast<const GeoDataLineString *>( placemark->geometry() );
+            QCOMPARE( placemark->visualCategory(), GeoDataFeature::HighwayRoad );
+        }
+    }
+
+    QVERIFY( way != 0 );
+    QCOMPARE( way->size(), 3 );
+    QCOMPARE( way->at( 2 ).longitude( GeoDataCoordinates::Degree ), 8.0 );
+    QCOMPARE( way->at( 2 ).latitude( GeoDataCoordinates::Degree ), 48.2 );
+
+    delete document;
+}
+
+}
+
+QTEST_MAIN( Marble::OsmRunnerTest )
+
+#include "OsmRunnerTest.moc"
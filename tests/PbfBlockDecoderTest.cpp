@@ -0,0 +1,271 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest>
+
+#include "PbfBlockDecoder.h"
+
+namespace Marble
+{
+
+class PbfBlockDecoderTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testStringTable();
+    void testDenseNodes();
+    void testWaysAndRelations();
+    void testUnpackedFields();
+    void testBlobs();
+    void testMalformedData();
+
+ private:
+    static QByteArray varint( quint64 value );
+    static quint64 zigZag( qint64 value );
+    static QByteArray varintField( int number, quint64 value );
+    static QByteArray bytesField( int number, const QByteArray &data );
+    static QByteArray packed( const QList<qint64> &values );
+    static QByteArray packedZigZag( const QList<qint64> &values );
+    static QByteArray stringTable( const QStringList &strings );
+    static QByteArray tag( const PbfBlock &block, int index );
+};
+
+QByteArray PbfBlockDecoderTest::varint( quint64 value )
+{
+    QByteArray result;
+    do {
+        const char byte = char( value & 0x7f );
+        value >>= 7;
+        result.append( value ? char( byte | 0x80 ) : byte );
+    } while ( value );
+
+    return result;
+}
+
+quint64 PbfBlockDecoderTest::zigZag( qint64 value )
+{
+    return ( quint64( value ) << 1 ) ^ quint64( value >> 63 );
+}
+
+QByteArray PbfBlockDecoderTest::varintField( int number, quint64 value )
+{
+    return varint( number << 3 ) + varint( value );
+}
+
+QByteArray PbfBlockDecoderTest::bytesField( int number, const QByteArray &data )
+{
+    return varint( ( number << 3 ) | 2 ) + varint( data.size() ) + data;
+}
+
+QByteArray PbfBlockDecoderTest::packed( const QList<qint64> &values )
+{
+    QByteArray result;
+    foreach ( qint64 value, values ) {
+        result += varint( quint64( value ) );
+    }
+
+    return result;
+}
+
+QByteArray PbfBlockDecoderTest::packedZigZag( const QList<qint64> &values )
+{
+    QByteArray result;
+    foreach ( qint64 value, values ) {
+        result += varint( zigZag( value ) );
+    }
+
+    return result;
+}
+
+QByteArray PbfBlockDecoderTest::stringTable( const QStringList &strings )
+{
+    QByteArray result;
+    foreach ( const QString &string, strings ) {
+        result += bytesField( 1, string.toUtf8() );
+    }
+
+    return bytesField( 1, result );
+}
+
+QByteArray PbfBlockDecoderTest::tag( const PbfBlock &block, int index )
+{
+    return ( block.tags[index].first + '=' + block.tags[index].second ).toUtf8();
+}
+
+void PbfBlockDecoderTest::testStringTable()
+{
+    // index 0 is reserved for the empty string, index 9 is out of range
+    const QByteArray node = varintField( 1, zigZag( 42 ) )
+                            + bytesField( 2, packed( QList<qint64>() << 1 << 3 ) )
+                            + bytesField( 3, packed( QList<qint64>() << 2 << 9 ) );
+    const QByteArray data = stringTable( QStringList() << "" << "name" << QString::fromUtf8( "Caf\xc3\xa9" ) << "note" )
+                            + bytesField( 2, bytesField( 1, node ) );
+
+    PbfBlock block;
+    QVERIFY( PbfBlockDecoder::decode( data, &block ) );
+    QVERIFY( block.error.isEmpty() );
+    QCOMPARE( block.nodes.size(), 1 );
+    QCOMPARE( block.nodes[0].id, qint64( 42 ) );
+    QCOMPARE( block.nodes[0].firstTag, 0 );
+    QCOMPARE( block.nodes[0].tagCount, 2 );
+    QCOMPARE( block.tags[0].first, QString( "name" ) );
+    QCOMPARE( block.tags[0].second, QString::fromUtf8( "Caf\xc3\xa9" ) );
+    QCOMPARE( block.tags[1].first, QString( "note" ) );
+    QCOMPARE( block.tags[1].second, QString() );
+}
+
+void PbfBlockDecoderTest::testDenseNodes()
+{
+    // ids, coordinates and tags of three nodes, the second one without tags
+    const QByteArray dense = bytesField( 1, packedZigZag( QList<qint64>() << 10 << 1 << 5 ) )
+                             + bytesField( 8, packedZigZag( QList<qint64>() << 48000000 << 100 << -200 ) )
+                             + bytesField( 9, packedZigZag( QList<qint64>() << 7500000 << -100 << 0 ) )
+                             + bytesField( 10, packed( QList<qint64>() << 1 << 2 << 0 << 0 << 3 << 4 << 1 << 2 << 0 ) );
+
+    // the granularity and offset follow the groups they apply to
+    const QByteArray data = stringTable( QStringList() << "" << "name" << "Cafe" << "amenity" << "cafe" )
+                            + bytesField( 2, bytesField( 2, dense ) )
+                            + varintField( 17, 1000 )
+                            + varintField( 20, 500000000 );
+
+    PbfBlock block;
+    QVERIFY( PbfBlockDecoder::decode( data, &block ) );
+    QCOMPARE( block.nodes.size(), 3 );
+
+    QCOMPARE( block.nodes[0].id, qint64( 10 ) );
+    QCOMPARE( block.nodes[1].id, qint64( 11 ) );
+    QCOMPARE( block.nodes[2].id, qint64( 16 ) );
+
+    QCOMPARE( block.nodes[0].lat, 48.0 );
+    QCOMPARE( block.nodes[0].lon, 8.0 );
+    QCOMPARE( block.nodes[1].lat, 48.0001 );
+    QCOMPARE( block.nodes[1].lon, 7.9999 );
+    QCOMPARE( block.nodes[2].lat, 47.9999 );
+    QCOMPARE( block.nodes[2].lon, 7.9999 );
+
+    QCOMPARE( block.nodes[0].tagCount, 1 );
+    QCOMPARE( tag( block, block.nodes[0].firstTag ), QByteArray( "name=Cafe" ) );
+    QCOMPARE( block.nodes[1].tagCount, 0 );
+    QCOMPARE( block.nodes[2].tagCount, 2 );
+    QCOMPARE( tag( block, block.nodes[2].firstTag ), QByteArray( "amenity=cafe" ) );
+    QCOMPARE( tag( block, block.nodes[2].firstTag + 1 ), QByteArray( "name=Cafe" ) );
+}
+
+void PbfBlockDecoderTest::testWaysAndRelations()
+{
+    const QByteArray way = varintField( 1, 5 )
+                           + bytesField( 2, packed( QList<qint64>() << 1 ) )
+                           + bytesField( 3, packed( QList<qint64>() << 2 ) )
+                           + bytesField( 8, packedZigZag( QList<qint64>() << 10 << 1 << 5 << -16 ) );
+    const QByteArray relation = varintField( 1, 7 )
+                                + bytesField( 8, packed( QList<qint64>() << 3 << 4 << 3 ) )
+                                + bytesField( 9, packedZigZag( QList<qint64>() << 5 << -2 << 10 ) )
+                                + bytesField( 10, packed( QList<qint64>() << 1 << 2 << 0 ) );
+    const QByteArray data = stringTable( QStringList() << "" << "highway" << "residential" << "outer" << "inner" )
+                            + bytesField( 2, bytesField( 3, way ) + bytesField( 4, relation ) );
+
+    PbfBlock block;
+    QVERIFY( PbfBlockDecoder::decode( data, &block ) );
+
+    QCOMPARE( block.ways.size(), 1 );
+    const PbfWay &decodedWay = block.ways[0];
+    QCOMPARE( decodedWay.id, qint64( 5 ) );
+    QCOMPARE( decodedWay.refCount, 4 );
+    QCOMPARE( block.refs.mid( decodedWay.firstRef, decodedWay.refCount ),
+              QVector<qint64>() << 10 << 11 << 16 << 0 );
+    QCOMPARE( decodedWay.tagCount, 1 );
+    QCOMPARE( tag( block, decodedWay.firstTag ), QByteArray( "highway=residential" ) );
+
+    QCOMPARE( block.relations.size(), 1 );
+    const PbfRelation &decodedRelation = block.relations[0];
+    QCOMPARE( decodedRelation.id, qint64( 7 ) );
+    QCOMPARE( decodedRelation.memberCount, 3 );
+    const PbfMember *members = block.members.constData() + decodedRelation.firstMember;
+    QCOMPARE( members[0].ref, qint64( 5 ) );
+    QCOMPARE( members[0].type, PbfMember::Way );
+    QCOMPARE( members[0].role, QString( "outer" ) );
+    QCOMPARE( members[1].ref, qint64( 3 ) );
+    QCOMPARE( members[1].type, PbfMember::Relation );
+    QCOMPARE( members[1].role, QString( "inner" ) );
+    QCOMPARE( members[2].ref, qint64( 13 ) );
+    QCOMPARE( members[2].type, PbfMember::Node );
+}
+
+void PbfBlockDecoderTest::testUnpackedFields()
+{
+    // repeated numbers may come as one field each as well
+    const QByteArray way = varintField( 1, 5 )
+                           + varintField( 8, zigZag( 10 ) )
+                           + varintField( 8, zigZag( 1 ) )
+                           + varintField( 2, 1 )
+                           + varintField( 3, 2 );
+    const QByteArray data = stringTable( QStringList() << "" << "highway" << "track" )
+                            + bytesField( 2, bytesField( 3, way ) );
+
+    PbfBlock block;
+    QVERIFY( PbfBlockDecoder::decode( data, &block ) );
+    QCOMPARE( block.ways.size(), 1 );
+    QCOMPARE( block.refs, QVector<qint64>() << 10 << 11 );
+    QCOMPARE( tag( block, block.ways[0].firstTag ), QByteArray( "highway=track" ) );
+}
+
+void PbfBlockDecoderTest::testBlobs()
+{
+    const QByteArray contents( 1000, 'x' );
+    QByteArray data;
+    QString error;
+
+    QVERIFY( PbfBlockDecoder::blobData( bytesField( 1, contents ), data, error ) );
+    QCOMPARE( data, contents );
+
+    // qCompress() puts the uncompressed size in front of the zlib stream
+    const QByteArray zlibData = qCompress( contents ).mid( 4 );
+    data.clear();
+    QVERIFY( PbfBlockDecoder::blobData( varintField( 2, contents.size() ) + bytesField( 3, zlibData ), data, error ) );
+    QCOMPARE( data, contents );
+
+    // a wrong size is no valid blob
+    QVERIFY( !PbfBlockDecoder::blobData( varintField( 2, contents.size() + 1 ) + bytesField( 3, zlibData ), data, error ) );
+    QVERIFY( !error.isEmpty() );
+
+    // the size is checked before anything is allocated for it
+    error.clear();
+    QVERIFY( !PbfBlockDecoder::blobData( varintField( 2, PbfBlockDecoder::maxBlobSize + 1 ) + bytesField( 3, zlibData ), data, error ) );
+    QVERIFY( error.contains( "size" ) );
+
+    error.clear();
+    QVERIFY( !PbfBlockDecoder::blobData( varintField( 2, 10 ) + bytesField( 4, "lzma" ), data, error ) );
+    QVERIFY( !error.isEmpty() );
+}
+
+void PbfBlockDecoderTest::testMalformedData()
+{
+    const QByteArray node = varintField( 1, zigZag( 42 ) );
+    const QByteArray data = stringTable( QStringList() << "" ) + bytesField( 2, bytesField( 1, node ) );
+
+    // cut off within the group
+    PbfBlock block;
+    QVERIFY( !PbfBlockDecoder::decode( data.left( data.size() - 1 ), &block ) );
+    QVERIFY( !block.error.isEmpty() );
+
+    // a varint without end
+    PbfBlock unterminated;
+    QVERIFY( !PbfBlockDecoder::decode( QByteArray( 3, char( 0x80 ) ), &unterminated ) );
+
+    QByteArray blobData;
+    QString error;
+    QVERIFY( !PbfBlockDecoder::blobData( bytesField( 1, "raw" ).left( 3 ), blobData, error ) );
+    QVERIFY( !error.isEmpty() );
+}
+
+}
+
+QTEST_MAIN( Marble::PbfBlockDecoderTest )
+
+#include "PbfBlockDecoderTest.moc"
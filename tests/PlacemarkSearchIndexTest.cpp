@@ -0,0 +1,177 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest>
+
+#include "GeoDataPlacemark.h"
+#include "PlacemarkSearchIndex.h"
+
+namespace Marble
+{
+
+class PlacemarkSearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testNormalized();
+    void testPrefix();
+    void testSimilar();
+    void testPreferred();
+    void testRemove();
+    void benchmarkSearch();
+
+ private:
+    GeoDataPlacemark *createPlacemark( const QString &name, qreal lon, qreal lat, qint64 popularity );
+
+    QList<GeoDataPlacemark *> m_placemarks;
+};
+
+void PlacemarkSearchIndexTest::initTestCase()
+{
+    createPlacemark( "Berlin", 13.4, 52.5, 3400000 );
+    createPlacemark( "Bern", 7.4, 46.9, 120000 );
+    createPlacemark( "Berlin, New Hampshire", -71.2, 44.5, 10000 );
+    createPlacemark( QString::fromUtf8( "Zürich" ), 8.5, 47.4, 380000 );
+    createPlacemark( QString::fromUtf8( "Kraków" ), 19.9, 50.1, 760000 );
+    createPlacemark( "Paris", 2.35, 48.86, 2200000 );
+}
+
+void PlacemarkSearchIndexTest::cleanupTestCase()
+{
+    qDeleteAll( m_placemarks );
+    m_placemarks.clear();
+}
+
+GeoDataPlacemark *PlacemarkSearchIndexTest::createPlacemark( const QString &name, qreal lon, qreal lat, qint64 popularity )
+{
+    GeoDataPlacemark *placemark = new GeoDataPlacemark( name );
+    placemark->setCoordinate( lon, lat, 0.0, GeoDataCoordinates::Degree );
+    placemark->setPopularity( popularity );
+    m_placemarks.append( placemark );
+
+    return placemark;
+}
+
+void PlacemarkSearchIndexTest::testNormalized()
+{
+    QCOMPARE( PlacemarkSearchIndex::normalized( QString::fromUtf8( "Zürich" ) ), QString( "zurich" ) );
+    QCOMPARE( PlacemarkSearchIndex::normalized( QString::fromUtf8( "Kraków" ) ), QString( "krakow" ) );
+}
+
+void PlacemarkSearchIndexTest::testPrefix()
+{
+    PlacemarkSearchIndex index;
+    foreach ( GeoDataPlacemark *placemark, m_placemarks ) {
+        index.addPlacemark( placemark );
+    }
+    QCOMPARE( index.size(), m_placemarks.size() );
+
+    // most popular first
+    const QVector<const GeoDataPlacemark *> berlin = index.search( "ber" );
+    QCOMPARE( berlin.size(), 3 );
+    QVERIFY( berlin[0] == m_placemarks[0] );
+    QVERIFY( berlin[1] == m_placemarks[1] );
+    QVERIFY( berlin[2] == m_placemarks[2] );
+
+    QCOMPARE( index.search( "ber", GeoDataLatLonAltBox(), 1 ).size(), 1 );
+
+    // case and accents are ignored
+    QCOMPARE( index.search( "ZUR" ).size(), 1 );
+    QCOMPARE( index.search( QString::fromUtf8( "krakó" ) ).size(), 1 );
+    QCOMPARE( index.search( "krako" ).size(), 1 );
+
+    QVERIFY( index.search( "x" ).isEmpty() );
+    QVERIFY( index.search( "" ).isEmpty() );
+}
+
+void PlacemarkSearchIndexTest::testSimilar()
+{
+    PlacemarkSearchIndex index;
+    foreach ( GeoDataPlacemark *placemark, m_placemarks ) {
+        index.addPlacemark( placemark );
+    }
+
+    const QVector<const GeoDataPlacemark *> typo = index.search( "berlni" );
+    QVERIFY( !typo.isEmpty() );
+    QVERIFY( typo.first() == m_placemarks[0] );
+
+    QVERIFY( index.search( "parsi" ).contains( m_placemarks[5] ) );
+    QVERIFY( index.search( "london" ).isEmpty() );
+}
+
+void PlacemarkSearchIndexTest::testPreferred()
+{
+    PlacemarkSearchIndex index;
+    foreach ( GeoDataPlacemark *placemark, m_placemarks ) {
+        index.addPlacemark( placemark );
+    }
+
+    // America
+    const GeoDataLatLonAltBox america( GeoDataLatLonBox( 60.0, 20.0, -60.0, -130.0, GeoDataCoordinates::Degree ), 0, 0 );
+    const QVector<const GeoDataPlacemark *> berlin = index.search( "berlin", america );
+    QCOMPARE( berlin.size(), 1 );
+    QVERIFY( berlin.first() == m_placemarks[2] );
+}
+
+void PlacemarkSearchIndexTest::testRemove()
+{
+    PlacemarkSearchIndex index;
+    foreach ( GeoDataPlacemark *placemark, m_placemarks ) {
+        index.addPlacemark( placemark );
+    }
+
+    index.removePlacemark( m_placemarks[0] );
+    QCOMPARE( index.size(), m_placemarks.size() - 1 );
+    QVERIFY( !index.search( "berlin" ).contains( m_placemarks[0] ) );
+    QCOMPARE( index.search( "berlin" ).size(), 1 );
+
+    // adding twice indexes once
+    index.addPlacemark( m_placemarks[1] );
+    QCOMPARE( index.search( "bern" ).size(), 1 );
+
+    index.clear();
+    QCOMPARE( index.size(), 0 );
+    QVERIFY( index.search( "bern" ).isEmpty() );
+}
+
+void PlacemarkSearchIndexTest::benchmarkSearch()
+{
+    QList<GeoDataPlacemark *> placemarks;
+    PlacemarkSearchIndex index;
+
+    qsrand( 1 );
+    for ( int i = 0; i < 100000; ++i ) {
+        QString name;
+        const int length = 4 + qrand() % 8;
+        for ( int j = 0; j < length; ++j ) {
+            name.append( QChar( 'a' + qrand() % 26 ) );
+        }
+
+        GeoDataPlacemark *placemark = new GeoDataPlacemark( name );
+        placemarks.append( placemark );
+        index.addPlacemark( placemark );
+    }
+
+    index.search( "mar" );
+
+    QBENCHMARK {
+        index.search( "mar" );
+    }
+
+    qDeleteAll( placemarks );
+}
+
+}
+
+QTEST_MAIN( Marble::PlacemarkSearchIndexTest )
+
+#include "PlacemarkSearchIndexTest.moc"
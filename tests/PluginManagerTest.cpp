@@ -8,9 +8,17 @@
 // Copyright 2008 Patrick Spendrin  <ps_ml@gmx.de>
 //
 
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTextStream>
+#include <QTime>
 #include <QtTest>
 
 #include "MarbleDirs.h"
+#include "ParseRunnerPlugin.h"
 #include "PluginManager.h"
 
 namespace Marble
@@ -19,15 +27,101 @@ namespace Marble
 class PluginManagerTest : public QObject
 {
     Q_OBJECT
+    public:
+        /**
+         * Starts like Marble in a new process, prints the time taken and the
+         * resident memory in kB. @p kind is "all" to load all plugins, or
+         * "parse" to load the plugins opening a KML file only.
+         */
+        static int startup( const QString &kind );
+
     private slots:
+        void initTestCase();
+        void cleanupTestCase();
         void loadPlugins();
+        void loadParseRunnerPluginsForFile();
+        void writeCache();
+        void benchmarkStartup_data();
+        void benchmarkStartup();
+
+    private:
+        static qint64 residentMemory();
+        static QString cachePath();
+
+        QString m_dataHome;
 };
 
-void PluginManagerTest::loadPlugins()
+int PluginManagerTest::startup( const QString &kind )
 {
     MarbleDirs::setMarbleDataPath( DATA_PATH );
     MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
 
+    QTime time;
+    time.start();
+
+    PluginManager pm;
+    if ( kind == "all" ) {
+        pm.renderPlugins();
+        pm.positionProviderPlugins();
+        pm.searchRunnerPlugins();
+        pm.reverseGeocodingRunnerPlugins();
+        pm.routingRunnerPlugins();
+        pm.parsingRunnerPlugins();
+    } else {
+        pm.parsingRunnerPlugins( "test.kml" );
+    }
+
+    const int elapsed = time.elapsed();
+    QTextStream( stdout ) << elapsed << ' ' << residentMemory() << endl;
+
+    return 0;
+}
+
+qint64 PluginManagerTest::residentMemory()
+{
+    // the VmRSS line of /proc/self/status, in kB
+    QFile status( "/proc/self/status" );
+    if ( !status.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+        return -1;
+    }
+
+    foreach ( const QByteArray &line, status.readAll().split( '\n' ) ) {
+        if ( line.startsWith( "VmRSS:" ) ) {
+            return line.mid( 6 ).trimmed().split( ' ' ).first().toLongLong();
+        }
+    }
+
+    return -1;
+}
+
+QString PluginManagerTest::cachePath()
+{
+    return MarbleDirs::localPath() + "/plugins.cache";
+}
+
+void PluginManagerTest::initTestCase()
+{
+    MarbleDirs::setMarbleDataPath( DATA_PATH );
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+
+    // keeps the plugin cache away from the one of the user
+    m_dataHome = QDir::tempPath() + "/PluginManagerTest-" + QString::number( QCoreApplication::applicationPid() );
+    qputenv( "XDG_DATA_HOME", QFile::encodeName( m_dataHome ) );
+    QDir::root().mkpath( MarbleDirs::localPath() );
+}
+
+void PluginManagerTest::cleanupTestCase()
+{
+    QDir localDir( MarbleDirs::localPath() );
+    foreach ( const QString &fileName, localDir.entryList( QDir::Files ) ) {
+        localDir.remove( fileName );
+    }
+    QDir::root().rmdir( MarbleDirs::localPath() );
+    QDir::root().rmdir( m_dataHome );
+}
+
+void PluginManagerTest::loadPlugins()
+{
     const int pluginNumber = MarbleDirs::pluginEntryList( "", QDir::Files ).size();
 
     PluginManager pm;
@@ -43,8 +137,92 @@ void PluginManagerTest::loadPlugins()
     QCOMPARE( renderPlugins + positionPlugins + runnerPlugins, pluginNumber );
 }
 
+void PluginManagerTest::loadParseRunnerPluginsForFile()
+{
+    PluginManager pm;
+    const QList<const ParseRunnerPlugin *> plugins = pm.parsingRunnerPlugins( "test.kml" );
+
+    QVERIFY( !plugins.isEmpty() );
+    foreach ( const ParseRunnerPlugin *plugin, plugins ) {
+        QVERIFY( plugin->fileExtensions().isEmpty() || plugin->fileExtensions().contains( "kml" ) );
+    }
+
+    // all plugins are still there when asked for
+    QVERIFY( pm.parsingRunnerPlugins().size() >= plugins.size() );
+}
+
+void PluginManagerTest::writeCache()
+{
+    QFile::remove( cachePath() );
+
+    PluginManager().parsingRunnerPlugins( "test.kml" );
+    QVERIFY( QFile::exists( cachePath() ) );
+
+    // an existing cache is replaced, no temporary file is left behind
+    QFile( cachePath() ).resize( 0 );
+    PluginManager().parsingRunnerPlugins( "test.kml" );
+    QVERIFY( QFileInfo( cachePath() ).size() > 0 );
+    QCOMPARE( QDir( MarbleDirs::localPath() ).entryList( QStringList() << "plugins.cache.*", QDir::Files ), QStringList() );
+}
+
+void PluginManagerTest::benchmarkStartup_data()
+{
+    QTest::addColumn<QString>( "kind" );
+    QTest::addColumn<bool>( "cached" );
+
+    QTest::newRow( "first start, all plugins" ) << "all" << false;
+    QTest::newRow( "all plugins" ) << "all" << true;
+    QTest::newRow( "first start, KML parsing plugins" ) << "parse" << false;
+    QTest::newRow( "KML parsing plugins" ) << "parse" << true;
+}
+
+void PluginManagerTest::benchmarkStartup()
+{
+    QFETCH( QString, kind );
+    QFETCH( bool, cached );
+
+    // each start is a new process, as only that shows which plugins were loaded
+    int bestTime = -1;
+    qint64 bestMemory = -1;
+    for ( int i = 0; i < 3; ++i ) {
+        if ( cached ) {
+            PluginManager().parsingRunnerPlugins( "test.kml" );
+        } else {
+            QFile::remove( cachePath() );
+        }
+
+        QProcess process;
+        process.start( QCoreApplication::applicationFilePath(), QStringList() << "--startup" << kind );
+        QVERIFY( process.waitForFinished( 60000 ) );
+        QCOMPARE( process.exitCode(), 0 );
+
+        const QList<QByteArray> result = process.readAllStandardOutput().trimmed().split( ' ' );
+        QCOMPARE( result.size(), 2 );
+
+        const int time = result[0].toInt();
+        const qint64 memory = result[1].toLongLong();
+        bestTime = bestTime < 0 ? time : qMin( bestTime, time );
+        bestMemory = bestMemory < 0 ? memory : qMin( bestMemory, memory );
+    }
+
+    qDebug() << kind << ( cached ? "with cache:" : "without cache:" )
+             << bestTime << "ms" << bestMemory << "kB resident";
+
+    QTest::setBenchmarkResult( bestTime, QTest::WalltimeMilliseconds );
+}
+
 }
 
-QTEST_MAIN( Marble::PluginManagerTest )
+int main( int argc, char **argv )
+{
+    QApplication app( argc, argv );
+
+    if ( argc == 3 && QString( argv[1] ) == "--startup" ) {
+        return Marble::PluginManagerTest::startup( argv[2] );
+    }
+
+    Marble::PluginManagerTest test;
+    return QTest::qExec( &test, argc, argv );
+}
 
 #include "PluginManagerTest.moc"
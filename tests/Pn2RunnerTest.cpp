@@ -0,0 +1,164 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QtTest>
+
+#include "TestUtils.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "GeoDataPolygon.h"
+#include "GeoDataTypes.h"
+#include "MarbleDirs.h"
+#include "ParseRunnerPlugin.h"
+#include "ParsingRunner.h"
+#include "PluginManager.h"
+
+namespace Marble
+{
+
+class Pn2RunnerTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+
+    void testNaturalEarth_data();
+    void testNaturalEarth();
+    void testFirstNode();
+
+    void benchmarkNaturalEarth_data();
+    void benchmarkNaturalEarth();
+
+    void documentParsed( GeoDataDocument *document, const QString &error );
+
+ private:
+    GeoDataDocument *parse( const QString &fileName );
+    static int nodeCount( const GeoDataPlacemark *placemark );
+
+    PluginManager m_pluginManager;
+    GeoDataDocument *m_document;
+    QString m_error;
+};
+
+void Pn2RunnerTest::initTestCase()
+{
+    MarbleDirs::setMarbleDataPath( DATA_PATH );
+    MarbleDirs::setMarblePluginPath( PLUGIN_PATH );
+}
+
+void Pn2RunnerTest::documentParsed( GeoDataDocument *document, const QString &error )
+{
+    m_document = document;
+    m_error = error;
+}
+
+GeoDataDocument *Pn2RunnerTest::parse( const QString &fileName )
+{
+    const QList<const ParseRunnerPlugin *> plugins = m_pluginManager.parsingRunnerPlugins( fileName );
+    if ( plugins.isEmpty() ) {
+        return 0;
+    }
+
+    m_document = 0;
+    m_error.clear();
+
+    ParsingRunner *runner = plugins.first()->newRunner();
+    connect( runner, SIGNAL(parsingFinished(GeoDataDocument*,QString)),
+             this, SLOT(documentParsed(GeoDataDocument*,QString)), Qt::DirectConnection );
+    runner->parseFile( fileName, UserDocument );
+    delete runner;
+
+    return m_document;
+}
+
+int Pn2RunnerTest::nodeCount( const GeoDataPlacemark *placemark )
+{
+    const GeoDataGeometry *geometry = placemark->geometry();
+    if ( geometry->nodeType() == GeoDataTypes::GeoDataPolygonType ) {
+        const GeoDataPolygon *polygon = static_cast<const GeoDataPolygon *>( geometry );
+        int count = polygon->outerBoundary().size();
+        foreach ( const GeoDataLinearRing &innerBoundary, polygon->innerBoundaries() ) {
+            count += innerBoundary.size();
+        }
+        return count;
+    }
+
+    return static_cast<const GeoDataLineString *>( geometry )->size();
+}
+
+void Pn2RunnerTest::testNaturalEarth_data()
+{
+    QTest::addColumn<QString>( "fileName" );
+    QTest::addColumn<int>( "placemarks" );
+    QTest::addColumn<int>( "nodes" );
+
+    const QString naturalEarth = QString( MARBLE_SRC_DIR ).append( "/data/naturalearth/" );
+    addNamedRow( "urban areas" ) << naturalEarth + "50m-urban-area.pn2" << 2143 << 35661;
+    addNamedRow( "glaciated areas" ) << naturalEarth + "50m_glaciated_areas.pn2" << 377 << 18819;
+    addNamedRow( "lakes" ) << naturalEarth + "50m_lakes.pn2" << 397 << 20291;
+    addNamedRow( "land" ) << naturalEarth + "50m_land.pn2" << 1420 << 60279;
+    addNamedRow( "boundaries" ) << naturalEarth + "ne_10m_admin_0_boundary_lines_land.pn2" << 350 << 71042;
+    addNamedRow( "rivers" ) << naturalEarth + "ne_10m_rivers_lake_centerlines.pn2" << 1956 << 210868;
+}
+
+void Pn2RunnerTest::testNaturalEarth()
+{
+    QFETCH( QString, fileName );
+    QFETCH( int, placemarks );
+    QFETCH( int, nodes );
+
+    GeoDataDocument *document = parse( fileName );
+    QVERIFY( document != 0 );
+    QVERIFY( m_error.isEmpty() );
+    QCOMPARE( document->documentRole(), UserDocument );
+    QCOMPARE( document->placemarkList().size(), placemarks );
+
+    int count = 0;
+    foreach ( const GeoDataPlacemark *placemark, document->placemarkList() ) {
+        count += nodeCount( placemark );
+    }
+    QCOMPARE( count, nodes );
+
+    delete document;
+}
+
+void Pn2RunnerTest::testFirstNode()
+{
+    GeoDataDocument *document = parse( QString( MARBLE_SRC_DIR ).append( "/data/naturalearth/50m_lakes.pn2" ) );
+    QVERIFY( document != 0 );
+
+    const GeoDataPolygon *polygon = dynamic_cast<GeoDataPolygon *>( document->placemarkList().first()->geometry() );
+    QVERIFY( polygon != 0 );
+    // an absolute node at 7347 and 3580 half arcminutes, followed by a relative node without offset
+    const GeoDataCoordinates expected( 3580 / 120.0, 7347 / 120.0, 0.0, GeoDataCoordinates::Degree );
+    QCOMPARE( polygon->outerBoundary().at( 0 ), expected );
+    QCOMPARE( polygon->outerBoundary().at( 1 ), expected );
+
+    delete document;
+}
+
+void Pn2RunnerTest::benchmarkNaturalEarth_data()
+{
+    testNaturalEarth_data();
+}
+
+void Pn2RunnerTest::benchmarkNaturalEarth()
+{
+    QFETCH( QString, fileName );
+
+    QBENCHMARK {
+        delete parse( fileName );
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::Pn2RunnerTest )
+
+#include "Pn2RunnerTest.moc"
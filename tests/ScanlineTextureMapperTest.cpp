@@ -0,0 +1,282 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QImage>
+#include <QSet>
+#include <QtTest>
+
+#include "EquirectScanlineTextureMapper.h"
+#include "GeoDataCoordinates.h"
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "GeoPainter.h"
+#include "GeoSceneTextureTile.h"
+#include "HttpDownloadManager.h"
+#include "MarbleDirs.h"
+#include "MercatorScanlineTextureMapper.h"
+#include "MergedLayerDecorator.h"
+#include "SphericalScanlineTextureMapper.h"
+#include "StackedTileLoader.h"
+#include "TextureColorizer.h"
+#include "TileId.h"
+#include "TileLoader.h"
+#include "VectorComposer.h"
+#include "ViewportParams.h"
+
+Q_DECLARE_METATYPE( Marble::Projection )
+
+namespace Marble
+{
+
+class ScanlineTextureMapperTest : public QObject
+{
+    Q_OBJECT
+
+ public:
+    ScanlineTextureMapperTest();
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testScroll_data();
+    void testScroll();
+    void testRepaintAfterScroll_data();
+    void testRepaintAfterScroll();
+    void testKeepFrame();
+
+ private:
+    TextureMapperInterface *createMapper( Projection projection );
+    TextureColorizer *createColorizer();
+    QImage map( TextureMapperInterface *mapper, const ViewportParams *viewport,
+                MapQuality mapQuality, TextureColorizer *colorizer = 0 ) const;
+    static qreal meanDifference( const QImage &image1, const QImage &image2 );
+
+    HttpDownloadManager m_downloadManager;
+    TileLoader m_tileLoader;
+    GeoSceneTextureTile m_texture;
+    MergedLayerDecorator *m_layerDecorator;
+    StackedTileLoader *m_loader;
+    VectorComposer m_vectorComposer;
+    GeoDataDocument m_land;
+};
+
+ScanlineTextureMapperTest::ScanlineTextureMapperTest()
+    : m_downloadManager( 0 ),
+      m_tileLoader( &m_downloadManager, 0 ),
+      m_texture( "srtm_data" ),
+      m_layerDecorator( 0 ),
+      m_loader( 0 )
+{
+}
+
+void ScanlineTextureMapperTest::initTestCase()
+{
+    // the bundled srtm map is a gray scale height map, as used with the colorizer
+    MarbleDirs::setMarbleDataPath( QString( MARBLE_SRC_DIR ).append( "/data" ) );
+    m_downloadManager.setDownloadEnabled( false );
+
+    m_texture.setSourceDir( "earth/srtm" );
+    m_texture.setFileFormat( "JPG" );
+    m_texture.setMaximumTileLevel( 5 );
+    m_texture.setLevelZeroColumns( 2 );
+    m_texture.setLevelZeroRows( 1 );
+
+    m_layerDecorator = new MergedLayerDecorator( &m_tileLoader, 0 );
+    m_layerDecorator->setTextureLayers( QVector<const GeoSceneTextureTile *>() << &m_texture );
+    m_loader = new StackedTileLoader( m_layerDecorator );
+
+    GeoDataLinearRing *ring = new GeoDataLinearRing;
+    *ring << GeoDataCoordinates( -20.0, -10.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 35.0, -5.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 25.0, 40.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( -15.0, 30.0, 0.0, GeoDataCoordinates::Degree );
+    GeoDataPlacemark *island = new GeoDataPlacemark;
+    island->setGeometry( ring );
+    m_land.append( island );
+}
+
+void ScanlineTextureMapperTest::cleanupTestCase()
+{
+    delete m_loader;
+    delete m_layerDecorator;
+}
+
+TextureMapperInterface *ScanlineTextureMapperTest::createMapper( Projection projection )
+{
+    switch ( projection ) {
+    case Spherical:
+        return new SphericalScanlineTextureMapper( m_loader );
+    case Equirectangular:
+        return new EquirectScanlineTextureMapper( m_loader );
+    case Mercator:
+        return new MercatorScanlineTextureMapper( m_loader );
+    }
+
+    return 0;
+}
+
+TextureColorizer *ScanlineTextureMapperTest::createColorizer()
+{
+    TextureColorizer *colorizer = new TextureColorizer( QString( MARBLE_SRC_DIR ).append( "/data/seacolors.leg" ),
+                                                        QString( MARBLE_SRC_DIR ).append( "/data/landcolors.leg" ),
+                                                        &m_vectorComposer );
+    colorizer->setShowRelief( true );
+    colorizer->addLandDocument( &m_land );
+
+    return colorizer;
+}
+
+QImage ScanlineTextureMapperTest::map( TextureMapperInterface *mapper, const ViewportParams *viewport,
+                                       MapQuality mapQuality, TextureColorizer *colorizer ) const
+{
+    QImage image( viewport->size(), QImage::Format_ARGB32_Premultiplied );
+    image.fill( 0 );
+
+    GeoPainter painter( &image, viewport, mapQuality );
+    mapper->mapTexture( &painter, viewport, 1, QRect( QPoint( 0, 0 ), viewport->size() ), colorizer );
+    painter.end();
+
+    return image;
+}
+
+qreal ScanlineTextureMapperTest::meanDifference( const QImage &image1, const QImage &image2 )
+{
+    qint64 sum = 0;
+    for ( int y = 0; y < image1.height(); ++y ) {
+        for ( int x = 0; x < image1.width(); ++x ) {
+            const QRgb pixel1 = image1.pixel( x, y );
+            const QRgb pixel2 = image2.pixel( x, y );
+            sum += qAbs( qRed( pixel1 ) - qRed( pixel2 ) )
+                   + qAbs( qGreen( pixel1 ) - qGreen( pixel2 ) )
+                   + qAbs( qBlue( pixel1 ) - qBlue( pixel2 ) );
+        }
+    }
+
+    return qreal( sum ) / ( 3 * image1.width() * image1.height() );
+}
+
+void ScanlineTextureMapperTest::testScroll_data()
+{
+    QTest::addColumn<Projection>( "projection" );
+    QTest::addColumn<bool>( "colorized" );
+
+    QTest::newRow( "equirect" ) << Equirectangular << false;
+    QTest::newRow( "equirect colorized" ) << Equirectangular << true;
+    QTest::newRow( "mercator" ) << Mercator << false;
+    QTest::newRow( "mercator colorized" ) << Mercator << true;
+}
+
+void ScanlineTextureMapperTest::testScroll()
+{
+    QFETCH( Projection, projection );
+    QFETCH( bool, colorized );
+
+    const int radius = 200;
+    const qreal pixel = M_PI / ( 2.0 * radius );
+
+    ViewportParams viewport( projection, 0.3, 0.2, radius, QSize( 300, 200 ) );
+
+    TextureMapperInterface *const mapper = createMapper( projection );
+    TextureColorizer *const colorizer = colorized ? createColorizer() : 0;
+    map( mapper, &viewport, NormalQuality, colorizer );
+
+    // pan by whole pixels a few times, so that the canvas is scrolled each time
+    for ( int i = 0; i < 3; ++i ) {
+        viewport.centerOn( viewport.centerLongitude() + 13 * pixel,
+                           viewport.centerLatitude() - 7 * pixel );
+        const QImage scrolled = map( mapper, &viewport, NormalQuality, colorizer );
+
+        TextureMapperInterface *const freshMapper = createMapper( projection );
+        TextureColorizer *const freshColorizer = colorized ? createColorizer() : 0;
+        const QImage expected = map( freshMapper, &viewport, NormalQuality, freshColorizer );
+        delete freshColorizer;
+        delete freshMapper;
+
+        // the exposed strips are interpolated from their own start, not from the left edge
+        QVERIFY( meanDifference( scrolled, expected ) < 1.0 );
+    }
+
+    delete colorizer;
+    delete mapper;
+}
+
+void ScanlineTextureMapperTest::testRepaintAfterScroll_data()
+{
+    QTest::addColumn<Projection>( "projection" );
+
+    QTest::newRow( "equirect" ) << Equirectangular;
+    QTest::newRow( "mercator" ) << Mercator;
+}
+
+void ScanlineTextureMapperTest::testRepaintAfterScroll()
+{
+    QFETCH( Projection, projection );
+
+    const int radius = 200;
+    const qreal pixel = M_PI / ( 2.0 * radius );
+
+    ViewportParams viewport( projection, 0.3, 0.2, radius, QSize( 300, 200 ) );
+
+    TextureMapperInterface *const mapper = createMapper( projection );
+    map( mapper, &viewport, NormalQuality );
+
+    // close enough to whole pixels to scroll, which leaves the canvas off by a fraction of a pixel
+    viewport.centerOn( viewport.centerLongitude() + 13.02 * pixel, viewport.centerLatitude() );
+    const QImage scrolled = map( mapper, &viewport, NormalQuality );
+    const QSet<TileId> visibleTiles = m_loader->visibleTiles().toSet();
+    const int lookups = m_loader->cacheHitCount() + m_loader->cacheMissCount();
+    QVERIFY( !visibleTiles.isEmpty() );
+
+    // the same viewport again maps nothing and keeps the tiles on display
+    for ( int i = 0; i < 2; ++i ) {
+        QCOMPARE( map( mapper, &viewport, NormalQuality ), scrolled );
+        QCOMPARE( m_loader->cacheHitCount() + m_loader->cacheMissCount(), lookups );
+        QCOMPARE( m_loader->visibleTiles().toSet(), visibleTiles );
+    }
+
+    delete mapper;
+}
+
+void ScanlineTextureMapperTest::testKeepFrame()
+{
+    const int radius = 300;
+    ViewportParams viewport( Spherical, 0.3, 0.2, radius, QSize( 400, 400 ) );
+
+    SphericalScanlineTextureMapper mapper( m_loader );
+    const QImage first = map( &mapper, &viewport, NormalQuality );
+
+    // moves the surface by at most a fifth of a pixel, so the frame is kept
+    viewport.centerOn( viewport.centerLongitude() + 0.2 / radius, viewport.centerLatitude() );
+    const QImage kept = map( &mapper, &viewport, NormalQuality );
+    QCOMPARE( kept, first );
+
+    SphericalScanlineTextureMapper normalMapper( m_loader );
+    const QImage normal = map( &normalMapper, &viewport, NormalQuality );
+    SphericalScanlineTextureMapper highMapper( m_loader );
+    const QImage high = map( &highMapper, &viewport, HighQuality );
+
+    // the frame kept is closer to the exact one than the normal quality is to the high one
+    const qreal keptError = meanDifference( kept, normal );
+    const qreal qualityError = meanDifference( normal, high );
+    qDebug() << "kept frame:" << keptError << "normal against high quality:" << qualityError;
+    QVERIFY( keptError < qualityError );
+
+    // a whole pixel needs a new frame
+    viewport.centerOn( viewport.centerLongitude() + 1.0 / radius, viewport.centerLatitude() );
+    const QImage moved = map( &mapper, &viewport, NormalQuality );
+    SphericalScanlineTextureMapper freshMapper( m_loader );
+    QCOMPARE( moved, map( &freshMapper, &viewport, NormalQuality ) );
+}
+
+}
+
+QTEST_MAIN( Marble::ScanlineTextureMapperTest )
+
+#include "ScanlineTextureMapperTest.moc"
@@ -0,0 +1,251 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <new>
+
+#include <QtTest>
+
+#include "GeoDataCoordinates.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataLineString.h"
+#include "GeoDataPolygon.h"
+#include "GeoPainter.h"
+#include "ScreenPolygonCache.h"
+#include "ViewportParams.h"
+
+namespace Marble
+{
+
+class ScreenPolygonCacheTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testPan_data();
+    void testPan();
+    void testChangedLineString();
+    void testRecycledAddress();
+    void testPolygon();
+    void testMaximumCost();
+
+ private:
+    static void createLineString( GeoDataLineString *lineString, qreal lonOffset );
+    static bool matches( const QVector<QPolygonF *> &polygons, const QVector<QPolygonF *> &expected );
+    static bool matches( const ScreenPolygonCache &cache, const ViewportParams *viewport,
+                         const GeoDataLineString &lineString );
+};
+
+void ScreenPolygonCacheTest::createLineString( GeoDataLineString *lineString, qreal lonOffset )
+{
+    *lineString << GeoDataCoordinates( lonOffset - 30.0, -20.0, 0.0, GeoDataCoordinates::Degree )
+                << GeoDataCoordinates( lonOffset, 10.0, 0.0, GeoDataCoordinates::Degree )
+                << GeoDataCoordinates( lonOffset + 40.0, 30.0, 0.0, GeoDataCoordinates::Degree );
+}
+
+bool ScreenPolygonCacheTest::matches( const QVector<QPolygonF *> &polygons, const QVector<QPolygonF *> &expected )
+{
+    if ( polygons.size() != expected.size() ) {
+        return false;
+    }
+
+    for ( int i = 0; i < polygons.size(); ++i ) {
+        if ( polygons[i]->size() != expected[i]->size() ) {
+            return false;
+        }
+
+        for ( int j = 0; j < polygons[i]->size(); ++j ) {
+            const QPointF difference = polygons[i]->at( j ) - expected[i]->at( j );
+            if ( qAbs( difference.x() ) > 1e-6 || qAbs( difference.y() ) > 1e-6 ) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ScreenPolygonCacheTest::matches( const ScreenPolygonCache &cache, const ViewportParams *viewport,
+                                      const GeoDataLineString &lineString )
+{
+    QVector<QPolygonF *> expected;
+    viewport->screenCoordinates( lineString, expected );
+    const bool result = matches( cache.polygons(), expected );
+    qDeleteAll( expected );
+
+    return result;
+}
+
+void ScreenPolygonCacheTest::testPan_data()
+{
+    QTest::addColumn<int>( "projection" );
+
+    QTest::newRow( "spherical" ) << int( Spherical );
+    QTest::newRow( "equirect" ) << int( Equirectangular );
+    QTest::newRow( "mercator" ) << int( Mercator );
+}
+
+void ScreenPolygonCacheTest::testPan()
+{
+    QFETCH( int, projection );
+
+    GeoDataLineString lineString;
+    createLineString( &lineString, 0.0 );
+
+    ViewportParams viewport( Projection( projection ), 0.0, 0.0, 100, QSize( 300, 200 ) );
+    ScreenPolygonCache cache;
+
+    QVERIFY( cache.project( &viewport, lineString ) );
+    QVERIFY( matches( cache, &viewport, lineString ) );
+
+    // across the date line, which adds a repetition in the flat projections
+    const qreal lons[] = { 0.3, 2.5, -2.9, -2.9 };
+    for ( int i = 0; i < 4; ++i ) {
+        viewport.centerOn( lons[i], 0.1 );
+        if ( cache.project( &viewport, lineString ) ) {
+            QVERIFY( matches( cache, &viewport, lineString ) );
+        } else {
+            // on the far side of the globe
+            QVERIFY( cache.polygons().isEmpty() );
+        }
+        cache.release();
+    }
+}
+
+void ScreenPolygonCacheTest::testChangedLineString()
+{
+    GeoDataLineString lineString;
+    createLineString( &lineString, 0.0 );
+
+    ViewportParams viewport( Equirectangular, 0.0, 0.0, 100, QSize( 300, 200 ) );
+    ScreenPolygonCache cache;
+    QVERIFY( cache.project( &viewport, lineString ) );
+    cache.release();
+
+    lineString << GeoDataCoordinates( 50.0, 0.0, 0.0, GeoDataCoordinates::Degree );
+    QVERIFY( cache.project( &viewport, lineString ) );
+    QVERIFY( matches( cache, &viewport, lineString ) );
+    cache.release();
+
+    lineString[0] = GeoDataCoordinates( -10.0, -5.0, 0.0, GeoDataCoordinates::Degree );
+    QVERIFY( cache.project( &viewport, lineString ) );
+    QVERIFY( matches( cache, &viewport, lineString ) );
+    cache.release();
+}
+
+void ScreenPolygonCacheTest::testRecycledAddress()
+{
+    ViewportParams viewport( Equirectangular, 0.0, 0.0, 100, QSize( 300, 200 ) );
+    ScreenPolygonCache cache;
+
+    GeoDataLineString *lineString = new GeoDataLineString;
+    createLineString( lineString, 0.0 );
+    QVERIFY( cache.project( &viewport, *lineString ) );
+    cache.release();
+
+    // another line string in the memory of the deleted one
+    lineString->~GeoDataLineString();
+    new ( lineString ) GeoDataLineString;
+    createLineString( lineString, 20.0 );
+
+    QVERIFY( cache.project( &viewport, *lineString ) );
+    QVERIFY( matches( cache, &viewport, *lineString ) );
+    cache.release();
+
+    delete lineString;
+}
+
+void ScreenPolygonCacheTest::testPolygon()
+{
+    GeoDataLinearRing outer;
+    outer << GeoDataCoordinates( -40.0, -30.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 40.0, -30.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 40.0, 30.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( -40.0, 30.0, 0.0, GeoDataCoordinates::Degree );
+    GeoDataLinearRing inner;
+    inner << GeoDataCoordinates( -10.0, -10.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 10.0, -10.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( 10.0, 10.0, 0.0, GeoDataCoordinates::Degree );
+
+    GeoDataPolygon polygon;
+    polygon.setOuterBoundary( outer );
+    polygon.appendInnerBoundary( inner );
+
+    ViewportParams viewport( Equirectangular, 0.0, 0.0, 100, QSize( 300, 200 ) );
+    ScreenPolygonCache cache;
+    QVERIFY( cache.project( &viewport, polygon ) );
+    cache.release();
+
+    // panned, then with a changed inner boundary
+    for ( int i = 0; i < 2; ++i ) {
+        if ( i == 0 ) {
+            viewport.centerOn( 0.4, 0.0 );
+        } else {
+            polygon.innerBoundaries()[0] << GeoDataCoordinates( -10.0, 10.0, 0.0, GeoDataCoordinates::Degree );
+        }
+
+        QVERIFY( cache.project( &viewport, polygon ) );
+
+        QVector<QPolygonF *> expected;
+        QVector<QPolygonF> expectedOutline;
+        GeoPainter::screenPolygons( &viewport, polygon, expected, expectedOutline );
+        QVERIFY( matches( cache.polygons(), expected ) );
+        QCOMPARE( cache.outline().size(), expectedOutline.size() );
+        for ( int j = 0; j < expectedOutline.size(); ++j ) {
+            QCOMPARE( cache.outline()[j].size(), expectedOutline[j].size() );
+        }
+        qDeleteAll( expected );
+
+        cache.release();
+    }
+}
+
+void ScreenPolygonCacheTest::testMaximumCost()
+{
+    const qint64 maximumCost = ScreenPolygonCache::maximumCost();
+
+    GeoDataLineString lineString;
+    createLineString( &lineString, 0.0 );
+    ViewportParams viewport( Equirectangular, 0.0, 0.0, 100, QSize( 300, 200 ) );
+
+    ScreenPolygonCache first;
+    ScreenPolygonCache second;
+
+    QVERIFY( first.project( &viewport, lineString ) );
+    QVERIFY( first.cost() > 0 );
+    QCOMPARE( ScreenPolygonCache::totalCost(), first.cost() );
+    first.release();
+
+    // room for one cache only, the one used least recently goes
+    ScreenPolygonCache::setMaximumCost( first.cost() );
+    QVERIFY( second.project( &viewport, lineString ) );
+    QCOMPARE( first.cost(), qint64( 0 ) );
+    QVERIFY( second.cost() > 0 );
+    QCOMPARE( ScreenPolygonCache::totalCost(), second.cost() );
+
+    // polygons which aren't painted yet are kept beyond the maximum cost
+    QVERIFY( first.project( &viewport, lineString ) );
+    QVERIFY( second.cost() > 0 );
+    QVERIFY( ScreenPolygonCache::totalCost() > ScreenPolygonCache::maximumCost() );
+    QVERIFY( matches( first, &viewport, lineString ) );
+    QVERIFY( matches( second, &viewport, lineString ) );
+
+    second.release();
+    QCOMPARE( second.cost(), qint64( 0 ) );
+    QVERIFY( first.cost() > 0 );
+
+    first.release();
+    QVERIFY( first.cost() > 0 );
+
+    ScreenPolygonCache::setMaximumCost( maximumCost );
+}
+
+}
+
+QTEST_MAIN( Marble::ScreenPolygonCacheTest )
+
+#include "ScreenPolygonCacheTest.moc"
@@ -0,0 +1,234 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QImage>
+#include <QtTest>
+
+#include "StackedTile.h"
+#include "StackedTileCache.h"
+#include "TextureTile.h"
+#include "TileId.h"
+
+namespace Marble
+{
+
+class StackedTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void testDisplayedAndCached();
+    void testEviction();
+    void testHighestLevelFirst();
+    void testOneBudgetForAllShards();
+    void testDisplayedTilesAreKept();
+    void testCounters();
+
+ private:
+    static StackedTile *createTile( const TileId &id );
+    static int tileByteCount();
+};
+
+StackedTile *StackedTileCacheTest::createTile( const TileId &id )
+{
+    QImage image( 16, 16, QImage::Format_ARGB32_Premultiplied );
+    image.fill( 0 );
+
+    QVector<QSharedPointer<TextureTile> > tiles;
+    tiles << QSharedPointer<TextureTile>( new TextureTile( id, image, 0 ) );
+
+    return new StackedTile( id, image, tiles );
+}
+
+int StackedTileCacheTest::tileByteCount()
+{
+    StackedTile *const tile = createTile( TileId( 0, 0, 0, 0 ) );
+    const int result = tile->byteCount();
+    delete tile;
+
+    return result;
+}
+
+void StackedTileCacheTest::testDisplayedAndCached()
+{
+    StackedTileCache cache;
+    const TileId id( 0, 2, 1, 3 );
+    StackedTile *const tile = createTile( id );
+
+    cache.insertDisplayedTile( id, tile );
+    QCOMPARE( cache.displayedTile( id ), tile );
+    QVERIFY( cache.cachedTile( id ) == 0 );
+    QCOMPARE( cache.displayedTileIds(), QList<TileId>() << id );
+    QCOMPARE( cache.count(), 1 );
+    QCOMPARE( cache.byteCount(), qint64( tile->byteCount() ) );
+
+    // off display
+    QCOMPARE( cache.takeDisplayedTile( id ), tile );
+    QVERIFY( cache.displayedTile( id ) == 0 );
+    cache.insertCachedTile( id, tile );
+    QCOMPARE( cache.cachedTile( id ), static_cast<const StackedTile *>( tile ) );
+    QVERIFY( cache.displayedTileIds().isEmpty() );
+    QCOMPARE( cache.count(), 1 );
+    QCOMPARE( cache.byteCount(), qint64( tile->byteCount() ) );
+
+    // back on display
+    QCOMPARE( cache.takeCachedTile( id ), tile );
+    QVERIFY( cache.cachedTile( id ) == 0 );
+    QCOMPARE( cache.count(), 0 );
+    QCOMPARE( cache.byteCount(), qint64( 0 ) );
+    cache.insertDisplayedTile( id, tile );
+    QCOMPARE( cache.displayedTile( id ), tile );
+
+    cache.clear();
+    QCOMPARE( cache.count(), 0 );
+    QCOMPARE( cache.byteCount(), qint64( 0 ) );
+}
+
+void StackedTileCacheTest::testEviction()
+{
+    StackedTileCache cache( 1 );
+    cache.setCapacity( 3 * tileByteCount() );
+
+    for ( int x = 0; x < 4; ++x ) {
+        const TileId id( 0, 2, x, 0 );
+        cache.insertCachedTile( id, createTile( id ) );
+    }
+
+    // the least recently used tile is gone
+    QCOMPARE( cache.count(), 3 );
+    QCOMPARE( cache.evictionCount(), 1 );
+    QVERIFY( cache.byteCount() <= cache.capacity() );
+    QVERIFY( cache.cachedTile( TileId( 0, 2, 0, 0 ) ) == 0 );
+    QVERIFY( cache.cachedTile( TileId( 0, 2, 3, 0 ) ) != 0 );
+
+    // reinserting a tile makes it the most recently used one
+    const TileId id( 0, 2, 1, 0 );
+    cache.insertCachedTile( id, cache.takeCachedTile( id ) );
+    const TileId next( 0, 2, 4, 0 );
+    cache.insertCachedTile( next, createTile( next ) );
+    QVERIFY( cache.cachedTile( id ) != 0 );
+    QVERIFY( cache.cachedTile( TileId( 0, 2, 2, 0 ) ) == 0 );
+    QCOMPARE( cache.evictionCount(), 2 );
+
+    // shrinking the budget evicts right away
+    cache.setCapacity( tileByteCount() );
+    QCOMPARE( cache.count(), 1 );
+    QCOMPARE( cache.evictionCount(), 4 );
+    QVERIFY( cache.cachedTile( next ) != 0 );
+}
+
+void StackedTileCacheTest::testHighestLevelFirst()
+{
+    StackedTileCache cache( 1 );
+    cache.setCapacity( 3 * tileByteCount() );
+
+    const TileId oldest( 0, 1, 0, 0 );
+    const TileId highest( 0, 3, 0, 0 );
+    const TileId middle( 0, 2, 0, 0 );
+    const TileId newest( 0, 1, 1, 0 );
+    cache.insertCachedTile( oldest, createTile( oldest ) );
+    cache.insertCachedTile( highest, createTile( highest ) );
+    cache.insertCachedTile( middle, createTile( middle ) );
+    cache.insertCachedTile( newest, createTile( newest ) );
+
+    // the tiles of lower levels serve as ancestors of placeholders
+    QCOMPARE( cache.evictionCount(), 1 );
+    QVERIFY( cache.cachedTile( highest ) == 0 );
+    QVERIFY( cache.cachedTile( oldest ) != 0 );
+    QVERIFY( cache.cachedTile( middle ) != 0 );
+    QVERIFY( cache.cachedTile( newest ) != 0 );
+}
+
+void StackedTileCacheTest::testOneBudgetForAllShards()
+{
+    const int shardCount = 16;
+    StackedTileCache cache( shardCount );
+    cache.setCapacity( 8 * tileByteCount() );
+
+    // four tiles in the same shard, twice the share of that shard in the budget
+    QList<TileId> ids;
+    for ( int x = 0; ids.size() < 4; ++x ) {
+        const TileId id( 0, 5, x, 0 );
+        if ( qHash( id ) % shardCount == qHash( TileId( 0, 5, 0, 0 ) ) % shardCount ) {
+            ids << id;
+        }
+    }
+
+    foreach ( const TileId &id, ids ) {
+        cache.insertCachedTile( id, createTile( id ) );
+    }
+
+    QCOMPARE( cache.evictionCount(), 0 );
+    QCOMPARE( cache.count(), 4 );
+    foreach ( const TileId &id, ids ) {
+        QVERIFY( cache.cachedTile( id ) != 0 );
+    }
+
+    // further tiles evict the oldest one of all shards
+    for ( int y = 1; y <= 5; ++y ) {
+        const TileId id( 0, 5, 0, y );
+        cache.insertCachedTile( id, createTile( id ) );
+    }
+
+    QCOMPARE( cache.evictionCount(), 1 );
+    QCOMPARE( cache.count(), 8 );
+    QVERIFY( cache.byteCount() <= cache.capacity() );
+    QVERIFY( cache.cachedTile( ids.first() ) == 0 );
+}
+
+void StackedTileCacheTest::testDisplayedTilesAreKept()
+{
+    StackedTileCache cache( 1 );
+    cache.setCapacity( 2 * tileByteCount() );
+
+    for ( int x = 0; x < 4; ++x ) {
+        const TileId id( 0, 2, x, 0 );
+        cache.insertDisplayedTile( id, createTile( id ) );
+    }
+
+    // the budget only applies to tiles which are not on display
+    QCOMPARE( cache.count(), 4 );
+    QCOMPARE( cache.evictionCount(), 0 );
+    QCOMPARE( cache.byteCount(), qint64( 4 * tileByteCount() ) );
+
+    for ( int x = 0; x < 4; ++x ) {
+        const TileId id( 0, 2, x, 0 );
+        cache.insertCachedTile( id, cache.takeDisplayedTile( id ) );
+    }
+
+    QCOMPARE( cache.count(), 2 );
+    QCOMPARE( cache.evictionCount(), 2 );
+    QVERIFY( cache.cachedTile( TileId( 0, 2, 2, 0 ) ) != 0 );
+    QVERIFY( cache.cachedTile( TileId( 0, 2, 3, 0 ) ) != 0 );
+}
+
+void StackedTileCacheTest::testCounters()
+{
+    StackedTileCache cache;
+    QCOMPARE( cache.hitCount(), 0 );
+    QCOMPARE( cache.missCount(), 0 );
+    QCOMPARE( cache.evictionCount(), 0 );
+
+    cache.countHit();
+    cache.countHit();
+    cache.countMiss();
+    QCOMPARE( cache.hitCount(), 2 );
+    QCOMPARE( cache.missCount(), 1 );
+
+    // clearing is no eviction
+    const TileId id( 0, 0, 0, 0 );
+    cache.insertCachedTile( id, createTile( id ) );
+    cache.clear();
+    QCOMPARE( cache.evictionCount(), 0 );
+}
+
+}
+
+QTEST_MAIN( Marble::StackedTileCacheTest )
+
+#include "StackedTileCacheTest.moc"
@@ -0,0 +1,240 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QSignalSpy>
+#include <QtTest>
+
+#include "GeoSceneTextureTile.h"
+#include "HttpDownloadManager.h"
+#include "MarbleDirs.h"
+#include "MergedLayerDecorator.h"
+#include "StackedTile.h"
+#include "StackedTileLoader.h"
+#include "TileId.h"
+#include "TileLoader.h"
+
+Q_DECLARE_METATYPE( Marble::TileId )
+
+namespace Marble
+{
+
+class StackedTileLoaderTest : public QObject
+{
+    Q_OBJECT
+
+ public:
+    StackedTileLoaderTest();
+
+ private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testSynchronousLoading();
+    void testAsynchronousLoading();
+    void testAsynchronousWithoutAncestor();
+    void testPlaceholder();
+    void testPrefetch();
+    void testPrefetchSynchronous();
+    void testPrefetchDoesNotReplaceLoadedTile();
+
+ private:
+    static bool waitFor( const QSignalSpy &spy, int count );
+
+    HttpDownloadManager m_downloadManager;
+    TileLoader m_tileLoader;
+    GeoSceneTextureTile m_texture;
+    MergedLayerDecorator *m_layerDecorator;
+    StackedTileLoader *m_loader;
+};
+
+StackedTileLoaderTest::StackedTileLoaderTest()
+    : m_downloadManager( 0 ),
+      m_tileLoader( &m_downloadManager, 0 ),
+      m_texture( "srtm_data" ),
+      m_layerDecorator( 0 ),
+      m_loader( 0 )
+{
+}
+
+void StackedTileLoaderTest::initTestCase()
+{
+    qRegisterMetaType<TileId>( "TileId" );
+
+    // level 0 of the bundled srtm map is available, all other levels are scaled from it
+    MarbleDirs::setMarbleDataPath( QString( MARBLE_SRC_DIR ).append( "/data" ) );
+    m_downloadManager.setDownloadEnabled( false );
+
+    m_texture.setSourceDir( "earth/srtm" );
+    m_texture.setFileFormat( "JPG" );
+    m_texture.setMaximumTileLevel( 5 );
+    m_texture.setLevelZeroColumns( 2 );
+    m_texture.setLevelZeroRows( 1 );
+}
+
+void StackedTileLoaderTest::init()
+{
+    m_layerDecorator = new MergedLayerDecorator( &m_tileLoader, 0 );
+    m_layerDecorator->setTextureLayers( QVector<const GeoSceneTextureTile *>() << &m_texture );
+    m_loader = new StackedTileLoader( m_layerDecorator );
+}
+
+void StackedTileLoaderTest::cleanup()
+{
+    delete m_loader;
+    m_loader = 0;
+    delete m_layerDecorator;
+    m_layerDecorator = 0;
+}
+
+bool StackedTileLoaderTest::waitFor( const QSignalSpy &spy, int count )
+{
+    for ( int i = 0; i < 100 && spy.count() < count; ++i ) {
+        QTest::qWait( 50 );
+    }
+
+    return spy.count() >= count;
+}
+
+void StackedTileLoaderTest::testSynchronousLoading()
+{
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+
+    const StackedTile *tile = m_loader->loadTile( TileId( 0, 0, 0, 0 ) );
+    QVERIFY( tile != 0 );
+    QVERIFY( !tile->resultImage()->isNull() );
+    QCOMPARE( tile->id(), TileId( 0, 0, 0, 0 ) );
+    QCOMPARE( m_loader->loadTile( TileId( 0, 0, 0, 0 ) ), tile );
+
+    QVERIFY( m_loader->loadTile( TileId( 0, 2, 1, 3 ) ) != 0 );
+    QCOMPARE( m_loader->cacheMissCount(), 2 );
+    QCOMPARE( m_loader->cacheHitCount(), 1 );
+
+    // the caller got the tiles already
+    QTest::qWait( 100 );
+    QCOMPARE( loadedSpy.count(), 0 );
+}
+
+void StackedTileLoaderTest::testAsynchronousLoading()
+{
+    m_loader->setAsynchronous( true );
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+
+    // the ancestor of the placeholders below
+    QVERIFY( m_loader->loadTile( TileId( 0, 0, 0, 0 ) ) != 0 );
+
+    const TileId id( 0, 1, 1, 0 );
+    const StackedTile *placeholder = m_loader->loadTile( id );
+    QVERIFY( placeholder != 0 );
+    QCOMPARE( placeholder->id(), id );
+    QCOMPARE( placeholder->resultImage()->size(), m_loader->tileSize() );
+    QCOMPARE( loadedSpy.count(), 0 );
+
+    QVERIFY( waitFor( loadedSpy, 1 ) );
+    QCOMPARE( loadedSpy.count(), 1 );
+    QCOMPARE( loadedSpy.first().first().value<TileId>(), id );
+
+    const StackedTile *tile = m_loader->loadTile( id );
+    QVERIFY( tile != 0 );
+    QCOMPARE( tile->id(), id );
+    QCOMPARE( m_loader->visibleTiles().count(), 2 );
+}
+
+void StackedTileLoaderTest::testAsynchronousWithoutAncestor()
+{
+    m_loader->setAsynchronous( true );
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+
+    // nothing to scale a placeholder from, so the tile is loaded right away
+    const StackedTile *tile = m_loader->loadTile( TileId( 0, 3, 2, 1 ) );
+    QVERIFY( tile != 0 );
+    QCOMPARE( tile->id(), TileId( 0, 3, 2, 1 ) );
+
+    QTest::qWait( 100 );
+    QCOMPARE( loadedSpy.count(), 0 );
+}
+
+void StackedTileLoaderTest::testPlaceholder()
+{
+    m_loader->setAsynchronous( true );
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+
+    QVERIFY( !m_loader->loadTile( TileId( 0, 0, 1, 0 ) )->isPlaceholder() );
+
+    const TileId id( 0, 2, 6, 1 );
+    QVERIFY( m_loader->loadTile( id )->isPlaceholder() );
+    // the same placeholder is on display until the tile has been loaded
+    QVERIFY( m_loader->loadTile( id )->isPlaceholder() );
+
+    QVERIFY( waitFor( loadedSpy, 1 ) );
+    QVERIFY( !m_loader->loadTile( id )->isPlaceholder() );
+
+    // placeholders don't end up in the cache
+    m_loader->resetTilehash();
+    m_loader->cleanupTilehash();
+    QCOMPARE( m_loader->visibleTiles().count(), 0 );
+    QCOMPARE( m_loader->tileCount(), 2 );
+}
+
+void StackedTileLoaderTest::testPrefetch()
+{
+    m_loader->setAsynchronous( true );
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+    QSignalSpy prefetchedSpy( m_loader, SIGNAL(tilePrefetched(TileId)) );
+
+    const TileId id( 0, 1, 2, 1 );
+    QVERIFY( m_loader->prefetchTile( id ) );
+    QVERIFY( !m_loader->prefetchTile( id ) );
+    QCOMPARE( m_loader->prefetchingTileCount(), 1 );
+
+    QVERIFY( waitFor( prefetchedSpy, 1 ) );
+    QCOMPARE( prefetchedSpy.first().first().value<TileId>(), id );
+    QCOMPARE( m_loader->prefetchingTileCount(), 0 );
+    QCOMPARE( loadedSpy.count(), 0 );
+
+    // the tile is in memory now
+    QVERIFY( !m_loader->prefetchTile( id ) );
+    const StackedTile *tile = m_loader->loadTile( id );
+    QVERIFY( !tile->isPlaceholder() );
+    QCOMPARE( m_loader->cacheHitCount(), 1 );
+    QCOMPARE( m_loader->cacheMissCount(), 0 );
+}
+
+void StackedTileLoaderTest::testPrefetchSynchronous()
+{
+    QVERIFY( !m_loader->isAsynchronous() );
+
+    QVERIFY( !m_loader->prefetchTile( TileId( 0, 1, 2, 1 ) ) );
+    QCOMPARE( m_loader->prefetchingTileCount(), 0 );
+    QCOMPARE( m_loader->tileCount(), 0 );
+}
+
+void StackedTileLoaderTest::testPrefetchDoesNotReplaceLoadedTile()
+{
+    m_loader->setAsynchronous( true );
+    QSignalSpy loadedSpy( m_loader, SIGNAL(tileLoaded(TileId)) );
+    QSignalSpy prefetchedSpy( m_loader, SIGNAL(tilePrefetched(TileId)) );
+
+    const TileId id( 0, 1, 3, 0 );
+    QVERIFY( m_loader->prefetchTile( id ) );
+
+    // without an ancestor in memory, the tile is loaded right away while the prefetch job is pending
+    const StackedTile *tile = m_loader->loadTile( id );
+    QVERIFY( !tile->isPlaceholder() );
+
+    QVERIFY( waitFor( prefetchedSpy, 1 ) );
+    QCOMPARE( loadedSpy.count(), 0 );
+    QCOMPARE( m_loader->loadTile( id ), tile );
+    QCOMPARE( m_loader->tileCount(), 1 );
+}
+
+}
+
+QTEST_MAIN( Marble::StackedTileLoaderTest )
+
+#include "StackedTileLoaderTest.moc"
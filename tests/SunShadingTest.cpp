@@ -0,0 +1,221 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QDateTime>
+#include <QImage>
+#include <QtTest>
+
+#include <cmath>
+
+#include "MarbleClock.h"
+#include "MarbleGlobal.h"
+#include "Planet.h"
+#include "SunLocator.h"
+#include "SunShading.h"
+#include "TileId.h"
+#include "TileLoaderHelper.h"
+
+Q_DECLARE_METATYPE( Marble::TileId )
+
+namespace Marble
+{
+
+class SunShadingTest : public QObject
+{
+    Q_OBJECT
+
+ public:
+    SunShadingTest();
+
+ private slots:
+    void initTestCase();
+
+    void testShade_data();
+    void testShade();
+
+    void testComposite_data();
+    void testComposite();
+
+    void benchmarkPixelShade();
+    void benchmarkShade();
+
+ private:
+    void setDateTime( const QDateTime &dateTime );
+
+    // shades every pixel on its own, as done before the scanline engine
+    void pixelShade( QImage *tileImage, const QImage *nightImage, const TileId &id ) const;
+
+    static QImage createImage( int seed );
+
+    MarbleClock m_clock;
+    Planet m_planet;
+    SunLocator m_sunLocator;
+    QImage m_day;
+    QImage m_night;
+};
+
+SunShadingTest::SunShadingTest()
+    : m_planet( "earth" ),
+      m_sunLocator( &m_clock, &m_planet )
+{
+}
+
+void SunShadingTest::initTestCase()
+{
+    m_day = createImage( 1 );
+    m_night = createImage( 2 );
+}
+
+QImage SunShadingTest::createImage( int seed )
+{
+    qsrand( seed );
+
+    QImage result( c_defaultTileSize, c_defaultTileSize, QImage::Format_ARGB32_Premultiplied );
+    for ( uint y = 0; y < c_defaultTileSize; ++y ) {
+        QRgb *line = (QRgb *)result.scanLine( y );
+        for ( uint x = 0; x < c_defaultTileSize; ++x ) {
+            line[x] = qRgb( qrand() % 256, qrand() % 256, qrand() % 256 );
+        }
+    }
+
+    return result;
+}
+
+void SunShadingTest::setDateTime( const QDateTime &dateTime )
+{
+    m_clock.setDateTime( dateTime );
+    m_sunLocator.update();
+}
+
+void SunShadingTest::pixelShade( QImage *tileImage, const QImage *nightImage, const TileId &id ) const
+{
+    const int tileHeight = tileImage->height();
+    const int tileWidth = tileImage->width();
+    const qreal global_width = tileWidth * TileLoaderHelper::levelToColumn( 2, id.zoomLevel() );
+    const qreal global_height = tileHeight * TileLoaderHelper::levelToRow( 1, id.zoomLevel() );
+    const qreal lon_scale = 2*M_PI / global_width;
+    const qreal lat_scale = -M_PI / global_height;
+
+    for ( int y = 0; y < tileHeight; ++y ) {
+        const qreal lat = lat_scale * ( id.y() * tileHeight + y ) - 0.5*M_PI;
+        const qreal a = sin( ( lat + DEG2RAD * m_sunLocator.getLat() ) / 2.0 );
+        const qreal c = cos( lat ) * cos( -DEG2RAD * m_sunLocator.getLat() );
+
+        QRgb *scanline = (QRgb *)tileImage->scanLine( y );
+        const QRgb *nightScanline = nightImage ? (const QRgb *)nightImage->scanLine( y ) : 0;
+
+        for ( int x = 0; x < tileWidth; ++x ) {
+            const qreal lon = lon_scale * ( id.x() * tileWidth + x );
+            const qreal shade = m_sunLocator.shading( lon, a, c );
+            if ( nightScanline ) {
+                m_sunLocator.shadePixelComposite( scanline[x], nightScanline[x], shade );
+            }
+            else {
+                m_sunLocator.shadePixel( scanline[x], shade );
+            }
+        }
+    }
+}
+
+void SunShadingTest::testShade_data()
+{
+    QTest::addColumn<QDateTime>( "dateTime" );
+    QTest::addColumn<TileId>( "id" );
+
+    const QList<QDateTime> dateTimes = QList<QDateTime>()
+        << QDateTime( QDate( 2012, 3, 20 ), QTime( 5, 14 ), Qt::UTC )
+        << QDateTime( QDate( 2012, 6, 20 ), QTime( 23, 9 ), Qt::UTC )
+        << QDateTime( QDate( 2012, 12, 21 ), QTime( 11, 11 ), Qt::UTC )
+        << QDateTime( QDate( 2013, 8, 1 ), QTime( 17, 30 ), Qt::UTC );
+
+    foreach ( const QDateTime &dateTime, dateTimes ) {
+        // every tile of the levels 0 to 2 with a level zero layout of 2x1 tiles
+        for ( int level = 0; level <= 2; ++level ) {
+            const int columns = TileLoaderHelper::levelToColumn( 2, level );
+            const int rows = TileLoaderHelper::levelToRow( 1, level );
+            for ( int y = 0; y < rows; ++y ) {
+                for ( int x = 0; x < columns; ++x ) {
+                    QTest::newRow( QString( "%1 %2/%3/%4" ).arg( dateTime.toString( Qt::ISODate ) )
+                                   .arg( level ).arg( x ).arg( y ).toLatin1() )
+                        << dateTime << TileId( 0, level, x, y );
+                }
+            }
+        }
+    }
+}
+
+void SunShadingTest::testShade()
+{
+    QFETCH( QDateTime, dateTime );
+    QFETCH( TileId, id );
+
+    setDateTime( dateTime );
+
+    QImage expected = m_day;
+    pixelShade( &expected, 0, id );
+
+    QImage result = m_day;
+    const SunShading sunShading( &m_sunLocator );
+    sunShading.shade( &result, id, 2, 1 );
+
+    QVERIFY( result == expected );
+}
+
+void SunShadingTest::testComposite_data()
+{
+    testShade_data();
+}
+
+void SunShadingTest::testComposite()
+{
+    QFETCH( QDateTime, dateTime );
+    QFETCH( TileId, id );
+
+    setDateTime( dateTime );
+
+    QImage expected = m_day;
+    pixelShade( &expected, &m_night, id );
+
+    QImage result = m_day;
+    const SunShading sunShading( &m_sunLocator );
+    sunShading.composite( &result, m_night, id, 2, 1 );
+
+    QVERIFY( result == expected );
+}
+
+void SunShadingTest::benchmarkPixelShade()
+{
+    setDateTime( QDateTime( QDate( 2012, 3, 20 ), QTime( 5, 14 ), Qt::UTC ) );
+
+    QBENCHMARK {
+        for ( int x = 0; x < 4; ++x ) {
+            QImage result = m_day;
+            pixelShade( &result, 0, TileId( 0, 1, x, 0 ) );
+        }
+    }
+}
+
+void SunShadingTest::benchmarkShade()
+{
+    setDateTime( QDateTime( QDate( 2012, 3, 20 ), QTime( 5, 14 ), Qt::UTC ) );
+
+    const SunShading sunShading( &m_sunLocator );
+
+    QBENCHMARK {
+        for ( int x = 0; x < 4; ++x ) {
+            QImage result = m_day;
+            sunShading.shade( &result, TileId( 0, 1, x, 0 ), 2, 1 );
+        }
+    }
+}
+
+}
+
+QTEST_MAIN( Marble::SunShadingTest )
+
+#include "SunShadingTest.moc"
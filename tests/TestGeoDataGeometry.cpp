@@ -26,6 +26,10 @@ private slots:
     void deleteAndDetachTest1();
     void deleteAndDetachTest2();
     void deleteAndDetachTest3();
+    void packedNodesTest();
+    void packedNodesDetachTest();
+    void packedNodesConstIteratorTest();
+    void revisionTest();
 };
 
 void TestGeoDataGeometry::downcastPointTest_data()
@@ -85,6 +89,162 @@ void TestGeoDataGeometry::deleteAndDetachTest3()
     line2 << GeoDataCoordinates();
 }
 
+/**
+ * The packed nodes of a line string and the GeoDataCoordinates they are
+ * unpacked into have to agree.
+ */
+void TestGeoDataGeometry::packedNodesTest()
+{
+    GeoDataLinearRing ring;
+    ring << GeoDataCoordinates( 0.1, 0.2 );
+    ring << GeoDataCoordinates( 0.3, -0.4, 100.0, GeoDataCoordinates::Radian, 2 );
+    ring << GeoDataCoordinates( -0.5, 0.6, 0.0, GeoDataCoordinates::Radian, 3 );
+    ring << GeoDataCoordinates( 3.0, 1.0, -50.0 );
+
+    ring.remove( 2 );
+    QCOMPARE( ring.size(), 3 );
+
+    GeoDataLineString appended;
+    appended << ring;
+    QCOMPARE( appended.size(), 3 );
+
+    const qreal length = ring.length( 1.0 );
+    const GeoDataLatLonAltBox box = ring.latLonAltBox();
+    QVERIFY( ring.contains( GeoDataCoordinates( 1.0, 0.2 ) ) );
+
+    // reads the packed nodes
+    const GeoDataLinearRing &constRing = ring;
+    for ( int i = 0; i < constRing.size(); ++i ) {
+        QCOMPARE( constRing.at( i ).longitude(), appended.longitude( i ) );
+        QCOMPARE( constRing.at( i ).latitude(), appended.latitude( i ) );
+        QCOMPARE( constRing.at( i ).altitude(), appended.altitude( i ) );
+        QCOMPARE( constRing.at( i ).detail(), appended.detail( i ) );
+        QCOMPARE( constRing.longitude( i ), appended.longitude( i ) );
+    }
+
+    QCOMPARE( appended.detail( 1 ), 2 );
+    QCOMPARE( appended.altitude( 2 ), -50.0 );
+    QCOMPARE( ring.length( 1.0 ), length );
+    QCOMPARE( GeoDataLatLonAltBox::fromLineString( ring ), box );
+    QVERIFY( ring.contains( GeoDataCoordinates( 1.0, 0.2 ) ) );
+
+    // changes through references are visible to the accessors
+    ring.at( 0 ).setLongitude( 0.7 );
+    QCOMPARE( ring.longitude( 0 ), 0.7 );
+
+    QByteArray data;
+    {
+        QDataStream stream( &data, QIODevice::WriteOnly );
+        appended.pack( stream );
+    }
+    GeoDataLineString unpacked;
+    {
+        QDataStream stream( &data, QIODevice::ReadOnly );
+        unpacked.unpack( stream );
+    }
+    QCOMPARE( unpacked.size(), appended.size() );
+    for ( int i = 0; i < unpacked.size(); ++i ) {
+        QCOMPARE( unpacked.at( i ), appended.at( i ) );
+    }
+
+    ring.clear();
+    QVERIFY( ring.isEmpty() );
+    ring << GeoDataCoordinates( 0.1, 0.2, 5.0 );
+    QCOMPARE( ring.altitude( 0 ), 5.0 );
+}
+
+/**
+ * Unpacking the nodes of a shared line string must not affect its copies.
+ */
+void TestGeoDataGeometry::packedNodesDetachTest()
+{
+    GeoDataLineString line1;
+    line1 << GeoDataCoordinates( 0.1, 0.2 ) << GeoDataCoordinates( 0.3, 0.4 );
+    GeoDataLineString line2 = line1;
+
+    line2.at( 1 ).setLatitude( 0.5 );
+    QCOMPARE( line1.latitude( 1 ), 0.4 );
+    QCOMPARE( line2.latitude( 1 ), 0.5 );
+
+    line1 << GeoDataCoordinates( 0.6, 0.7 );
+    QCOMPARE( line1.size(), 3 );
+    QCOMPARE( line2.size(), 2 );
+}
+
+/**
+ * The const iterators have to agree with the accessors, whether the nodes
+ * are packed or not.
+ */
+void TestGeoDataGeometry::packedNodesConstIteratorTest()
+{
+    GeoDataLineString line;
+    line << GeoDataCoordinates( 0.1, 0.2 );
+    line << GeoDataCoordinates( 0.3, -0.4, 100.0, GeoDataCoordinates::Radian, 2 );
+    line << GeoDataCoordinates( -0.5, 0.6 );
+
+    for ( int pass = 0; pass < 2; ++pass ) {
+        const GeoDataLineString &constLine = line;
+        QCOMPARE( constLine.constEnd() - constLine.constBegin(), constLine.size() );
+        QCOMPARE( constLine.end() - constLine.begin(), constLine.size() );
+
+        int i = 0;
+        GeoDataLineString::ConstIterator it = constLine.constBegin();
+        for ( ; it != constLine.constEnd(); ++it, ++i ) {
+            QCOMPARE( it->longitude(), line.longitude( i ) );
+            QCOMPARE( it->latitude(), line.latitude( i ) );
+            QCOMPARE( it->altitude(), line.altitude( i ) );
+            QCOMPARE( it->detail(), line.detail( i ) );
+            QCOMPARE( *it, constLine.at( i ) );
+        }
+        QCOMPARE( i, 3 );
+
+        GeoDataLineString::ConstIterator second = constLine.constBegin() + 1;
+        QVERIFY( constLine.constBegin() < second );
+        QCOMPARE( second[ 1 ], constLine.last() );
+        QCOMPARE( *( second - 1 ), constLine.first() );
+        QCOMPARE( *( constLine.constEnd() - 1 ), constLine.last() );
+
+        // unpacks the nodes for the second pass
+        line.at( 0 );
+    }
+
+    // a copy keeps the nodes it had
+    GeoDataLineString copy = line;
+    const GeoDataLineString &constCopy = copy;
+    const GeoDataCoordinates first = *constCopy.constBegin();
+    line.at( 0 ).setLongitude( 0.7 );
+    QCOMPARE( constCopy.constBegin()->longitude(), first.longitude() );
+}
+
+void TestGeoDataGeometry::revisionTest()
+{
+    GeoDataLineString line;
+    line << GeoDataCoordinates( 0.1, 0.2 ) << GeoDataCoordinates( 0.3, 0.4 );
+    const quint64 revision = line.revision();
+
+    // const access is no change
+    line.latLonAltBox();
+    QCOMPARE( line.at( 1 ), GeoDataCoordinates( 0.3, 0.4 ) );
+    QCOMPARE( line.revision(), revision );
+
+    // the same number of nodes
+    line[1] = GeoDataCoordinates( 0.5, 0.6 );
+    QVERIFY( line.revision() != revision );
+
+    // a copy shares the revision until either of them changes
+    GeoDataLineString copy = line;
+    QCOMPARE( copy.revision(), line.revision() );
+    copy.setTessellate( true );
+    QVERIFY( copy.revision() != line.revision() );
+
+    // another line string with as many changes has another revision
+    GeoDataLineString other;
+    other << GeoDataCoordinates( 0.1, 0.2 ) << GeoDataCoordinates( 0.3, 0.4 );
+    const quint64 lineRevision = line.revision();
+    line = other;
+    QVERIFY( line.revision() != lineRevision );
+}
+
 QTEST_MAIN( TestGeoDataGeometry )
 #include "TestGeoDataGeometry.moc"
 
@@ -0,0 +1,200 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QImage>
+#include <QtTest>
+
+#include "GeoDataCoordinates.h"
+#include "GeoDataDocument.h"
+#include "GeoDataLinearRing.h"
+#include "GeoDataPlacemark.h"
+#include "TextureColorizer.h"
+#include "VectorComposer.h"
+#include "ViewportParams.h"
+
+Q_DECLARE_METATYPE( Marble::Projection )
+
+namespace Marble
+{
+
+class TextureColorizerTest : public QObject
+{
+    Q_OBJECT
+
+ public:
+    TextureColorizerTest();
+    ~TextureColorizerTest();
+
+ private slots:
+    void testPan_data();
+    void testPan();
+    void testChangedDocuments();
+
+ private:
+    static GeoDataPlacemark *createIsland( qreal west, qreal south, qreal east, qreal north );
+    QImage colorizeFresh( const GeoDataDocument *land, const ViewportParams *viewport );
+    static QImage greyImage( const QSize &size );
+    QImage colorize( TextureColorizer *colorizer, const ViewportParams *viewport ) const;
+    static int differences( const QImage &image1, const QImage &image2 );
+
+    VectorComposer m_vectorComposer;
+    GeoDataDocument m_land;
+};
+
+TextureColorizerTest::TextureColorizerTest()
+{
+    m_land.append( createIsland( -40.0, -30.0, 10.0, 20.0 ) );
+    m_land.append( createIsland( 30.0, 40.0, 60.0, 70.0 ) );
+    m_land.append( createIsland( 150.0, -60.0, 175.0, -10.0 ) );
+}
+
+TextureColorizerTest::~TextureColorizerTest()
+{
+}
+
+GeoDataPlacemark *TextureColorizerTest::createIsland( qreal west, qreal south, qreal east, qreal north )
+{
+    GeoDataLinearRing *ring = new GeoDataLinearRing;
+    *ring << GeoDataCoordinates( west, south, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( east, south + 5.0, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( east - 5.0, north, 0.0, GeoDataCoordinates::Degree )
+          << GeoDataCoordinates( west + 3.0, north - 7.0, 0.0, GeoDataCoordinates::Degree );
+
+    GeoDataPlacemark *placemark = new GeoDataPlacemark;
+    placemark->setGeometry( ring );
+
+    return placemark;
+}
+
+QImage TextureColorizerTest::greyImage( const QSize &size )
+{
+    QImage image( size, QImage::Format_RGB32 );
+    for ( int y = 0; y < size.height(); ++y ) {
+        for ( int x = 0; x < size.width(); ++x ) {
+            const int grey = ( 3 * x + 7 * y ) % 256;
+            image.setPixel( x, y, qRgb( grey, grey, grey ) );
+        }
+    }
+
+    return image;
+}
+
+QImage TextureColorizerTest::colorize( TextureColorizer *colorizer, const ViewportParams *viewport ) const
+{
+    QImage image = greyImage( viewport->size() );
+    colorizer->colorize( &image, viewport, NormalQuality );
+
+    return image;
+}
+
+QImage TextureColorizerTest::colorizeFresh( const GeoDataDocument *land, const ViewportParams *viewport )
+{
+    TextureColorizer colorizer( QString( MARBLE_SRC_DIR ).append( "/data/seacolors.leg" ),
+                                QString( MARBLE_SRC_DIR ).append( "/data/landcolors.leg" ),
+                                &m_vectorComposer );
+    colorizer.setShowRelief( false );
+    colorizer.addLandDocument( land );
+
+    return colorize( &colorizer, viewport );
+}
+
+int TextureColorizerTest::differences( const QImage &image1, const QImage &image2 )
+{
+    int count = 0;
+    for ( int y = 0; y < image1.height(); ++y ) {
+        for ( int x = 0; x < image1.width(); ++x ) {
+            if ( image1.pixel( x, y ) != image2.pixel( x, y ) ) {
+                ++count;
+            }
+        }
+    }
+
+    return count;
+}
+
+void TextureColorizerTest::testPan_data()
+{
+    QTest::addColumn<Projection>( "projection" );
+    QTest::addColumn<qreal>( "lonPixels" );
+    QTest::addColumn<qreal>( "latPixels" );
+
+    // whole pixels translate the coast image, anything else draws it again
+    QTest::newRow( "equirect" ) << Equirectangular << qreal( 17 ) << qreal( -9 );
+    QTest::newRow( "equirect across date line" ) << Equirectangular << qreal( -150 ) << qreal( 0 );
+    QTest::newRow( "equirect half pixel" ) << Equirectangular << qreal( 10.5 ) << qreal( 3 );
+    QTest::newRow( "equirect out of view" ) << Equirectangular << qreal( 250 ) << qreal( 0 );
+    QTest::newRow( "mercator" ) << Mercator << qreal( -23 ) << qreal( 0 );
+    QTest::newRow( "mercator north, drawn again" ) << Mercator << qreal( 0 ) << qreal( 12 );
+    QTest::newRow( "spherical" ) << Spherical << qreal( 17 ) << qreal( -9 );
+}
+
+void TextureColorizerTest::testPan()
+{
+    QFETCH( Projection, projection );
+    QFETCH( qreal, lonPixels );
+    QFETCH( qreal, latPixels );
+
+    const int radius = 100;
+    const qreal pixel = M_PI / ( 2.0 * radius );
+    const QString seaFile = QString( MARBLE_SRC_DIR ).append( "/data/seacolors.leg" );
+    const QString landFile = QString( MARBLE_SRC_DIR ).append( "/data/landcolors.leg" );
+
+    ViewportParams viewport( projection, 0.4, 0.2, radius, QSize( 240, 160 ) );
+
+    TextureColorizer colorizer( seaFile, landFile, &m_vectorComposer );
+    colorizer.setShowRelief( false );
+    colorizer.addLandDocument( &m_land );
+    colorize( &colorizer, &viewport );
+
+    viewport.centerOn( viewport.centerLongitude() - lonPixels * pixel,
+                       viewport.centerLatitude() + latPixels * pixel );
+    const QImage panned = colorize( &colorizer, &viewport );
+
+    TextureColorizer freshColorizer( seaFile, landFile, &m_vectorComposer );
+    freshColorizer.setShowRelief( false );
+    freshColorizer.addLandDocument( &m_land );
+    const QImage expected = colorize( &freshColorizer, &viewport );
+
+    // the coast lines may be rasterized a little differently along the strips drawn anew
+    QVERIFY( differences( panned, expected ) <= 16 );
+}
+
+}
+
+void TextureColorizerTest::testChangedDocuments()
+{
+    GeoDataDocument land;
+    land.append( createIsland( -40.0, -30.0, 10.0, 20.0 ) );
+
+    ViewportParams viewport( Equirectangular, 0.4, 0.2, 100, QSize( 240, 160 ) );
+
+    TextureColorizer colorizer( QString( MARBLE_SRC_DIR ).append( "/data/seacolors.leg" ),
+                                QString( MARBLE_SRC_DIR ).append( "/data/landcolors.leg" ),
+                                &m_vectorComposer );
+    colorizer.setShowRelief( false );
+    colorizer.addLandDocument( &land );
+    const QImage first = colorize( &colorizer, &viewport );
+
+    // another island
+    land.append( createIsland( 30.0, 40.0, 60.0, 70.0 ) );
+    const QImage added = colorize( &colorizer, &viewport );
+    QVERIFY( differences( added, first ) > 0 );
+    QCOMPARE( differences( added, colorizeFresh( &land, &viewport ) ), 0 );
+
+    // a moved coast line of the first island
+    GeoDataPlacemark *const island = static_cast<GeoDataPlacemark *>( land.child( 0 ) );
+    GeoDataLinearRing *const ring = static_cast<GeoDataLinearRing *>( island->geometry() );
+    ( *ring )[1] = GeoDataCoordinates( 20.0, -20.0, 0.0, GeoDataCoordinates::Degree );
+    const QImage moved = colorize( &colorizer, &viewport );
+    QVERIFY( differences( moved, added ) > 0 );
+    QCOMPARE( differences( moved, colorizeFresh( &land, &viewport ) ), 0 );
+}
+
+QTEST_MAIN( Marble::TextureColorizerTest )
+
+#include "TextureColorizerTest.moc"
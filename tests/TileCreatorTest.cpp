@@ -0,0 +1,273 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QImage>
+#include <QTime>
+#include <QtTest>
+
+#include "MarbleGlobal.h"
+#include "TileCreator.h"
+
+namespace Marble
+{
+
+/**
+ * Source of a synthetic image which is 4 tiles high, resulting in tile levels 0 to 2.
+ */
+class TestTileSource : public TileCreatorSource
+{
+ public:
+    virtual QSize fullImageSize() const
+    {
+        return QSize( 8 * c_defaultTileSize, 4 * c_defaultTileSize );
+    }
+
+    virtual QImage tile( int n, int m, int maxTileLevel )
+    {
+        Q_UNUSED( maxTileLevel );
+
+        QImage result( c_defaultTileSize, c_defaultTileSize, QImage::Format_ARGB32 );
+        for ( uint y = 0; y < c_defaultTileSize; ++y ) {
+            QRgb *line = (QRgb *) result.scanLine( y );
+            for ( uint x = 0; x < c_defaultTileSize; ++x ) {
+                line[x] = qRgb( ( x + 32 * m ) % 256, ( y + 32 * n ) % 256, ( x ^ y ) % 256 );
+            }
+        }
+
+        return result;
+    }
+};
+
+class TileCreatorTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void init();
+    void cleanup();
+
+    void testThreadCount_data();
+    void testThreadCount();
+    void testDefaultThreadCount();
+    void testResume();
+    void testWriteFailure();
+
+    void benchmarkTileCreation_data();
+    void benchmarkTileCreation();
+
+ private:
+    static void createTiles( const QString &targetDir, int threadCount, bool resume = false );
+    static QStringList tileFiles( const QString &targetDir );
+    static bool compareTiles( const QString &fileName, const QString &referenceFileName );
+    static void removeDirectory( const QString &path );
+
+    QString m_referenceDir;
+    QString m_targetDir;
+};
+
+void TileCreatorTest::init()
+{
+    const QString baseDir = QDir::tempPath() + QString( "/marble-tilecreatortest-%1" ).arg( QCoreApplication::applicationPid() );
+    m_referenceDir = baseDir + "/reference";
+    m_targetDir = baseDir + "/target";
+}
+
+void TileCreatorTest::cleanup()
+{
+    removeDirectory( QFileInfo( m_targetDir ).absolutePath() );
+}
+
+void TileCreatorTest::createTiles( const QString &targetDir, int threadCount, bool resume )
+{
+    TileCreator creator( new TestTileSource, "false", targetDir );
+    creator.setTileFormat( "png" );
+    creator.setThreadCount( threadCount );
+    creator.setResume( resume );
+    creator.start();
+    creator.wait();
+}
+
+QStringList TileCreatorTest::tileFiles( const QString &targetDir )
+{
+    QStringList result;
+
+    QDirIterator it( targetDir, QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        it.next();
+        result << QDir( targetDir ).relativeFilePath( it.filePath() );
+    }
+
+    result.sort();
+    return result;
+}
+
+/**
+ * QCOMPARE can't print QImages without QtGui support in QtTest, so this
+ * reports where the tiles differ instead.
+ */
+bool TileCreatorTest::compareTiles( const QString &fileName, const QString &referenceFileName )
+{
+    const QImage tile( fileName );
+    const QImage reference( referenceFileName );
+
+    if ( tile.size() != reference.size() ) {
+        qWarning() << fileName << "has size" << tile.size() << "instead of" << reference.size();
+        return false;
+    }
+
+    for ( int y = 0; y < reference.height(); ++y ) {
+        for ( int x = 0; x < reference.width(); ++x ) {
+            if ( tile.pixel( x, y ) != reference.pixel( x, y ) ) {
+                qWarning() << fileName << "differs at" << x << y << ":" << hex
+                           << tile.pixel( x, y ) << "instead of" << reference.pixel( x, y );
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void TileCreatorTest::removeDirectory( const QString &path )
+{
+    QDirIterator it( path, QDir::Files, QDirIterator::Subdirectories );
+    while ( it.hasNext() ) {
+        QFile::remove( it.next() );
+    }
+
+    QStringList dirs;
+    QDirIterator dirIt( path, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories );
+    while ( dirIt.hasNext() ) {
+        dirs << dirIt.next();
+    }
+
+    // remove the deepest directories first
+    dirs.sort();
+    for ( int i = dirs.size() - 1; i >= 0; --i ) {
+        QDir().rmdir( dirs.at( i ) );
+    }
+    QDir().rmdir( path );
+}
+
+void TileCreatorTest::testThreadCount_data()
+{
+    QTest::addColumn<int>( "threadCount" );
+
+    QTest::newRow( "two threads" ) << 2;
+    QTest::newRow( "eight threads" ) << 8;
+}
+
+void TileCreatorTest::testThreadCount()
+{
+    QFETCH( int, threadCount );
+
+    createTiles( m_referenceDir, 1 );
+    createTiles( m_targetDir, threadCount );
+
+    const QStringList files = tileFiles( m_referenceDir );
+
+    // 2 + 8 + 32 tiles of levels 0 to 2
+    QCOMPARE( files.size(), 42 );
+    QCOMPARE( tileFiles( m_targetDir ), files );
+
+    foreach ( const QString &file, files ) {
+        QVERIFY( compareTiles( m_targetDir + '/' + file, m_referenceDir + '/' + file ) );
+    }
+}
+
+void TileCreatorTest::testDefaultThreadCount()
+{
+    TileCreator creator( new TestTileSource, "false", m_targetDir );
+    QCOMPARE( creator.threadCount(), qMax( 1, QThread::idealThreadCount() ) );
+
+    creator.setThreadCount( 3 );
+    QCOMPARE( creator.threadCount(), 3 );
+}
+
+void TileCreatorTest::testResume()
+{
+    createTiles( m_referenceDir, 1 );
+    createTiles( m_targetDir, 1 );
+
+    QStringList const files = tileFiles( m_referenceDir );
+    QVERIFY( QFile::remove( m_targetDir + "/0/000000/000000_000001.png" ) );
+    QVERIFY( QFile::remove( m_targetDir + "/1/000001/000001_000002.png" ) );
+    QVERIFY( QFile::remove( m_targetDir + "/2/000003/000003_000007.png" ) );
+
+    TileCreator creator( new TestTileSource, "false", m_targetDir );
+    creator.setTileFormat( "png" );
+    creator.setResume( true );
+    creator.start();
+    creator.wait();
+
+    QCOMPARE( creator.createdTilesCount(), 3 );
+    QCOMPARE( tileFiles( m_targetDir ), files );
+
+    foreach ( const QString &file, files ) {
+        QVERIFY( compareTiles( m_targetDir + '/' + file, m_referenceDir + '/' + file ) );
+    }
+}
+
+void TileCreatorTest::testWriteFailure()
+{
+    TileCreator creator( new TestTileSource, "false", m_targetDir );
+    // there is no image writer for this format
+    creator.setTileFormat( "nonexistent" );
+    creator.setThreadCount( 2 );
+    creator.start();
+    creator.wait();
+
+    QCOMPARE( creator.createdTilesCount(), 0 );
+    QVERIFY( creator.failedTilesCount() > 0 );
+
+    // the next run starts over
+    creator.setTileFormat( "png" );
+    creator.start();
+    creator.wait();
+
+    QCOMPARE( creator.failedTilesCount(), 0 );
+    QCOMPARE( creator.createdTilesCount(), tileFiles( m_targetDir ).size() );
+}
+
+void TileCreatorTest::benchmarkTileCreation_data()
+{
+    QTest::addColumn<int>( "threadCount" );
+
+    QTest::newRow( "one thread" ) << 1;
+    QTest::newRow( "ideal thread count" ) << QThread::idealThreadCount();
+}
+
+void TileCreatorTest::benchmarkTileCreation()
+{
+    QFETCH( int, threadCount );
+
+    int tiles = 0;
+    QTime time;
+    time.start();
+
+    QBENCHMARK {
+        TileCreator creator( new TestTileSource, "false", m_targetDir );
+        creator.setTileFormat( "png" );
+        creator.setThreadCount( threadCount );
+        creator.start();
+        creator.wait();
+        tiles += creator.createdTilesCount();
+    }
+
+    const int elapsed = time.elapsed();
+    qDebug() << threadCount << "threads:" << ( elapsed > 0 ? 1000.0 * tiles / elapsed : 0.0 ) << "tiles/s";
+}
+
+}
+
+QTEST_MAIN( Marble::TileCreatorTest )
+
+#include "TileCreatorTest.moc"
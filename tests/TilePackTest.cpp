@@ -0,0 +1,251 @@
+//
+// This file is part of the Marble Virtual Globe.
+//
+// This program is free software licensed under the GNU LGPL. You can
+// find a copy of this license in LICENSE.txt in the top directory of
+// the source code.
+//
+
+#include <QDir>
+#include <QFile>
+#include <QtTest>
+
+#include "TilePack.h"
+
+namespace Marble
+{
+
+class TilePackTest : public QObject
+{
+    Q_OBJECT
+
+ private slots:
+    void init();
+    void cleanup();
+
+    void testInsertReadRemove();
+    void testReopen();
+    void testShrink();
+    void testCompact();
+    void testInterruptedCompactionBeforeCommit();
+    void testInterruptedCompactionAfterCommit();
+    void testLock();
+
+ private:
+    QString packFileName() const;
+    QString indexFileName() const;
+    static void copyFile( const QString &source, const QString &target );
+
+    QString m_directory;
+};
+
+void TilePackTest::init()
+{
+    m_directory = QDir::tempPath() + "/TilePackTest-" + QString::number( QCoreApplication::applicationPid() );
+    QDir::root().mkpath( m_directory );
+}
+
+void TilePackTest::cleanup()
+{
+    QDir directory( m_directory );
+    foreach ( const QString &fileName, directory.entryList( QDir::Files ) ) {
+        directory.remove( fileName );
+    }
+    QDir::root().rmdir( m_directory );
+}
+
+QString TilePackTest::packFileName() const
+{
+    return m_directory + "/tiles.pack";
+}
+
+QString TilePackTest::indexFileName() const
+{
+    return m_directory + "/tiles.pack.idx";
+}
+
+void TilePackTest::copyFile( const QString &source, const QString &target )
+{
+    QFile::remove( target );
+    QVERIFY( QFile::copy( source, target ) );
+}
+
+void TilePackTest::testInsertReadRemove()
+{
+    TilePack pack( packFileName() );
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.count(), 0 );
+
+    QVERIFY( pack.insert( "maps/earth/a.png", "first" ) );
+    QVERIFY( pack.insert( "maps/earth/b.png", "second" ) );
+    QVERIFY( pack.contains( "maps/earth/a.png" ) );
+    QVERIFY( pack.lastModified( "maps/earth/a.png" ).isValid() );
+    QCOMPARE( pack.count(), 2 );
+    QCOMPARE( pack.size(), qint64( 11 ) );
+
+    QByteArray data;
+    QVERIFY( pack.read( "maps/earth/b.png", data ) );
+    QCOMPARE( data, QByteArray( "second" ) );
+
+    // the replaced data is garbage now
+    QVERIFY( pack.insert( "maps/earth/a.png", "replaced" ) );
+    QVERIFY( pack.read( "maps/earth/a.png", data ) );
+    QCOMPARE( data, QByteArray( "replaced" ) );
+    QCOMPARE( pack.garbageSize(), qint64( 5 ) );
+
+    pack.remove( "maps/earth/b.png" );
+    QVERIFY( !pack.contains( "maps/earth/b.png" ) );
+    QVERIFY( !pack.read( "maps/earth/b.png", data ) );
+    QVERIFY( !pack.lastModified( "maps/earth/b.png" ).isValid() );
+    QCOMPARE( pack.count(), 1 );
+    QCOMPARE( pack.garbageSize(), qint64( 11 ) );
+
+    pack.clear();
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.count(), 0 );
+    QCOMPARE( pack.size(), qint64( 0 ) );
+}
+
+void TilePackTest::testReopen()
+{
+    {
+        TilePack pack( packFileName() );
+        QVERIFY( pack.insert( "maps/earth/a.png", "first" ) );
+        QVERIFY( pack.insert( "maps/earth/b.png", "second" ) );
+        pack.remove( "maps/earth/a.png" );
+    }
+
+    TilePack pack( packFileName() );
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.count(), 1 );
+    QVERIFY( !pack.contains( "maps/earth/a.png" ) );
+
+    QByteArray data;
+    QVERIFY( pack.read( "maps/earth/b.png", data ) );
+    QCOMPARE( data, QByteArray( "second" ) );
+}
+
+void TilePackTest::testShrink()
+{
+    TilePack pack( packFileName() );
+    for ( int i = 0; i < 10; ++i ) {
+        QVERIFY( pack.insert( QString( "maps/earth/%1.png" ).arg( i ), QByteArray( 100, 'x' ) ) );
+    }
+    QCOMPARE( pack.size(), qint64( 1000 ) );
+
+    pack.shrink( 450 );
+    QCOMPARE( pack.count(), 4 );
+    QCOMPARE( pack.size(), qint64( 400 ) );
+    QCOMPARE( pack.garbageSize(), qint64( 600 ) );
+
+    // nothing to do
+    pack.shrink( 1000 );
+    QCOMPARE( pack.count(), 4 );
+}
+
+void TilePackTest::testCompact()
+{
+    TilePack pack( packFileName() );
+    QVERIFY( pack.insert( "maps/earth/a.png", QByteArray( 100, 'a' ) ) );
+    QVERIFY( pack.insert( "maps/earth/b.png", QByteArray( 100, 'b' ) ) );
+    pack.remove( "maps/earth/a.png" );
+    const qint64 fileSize = QFileInfo( packFileName() ).size();
+
+    QVERIFY( pack.compact() );
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.garbageSize(), qint64( 0 ) );
+    QCOMPARE( pack.count(), 1 );
+    QCOMPARE( QFileInfo( packFileName() ).size(), fileSize - 100 );
+
+    QByteArray data;
+    QVERIFY( pack.read( "maps/earth/b.png", data ) );
+    QCOMPARE( data, QByteArray( 100, 'b' ) );
+
+    // no files are left behind
+    QVERIFY( !QFile::exists( packFileName() + ".compact" ) );
+    QVERIFY( !QFile::exists( indexFileName() + ".compact" ) );
+    QVERIFY( !QFile::exists( packFileName() + ".old" ) );
+    QVERIFY( !QFile::exists( indexFileName() + ".old" ) );
+
+    // the pack is still writable
+    QVERIFY( pack.insert( "maps/earth/c.png", "third" ) );
+    QCOMPARE( pack.count(), 2 );
+}
+
+void TilePackTest::testInterruptedCompactionBeforeCommit()
+{
+    {
+        TilePack pack( packFileName() );
+        QVERIFY( pack.insert( "maps/earth/a.png", "first" ) );
+    }
+
+    // the pack was moved aside, the compacted files are not in place yet
+    QVERIFY( QFile::rename( packFileName(), packFileName() + ".old" ) );
+    copyFile( indexFileName(), indexFileName() + ".compact" );
+    QFile compact( packFileName() + ".compact" );
+    QVERIFY( compact.open( QIODevice::WriteOnly ) );
+    compact.write( "incomplete" );
+    compact.close();
+
+    TilePack pack( packFileName() );
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.count(), 1 );
+    QByteArray data;
+    QVERIFY( pack.read( "maps/earth/a.png", data ) );
+    QCOMPARE( data, QByteArray( "first" ) );
+
+    QVERIFY( !QFile::exists( packFileName() + ".compact" ) );
+    QVERIFY( !QFile::exists( indexFileName() + ".compact" ) );
+    QVERIFY( !QFile::exists( packFileName() + ".old" ) );
+}
+
+void TilePackTest::testInterruptedCompactionAfterCommit()
+{
+    {
+        TilePack pack( packFileName() );
+        QVERIFY( pack.insert( "maps/earth/a.png", "first" ) );
+    }
+
+    // both compacted files are in place, only the old ones are left
+    copyFile( packFileName(), packFileName() + ".old" );
+    copyFile( indexFileName(), indexFileName() + ".old" );
+
+    TilePack pack( packFileName() );
+    QVERIFY( pack.isValid() );
+    QCOMPARE( pack.count(), 1 );
+
+    QVERIFY( !QFile::exists( packFileName() + ".old" ) );
+    QVERIFY( !QFile::exists( indexFileName() + ".old" ) );
+}
+
+void TilePackTest::testLock()
+{
+#ifdef Q_OS_UNIX
+    TilePack *first = new TilePack( packFileName() );
+    QVERIFY( first->isValid() );
+    QVERIFY( first->insert( "maps/earth/a.png", "first" ) );
+
+    {
+        // behaves like another process, the lock is held per open file
+        TilePack second( packFileName() );
+        QVERIFY( !second.isValid() );
+        QVERIFY( !second.errorString().isEmpty() );
+        QVERIFY( !second.contains( "maps/earth/a.png" ) );
+        QVERIFY( !second.insert( "maps/earth/b.png", "second" ) );
+    }
+
+    delete first;
+
+    TilePack third( packFileName() );
+    QVERIFY( third.isValid() );
+    QVERIFY( third.contains( "maps/earth/a.png" ) );
+#else
+    QSKIP( "The tile pack is only locked on Unix", SkipAll );
+#endif
+}
+
+}
+
+QTEST_MAIN( Marble::TilePackTest )
+
+#include "TilePackTest.moc"
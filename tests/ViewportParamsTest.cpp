@@ -9,6 +9,8 @@
 // Copyright 2012,2013  Bernhard Beschow <bbeschow@cs.tu-berlin.de>
 //
 
+#include <QRunnable>
+#include <QThreadPool>
 #include <QtTest>
 #include "TestUtils.h"
 
@@ -40,6 +42,9 @@ class ViewportParamsTest : public QObject
     void geoDataLinearRing_data();
     void geoDataLinearRing();
 
+    void screenCoordinates_sharedLineStrings_data();
+    void screenCoordinates_sharedLineStrings();
+
     void setInvalidRadius();
 
     void setFocusPoint();
@@ -458,6 +463,106 @@ void ViewportParamsTest::geoDataLinearRing()
     QCOMPARE( polys.size(), size );
 }
 
+/**
+ * Projects copies of the same line strings on several threads, like
+ * GeometryLayer does. The copies share the lazily computed boxes.
+ */
+class ProjectionJob : public QRunnable
+{
+ public:
+    ProjectionJob( const ViewportParams *viewport, const QVector<GeoDataLineString> &lineStrings )
+        : m_viewport( viewport ),
+          m_lineStrings( lineStrings )
+    {
+        setAutoDelete( false );
+    }
+
+    ~ProjectionJob()
+    {
+        foreach ( const QVector<QPolygonF*> &polygons, m_polygons ) {
+            qDeleteAll( polygons );
+        }
+    }
+
+    virtual void run()
+    {
+        foreach ( const GeoDataLineString &lineString, m_lineStrings ) {
+            QVector<QPolygonF*> polygons;
+            m_viewport->screenCoordinates( lineString, polygons );
+            m_polygons << polygons;
+        }
+    }
+
+    const QVector<QVector<QPolygonF*> > &polygons() const { return m_polygons; }
+
+ private:
+    const ViewportParams *const m_viewport;
+    const QVector<GeoDataLineString> m_lineStrings;
+    QVector<QVector<QPolygonF*> > m_polygons;
+};
+
+void ViewportParamsTest::screenCoordinates_sharedLineStrings_data()
+{
+    QTest::addColumn<Marble::Projection>( "projection" );
+
+    addRow() << Spherical;
+    addRow() << Equirectangular;
+    addRow() << Mercator;
+}
+
+void ViewportParamsTest::screenCoordinates_sharedLineStrings()
+{
+    QFETCH( Marble::Projection, projection );
+
+    const ViewportParams viewport( projection, 170 * DEG2RAD, 20 * DEG2RAD, 400, QSize( 800, 600 ) );
+    // GeometryLayer computes the view box before starting its jobs, too
+    viewport.viewLatLonAltBox();
+
+    // none of the boxes has been computed yet
+    QVector<GeoDataLineString> lineStrings;
+    for ( int i = 0; i < 200; ++i ) {
+        GeoDataLineString lineString( Tessellate );
+        for ( int j = 0; j < 50; ++j ) {
+            lineString << GeoDataCoordinates( 120.0 + i * 0.5 + j, -40.0 + i * 0.4 + j * 0.2, 0.0, GeoDataCoordinates::Degree );
+        }
+        lineStrings << lineString;
+    }
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount( 8 );
+    QList<ProjectionJob *> jobs;
+    for ( int i = 0; i < 8; ++i ) {
+        jobs << new ProjectionJob( &viewport, lineStrings );
+        threadPool.start( jobs.last() );
+    }
+    threadPool.waitForDone();
+
+    foreach ( ProjectionJob *job, jobs ) {
+        QCOMPARE( job->polygons().size(), lineStrings.size() );
+    }
+
+    // compare with line strings which don't share anything with the ones above
+    for ( int i = 0; i < lineStrings.size(); ++i ) {
+        GeoDataLineString unshared( Tessellate );
+        for ( int j = 0; j < lineStrings[i].size(); ++j ) {
+            unshared << lineStrings[i].at( j );
+        }
+        QCOMPARE( lineStrings[i].latLonAltBox(), unshared.latLonAltBox() );
+
+        QVector<QPolygonF*> polygons;
+        viewport.screenCoordinates( unshared, polygons );
+        foreach ( ProjectionJob *job, jobs ) {
+            QCOMPARE( job->polygons()[i].size(), polygons.size() );
+            for ( int j = 0; j < polygons.size(); ++j ) {
+                QCOMPARE( *job->polygons()[i][j], *polygons[j] );
+            }
+        }
+        qDeleteAll( polygons );
+    }
+
+    qDeleteAll( jobs );
+}
+
 void ViewportParamsTest::setInvalidRadius()
 {
     ViewportParams viewport;
@@ -23,10 +23,13 @@ int main(int argc, char *argv[])
     /*
             PREFIX: this is the prefix of the source directory
             TARGETDIR: the directory where the output should go to
+            THREADS: the number of threads encoding tiles, one per core if omitted
             */
-        qDebug() << "Syntax: tilecreator PREFIX TARGETDIR";
+        qDebug() << "Syntax: tilecreator PREFIX TARGETDIR [THREADS]";
         return -1;
     } else {
-        return app.exec();
+        const int result = app.exec();
+        app.printStatistics();
+        return app.failed() ? 1 : result;
     }
 }
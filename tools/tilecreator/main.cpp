@@ -23,10 +23,13 @@ int main(int argc, char *argv[])
             INSTALLMAP: this is the map that you want to install - in the form MAPNAME/MAPNAME.jpg
             DEM: Digital Elevation Model(grayscale) set to "true" for srtm sources set to "false" else
             TARGETDIR: the directory where the output should go to
+            THREADS: the number of threads encoding tiles, one per core if omitted
             */
-        qDebug() << "Syntax: tilecreator PREFIX INSTALLMAP DEM TARGETDIR";
+        qDebug() << "Syntax: tilecreator PREFIX INSTALLMAP DEM TARGETDIR [THREADS]";
         return -1;
     } else {
-        return app.exec();
+        const int result = app.exec();
+        app.printStatistics();
+        return app.failed() ? 1 : result;
     }
 }
@@ -12,12 +12,36 @@
 
 using namespace Marble;
 
-TCCoreApplication::TCCoreApplication( int & argc, char ** argv ) : QCoreApplication( argc, argv )
+TCCoreApplication::TCCoreApplication( int & argc, char ** argv ) : QCoreApplication( argc, argv ),
+    m_tilecreator( 0 )
 {
     if( !(argc < 5) )
     {
         m_tilecreator = new TileCreator( argv [1], argv[2], argv[3], argv[4] );
+        if ( argc > 5 )
+            m_tilecreator->setThreadCount( QString( argv[5] ).toInt() );
         connect(m_tilecreator, SIGNAL(finished()), this, SLOT(quit()));
+        m_time.start();
         m_tilecreator->start();
     }
 }
+
+void TCCoreApplication::printStatistics() const
+{
+    if ( !m_tilecreator )
+        return;
+
+    const int elapsed = m_time.elapsed();
+    const int tiles = m_tilecreator->createdTilesCount();
+    qDebug() << "Created" << tiles << "tiles in" << elapsed / 1000.0 << "s,"
+             << ( elapsed > 0 ? 1000.0 * tiles / elapsed : 0.0 ) << "tiles/s using"
+             << m_tilecreator->threadCount() << "threads";
+
+    if ( failed() )
+        qWarning() << m_tilecreator->failedTilesCount() << "tiles could not be written";
+}
+
+bool TCCoreApplication::failed() const
+{
+    return m_tilecreator && m_tilecreator->failedTilesCount() > 0;
+}
@@ -16,6 +16,7 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QObject>
+#include <QTime>
 
 #include <marble/TileCreator.h>
 
@@ -27,8 +28,19 @@ class TCCoreApplication : public QCoreApplication
     public:
         TCCoreApplication( int & argc, char ** argv );
 
+        /**
+         * Prints how many tiles have been created and how fast.
+         */
+        void printStatistics() const;
+
+        /**
+         * Returns whether tiles could not be written.
+         */
+        bool failed() const;
+
     private:
         TileCreator *m_tilecreator;
+        QTime m_time;
 };
 
 }